@@ -9,8 +9,21 @@
 #import "iTerm2SandboxedWorker.h"
 #import "iTermImage+ImageWithData.h"
 #import "iTermImage+Sixel.h"
+#import "iTermSixelStream.h"
 
-@implementation iTerm2SandboxedWorker
+@implementation iTerm2SandboxedWorker {
+    // Sixel images being decoded a piece at a time, by identifier. Messages on a connection are
+    // delivered serially, so this needs no lock.
+    NSMutableDictionary<NSString *, iTermSixelStream *> *_sixelStreams;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _sixelStreams = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
 
 - (void)decodeImageFromData:(NSData *)imageData withReply:(void (^)(iTermImage *))reply {
     reply([[iTermImage alloc] initWithData:imageData]);
@@ -20,4 +33,46 @@
     reply([[iTermImage alloc] initWithSixelData:imageData]);
 }
 
+- (void)appendSixelData:(NSData *)data
+  toImageWithIdentifier:(NSString *)identifier
+              withReply:(void (^)(NSData *, NSInteger, NSInteger, NSInteger, BOOL))reply {
+    iTermSixelStream *stream = _sixelStreams[identifier];
+    if (!stream) {
+        stream = [[iTermSixelStream alloc] init];
+        if (stream) {
+            _sixelStreams[identifier] = stream;
+        }
+    }
+    if (!stream || ![stream appendData:data]) {
+        [_sixelStreams removeObjectForKey:identifier];
+        reply(nil, 0, 0, 0, NO);
+        return;
+    }
+    NSInteger firstRow = 0;
+    NSInteger width = 0;
+    NSInteger height = 0;
+    BOOL declaredSize = NO;
+    NSData *rgba = [stream takeNewRowsWithFirstRow:&firstRow
+                                             width:&width
+                                            height:&height
+                                      declaredSize:&declaredSize];
+    reply(rgba, firstRow, width, height, declaredSize);
+}
+
+- (void)finishSixelData:(NSData *)data
+  toImageWithIdentifier:(NSString *)identifier
+              withReply:(void (^)(iTermImage *))reply {
+    iTermSixelStream *stream = _sixelStreams[identifier];
+    [_sixelStreams removeObjectForKey:identifier];
+    if (![stream appendData:data]) {
+        reply(nil);
+        return;
+    }
+    reply([stream imageByFinishing]);
+}
+
+- (void)cancelSixelImageWithIdentifier:(NSString *)identifier {
+    [_sixelStreams removeObjectForKey:identifier];
+}
+
 @end
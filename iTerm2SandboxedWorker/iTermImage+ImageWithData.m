@@ -59,6 +59,7 @@
 - (instancetype)initWithData:(NSData *)data {
     self = [self init];
     if (self) {
+        self.digest = [iTermImage digestForData:data];
         NSImage *image = [[NSImage alloc] initWithData:data];
         NSImageRep *rep = [[image representations] firstObject];
         NSSize imageSize = NSMakeSize(rep.pixelsWide, rep.pixelsHigh);
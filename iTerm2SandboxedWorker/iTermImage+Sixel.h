@@ -6,6 +6,7 @@
 //
 
 #import "iTermImage.h"
+#include "iTermSixelDecoder.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -13,6 +14,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (instancetype)initWithSixelData:(NSData *)data;
 
+// Makes an image of everything the decoder has drawn so far.
+- (nullable instancetype)initWithSixelDecoder:(const iTermSixelDecoder *)decoder;
+
 @end
 
 NS_ASSUME_NONNULL_END
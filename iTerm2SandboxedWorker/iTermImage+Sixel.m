@@ -7,7 +7,6 @@
 
 #import "iTermImage+Sixel.h"
 #import "iTermImage+Private.h"
-#include "sixel.h"
 
 @implementation NSImage(ImageDecoder)
 
@@ -40,40 +39,14 @@
 
 @end
 
-static NSImage *DecodeSixelData(sixel_decoder_t *decoder, NSData *data) {
-    unsigned char *pixels = NULL;
-    int width = 0;
-    int height = 0;
-    unsigned char *palette = NULL;  // argb
-    int ncolors = 0;
-    if (data.length >= INT_MAX) {
+static NSImage *ImageFromSixelDecoder(const iTermSixelDecoder *decoder) {
+    const int width = iTermSixelDecoderGetWidth(decoder);
+    const int height = iTermSixelDecoderGetHeight(decoder);
+    NSMutableData *rgbaData = [NSMutableData dataWithLength:(NSUInteger)width * height * 4];
+    if (!rgbaData) {
         return nil;
     }
-    SIXELSTATUS status = sixel_decode_raw((unsigned char *)[[data mutableCopy] mutableBytes],
-                                          (int)data.length,
-                                          &pixels,
-                                          &width,
-                                          &height,
-                                          &palette,
-                                          &ncolors,
-                                          NULL);
-    if (status != SIXEL_OK || ncolors <= 0) {
-        return nil;
-    }
-    
-    const int limit = ncolors - 1;
-    NSMutableData *rgbaData = [NSMutableData dataWithLength:width * height * 4];
-    unsigned char *rgba = rgbaData.mutableBytes;
-    const int stride = 3;
-    for (int i = 0; i < width * height; i++) {
-        const unsigned char index = MAX(0, MIN(pixels[i], limit));
-        rgba[i * 4 + 0] = palette[index * stride + 0];
-        rgba[i * 4 + 1] = palette[index * stride + 1];
-        rgba[i * 4 + 2] = palette[index * stride + 2];
-        rgba[i * 4 + 3] = 0xff;
-    }
-    free(palette);
-    free(pixels);
+    iTermSixelDecoderCopyRGBA(decoder, 0, height, rgbaData.mutableBytes);
     return [NSImage imageWithRawData:rgbaData
                                 size:NSMakeSize(width, height)
                        bitsPerSample:8
@@ -82,34 +55,25 @@ static NSImage *DecodeSixelData(sixel_decoder_t *decoder, NSData *data) {
                       colorSpaceName:NSDeviceRGBColorSpace];
 }
 
-
+// The data begins with a header line giving the DCS parameters, which the decoder doesn't need
+// because the introducer that follows repeats them.
 static NSImage *ImageFromSixelData(NSData *data) {
     NSData *newlineData = [@"\n" dataUsingEncoding:NSUTF8StringEncoding];
     NSRange range = [data rangeOfData:newlineData options:0 range:NSMakeRange(0, data.length)];
     if (range.location == NSNotFound) {
         return nil;
     }
-    NSData *params = [data subdataWithRange:NSMakeRange(0, range.location)];
-    NSData *payload = [data subdataWithRange:NSMakeRange(NSMaxRange(range), data.length - NSMaxRange(range))];
-    NSString *paramString = [[NSString alloc] initWithData:params encoding:NSUTF8StringEncoding];
-    if (!paramString) {
+    iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+    if (!decoder) {
         return nil;
     }
-    sixel_decoder_t *decoder;
-    SIXELSTATUS status = sixel_decoder_new(&decoder, NULL);
-    if (status != SIXEL_OK) {
-        return nil;
+    NSImage *image = nil;
+    if (iTermSixelDecoderAppend(decoder,
+                                data.bytes + NSMaxRange(range),
+                                data.length - NSMaxRange(range))) {
+        image = ImageFromSixelDecoder(decoder);
     }
-    NSArray<NSString *> *paramParts = [paramString componentsSeparatedByString:@";"];
-    [paramParts enumerateObjectsUsingBlock:^(NSString * _Nonnull value, NSUInteger index, BOOL * _Nonnull stop) {
-        sixel_decoder_setopt(decoder,
-                             (int)index,
-                             value.UTF8String);
-    }];
-    
-    NSImage *image = DecodeSixelData(decoder, payload);
-    sixel_decoder_unref(decoder);
-    
+    iTermSixelDecoderFree(decoder);
     return image;
 }
 
@@ -124,6 +88,20 @@ static NSImage *ImageFromSixelData(NSData *data) {
         }
         [self.images addObject:image];
         self.size = image.size;
+        self.digest = [iTermImage digestForData:data];
+    }
+    return self;
+}
+
+- (instancetype)initWithSixelDecoder:(const iTermSixelDecoder *)decoder {
+    self = [self init];
+    if (self) {
+        NSImage *image = ImageFromSixelDecoder(decoder);
+        if (!image) {
+            return nil;
+        }
+        [self.images addObject:image];
+        self.size = image.size;
     }
     return self;
 }
@@ -0,0 +1,33 @@
+//
+//  iTermSixelStream.h
+//  iTerm2SandboxedWorker
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class iTermImage;
+
+// Decodes one sixel image as its data arrives and hands out the rows that become complete.
+@interface iTermSixelStream : NSObject
+
+// Returns NO if the decoder ran out of memory. The first data appended begins with the header line
+// the parser puts before the DCS introducer.
+- (BOOL)appendData:(NSData *)data;
+
+// Returns the rows completed since the last call as RGBA, or nil if there are none. If the width
+// of the image has changed since then, all the complete rows are returned again.
+- (nullable NSData *)takeNewRowsWithFirstRow:(out NSInteger *)firstRowPtr
+                                       width:(out NSInteger *)widthPtr
+                                      height:(out NSInteger *)heightPtr
+                                declaredSize:(out BOOL *)declaredSizePtr;
+
+// The image as it stands, with the digest of all the data appended. Call this once, at the end.
+- (nullable iTermImage *)imageByFinishing;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,95 @@
+//
+//  iTermSixelStream.m
+//  iTerm2SandboxedWorker
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermSixelStream.h"
+
+#import "iTermImage+Private.h"
+#import "iTermImage+Sixel.h"
+#include "iTermSixelDecoder.h"
+#import <CommonCrypto/CommonDigest.h>
+
+@implementation iTermSixelStream {
+    iTermSixelDecoder *_decoder;
+    // Digest of everything appended, which is the data the app keeps for the image.
+    CC_SHA256_CTX _digestContext;
+    BOOL _sawHeader;
+    // How much of the image the client has.
+    int _rowsTaken;
+    int _widthTaken;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _decoder = iTermSixelDecoderCreate();
+        if (!_decoder) {
+            return nil;
+        }
+        CC_SHA256_Init(&_digestContext);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    iTermSixelDecoderFree(_decoder);
+}
+
+- (BOOL)appendData:(NSData *)data {
+    CC_SHA256_Update(&_digestContext, data.bytes, (CC_LONG)data.length);
+    const unsigned char *bytes = data.bytes;
+    size_t length = data.length;
+    if (!_sawHeader) {
+        const unsigned char *newline = memchr(bytes, '\n', length);
+        if (!newline) {
+            // The header is never split, so this is garbage.
+            return NO;
+        }
+        _sawHeader = YES;
+        length -= newline + 1 - bytes;
+        bytes = newline + 1;
+    }
+    return iTermSixelDecoderAppend(_decoder, bytes, length);
+}
+
+- (NSData *)takeNewRowsWithFirstRow:(out NSInteger *)firstRowPtr
+                              width:(out NSInteger *)widthPtr
+                             height:(out NSInteger *)heightPtr
+                       declaredSize:(out BOOL *)declaredSizePtr {
+    const int width = iTermSixelDecoderGetWidth(_decoder);
+    const int height = iTermSixelDecoderGetHeight(_decoder);
+    const int completeRows = iTermSixelDecoderGetNumberOfCompleteRows(_decoder);
+    if (width != _widthTaken) {
+        _rowsTaken = 0;
+        _widthTaken = width;
+    }
+    *firstRowPtr = _rowsTaken;
+    *widthPtr = width;
+    *heightPtr = height;
+    *declaredSizePtr = iTermSixelDecoderHasDeclaredSize(_decoder);
+
+    const int count = completeRows - _rowsTaken;
+    if (count <= 0) {
+        return nil;
+    }
+    NSMutableData *rgba = [NSMutableData dataWithLength:(NSUInteger)width * count * 4];
+    if (!rgba) {
+        return nil;
+    }
+    iTermSixelDecoderCopyRGBA(_decoder, _rowsTaken, count, rgba.mutableBytes);
+    _rowsTaken = completeRows;
+    return rgba;
+}
+
+- (iTermImage *)imageByFinishing {
+    iTermImage *image = [[iTermImage alloc] initWithSixelDecoder:_decoder];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &_digestContext);
+    image.digest = [NSData dataWithBytes:digest length:sizeof(digest)];
+    return image;
+}
+
+@end
@@ -0,0 +1,201 @@
+//
+//  DVRTest.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import "DVR.h"
+#import "DVRStream.h"
+#import "ScreenChar.h"
+
+static const int kWidth = 20;
+static const int kHeight = 10;
+
+@interface DVRTest : XCTestCase
+@end
+
+@implementation DVRTest
+
+// Line `n` of an endless scrolling log.
+- (NSMutableData *)lineNumbered:(int)n {
+    NSMutableData *data = [NSMutableData dataWithLength:(kWidth + 1) * sizeof(screen_char_t)];
+    screen_char_t *line = data.mutableBytes;
+    NSString *string = [NSString stringWithFormat:@"line %d", n];
+    for (int x = 0; x < string.length; x++) {
+        line[x].code = [string characterAtIndex:x];
+    }
+    line[kWidth].code = EOL_HARD;
+    return data;
+}
+
+- (NSArray<NSData *> *)frameStartingAtLine:(int)first {
+    NSMutableArray<NSData *> *lines = [NSMutableArray array];
+    for (int y = 0; y < kHeight; y++) {
+        [lines addObject:[self lineNumbered:first + y]];
+    }
+    return lines;
+}
+
+- (NSData *)combinedLines:(NSArray<NSData *> *)lines {
+    NSMutableData *data = [NSMutableData data];
+    for (NSData *line in lines) {
+        [data appendData:line];
+    }
+    return data;
+}
+
+- (void)testScrollingRoundTrips {
+    DVR *dvr = [[[DVR alloc] initWithBufferCapacity:1024 * 1024] autorelease];
+    const int length = (kWidth + 1) * kHeight * sizeof(screen_char_t);
+    const int numFrames = 50;
+    for (int i = 0; i < numFrames; i++) {
+        DVRFrameInfo info = { .width = kWidth, .height = kHeight };
+        // Nothing is known to be clean, as when the screen scrolls.
+        [dvr appendFrame:[self frameStartingAtLine:i]
+                  length:length
+              cleanLines:[NSIndexSet indexSet]
+                    info:&info];
+    }
+
+    // Each scrolled frame is one copy sequence and one line of new text, and the key frame is
+    // compressed.
+    XCTAssertGreaterThan(dvr.compressionRatio, 5);
+
+    DVRDecoder *decoder = [dvr getDecoder];
+    XCTAssertTrue([decoder seek:0]);
+    for (int i = 0; i < numFrames; i++) {
+        XCTAssertEqual([decoder length], length);
+        NSData *actual = [NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]];
+        XCTAssertEqualObjects(actual, [self combinedLines:[self frameStartingAtLine:i]]);
+        XCTAssertEqual([decoder next], i + 1 < numFrames);
+    }
+
+    // Seeking backwards replays the diffs from the key frame.
+    XCTAssertTrue([decoder prev]);
+    NSData *actual = [NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]];
+    XCTAssertEqualObjects(actual, [self combinedLines:[self frameStartingAtLine:numFrames - 2]]);
+    [dvr releaseDecoder:decoder];
+}
+
+- (void)testSeekAfterOldFramesAreFreed {
+    // Small enough that most frames get freed, so the index wraps around many times.
+    DVR *dvr = [[[DVR alloc] initWithBufferCapacity:16 * 1024] autorelease];
+    const int length = (kWidth + 1) * kHeight * sizeof(screen_char_t);
+    const int numFrames = 500;
+    for (int i = 0; i < numFrames; i++) {
+        DVRFrameInfo info = { .width = kWidth, .height = kHeight };
+        [dvr appendFrame:[self frameStartingAtLine:i]
+                  length:length
+              cleanLines:[NSIndexSet indexSet]
+                    info:&info];
+    }
+
+    // Record the timestamp of each frame still in the buffer.
+    DVRDecoder *decoder = [dvr getDecoder];
+    XCTAssertTrue([decoder seek:0]);
+    NSMutableArray<NSNumber *> *timestamps = [NSMutableArray array];
+    NSMutableArray<NSData *> *frames = [NSMutableArray array];
+    do {
+        [timestamps addObject:@(decoder.timestamp)];
+        [frames addObject:[NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]]];
+    } while ([decoder next]);
+    XCTAssertLessThan(timestamps.count, numFrames);
+    XCTAssertEqualObjects(frames.lastObject, [self combinedLines:[self frameStartingAtLine:numFrames - 1]]);
+
+    // Seek backwards to each timestamp. Frames can share a timestamp, in which case seeking finds
+    // the first of them.
+    for (NSInteger i = timestamps.count - 1; i >= 0; i--) {
+        XCTAssertTrue([decoder seek:timestamps[i].longLongValue]);
+        const NSInteger expected = [timestamps indexOfObject:timestamps[i]];
+        NSData *actual = [NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]];
+        XCTAssertEqualObjects(actual, frames[expected]);
+    }
+    XCTAssertFalse([decoder seek:timestamps.lastObject.longLongValue + 1]);
+    [dvr releaseDecoder:decoder];
+}
+
+- (void)testStreamRoundTrips {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    DVR *dvr = [[[DVR alloc] initWithBufferCapacity:1024 * 1024] autorelease];
+    DVRStreamWriter *writer = [[[DVRStreamWriter alloc] initWithPath:path] autorelease];
+    XCTAssertNotNil(writer);
+    dvr.streamWriter = writer;
+    const int length = (kWidth + 1) * kHeight * sizeof(screen_char_t);
+    const int numFrames = 50;
+    for (int i = 0; i < numFrames; i++) {
+        DVRFrameInfo info = { .width = kWidth, .height = kHeight, .timestamp = 1000 + i };
+        [dvr appendFrame:[self frameStartingAtLine:i]
+                  length:length
+              cleanLines:[NSIndexSet indexSet]
+                    info:&info];
+    }
+    [writer close];
+
+    DVR *loaded = [[[DVR alloc] initWithBufferCapacity:1] autorelease];
+    XCTAssertTrue([loaded loadStreamAtPath:path]);
+    XCTAssertTrue(loaded.readOnly);
+    XCTAssertEqual(loaded.firstTimeStamp, 1000);
+    XCTAssertEqual(loaded.lastTimeStamp, 1000 + numFrames - 1);
+
+    DVRDecoder *decoder = [loaded getDecoder];
+    for (int i = numFrames - 1; i >= 0; i--) {
+        XCTAssertTrue([decoder seek:1000 + i]);
+        NSData *actual = [NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]];
+        XCTAssertEqualObjects(actual, [self combinedLines:[self frameStartingAtLine:i]]);
+    }
+    [loaded releaseDecoder:decoder];
+
+    // Without the index, as after a crash, the frames are found by scanning.
+    NSString *truncatedPath = [path stringByAppendingString:@"-truncated"];
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    [[data subdataWithRange:NSMakeRange(0, data.length - 4)] writeToFile:truncatedPath atomically:NO];
+    DVR *recovered = [[[DVR alloc] initWithBufferCapacity:1] autorelease];
+    XCTAssertTrue([recovered loadStreamAtPath:truncatedPath]);
+    XCTAssertEqual(recovered.lastTimeStamp, 1000 + numFrames - 1);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:truncatedPath error:nil];
+}
+
+// When the disk can't keep up, frames are dropped instead of piling up in memory. Whatever does get
+// written must still decode, so after a gap the recording resumes with a key frame.
+- (void)testStreamDropsFramesWhenBackloggedAndStaysDecodable {
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    DVR *dvr = [[[DVR alloc] initWithBufferCapacity:1024 * 1024] autorelease];
+    DVRStreamWriter *writer = [[[DVRStreamWriter alloc] initWithPath:path] autorelease];
+    XCTAssertNotNil(writer);
+    // Anything waiting to be written counts as a backlog.
+    writer.maximumPendingBytes = 1;
+    dvr.streamWriter = writer;
+    const int length = (kWidth + 1) * kHeight * sizeof(screen_char_t);
+    const int numFrames = 200;
+    for (int i = 0; i < numFrames; i++) {
+        DVRFrameInfo info = { .width = kWidth, .height = kHeight, .timestamp = 1000 + i };
+        [dvr appendFrame:[self frameStartingAtLine:i]
+                  length:length
+              cleanLines:[NSIndexSet indexSet]
+                    info:&info];
+    }
+    [writer close];
+
+    DVR *loaded = [[[DVR alloc] initWithBufferCapacity:1] autorelease];
+    XCTAssertTrue([loaded loadStreamAtPath:path]);
+    DVRDecoder *decoder = [loaded getDecoder];
+    XCTAssertTrue([decoder seek:loaded.firstTimeStamp]);
+    int count = 0;
+    do {
+        const int i = (int)(decoder.timestamp - 1000);
+        XCTAssertGreaterThanOrEqual(i, 0);
+        XCTAssertLessThan(i, numFrames);
+        NSData *actual = [NSData dataWithBytes:[decoder decodedFrame] length:[decoder length]];
+        XCTAssertEqualObjects(actual, [self combinedLines:[self frameStartingAtLine:i]]);
+        count++;
+    } while ([decoder next]);
+    XCTAssertGreaterThan(count, 0);
+    XCTAssertLessThanOrEqual(count, numFrames);
+    [loaded releaseDecoder:decoder];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+@end
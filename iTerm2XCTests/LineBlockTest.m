@@ -0,0 +1,285 @@
+//
+//  LineBlockTest.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import "iTermAdvancedSettingsModel.h"
+#import "iTermFakeUserDefaults.h"
+#import "iTermSelectorSwizzler.h"
+#import "LineBlock.h"
+
+extern NSString *const kLineBlockRawBufferKey;
+extern NSString *const kLineBlockBufferStartOffsetKey;
+extern NSString *const kLineBlockStartOffsetKey;
+extern NSString *const kLineBlockFirstEntryKey;
+extern NSString *const kLineBlockBufferSizeKey;
+extern NSString *const kLineBlockCLLKey;
+extern NSString *const kLineBlockIsPartialKey;
+extern NSString *const kLineBlockMetadataKey;
+extern NSString *const kLineBlockMayHaveDWCKey;
+extern NSString *const kLineBlockGuid;
+extern NSString *const kLineBlockPackedKey;
+
+static const int kLineBlockTestWidth = 80;
+
+@interface LineBlockTest : XCTestCase
+@end
+
+@implementation LineBlockTest
+
+#pragma mark - Helpers
+
+- (screen_char_t)continuationWithCode:(unichar)code {
+    screen_char_t continuation;
+    memset(&continuation, 0, sizeof(continuation));
+    continuation.code = code;
+    continuation.backgroundColor = 3;
+    continuation.bgGreen = 4;
+    continuation.bgBlue = 5;
+    continuation.backgroundColorMode = 1;
+    return continuation;
+}
+
+// Appends lines of repetitive text so the raw buffer compresses well.
+- (LineBlock *)blockWithLines:(NSArray<NSString *> *)lines lastIsPartial:(BOOL)lastIsPartial {
+    LineBlock *block = [[[LineBlock alloc] initWithRawBufferSize:8192] autorelease];
+    for (NSUInteger i = 0; i < lines.count; i++) {
+        NSString *line = lines[i];
+        const int length = (int)line.length;
+        screen_char_t *buffer = (screen_char_t *)calloc(MAX(1, length), sizeof(screen_char_t));
+        for (int j = 0; j < length; j++) {
+            buffer[j].code = [line characterAtIndex:j];
+        }
+        const BOOL partial = (lastIsPartial && i + 1 == lines.count);
+        XCTAssertTrue([block appendLine:buffer
+                                 length:length
+                                partial:partial
+                                  width:kLineBlockTestWidth
+                              timestamp:1000.5 + i
+                           continuation:[self continuationWithCode:partial ? EOL_SOFT : EOL_HARD]]);
+        free(buffer);
+    }
+    return block;
+}
+
+- (NSArray<NSString *> *)sampleLines {
+    NSMutableArray<NSString *> *lines = [NSMutableArray array];
+    for (int i = 0; i < 50; i++) {
+        [lines addObject:[@"" stringByPaddingToLength:i % 7 * 10
+                                           withString:@"abc"
+                                      startingAtIndex:0]];
+    }
+    [lines addObject:@"the end"];
+    return lines;
+}
+
+- (void)assertBlock:(LineBlock *)actual equalsBlock:(LineBlock *)expected {
+    XCTAssertNotNil(actual);
+    XCTAssertEqual(actual.numEntries, expected.numEntries);
+    XCTAssertEqual(actual.numRawLines, expected.numRawLines);
+    XCTAssertEqual(actual.firstEntry, expected.firstEntry);
+    XCTAssertEqual(actual.startOffset, expected.startOffset);
+    XCTAssertEqual(actual.rawSpaceUsed, expected.rawSpaceUsed);
+    XCTAssertEqual(actual.hasPartial, expected.hasPartial);
+    XCTAssertEqual([actual getNumLinesWithWrapWidth:kLineBlockTestWidth],
+                   [expected getNumLinesWithWrapWidth:kLineBlockTestWidth]);
+    for (int entry = expected.firstEntry; entry < expected.numEntries; entry++) {
+        int expectedLength = 0;
+        int actualLength = 0;
+        const screen_char_t *expectedChars = [expected charactersOfRawLine:entry length:&expectedLength];
+        const screen_char_t *actualChars = [actual charactersOfRawLine:entry length:&actualLength];
+        XCTAssertEqual(actualLength, expectedLength);
+        XCTAssertEqual(memcmp(actualChars, expectedChars, expectedLength * sizeof(screen_char_t)), 0);
+    }
+    const int numLines = [expected getNumLinesWithWrapWidth:kLineBlockTestWidth];
+    for (int i = 0; i < numLines; i++) {
+        XCTAssertEqual([actual timestampForLineNumber:i width:kLineBlockTestWidth],
+                       [expected timestampForLineNumber:i width:kLineBlockTestWidth]);
+    }
+}
+
+- (NSDictionary *)dictionaryForBlock:(LineBlock *)block compressed:(BOOL)compressed {
+    __block NSDictionary *dictionary = nil;
+    iTermFakeUserDefaults *fakeDefaults = [[[iTermFakeUserDefaults alloc] init] autorelease];
+    [fakeDefaults setFakeObject:@(compressed) forKey:@"CompressScrollbackInRestorableState"];
+    [iTermSelectorSwizzler swizzleSelector:@selector(standardUserDefaults)
+                                 fromClass:[NSUserDefaults class]
+                                 withBlock:^ id { return fakeDefaults; }
+                                  forBlock:^{
+        [iTermAdvancedSettingsModel loadAdvancedSettingsFromUserDefaults];
+        dictionary = [[block dictionary] retain];
+    }];
+    [iTermAdvancedSettingsModel loadAdvancedSettingsFromUserDefaults];
+    return [dictionary autorelease];
+}
+
+- (NSDictionary *)dictionary:(NSDictionary *)dictionary withObject:(id)object forKey:(NSString *)key {
+    NSMutableDictionary *temp = [[dictionary mutableCopy] autorelease];
+    temp[key] = object;
+    return temp;
+}
+
+#pragma mark - Round Trip
+
+- (void)testRoundTripUncompressed {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:YES];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+
+    NSData *packed = dictionary[kLineBlockPackedKey];
+    XCTAssertNotNil(packed);
+    XCTAssertNil(dictionary[kLineBlockCLLKey]);
+    XCTAssertNil(dictionary[kLineBlockMetadataKey]);
+    XCTAssertEqual(((const uint8_t *)packed.bytes)[1], 0);
+    XCTAssertEqual([dictionary[kLineBlockRawBufferKey] length], block.rawSpaceUsed * sizeof(screen_char_t));
+
+    [self assertBlock:[LineBlock blockWithDictionary:dictionary] equalsBlock:block];
+}
+
+- (void)testRoundTripCompressed {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:YES];
+
+    NSData *packed = dictionary[kLineBlockPackedKey];
+    XCTAssertEqual(((const uint8_t *)packed.bytes)[1], 1);
+    XCTAssertLessThan([dictionary[kLineBlockRawBufferKey] length], block.rawSpaceUsed * sizeof(screen_char_t));
+
+    [self assertBlock:[LineBlock blockWithDictionary:dictionary] equalsBlock:block];
+}
+
+- (void)testRoundTripAfterDroppingLines {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    int charsDropped = 0;
+    [block dropLines:5 withWidth:kLineBlockTestWidth chars:&charsDropped];
+    XCTAssertGreaterThan(block.firstEntry, 0);
+
+    for (NSNumber *compressed in @[ @NO, @YES ]) {
+        NSDictionary *dictionary = [self dictionaryForBlock:block compressed:compressed.boolValue];
+        [self assertBlock:[LineBlock blockWithDictionary:dictionary] equalsBlock:block];
+    }
+}
+
+#pragma mark - Legacy Format
+
+- (void)testLoadsLegacyFormat {
+    NSArray<NSString *> *lines = [self sampleLines];
+    LineBlock *block = [self blockWithLines:lines lastIsPartial:YES];
+    NSMutableDictionary *legacy = [[[self dictionaryForBlock:block compressed:NO] mutableCopy] autorelease];
+    [legacy removeObjectForKey:kLineBlockPackedKey];
+
+    // Build the boxed arrays the way older versions saved them.
+    NSMutableArray *cll = [NSMutableArray array];
+    NSMutableArray *metadata = [NSMutableArray array];
+    int cumulative = 0;
+    for (NSUInteger i = 0; i < lines.count; i++) {
+        cumulative += (int)lines[i].length;
+        [cll addObject:@(cumulative)];
+        const screen_char_t continuation = [self continuationWithCode:i + 1 == lines.count ? EOL_SOFT : EOL_HARD];
+        [metadata addObject:@[ @(continuation.code),
+                               @(continuation.backgroundColor),
+                               @(continuation.bgGreen),
+                               @(continuation.bgBlue),
+                               @(continuation.backgroundColorMode),
+                               @(1000.5 + i) ]];
+    }
+    legacy[kLineBlockCLLKey] = cll;
+    legacy[kLineBlockMetadataKey] = metadata;
+
+    [self assertBlock:[LineBlock blockWithDictionary:legacy] equalsBlock:block];
+}
+
+- (void)testRejectsLegacyRawBufferLargerThanBuffer {
+    LineBlock *block = [self blockWithLines:@[ @"abc" ] lastIsPartial:NO];
+    NSMutableDictionary *legacy = [[[self dictionaryForBlock:block compressed:NO] mutableCopy] autorelease];
+    [legacy removeObjectForKey:kLineBlockPackedKey];
+    legacy[kLineBlockCLLKey] = @[ @3 ];
+    legacy[kLineBlockMetadataKey] = @[ @[ @(EOL_HARD), @0, @0, @0, @0, @0 ] ];
+    legacy[kLineBlockBufferSizeKey] = @1;
+
+    XCTAssertNil([LineBlock blockWithDictionary:legacy]);
+}
+
+#pragma mark - Malformed Data
+
+- (void)testRejectsTruncatedPackedData {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+    NSData *packed = dictionary[kLineBlockPackedKey];
+
+    for (NSUInteger length = 0; length < packed.length; length += 7) {
+        NSData *truncated = [packed subdataWithRange:NSMakeRange(0, length)];
+        XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                          withObject:truncated
+                                                              forKey:kLineBlockPackedKey]]);
+    }
+    NSData *truncated = [packed subdataWithRange:NSMakeRange(0, packed.length - 1)];
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:truncated
+                                                          forKey:kLineBlockPackedKey]]);
+}
+
+- (void)testRejectsLineLengthsThatDisagreeWithRawBuffer {
+    LineBlock *block = [self blockWithLines:@[ @"abc", @"defg" ] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+    NSMutableData *packed = [[dictionary[kLineBlockPackedKey] mutableCopy] autorelease];
+    // version, flags, raw length, line count, then the first line length.
+    uint8_t *bytes = (uint8_t *)packed.mutableBytes;
+    XCTAssertEqual(bytes[3], 2);
+    XCTAssertEqual(bytes[4], 3);
+    bytes[4] = 4;
+
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:packed
+                                                          forKey:kLineBlockPackedKey]]);
+}
+
+- (void)testRejectsUnknownPackedVersion {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+    NSMutableData *packed = [[dictionary[kLineBlockPackedKey] mutableCopy] autorelease];
+    ((uint8_t *)packed.mutableBytes)[0] = 0xff;
+
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:packed
+                                                          forKey:kLineBlockPackedKey]]);
+}
+
+- (void)testRejectsRawBufferOfWrongLength {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+    NSData *raw = dictionary[kLineBlockRawBufferKey];
+    NSData *shortRaw = [raw subdataWithRange:NSMakeRange(0, raw.length / 2)];
+
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:shortRaw
+                                                          forKey:kLineBlockRawBufferKey]]);
+}
+
+- (void)testRejectsCorruptCompressedRawBuffer {
+    LineBlock *block = [self blockWithLines:[self sampleLines] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:YES];
+    NSMutableData *raw = [[dictionary[kLineBlockRawBufferKey] mutableCopy] autorelease];
+    memset(raw.mutableBytes, 0xa5, raw.length);
+
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:raw
+                                                          forKey:kLineBlockRawBufferKey]]);
+
+    NSData *truncated = [dictionary[kLineBlockRawBufferKey] subdataWithRange:NSMakeRange(0, raw.length / 2)];
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:truncated
+                                                          forKey:kLineBlockRawBufferKey]]);
+}
+
+- (void)testRejectsRawLengthLargerThanBuffer {
+    LineBlock *block = [self blockWithLines:@[ @"abc" ] lastIsPartial:NO];
+    NSDictionary *dictionary = [self dictionaryForBlock:block compressed:NO];
+
+    XCTAssertNil([LineBlock blockWithDictionary:[self dictionary:dictionary
+                                                      withObject:@1
+                                                          forKey:kLineBlockBufferSizeKey]]);
+}
+
+@end
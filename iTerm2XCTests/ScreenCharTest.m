@@ -0,0 +1,145 @@
+//
+//  ScreenCharTest.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "ScreenChar.h"
+
+static const NSInteger kUnicodeVersion = 9;
+
+// The largest complex char key. Keys wrap around to 1 after it.
+static const int ScreenCharTestLastKey = 0xefff;
+
+// Enough complex chars to wrap around the key space and delete enough entries from the lookup table
+// to force it to be rebuilt.
+static const int ScreenCharTestChurnCount = 0xf000 + 40000;
+
+@interface ScreenCharTest : XCTestCase
+@end
+
+@implementation ScreenCharTest {
+    // Index of the next string from -uniqueComplexString.
+    uint32_t _nextString;
+}
+
+- (void)setUp {
+    // Start somewhere random so strings interned by earlier runs in the same process aren't reused.
+    _nextString = arc4random_uniform(1 << 24);
+}
+
+#pragma mark - Helpers
+
+// A CJK ideograph followed by two combining marks. Each is a single grapheme, and so a single
+// complex char.
+- (NSString *)uniqueComplexString {
+    const uint32_t n = _nextString++;
+    const unichar chars[] = {
+        0x4e00 + n % 20000,
+        0x0300 + (n / 20000) % 112,
+        0x0300 + (n / (20000 * 112)) % 112
+    };
+    return [NSString stringWithCharacters:chars length:sizeof(chars) / sizeof(*chars)];
+}
+
+- (screen_char_t)screenCharForString:(NSString *)string {
+    screen_char_t buf[string.length * 2];
+    screen_char_t zero = { 0 };
+    int len = 0;
+    BOOL foundDwc = NO;
+    StringToScreenChars(string,
+                        buf,
+                        zero,
+                        zero,
+                        &len,
+                        NO,
+                        NULL,
+                        &foundDwc,
+                        iTermUnicodeNormalizationNone,
+                        kUnicodeVersion);
+    XCTAssertTrue(buf[0].complexChar);
+    return buf[0];
+}
+
+- (int)keyForString:(NSString *)string {
+    return [self screenCharForString:string].code;
+}
+
+- (void)setNextKey:(int)key {
+    ScreenCharDecodeRestorableState(@{ @"Next Key": @(key),
+                                       @"Has Wrapped": @YES });
+}
+
+#pragma mark - Tests
+
+- (void)testInterningReturnsTheSameKey {
+    NSString *string = [self uniqueComplexString];
+    const int key = [self keyForString:string];
+    XCTAssertEqualObjects(ComplexCharToStr(key), string);
+    XCTAssertEqual([self keyForString:[[string mutableCopy] autorelease]], key);
+}
+
+// Wrapping around reuses keys, which deletes their old strings from the lookup table. Enough
+// deletions cause the table to be rebuilt. Recently interned strings must still be found under
+// their keys afterwards.
+- (void)testLookupSurvivesWraparoundAndRebuild {
+    NSMutableArray<NSString *> *strings = [NSMutableArray array];
+    NSMutableArray<NSNumber *> *keys = [NSMutableArray array];
+    for (int i = 0; i < ScreenCharTestChurnCount; i++) {
+        NSString *string = [self uniqueComplexString];
+        const int key = [self keyForString:string];
+        if (i >= ScreenCharTestChurnCount - 2000) {
+            [strings addObject:string];
+            [keys addObject:@(key)];
+        }
+    }
+    XCTAssertEqual([NSSet setWithArray:keys].count, keys.count);
+    for (NSUInteger i = 0; i < strings.count; i++) {
+        XCTAssertEqualObjects(ComplexCharToStr(keys[i].intValue), strings[i]);
+        XCTAssertEqual([self keyForString:strings[i]], keys[i].intValue);
+    }
+}
+
+// After wrapping, a key that a line block holds is passed over. Once the reference is released its
+// count reaches zero and the key can be reused.
+- (void)testReferencedKeyIsReusedOnlyAfterRelease {
+    [self setNextKey:ScreenCharTestLastKey];
+    NSString *held = [self uniqueComplexString];
+    const screen_char_t heldChar = [self screenCharForString:held];
+    XCTAssertEqual(heldChar.code, ScreenCharTestLastKey);
+    ScreenCharRetainComplexChars(&heldChar, 1);
+
+    // Come back around to the held key. The next string gets a key past the wraparound instead.
+    [self setNextKey:ScreenCharTestLastKey];
+    const int other = [self keyForString:[self uniqueComplexString]];
+    XCTAssertNotEqual(other, ScreenCharTestLastKey);
+    XCTAssertLessThan(other, ScreenCharTestLastKey);
+    XCTAssertEqualObjects(ComplexCharToStr(ScreenCharTestLastKey), held);
+
+    ScreenCharReleaseComplexChars(&heldChar, 1);
+    [self setNextKey:ScreenCharTestLastKey];
+    NSString *replacement = [self uniqueComplexString];
+    XCTAssertEqual([self keyForString:replacement], ScreenCharTestLastKey);
+    XCTAssertEqualObjects(ComplexCharToStr(ScreenCharTestLastKey), replacement);
+}
+
+// Retains are counted, so a key stays protected until every reference is released.
+- (void)testKeyWithSeveralReferencesIsProtectedUntilAllAreReleased {
+    [self setNextKey:ScreenCharTestLastKey];
+    const screen_char_t heldChar = [self screenCharForString:[self uniqueComplexString]];
+    const screen_char_t chars[] = { heldChar, heldChar };
+    ScreenCharRetainComplexChars(chars, 2);
+
+    ScreenCharReleaseComplexChars(&heldChar, 1);
+    [self setNextKey:ScreenCharTestLastKey];
+    XCTAssertNotEqual([self keyForString:[self uniqueComplexString]], ScreenCharTestLastKey);
+
+    ScreenCharReleaseComplexChars(&heldChar, 1);
+    [self setNextKey:ScreenCharTestLastKey];
+    XCTAssertEqual([self keyForString:[self uniqueComplexString]], ScreenCharTestLastKey);
+}
+
+@end
@@ -399,4 +399,68 @@
     XCTAssert(token->type == DCS_SIXEL);
 }
 
+- (void)testSixelSavedDataHasWorkerHeader {
+    VT100Token *token = [self tokenForDataWithFormat:@"%cP0;1;8q#0;2;0;0;0#0!10~%c\\", VT100CC_ESC, VT100CC_ESC];
+    XCTAssert(token->type == VT100_SKIP);
+
+    // The hook consumes the rest of the input on the next pass.
+    token = [[[VT100Token alloc] init] autorelease];
+    [_parser decodeFromContext:&_context
+                         token:token
+                      encoding:NSUTF8StringEncoding
+                    savedState:_savedState];
+    XCTAssert(token->type == DCS_SIXEL);
+    NSString *saved = [[[NSString alloc] initWithData:token.savedData encoding:NSUTF8StringEncoding] autorelease];
+    NSString *expected = [NSString stringWithFormat:@"0;1;8\n%cP0;1;8q#0;2;0;0;0#0!10~", VT100CC_ESC];
+    XCTAssertEqualObjects(saved, expected);
+}
+
+// A large image is sent on in pieces that end with complete bands, followed by the rest.
+- (void)testLargeSixelIsSentInBands {
+    VT100Parser *parser = [[[VT100Parser alloc] init] autorelease];
+    parser.encoding = NSUTF8StringEncoding;
+    NSMutableData *data = [NSMutableData dataWithData:[@"\x1bP0;1q\"1;1;100;60000" dataUsingEncoding:NSUTF8StringEncoding]];
+    for (int i = 0; i < 10000; i++) {
+        [data appendBytes:"#0!100~-" length:8];
+    }
+    [data appendBytes:"#0!50~" length:6];
+    NSData *payload = [data subdataWithRange:NSMakeRange(0, data.length)];
+    [data appendBytes:"\x1b\x5c" length:2];
+
+    CVector v;
+    CVectorCreate(&v, 10);
+    while (data.length > 0) {
+        NSInteger count = MIN(1024, data.length);
+        [parser putStreamData:data.bytes length:count];
+        [parser addParsedTokensToVector:&v];
+        [data replaceBytesInRange:NSMakeRange(0, count) withBytes:"" length:0];
+    }
+    const int n = CVectorCount(&v);
+    XCTAssertGreaterThan(n, 3);
+
+    VT100Token *token = CVectorGetObject(&v, 0);
+    XCTAssertEqual(token->type, VT100_SKIP);
+
+    NSMutableData *reassembled = [NSMutableData data];
+    NSString *identifier = nil;
+    for (int i = 1; i < n; i++) {
+        token = CVectorGetObject(&v, i);
+        XCTAssertEqual(token->type, i + 1 < n ? DCS_SIXEL_BANDS : DCS_SIXEL_END);
+        if (i == 1) {
+            identifier = token.string;
+            XCTAssertNotNil(identifier);
+        } else {
+            XCTAssertEqualObjects(token.string, identifier);
+        }
+        if (token->type == DCS_SIXEL_BANDS) {
+            const char *bytes = token.savedData.bytes;
+            XCTAssertEqual(bytes[token.savedData.length - 1], '-');
+        }
+        [reassembled appendData:token.savedData];
+    }
+    NSMutableData *expected = [NSMutableData dataWithData:[@"0;1\n" dataUsingEncoding:NSUTF8StringEncoding]];
+    [expected appendData:payload];
+    XCTAssertEqualObjects(reassembled, expected);
+}
+
 @end
@@ -1402,6 +1402,20 @@ do { \
 
 }
 
+- (void)testScrollFullWidthRectAcrossRingWrap {
+    VT100Grid *grid = [self gridFromCompactLines:@"abcd\nefgh\nijkl\nmnop"];
+    // Rotate the ring so the lines being moved straddle the end of the storage.
+    [grid scrollWholeScreenUpIntoLineBuffer:nil unlimitedScrollback:NO];
+    [self setLine:3 ofGrid:grid toString:@"qrst"];
+    XCTAssertEqualObjects([grid compactLineDump], @"efgh\nijkl\nmnop\nqrst");
+
+    [grid scrollRect:VT100GridRectMake(0, 0, 4, 4) downBy:1 softBreak:NO];
+    XCTAssertEqualObjects([grid compactLineDump], @"....\nefgh\nijkl\nmnop");
+
+    [grid scrollRect:VT100GridRectMake(0, 0, 4, 4) downBy:-2 softBreak:NO];
+    XCTAssertEqualObjects([grid compactLineDump], @"ijkl\nmnop\n....\n....");
+}
+
 - (void)testSetContentsFromDVRFrame {
     NSString *compactLines = @"abcd\nefgh\nijkl\nmnop";
     VT100Grid *grid = [self gridFromCompactLines:compactLines];
@@ -10,12 +10,14 @@
 #import "DVR.h"
 #import "DVRDecoder.h"
 #import "iTermAdvancedSettingsModel.h"
+#import "iTermAutocompleteIndex.h"
 #import "LineBuffer.h"
 #import "PTYNoteViewController.h"
 #import "SearchResult.h"
 #import "TmuxStateParser.h"
 #import "VT100Screen.h"
 #import "iTermSelection.h"
+#import "iTermStreamingTextExtractor.h"
 
 static const NSInteger kUnicodeVersion = 9;
 
@@ -162,6 +164,36 @@ NSLog(@"Known bug: %s should be true, but %s is.", #expressionThatShouldBeTrue,
     }
 }
 
+- (void)testStringToScreenCharsMixesSimpleAndComposedCharacters {
+    // "ab" takes the fast path, "e" plus a combining acute accent is composed, and the wide
+    // character and "x" take the fast path again.
+    NSString *string = @"abe\u0301\u4e2dx";
+    screen_char_t buf[12];
+    int len;
+    int cursorIndex = 4;
+    BOOL foundDwc = NO;
+    StringToScreenChars(string,
+                        buf,
+                        [terminal_ foregroundColorCode],
+                        [terminal_ backgroundColorCode],
+                        &len,
+                        NO,
+                        &cursorIndex,
+                        &foundDwc,
+                        iTermUnicodeNormalizationNone,
+                        kUnicodeVersion);
+    XCTAssertEqual(len, 6);
+    XCTAssertEqual(buf[0].code, 'a');
+    XCTAssertEqual(buf[1].code, 'b');
+    XCTAssertTrue(buf[2].complexChar);
+    XCTAssertEqualObjects(ScreenCharToStr(&buf[2]), @"e\u0301");
+    XCTAssertEqual(buf[3].code, 0x4e2d);
+    XCTAssertEqual(buf[4].code, DWC_RIGHT);
+    XCTAssertEqual(buf[5].code, 'x');
+    XCTAssertTrue(foundDwc);
+    XCTAssertEqual(cursorIndex, 3);
+}
+
 - (void)testDestructivelySetScreenWidthHeight {
     VT100Screen *screen = [self screen];
     [screen terminalShowTestPattern];
@@ -4001,6 +4033,53 @@ NSLog(@"Known bug: %s should be true, but %s is.", #expressionThatShouldBeTrue,
 
 }
 
+- (void)testSelectedIndexesWithManySubSelections {
+    // One tall box under many one-line boxes. Overlapping cells are deselected.
+    NSMutableArray<iTermSubSelection *> *subs = [NSMutableArray array];
+    [subs addObject:[iTermSubSelection subSelectionWithAbsRange:VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(0, 0, 3, 1999), 0, 0)
+                                                           mode:kiTermSelectionModeBox
+                                                          width:80]];
+    for (int y = 0; y < 2000; y++) {
+        const int x = y % 10;
+        [subs addObject:[iTermSubSelection subSelectionWithAbsRange:VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(x, y, x + 5, y), 0, 0)
+                                                               mode:kiTermSelectionModeBox
+                                                              width:80]];
+    }
+    [selection_ addSubSelections:subs];
+    const NSUInteger generation = selection_.generation;
+
+    for (int y = 0; y < 2000; y += 7) {
+        const int x = y % 10;
+        NSMutableIndexSet *expected = [NSMutableIndexSet indexSet];
+        for (int i = 0; i < 10; i++) {
+            const BOOL inTallBox = i < 3;
+            const BOOL inShortBox = (i >= x && i < x + 5);
+            if (inTallBox != inShortBox) {
+                [expected addIndex:i];
+            }
+        }
+        XCTAssertEqualObjects([selection_ selectedIndexesOnAbsoluteLine:y], expected);
+        // Cached results are the same.
+        XCTAssertEqualObjects([selection_ selectedIndexesOnAbsoluteLine:y], expected);
+        for (int i = 0; i < 10; i++) {
+            XCTAssertEqual([selection_ containsAbsCoord:VT100GridAbsCoordMake(i, y)],
+                           [expected containsIndex:i]);
+        }
+    }
+    XCTAssertEqual([[selection_ selectedIndexesOnAbsoluteLine:2000] count], 0);
+
+    iTermSelection *copy = [[selection_ copy] autorelease];
+    XCTAssertEqual(copy.generation, generation);
+    XCTAssertEqualObjects([copy selectedIndexesOnAbsoluteLine:14],
+                          [selection_ selectedIndexesOnAbsoluteLine:14]);
+
+    [selection_ clearSelection];
+    XCTAssertNotEqual(selection_.generation, generation);
+    XCTAssertEqual([[selection_ selectedIndexesOnAbsoluteLine:14] count], 0);
+    XCTAssertFalse([selection_ containsAbsCoord:VT100GridAbsCoordMake(0, 14)]);
+    XCTAssertEqual(copy.generation, generation);
+}
+
 - (void)testResizeWithSelectionOfJustNullsInAltScreen {
     VT100Screen *screen = [self screenWithWidth:5 height:4];
     screen.delegate = self;
@@ -4299,6 +4378,106 @@ NSLog(@"Known bug: %s should be true, but %s is.", #expressionThatShouldBeTrue,
     XCTAssertTrue(VT100GridCoordRangeEqualsCoordRange(rangeAfterResize, expected));
 }
 
+- (void)testAutocompleteMatchesComeFromScreenThenScrollback {
+    VT100Screen *screen = [self screenWithWidth:20 height:3];
+    screen.maxScrollbackLines = 1000;
+    [self appendLines:@[ @"make install", @"make test", @"cd src", @"Makefile" ] toScreen:screen];
+    XCTAssertEqual([screen numberOfScrollbackLines], 2);
+
+    NSArray<iTermAutocompleteIndexMatch *> *matches =
+        [screen autocompleteMatchesWithPrefix:@"ma"
+                                       before:VT100GridCoordMake(0, [screen numberOfLines] - 1)
+                                 maximumCount:10];
+    XCTAssertEqual(matches.count, 2);
+    XCTAssertEqualObjects(matches[0].word, @"Makefile");
+    XCTAssertEqualObjects(matches[1].word, @"make");
+    XCTAssertEqualObjects(matches[1].followers, (@[ @" test", @" install" ]));
+    XCTAssertEqualObjects(matches[1].context, (@[ @"install", @"make" ]));
+}
+
+- (void)testStreamingTextExtractorMatchesOneShotExtraction {
+    VT100Screen *screen = [self screenWithWidth:8 height:4];
+    screen.maxScrollbackLines = 10000;
+    NSMutableArray<NSString *> *lines = [NSMutableArray array];
+    for (int i = 0; i < 2500; i++) {
+        // Some lines wrap and some end in whitespace.
+        [lines addObject:(i % 3 == 0) ? [NSString stringWithFormat:@"line %d wraps", i] : [NSString stringWithFormat:@"%d  ", i]];
+    }
+    [self appendLines:lines toScreen:screen];
+
+    VT100GridAbsWindowedRange range =
+        VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(2, 1, 8, [screen numberOfLines] - 1), 0, 0);
+    iTermTextExtractor *extractor = [iTermTextExtractor textExtractorWithDataSource:screen];
+    NSString *expected = [extractor contentInRange:VT100GridWindowedRangeFromAbsWindowedRange(range, 0)
+                                 attributeProvider:nil
+                                        nullPolicy:kiTermTextExtractorNullPolicyMidlineAsSpaceIgnoreTerminal
+                                               pad:NO
+                                includeLastNewline:NO
+                            trimTrailingWhitespace:YES
+                                      cappedAtSize:-1
+                                      truncateTail:YES
+                                 continuationChars:nil
+                                            coords:nil];
+
+    iTermStreamingTextExtractor *streamingExtractor =
+        [[[iTermStreamingTextExtractor alloc] initWithDataSource:screen] autorelease];
+    streamingExtractor.trimTrailingWhitespace = YES;
+    [streamingExtractor addRange:range eol:NO];
+    NSMutableData *data = [NSMutableData data];
+    XCTestExpectation *finished = [self expectationWithDescription:@"finished"];
+    [streamingExtractor startWithSink:^BOOL(NSData *chunk) {
+        [data appendData:chunk];
+        return YES;
+    } completion:^(BOOL completed) {
+        XCTAssertTrue(completed);
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    NSString *actual = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+    XCTAssertEqualObjects(actual, expected);
+    XCTAssertFalse(streamingExtractor.linesWereLost);
+}
+
+// A pasteboard asking for promised text can't wait for the run loop, so the rest is extracted on
+// the spot.
+- (void)testStreamingTextExtractorFinishesSynchronously {
+    VT100Screen *screen = [self screenWithWidth:8 height:4];
+    screen.maxScrollbackLines = 10000;
+    NSMutableArray<NSString *> *lines = [NSMutableArray array];
+    NSMutableString *expected = [NSMutableString string];
+    for (int i = 0; i < 2500; i++) {
+        NSString *line = [NSString stringWithFormat:@"%d", i];
+        [lines addObject:line];
+        [expected appendFormat:@"%@\n", line];
+    }
+    [self appendLines:lines toScreen:screen];
+
+    iTermStreamingTextExtractor *streamingExtractor =
+        [[[iTermStreamingTextExtractor alloc] initWithDataSource:screen] autorelease];
+    [streamingExtractor addRange:VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(0, 0, 8, 2499), 0, 0)
+                             eol:YES];
+    NSMutableData *data = [NSMutableData data];
+    __block int completions = 0;
+    [streamingExtractor startWithSink:^BOOL(NSData *chunk) {
+        [data appendData:chunk];
+        return YES;
+    } completion:^(BOOL completed) {
+        XCTAssertTrue(completed);
+        completions++;
+    }];
+    [streamingExtractor finishSynchronously];
+    XCTAssertEqual(completions, 1);
+
+    NSString *actual = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+    XCTAssertEqualObjects(actual, expected);
+
+    // Callbacks already queued for the main thread must not extract or complete again.
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    XCTAssertEqual(completions, 1);
+    XCTAssertEqual(data.length, [expected lengthOfBytesUsingEncoding:NSUTF8StringEncoding]);
+}
+
 - (void)commonNoteResizeRegressionTestWithInitialRange:(VT100GridCoordRange)range1
                                      intermediateRange:(VT100GridCoordRange)range2 {
     VT100Screen *screen = [self screenWithWidth:80 height:25];
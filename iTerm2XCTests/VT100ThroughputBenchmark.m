@@ -0,0 +1,274 @@
+//
+//  VT100ThroughputBenchmark.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import <malloc/malloc.h>
+
+#import "CVector.h"
+#import "iTermHistogram.h"
+#import "VT100Parser.h"
+#import "VT100Screen.h"
+#import "VT100Terminal.h"
+#import "VT100Token.h"
+
+// Feeds byte streams through VT100Parser -> VT100Terminal -> VT100Screen/LineBuffer with no
+// session, view, or renderer attached, in pty-read-sized batches, and logs throughput, net heap
+// growth, and per-batch latency. Each workload is a synthetic stand-in for a kind of output that
+// stresses a different part of the emulator.
+//
+// The benchmarks only run when ITERM_RUN_BENCHMARKS is set in the test environment, so normal test
+// runs stay fast. Each workload is timed with XCTest's performance metrics; set a baseline for it
+// in Xcode and a run that is slower than the baseline fails.
+//
+// To benchmark captured output too, set ITERM_BENCHMARK_RECORDINGS to a directory. The files in it
+// are played back in name order as one more workload.
+@interface VT100ThroughputBenchmark : XCTestCase
+@end
+
+static const NSUInteger VT100ThroughputBenchmarkBatchSize = 4096;
+static const NSUInteger VT100ThroughputBenchmarkWorkloadSize = 1024 * 1024;
+
+@implementation VT100ThroughputBenchmark {
+    uint32_t _random;
+}
+
++ (NSArray<NSInvocation *> *)testInvocations {
+    if (![[NSProcessInfo processInfo] environment][@"ITERM_RUN_BENCHMARKS"]) {
+        return @[];
+    }
+    return [super testInvocations];
+}
+
+- (void)setUp {
+    _random = 1;
+}
+
+- (uint32_t)nextRandom {
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+// Repeats `block`'s output until it's at least VT100ThroughputBenchmarkWorkloadSize bytes.
+- (NSData *)workloadWithBlock:(void (^)(NSMutableString *s))block {
+    NSMutableData *data = [NSMutableData data];
+    while (data.length < VT100ThroughputBenchmarkWorkloadSize) {
+        NSMutableString *s = [NSMutableString string];
+        block(s);
+        [data appendData:[s dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    return data;
+}
+
+#pragma mark - Harness
+
+- (void)runWorkload:(NSData *)data
+              named:(NSString *)name
+              width:(int)width
+             height:(int)height {
+    iTermHistogram *latencies = [[[iTermHistogram alloc] init] autorelease];
+    __block NSTimeInterval totalTime = 0;
+    __block long long blockGrowth = 0;
+    __block long long byteGrowth = 0;
+    __block int iterations = 0;
+
+    // Only feeding the data is measured, not setting up the screen.
+    [self measureMetrics:@[ XCTPerformanceMetric_WallClockTime ] automaticallyStartMeasuring:NO forBlock:^{
+        @autoreleasepool {
+            VT100Terminal *terminal = [[[VT100Terminal alloc] init] autorelease];
+            terminal.encoding = NSUTF8StringEncoding;
+            VT100Screen *screen = [[[VT100Screen alloc] initWithTerminal:terminal] autorelease];
+            terminal.delegate = screen;
+            [screen destructivelySetScreenWidth:width height:height];
+            screen.maxScrollbackLines = 10000;
+
+            malloc_statistics_t before;
+            malloc_zone_statistics(NULL, &before);
+
+            [self startMeasuring];
+            const unsigned char *bytes = data.bytes;
+            for (NSUInteger offset = 0; offset < data.length; offset += VT100ThroughputBenchmarkBatchSize) {
+                const int length = (int)MIN(VT100ThroughputBenchmarkBatchSize, data.length - offset);
+                const NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+
+                [terminal.parser putStreamData:(const char *)bytes + offset length:length];
+                CVector vector;
+                CVectorCreate(&vector, 100);
+                [terminal.parser addParsedTokensToVector:&vector];
+                const int n = CVectorCount(&vector);
+                for (int i = 0; i < n; i++) {
+                    VT100Token *token = CVectorGetObject(&vector, i);
+                    [terminal executeToken:token];
+                    [token release];
+                }
+                CVectorDestroy(&vector);
+
+                const NSTimeInterval duration = [NSDate timeIntervalSinceReferenceDate] - start;
+                totalTime += duration;
+                [latencies addValue:duration * 1000000];
+            }
+            [self stopMeasuring];
+
+            malloc_statistics_t after;
+            malloc_zone_statistics(NULL, &after);
+            blockGrowth += (long long)after.blocks_in_use - (long long)before.blocks_in_use;
+            byteGrowth += (long long)after.size_in_use - (long long)before.size_in_use;
+            iterations++;
+        }
+    }];
+
+    const double megabytes = (double)data.length * iterations / (1024 * 1024);
+    NSLog(@"%@: %.1f MB/s, batch p50=%.0fus p99=%.0fus max=%.0fus, net heap growth %lld blocks %lld KB per run",
+          name,
+          megabytes / totalTime,
+          [latencies valueAtNTile:0.5],
+          [latencies valueAtNTile:0.99],
+          [latencies valueAtNTile:1.0],
+          blockGrowth / iterations,
+          byteGrowth / iterations / 1024);
+}
+
+#pragma mark - Workloads
+
+- (void)testPlainLog {
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        [s appendFormat:@"2026-10-19T12:%02u:%02u.%03uZ INFO [worker-%u] handled request id=%08x in %ums\r\n",
+         [self nextRandom] % 60,
+         [self nextRandom] % 60,
+         [self nextRandom] % 1000,
+         [self nextRandom] % 16,
+         [self nextRandom],
+         [self nextRandom] % 500];
+    }];
+    [self runWorkload:data named:@"plain log" width:120 height:40];
+}
+
+- (void)testVimRedraw {
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        // A full-screen redraw: home, then each line with a colored gutter, syntax highlighting,
+        // and erase-to-end-of-line.
+        [s appendString:@"\e[?25l\e[H"];
+        for (int y = 1; y <= 39; y++) {
+            [s appendFormat:@"\e[%d;1H\e[33m%4u \e[m", y, [self nextRandom] % 10000];
+            [s appendFormat:@"\e[38;5;%um    if\e[m (\e[36mvalue\e[m == \e[35m%u\e[m) {\e[K",
+             [self nextRandom] % 256,
+             [self nextRandom] % 100];
+        }
+        [s appendString:@"\e[40;1H\e[7m-- INSERT --\e[m\e[K\e[12;20H\e[?25h"];
+    }];
+    [self runWorkload:data named:@"vim redraw" width:120 height:40];
+}
+
+- (void)testHtop {
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        // Meter bars at the top, then a scroll region of process rows.
+        [s appendString:@"\e[H"];
+        for (int cpu = 0; cpu < 8; cpu++) {
+            const int used = [self nextRandom] % 40;
+            [s appendFormat:@"\e[%d;1H\e[36m%3d\e[m[\e[32m", cpu + 1, cpu];
+            for (int i = 0; i < 40; i++) {
+                [s appendString:i < used ? @"|" : @" "];
+            }
+            [s appendFormat:@"\e[m%5.1f%%]", used * 2.5];
+        }
+        [s appendString:@"\e[10;50r\e[10;1H"];
+        for (int row = 0; row < 40; row++) {
+            [s appendFormat:@"\e[%d;1H\e[30;46m%7u\e[m root      20   0 \e[36m%6uM\e[m S %4.1f  0.%u %@\e[K",
+             row + 10,
+             [self nextRandom] % 100000,
+             [self nextRandom] % 4096,
+             ([self nextRandom] % 1000) / 10.0,
+             [self nextRandom] % 10,
+             @"/usr/libexec/process --flag"];
+        }
+        [s appendString:@"\e[r"];
+    }];
+    [self runWorkload:data named:@"htop" width:200 height:50];
+}
+
+- (void)testTrueColor {
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        for (int i = 0; i < 80; i++) {
+            [s appendFormat:@"\e[38;2;%u;%u;%um\e[48;2;%u;%u;%um%c",
+             [self nextRandom] % 256, [self nextRandom] % 256, [self nextRandom] % 256,
+             [self nextRandom] % 256, [self nextRandom] % 256, [self nextRandom] % 256,
+             'A' + i % 26];
+        }
+        [s appendString:@"\e[m\r\n"];
+    }];
+    [self runWorkload:data named:@"24-bit color" width:80 height:25];
+}
+
+- (void)testCJK {
+    NSArray<NSString *> *phrases = @[ @"敏捷的棕色狐狸跳过了懒狗", @"素早い茶色の狐がのろまな犬を飛び越える", @"빠른 갈색 여우가 게으른 개를 뛰어넘는다" ];
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        for (int i = 0; i < 6; i++) {
+            [s appendString:phrases[[self nextRandom] % phrases.count]];
+        }
+        [s appendString:@"\r\n"];
+    }];
+    [self runWorkload:data named:@"CJK" width:80 height:25];
+}
+
+- (void)testSixel {
+    NSData *data = [self workloadWithBlock:^(NSMutableString *s) {
+        // A 256x96 image with a 16-color palette.
+        [s appendString:@"\eP0;0;8q\"1;1;256;96"];
+        for (int c = 0; c < 16; c++) {
+            [s appendFormat:@"#%d;2;%u;%u;%u", c, [self nextRandom] % 101, [self nextRandom] % 101, [self nextRandom] % 101];
+        }
+        for (int band = 0; band < 16; band++) {
+            for (int c = 0; c < 4; c++) {
+                [s appendFormat:@"#%u", [self nextRandom] % 16];
+                for (int x = 0; x < 256; x += 16) {
+                    [s appendFormat:@"!16%c", '?' + ([self nextRandom] % 64)];
+                }
+                [s appendString:c == 3 ? @"-" : @"$"];
+            }
+        }
+        [s appendString:@"\e\\\r\n"];
+    }];
+    [self runWorkload:data named:@"sixel" width:80 height:25];
+}
+
+- (void)testTmuxControlMode {
+    NSMutableData *data = [NSMutableData data];
+    [data appendData:[@"\eP1000p" dataUsingEncoding:NSUTF8StringEncoding]];
+    [data appendData:[self workloadWithBlock:^(NSMutableString *s) {
+        [s appendFormat:@"%%begin %u %u 0\n%%end %u %u 0\n", 1600000000, [self nextRandom] % 1000, 1600000000, [self nextRandom] % 1000];
+        for (int i = 0; i < 8; i++) {
+            [s appendFormat:@"%%output %%%u \\033[32mbuild\\033[m step %u of 400: compiling module_%u.o\\015\\012\n",
+             [self nextRandom] % 8,
+             [self nextRandom] % 400,
+             [self nextRandom] % 1000];
+        }
+    }]];
+    [self runWorkload:data named:@"tmux control mode" width:80 height:25];
+}
+
+- (void)testRecordedStreams {
+    NSString *path = [[NSProcessInfo processInfo] environment][@"ITERM_BENCHMARK_RECORDINGS"];
+    if (!path) {
+        return;
+    }
+    // A test can only be measured once, so the recordings are played back to back as one workload.
+    NSArray<NSString *> *files = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:path error:nil];
+    NSMutableData *data = [NSMutableData data];
+    for (NSString *file in [files sortedArrayUsingSelector:@selector(compare:)]) {
+        NSData *recording = [NSData dataWithContentsOfFile:[path stringByAppendingPathComponent:file]];
+        if (recording.length) {
+            [data appendData:recording];
+        }
+    }
+    if (data.length == 0) {
+        return;
+    }
+    [self runWorkload:data named:[NSString stringWithFormat:@"%@ recordings", @(files.count)] width:80 height:25];
+}
+
+@end
@@ -0,0 +1,125 @@
+//
+//  iTermAutocompleteIndexTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermAutocompleteIndex.h"
+#import "LineBuffer.h"
+#import "ScreenChar.h"
+
+static const int kWidth = 80;
+
+@interface iTermAutocompleteIndexTests : XCTestCase
+@end
+
+@implementation iTermAutocompleteIndexTests
+
+#pragma mark - Helpers
+
+- (LineBuffer *)lineBuffer {
+    return [[[LineBuffer alloc] initWithBlockSize:1000] autorelease];
+}
+
+- (iTermAutocompleteIndex *)index {
+    return [[[iTermAutocompleteIndex alloc] initWithWordCharacters:@""] autorelease];
+}
+
+- (void)appendString:(NSString *)string partial:(BOOL)partial toLineBuffer:(LineBuffer *)lineBuffer {
+    screen_char_t buf[string.length * 2 + 1];
+    screen_char_t zero = { 0 };
+    int len = 0;
+    BOOL foundDwc = NO;
+    StringToScreenChars(string,
+                        buf,
+                        zero,
+                        zero,
+                        &len,
+                        NO,
+                        NULL,
+                        &foundDwc,
+                        iTermUnicodeNormalizationNone,
+                        9);
+    [lineBuffer appendLine:buf
+                    length:len
+                   partial:partial
+                     width:kWidth
+                 timestamp:0
+              continuation:zero];
+}
+
+- (void)popLastLineFromLineBuffer:(LineBuffer *)lineBuffer {
+    screen_char_t buf[kWidth];
+    int eol = 0;
+    screen_char_t continuation;
+    XCTAssertTrue([lineBuffer popAndCopyLastLineInto:buf
+                                               width:kWidth
+                                   includesEndOfLine:&eol
+                                           timestamp:NULL
+                                        continuation:&continuation]);
+}
+
+- (NSArray<NSString *> *)wordsWithPrefix:(NSString *)prefix index:(iTermAutocompleteIndex *)index {
+    NSMutableArray<NSString *> *words = [NSMutableArray array];
+    for (iTermAutocompleteIndexMatch *match in [index matchesWithPrefix:prefix maximumCount:10]) {
+        [words addObject:match.word];
+    }
+    return words;
+}
+
+#pragma mark - Tests
+
+- (void)testCompleteLinesAreIndexed {
+    LineBuffer *lineBuffer = [self lineBuffer];
+    [self appendString:@"alpha bravo" partial:NO toLineBuffer:lineBuffer];
+    [self appendString:@"babel" partial:YES toLineBuffer:lineBuffer];
+
+    iTermAutocompleteIndex *index = [self index];
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:100]);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"b" index:index], @[ @"bravo" ]);
+
+    // The partial line is indexed once it's complete.
+    [self appendString:@"fish" partial:NO toLineBuffer:lineBuffer];
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:100]);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"babel" index:index], @[ @"babelfish" ]);
+}
+
+// Popping a line gives its number to the next line completed, which must still be indexed.
+- (void)testLineReplacingPoppedLineIsIndexed {
+    LineBuffer *lineBuffer = [self lineBuffer];
+    [self appendString:@"alpha" partial:NO toLineBuffer:lineBuffer];
+    [self appendString:@"bravo" partial:NO toLineBuffer:lineBuffer];
+
+    iTermAutocompleteIndex *index = [self index];
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:100]);
+
+    [self popLastLineFromLineBuffer:lineBuffer];
+    [self appendString:@"charlie" partial:NO toLineBuffer:lineBuffer];
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:100]);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"c" index:index], @[ @"charlie" ]);
+
+    [self appendString:@"delta" partial:NO toLineBuffer:lineBuffer];
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:100]);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"d" index:index], @[ @"delta" ]);
+}
+
+- (void)testBoundedUpdatesCatchUpOverSeveralCalls {
+    LineBuffer *lineBuffer = [self lineBuffer];
+    for (int i = 0; i < 10; i++) {
+        [self appendString:[NSString stringWithFormat:@"word%d", i] partial:NO toLineBuffer:lineBuffer];
+    }
+
+    iTermAutocompleteIndex *index = [self index];
+    XCTAssertFalse([index updateWithLineBuffer:lineBuffer maximumLines:3]);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"word" index:index], (@[ @"word2", @"word1", @"word0" ]));
+    XCTAssertFalse([index updateWithLineBuffer:lineBuffer maximumLines:3]);
+    XCTAssertFalse([index updateWithLineBuffer:lineBuffer maximumLines:3]);
+    XCTAssertTrue([index updateWithLineBuffer:lineBuffer maximumLines:3]);
+    XCTAssertEqual([self wordsWithPrefix:@"word" index:index].count, 10);
+    XCTAssertEqualObjects([self wordsWithPrefix:@"word9" index:index], @[ @"word9" ]);
+}
+
+@end
@@ -248,6 +248,17 @@
     return YES;
 }
 
+- (BOOL)executeUpdate:(NSString *)sql withArguments:(NSArray *)arguments {
+    NSMutableString *string = [sql mutableCopy];
+    for (id obj in arguments) {
+        const NSInteger index = [string rangeOfString:@"?"].location;
+        [string replaceCharactersInRange:NSMakeRange(index, 1) withString:[obj description]];
+    }
+    _lastRowID = 0;
+    [_commands addObject:string];
+    return YES;
+}
+
 - (id<iTermDatabaseResultSet> _Nullable)executeQuery:(NSString*)sql, ... {
     va_list args;
     va_start(args, sql);
@@ -0,0 +1,162 @@
+//
+//  iTermGraphDatabaseBenchmark.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermDatabase.h"
+#import "iTermGraphDatabase.h"
+#import "iTermHistogram.h"
+
+// Saves a synthetic arrangement the size of a big restored workspace over and over, the way the
+// restorable state controller does while sessions produce output, and logs the distribution of
+// save latencies. Like the other benchmarks, it only runs when ITERM_RUN_BENCHMARKS is set in the
+// test environment.
+@interface iTermGraphDatabaseBenchmark : XCTestCase
+@end
+
+static const NSInteger iTermGraphDatabaseBenchmarkWindows = 100;
+static const NSInteger iTermGraphDatabaseBenchmarkSessionsPerWindow = 4;
+static const NSInteger iTermGraphDatabaseBenchmarkFullBlocksPerSession = 4;
+static const NSInteger iTermGraphDatabaseBenchmarkSaves = 30;
+static const NSUInteger iTermGraphDatabaseBenchmarkBlockSize = 96 * 1024;
+
+@implementation iTermGraphDatabaseBenchmark {
+    NSURL *_directory;
+}
+
++ (NSArray<NSInvocation *> *)testInvocations {
+    if (![[NSProcessInfo processInfo] environment][@"ITERM_RUN_BENCHMARKS"]) {
+        return @[];
+    }
+    return [super testInvocations];
+}
+
+- (void)setUp {
+    _directory = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtURL:_directory
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:nil];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_directory error:nil];
+    [_directory release];
+    _directory = nil;
+}
+
+- (NSData *)blockDataWithSeed:(uint32_t)seed length:(NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    unsigned char *bytes = data.mutableBytes;
+    uint32_t x = seed | 1;
+    for (NSUInteger i = 0; i < length; i++) {
+        // Mostly printable text with some variety, like a real scrollback buffer.
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bytes[i] = ' ' + (x % 64);
+    }
+    return data;
+}
+
+- (void)encodeArrangementWithEncoder:(iTermGraphEncoder *)encoder
+                                save:(NSInteger)save
+                          fullBlocks:(NSArray<NSData *> *)fullBlocks
+                           tailBlock:(NSData *)tailBlock {
+    NSMutableArray<NSString *> *windowIDs = [NSMutableArray array];
+    for (NSInteger w = 0; w < iTermGraphDatabaseBenchmarkWindows; w++) {
+        [windowIDs addObject:[NSString stringWithFormat:@"window-%@", @(w)]];
+    }
+    [encoder encodeArrayWithKey:@"windows"
+                     generation:save
+                    identifiers:windowIDs
+                        options:0
+                          block:^BOOL(NSString * _Nonnull identifier,
+                                      NSInteger w,
+                                      iTermGraphEncoder * _Nonnull windowEncoder,
+                                      BOOL * _Nonnull stop) {
+        [windowEncoder encodeString:identifier forKey:@"__identifier"];
+        for (NSInteger s = 0; s < iTermGraphDatabaseBenchmarkSessionsPerWindow; s++) {
+            NSString *sessionID = [NSString stringWithFormat:@"%@-session-%@", identifier, @(s)];
+            [windowEncoder encodeChildWithKey:@"session"
+                                   identifier:sessionID
+                                   generation:save
+                                        block:^BOOL(iTermGraphEncoder * _Nonnull sessionEncoder) {
+                [sessionEncoder encodeString:@"Default" forKey:@"profile"];
+                for (NSInteger b = 0; b < fullBlocks.count; b++) {
+                    // Full blocks never change, so their generation is constant.
+                    [sessionEncoder encodeChildWithKey:@"block"
+                                            identifier:[NSString stringWithFormat:@"%@", @(b)]
+                                            generation:1
+                                                 block:^BOOL(iTermGraphEncoder * _Nonnull blockEncoder) {
+                        [blockEncoder encodeData:fullBlocks[b] forKey:@"Raw Buffer"];
+                        return YES;
+                    }];
+                }
+                [sessionEncoder encodeChildWithKey:@"block"
+                                        identifier:@"tail"
+                                        generation:save
+                                             block:^BOOL(iTermGraphEncoder * _Nonnull blockEncoder) {
+                    [blockEncoder encodeData:tailBlock forKey:@"Raw Buffer"];
+                    return YES;
+                }];
+                return YES;
+            }];
+        }
+        return YES;
+    }];
+}
+
+- (void)testSaveLatencyForLargeArrangement {
+    NSURL *url = [_directory URLByAppendingPathComponent:@"benchmark.sqlite"];
+    iTermSqliteDatabaseImpl *db = [[[iTermSqliteDatabaseImpl alloc] initWithURL:url] autorelease];
+    iTermGraphDatabase *gdb = [[[iTermGraphDatabase alloc] initWithDatabase:db] autorelease];
+    XCTAssertNotNil(gdb);
+
+    XCTestExpectation *ready = [self expectationWithDescription:@"ready"];
+    [gdb whenReady:^{
+        [ready fulfill];
+    }];
+    [self waitForExpectations:@[ ready ] timeout:30];
+
+    NSMutableArray<NSData *> *fullBlocks = [NSMutableArray array];
+    for (NSInteger b = 0; b < iTermGraphDatabaseBenchmarkFullBlocksPerSession; b++) {
+        [fullBlocks addObject:[self blockDataWithSeed:(uint32_t)b + 1 length:iTermGraphDatabaseBenchmarkBlockSize]];
+    }
+    NSData *output = [self blockDataWithSeed:1234 length:iTermGraphDatabaseBenchmarkBlockSize];
+
+    iTermHistogram *histogram = [[[iTermHistogram alloc] init] autorelease];
+    for (NSInteger save = 1; save <= iTermGraphDatabaseBenchmarkSaves; save++) {
+        // Each save, the tail block has grown by some new output.
+        const NSUInteger tailLength = MIN(output.length, save * (output.length / iTermGraphDatabaseBenchmarkSaves));
+        NSData *tailBlock = [output subdataWithRange:NSMakeRange(0, tailLength)];
+        const NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        [gdb updateSynchronously:YES block:^(iTermGraphEncoder * _Nonnull encoder) {
+            [self encodeArrangementWithEncoder:encoder
+                                          save:save
+                                    fullBlocks:fullBlocks
+                                     tailBlock:tailBlock];
+        } completion:nil];
+        const NSTimeInterval duration = [NSDate timeIntervalSinceReferenceDate] - start;
+        if (save > 1) {
+            // The first save writes everything and isn't representative.
+            [histogram addValue:duration * 1000];
+        }
+    }
+    NSLog(@"Save latency over %@ saves of %@ windows: p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms\n%@",
+          @(histogram.count),
+          @(iTermGraphDatabaseBenchmarkWindows),
+          [histogram valueAtNTile:0.5],
+          [histogram valueAtNTile:0.9],
+          [histogram valueAtNTile:0.99],
+          [histogram valueAtNTile:1.0],
+          histogram.stringValue);
+    XCTAssertEqual(histogram.count, iTermGraphDatabaseBenchmarkSaves - 1);
+    [gdb invalidateSynchronously:YES];
+}
+
+@end
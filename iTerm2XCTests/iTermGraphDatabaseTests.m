@@ -0,0 +1,149 @@
+//
+//  iTermGraphDatabaseTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermDatabase.h"
+#import "iTermEncoderGraphRecord.h"
+#import "iTermGraphDatabase.h"
+#import "iTermGraphEncoder.h"
+#import "iTermThreadSafety.h"
+
+// Exercises the chunked storage of large nodes against a real SQLite database.
+@interface iTermGraphDatabaseTests : XCTestCase
+@end
+
+@implementation iTermGraphDatabaseTests {
+    NSURL *_directory;
+}
+
+- (void)setUp {
+    NSString *name = [NSString stringWithFormat:@"iTermGraphDatabaseTests-%@", [[NSUUID UUID] UUIDString]];
+    _directory = [[NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtURL:_directory
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:nil];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:_directory error:nil];
+    [_directory release];
+    _directory = nil;
+}
+
+#pragma mark - Helpers
+
+- (NSURL *)databaseURL {
+    return [_directory URLByAppendingPathComponent:@"test.sqlite"];
+}
+
+- (iTermGraphDatabase *)openDatabase {
+    iTermSqliteDatabaseImpl *db = [[[iTermSqliteDatabaseImpl alloc] initWithURL:self.databaseURL] autorelease];
+    iTermGraphDatabase *gdb = [[[iTermGraphDatabase alloc] initWithDatabase:db] autorelease];
+    XCTAssertNotNil(gdb);
+    // Wait for the initial load, checkpoint, and vacuum to finish.
+    [gdb.thread dispatchSync:^(id _Nullable state) {}];
+    return gdb;
+}
+
+- (void)closeDatabase:(iTermGraphDatabase *)gdb {
+    [gdb.thread dispatchSync:^(id _Nullable state) {
+        [gdb.db close];
+        [gdb.db unlock];
+    }];
+}
+
+- (long long)numberOfRowsInTable:(NSString *)table database:(iTermGraphDatabase *)gdb {
+    __block long long count = -1;
+    [gdb.thread dispatchSync:^(id _Nullable state) {
+        NSString *query = [NSString stringWithFormat:@"select count(*) as c from %@", table];
+        id<iTermDatabaseResultSet> rs = [gdb.db executeQuery:query];
+        if ([rs next]) {
+            count = [rs longLongIntForColumn:@"c"];
+        }
+        [rs close];
+    }];
+    return count;
+}
+
+// Well over the chunking threshold, and varied enough that no two chunks are identical.
+- (NSString *)largeString {
+    NSMutableString *string = [NSMutableString string];
+    for (int i = 0; i < 30000; i++) {
+        [string appendFormat:@"%d ", (i * 7919) % 100003];
+    }
+    return string;
+}
+
+- (void)saveChildren:(NSDictionary<NSString *, NSString *> *)children
+          generation:(NSInteger)generation
+            database:(iTermGraphDatabase *)gdb {
+    [gdb updateSynchronously:YES block:^(iTermGraphEncoder * _Nonnull encoder) {
+        for (NSString *key in [children.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+            [encoder encodeChildWithKey:key
+                             identifier:@""
+                             generation:generation
+                                  block:^BOOL(iTermGraphEncoder * _Nonnull subencoder) {
+                [subencoder encodeString:children[key] forKey:@"value"];
+                return YES;
+            }];
+        }
+    } completion:nil];
+}
+
+#pragma mark - Tests
+
+- (void)testValueSplitAcrossChunksRoundTrips {
+    NSString *large = [self largeString];
+    iTermGraphDatabase *gdb = [self openDatabase];
+    [self saveChildren:@{ @"root": large } generation:1 database:gdb];
+
+    XCTAssertGreaterThan([self numberOfRowsInTable:@"NodeChunk" database:gdb], 1);
+    XCTAssertGreaterThan([self numberOfRowsInTable:@"Chunk" database:gdb], 1);
+    [self closeDatabase:gdb];
+
+    gdb = [self openDatabase];
+    XCTAssertEqualObjects(gdb.record.propertyListValue[@"root"][@"value"], large);
+    [self closeDatabase:gdb];
+}
+
+- (void)testIdenticalNodesShareChunks {
+    NSString *large = [self largeString];
+    iTermGraphDatabase *gdb = [self openDatabase];
+    [self saveChildren:@{ @"a": large, @"b": large } generation:1 database:gdb];
+
+    const long long references = [self numberOfRowsInTable:@"NodeChunk" database:gdb];
+    const long long chunks = [self numberOfRowsInTable:@"Chunk" database:gdb];
+    XCTAssertGreaterThan(chunks, 1);
+    XCTAssertEqual(references, chunks * 2);
+    [self closeDatabase:gdb];
+
+    gdb = [self openDatabase];
+    XCTAssertEqualObjects(gdb.record.propertyListValue[@"a"][@"value"], large);
+    XCTAssertEqualObjects(gdb.record.propertyListValue[@"b"][@"value"], large);
+    [self closeDatabase:gdb];
+}
+
+- (void)testUnreferencedChunksAreCollectedAtLaunch {
+    iTermGraphDatabase *gdb = [self openDatabase];
+    [self saveChildren:@{ @"root": [self largeString] } generation:1 database:gdb];
+    XCTAssertGreaterThan([self numberOfRowsInTable:@"Chunk" database:gdb], 1);
+
+    // Shrinking the node below the threshold drops its references but leaves the chunks behind.
+    [self saveChildren:@{ @"root": @"small" } generation:2 database:gdb];
+    XCTAssertEqual([self numberOfRowsInTable:@"NodeChunk" database:gdb], 0);
+    XCTAssertGreaterThan([self numberOfRowsInTable:@"Chunk" database:gdb], 0);
+    [self closeDatabase:gdb];
+
+    gdb = [self openDatabase];
+    XCTAssertEqual([self numberOfRowsInTable:@"Chunk" database:gdb], 0);
+    XCTAssertEqualObjects(gdb.record.propertyListValue[@"root"][@"value"], @"small");
+    [self closeDatabase:gdb];
+}
+
+@end
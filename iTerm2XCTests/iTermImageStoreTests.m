@@ -0,0 +1,107 @@
+//
+//  iTermImageStoreTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import "iTermAdvancedSettingsModel.h"
+#import "iTermImage.h"
+#import "iTermImageStore.h"
+#import "NSData+iTerm.h"
+
+@interface iTermImageStoreTests : XCTestCase
+
+@end
+
+@implementation iTermImageStoreTests
+
+- (iTermImage *)imageOfSize:(NSSize)size {
+    NSImage *nativeImage = [[[NSImage alloc] initWithSize:size] autorelease];
+    [nativeImage lockFocus];
+    [[NSColor redColor] set];
+    NSRectFill(NSMakeRect(0, 0, size.width, size.height));
+    [nativeImage unlockFocus];
+    return [iTermImage imageWithNativeImage:nativeImage];
+}
+
+- (NSData *)dataWithString:(NSString *)string {
+    return [string dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (iTermImageStoreEntry *)retainEntryInStore:(iTermImageStore *)store
+                                      string:(NSString *)string
+                                       image:(iTermImage *)image {
+    NSData *data = [self dataWithString:string];
+    return [store retainEntryForData:data digest:[data it_sha256] image:image];
+}
+
+- (void)testIdenticalDataSharesEntry {
+    iTermImageStore *store = [[[iTermImageStore alloc] init] autorelease];
+    iTermImage *first = [self imageOfSize:NSMakeSize(4, 4)];
+    iTermImage *second = [self imageOfSize:NSMakeSize(4, 4)];
+    iTermImageStoreEntry *entry1 = [self retainEntryInStore:store string:@"logo" image:first];
+    iTermImageStoreEntry *entry2 = [self retainEntryInStore:store string:@"logo" image:second];
+
+    XCTAssertEqual(entry1, entry2);
+    XCTAssertEqual(entry2.image, first);
+    XCTAssertEqual(store.count, 1);
+}
+
+// The digest comes from the sandboxed decoder, so a digest that doesn't match the data must not
+// hand out another image's entry.
+- (void)testMismatchedDigestIsRejected {
+    iTermImageStore *store = [[[iTermImageStore alloc] init] autorelease];
+    iTermImage *image = [self imageOfSize:NSMakeSize(4, 4)];
+    iTermImageStoreEntry *entry = [self retainEntryInStore:store string:@"logo" image:image];
+    XCTAssertNotNil(entry);
+
+    NSData *other = [self dataWithString:@"other"];
+    XCTAssertNil([store retainEntryForData:other
+                                    digest:[[self dataWithString:@"logo"] it_sha256]
+                                     image:[self imageOfSize:NSMakeSize(4, 4)]]);
+    XCTAssertEqual(store.count, 1);
+}
+
+- (void)testEntryRemovedWhenLastReferenceReleased {
+    iTermImageStore *store = [[[iTermImageStore alloc] init] autorelease];
+    iTermImage *image = [self imageOfSize:NSMakeSize(4, 4)];
+    iTermImageStoreEntry *entry = [self retainEntryInStore:store string:@"spinner" image:image];
+    [self retainEntryInStore:store string:@"spinner" image:image];
+
+    [store releaseEntry:entry];
+    XCTAssertEqual(store.count, 1);
+    [store releaseEntry:entry];
+    XCTAssertEqual(store.count, 0);
+    XCTAssertEqual(store.decodedBytes, 0);
+}
+
+- (void)testLeastRecentlyUsedIsEvictedOverBudget {
+    iTermImageStore *store = [[[iTermImageStore alloc] init] autorelease];
+    iTermImageStoreEntry *a = [self retainEntryInStore:store
+                                                string:@"a"
+                                                 image:[self imageOfSize:NSMakeSize(8, 8)]];
+    iTermImageStoreEntry *b = [self retainEntryInStore:store
+                                                string:@"b"
+                                                 image:[self imageOfSize:NSMakeSize(8, 8)]];
+    [store touchEntry:a];
+    store.memoryBudget = a.decodedCost;
+
+    XCTAssertNotNil(a.image);
+    XCTAssertNil(b.image);
+    XCTAssertEqual(store.decodedBytes, a.decodedCost);
+    XCTAssertEqual(store.count, 2);
+}
+
+- (void)testMemoryBudgetTracksAdvancedSettingUntilAssigned {
+    iTermImageStore *store = [[[iTermImageStore alloc] init] autorelease];
+    const NSUInteger settingBudget =
+        (NSUInteger)MAX(0, [iTermAdvancedSettingsModel inlineImageMemoryBudgetMB]) * 1024 * 1024;
+    XCTAssertEqual(store.memoryBudget, settingBudget);
+
+    store.memoryBudget = 1234;
+    XCTAssertEqual(store.memoryBudget, 1234);
+}
+
+@end
@@ -0,0 +1,526 @@
+//
+//  iTermMultiServerProtocolTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermClientServerProtocol.h"
+#import "iTermFileDescriptorServerShared.h"
+#import "iTermMultiServerOutputBuffer.h"
+#import "iTermMultiServerProtocol.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Covers the wire format of multi-server messages, including the file descriptors that ride along
+// with a batch launch response, and the buffer that holds a child's output while no client is
+// attached. Messages go through a socketpair the same way the server and client exchange them.
+@interface iTermMultiServerProtocolTests : XCTestCase
+@end
+
+@implementation iTermMultiServerProtocolTests {
+    int _fds[2];
+}
+
+- (void)setUp {
+    XCTAssertEqual(socketpair(AF_UNIX, SOCK_STREAM, 0, _fds), 0);
+}
+
+- (void)tearDown {
+    close(_fds[0]);
+    close(_fds[1]);
+}
+
+#pragma mark - Helpers
+
+// Writes an encoded message to one end of the socketpair the way the server does.
+- (void)sendEncodedMessage:(iTermClientServerProtocolMessage *)obj {
+    int error = 0;
+    const ssize_t rc = iTermFileDescriptorServerWriteLengthAndBuffer(_fds[0],
+                                                                     obj->ioVectors[0].iov_base,
+                                                                     obj->ioVectors[0].iov_len,
+                                                                     &error);
+    XCTAssertGreaterThan(rc, 0);
+}
+
+- (int)sendAndParseMessageFromServer:(iTermMultiServerServerOriginatedMessage *)message
+                              output:(iTermMultiServerServerOriginatedMessage *)output {
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    XCTAssertEqual(iTermMultiServerProtocolEncodeMessageFromServer(message, &obj), 0);
+    [self sendEncodedMessage:&obj];
+    iTermClientServerProtocolMessageFree(&obj);
+
+    iTermClientServerProtocolMessage received;
+    XCTAssertEqual(iTermMultiServerRead(_fds[1], &received), 0);
+    const int rc = iTermMultiServerProtocolParseMessageFromServer(&received, output);
+    iTermClientServerProtocolMessageFree(&received);
+    return rc;
+}
+
+- (int)sendAndParseMessageFromClient:(iTermMultiServerClientOriginatedMessage *)message
+                              output:(iTermMultiServerClientOriginatedMessage *)output {
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    XCTAssertEqual(iTermMultiServerProtocolEncodeMessageFromClient(message, &obj), 0);
+    [self sendEncodedMessage:&obj];
+    iTermClientServerProtocolMessageFree(&obj);
+
+    iTermClientServerProtocolMessage received;
+    XCTAssertEqual(iTermMultiServerRead(_fds[1], &received), 0);
+    const int rc = iTermMultiServerProtocolParseMessageFromClient(&received, output);
+    iTermClientServerProtocolMessageFree(&received);
+    return rc;
+}
+
+// Sends a server message with file descriptors attached and receives it the way
+// iTermFileDescriptorMultiClient does: the length with a plain read and the payload with recvmsg so
+// the control message comes along. The caller must free *received.
+- (void)sendMessageFromServer:(iTermMultiServerServerOriginatedMessage *)message
+              fileDescriptors:(const int *)fds
+                        count:(int)count
+                     received:(iTermClientServerProtocolMessage *)received {
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    XCTAssertEqual(iTermMultiServerProtocolEncodeMessageFromServer(message, &obj), 0);
+    int error = 0;
+    XCTAssertGreaterThan(iTermFileDescriptorServerWriteLengthAndBufferAndFileDescriptors(_fds[0],
+                                                                                         obj.ioVectors[0].iov_base,
+                                                                                         obj.ioVectors[0].iov_len,
+                                                                                         fds,
+                                                                                         count,
+                                                                                         &error), 0);
+    iTermClientServerProtocolMessageFree(&obj);
+
+    size_t length = 0;
+    XCTAssertEqual(read(_fds[1], &length, sizeof(length)), sizeof(length));
+    XCTAssertEqual(iTermMultiServerReadMessage(_fds[1], received, length), (ssize_t)length);
+}
+
+- (iTermMultiServerRequestLaunch)launchRequestWithPath:(const char *)path
+                                                  argv:(const char **)argv
+                                              uniqueId:(unsigned long long)uniqueId {
+    static const char *environment[] = { "PATH=/usr/bin:/bin", "TERM=xterm" };
+    int argc = 0;
+    while (argv[argc]) {
+        argc++;
+    }
+    return (iTermMultiServerRequestLaunch){
+        .path = path,
+        .argv = argv,
+        .argc = argc,
+        .envp = environment,
+        .envc = 2,
+        .columns = 80,
+        .rows = 25,
+        .pixel_width = 640,
+        .pixel_height = 400,
+        .isUTF8 = 1,
+        .pwd = "/tmp",
+        .uniqueId = uniqueId
+    };
+}
+
+// Reads what was written to the other end of a pipe through a file descriptor received in a
+// message, which shows that it refers to the same pipe.
+- (void)assertFileDescriptor:(int)fd isReadEndOfPipeWithWriteEnd:(int)writeEnd {
+    XCTAssertGreaterThanOrEqual(fd, 0);
+    const char c = 'x';
+    XCTAssertEqual(write(writeEnd, &c, 1), 1);
+    char d = 0;
+    XCTAssertEqual(read(fd, &d, 1), 1);
+    XCTAssertEqual(d, c);
+}
+
+- (NSData *)drainOutputBuffer:(iTermMultiServerOutputBuffer *)buffer chunkSize:(size_t)chunkSize {
+    NSMutableData *data = [NSMutableData data];
+    const char *bytes;
+    size_t length;
+    while ((length = iTermMultiServerOutputBufferPeek(buffer, chunkSize, &bytes)) > 0) {
+        XCTAssertLessThanOrEqual(length, chunkSize);
+        [data appendBytes:bytes length:length];
+        iTermMultiServerOutputBufferConsume(buffer, length);
+    }
+    return data;
+}
+
+- (NSData *)dataWithString:(NSString *)string {
+    return [string dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (void)appendString:(NSString *)string to:(iTermMultiServerOutputBuffer *)buffer {
+    NSData *data = [self dataWithString:string];
+    iTermMultiServerOutputBufferAppend(buffer, data.bytes, data.length);
+}
+
+#pragma mark - Replay
+
+- (void)testReplayRoundTrips {
+    // Pty output is binary and may contain NULs.
+    NSMutableData *payload = [NSMutableData data];
+    for (int i = 0; i < 1000; i++) {
+        const unsigned char c = i % 256;
+        [payload appendBytes:&c length:1];
+    }
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeReplay,
+        .payload = {
+            .replay = {
+                .pid = 1234,
+                .data = payload.bytes,
+                .length = payload.length
+            }
+        }
+    };
+    iTermMultiServerServerOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual([self sendAndParseMessageFromServer:&message output:&decoded], 0);
+    XCTAssertEqual(decoded.type, iTermMultiServerRPCTypeReplay);
+    XCTAssertEqual(decoded.payload.replay.pid, 1234);
+    XCTAssertEqualObjects([NSData dataWithBytes:decoded.payload.replay.data
+                                         length:decoded.payload.replay.length],
+                          payload);
+    iTermMultiServerServerOriginatedMessageFree(&decoded);
+}
+
+- (void)testEmptyReplayRoundTrips {
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeReplay,
+        .payload = {
+            .replay = {
+                .pid = 99,
+                .data = "",
+                .length = 0
+            }
+        }
+    };
+    iTermMultiServerServerOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual([self sendAndParseMessageFromServer:&message output:&decoded], 0);
+    XCTAssertEqual(decoded.payload.replay.pid, 99);
+    XCTAssertEqual(decoded.payload.replay.length, 0);
+    iTermMultiServerServerOriginatedMessageFree(&decoded);
+}
+
+- (void)testReplayWithoutDataIsRejected {
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    iTermClientServerProtocolMessageEncoder encoder = {
+        .offset = 0,
+        .message = &obj
+    };
+    iTermMultiServerRPCType type = iTermMultiServerRPCTypeReplay;
+    pid_t pid = 1234;
+    XCTAssertEqual(iTermClientServerProtocolEncodeTaggedInt(&encoder, &type, sizeof(type), iTermMultiServerTagType), 0);
+    XCTAssertEqual(iTermClientServerProtocolEncodeTaggedInt(&encoder, &pid, sizeof(pid), iTermMultiServerTagReplayPid), 0);
+    iTermEncoderCommit(&encoder);
+    [self sendEncodedMessage:&obj];
+    iTermClientServerProtocolMessageFree(&obj);
+
+    iTermClientServerProtocolMessage received;
+    XCTAssertEqual(iTermMultiServerRead(_fds[1], &received), 0);
+    iTermMultiServerServerOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertNotEqual(iTermMultiServerProtocolParseMessageFromServer(&received, &decoded), 0);
+    iTermClientServerProtocolMessageFree(&received);
+}
+
+#pragma mark - Handshake
+
+- (void)testVersion4HandshakeCarriesFlags {
+    iTermMultiServerClientOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeHandshake,
+        .payload = {
+            .handshake = {
+                .maximumProtocolVersion = iTermMultiServerProtocolVersion4,
+                .flags = iTermMultiServerHandshakeFlagBufferOutputWhileDetached
+            }
+        }
+    };
+    iTermMultiServerClientOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual([self sendAndParseMessageFromClient:&message output:&decoded], 0);
+    XCTAssertEqual(decoded.type, iTermMultiServerRPCTypeHandshake);
+    XCTAssertEqual(decoded.payload.handshake.maximumProtocolVersion, iTermMultiServerProtocolVersion4);
+    XCTAssertEqual(decoded.payload.handshake.flags, iTermMultiServerHandshakeFlagBufferOutputWhileDetached);
+    iTermMultiServerClientOriginatedMessageFree(&decoded);
+}
+
+- (void)testVersion4HandshakeWithoutFlagsParses {
+    // Flags are optional even for version 4 clients.
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    iTermClientServerProtocolMessageEncoder encoder = {
+        .offset = 0,
+        .message = &obj
+    };
+    iTermMultiServerRPCType type = iTermMultiServerRPCTypeHandshake;
+    int version = iTermMultiServerProtocolVersion4;
+    XCTAssertEqual(iTermClientServerProtocolEncodeTaggedInt(&encoder, &type, sizeof(type), iTermMultiServerTagType), 0);
+    XCTAssertEqual(iTermClientServerProtocolEncodeTaggedInt(&encoder, &version, sizeof(version), iTermMultiServerTagHandshakeRequestClientMaximumProtocolVersion), 0);
+    iTermEncoderCommit(&encoder);
+    [self sendEncodedMessage:&obj];
+    iTermClientServerProtocolMessageFree(&obj);
+
+    iTermClientServerProtocolMessage received;
+    XCTAssertEqual(iTermMultiServerRead(_fds[1], &received), 0);
+    iTermMultiServerClientOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual(iTermMultiServerProtocolParseMessageFromClient(&received, &decoded), 0);
+    iTermClientServerProtocolMessageFree(&received);
+    XCTAssertEqual(decoded.payload.handshake.maximumProtocolVersion, iTermMultiServerProtocolVersion4);
+    XCTAssertEqual(decoded.payload.handshake.flags, 0);
+    iTermMultiServerClientOriginatedMessageFree(&decoded);
+}
+
+- (void)testVersion3HandshakeOmitsFlags {
+    iTermMultiServerClientOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeHandshake,
+        .payload = {
+            .handshake = {
+                .maximumProtocolVersion = iTermMultiServerProtocolVersion3,
+                .flags = iTermMultiServerHandshakeFlagBufferOutputWhileDetached
+            }
+        }
+    };
+    iTermMultiServerClientOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual([self sendAndParseMessageFromClient:&message output:&decoded], 0);
+    XCTAssertEqual(decoded.payload.handshake.maximumProtocolVersion, iTermMultiServerProtocolVersion3);
+    XCTAssertEqual(decoded.payload.handshake.flags, 0);
+    iTermMultiServerClientOriginatedMessageFree(&decoded);
+}
+
+#pragma mark - Batch Launch
+
+- (void)testBatchLaunchRequestRoundTrips {
+    const char *shellArgv[] = { "/bin/sh", "-l", NULL };
+    const char *sleepArgv[] = { "/bin/sleep", "10", NULL };
+    iTermMultiServerRequestLaunch launches[] = {
+        [self launchRequestWithPath:"/bin/sh" argv:shellArgv uniqueId:1],
+        [self launchRequestWithPath:"/bin/sleep" argv:sleepArgv uniqueId:2]
+    };
+    iTermMultiServerClientOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeBatchLaunch,
+        .payload = {
+            .batchLaunch = {
+                .count = 2,
+                .launches = launches
+            }
+        }
+    };
+    iTermMultiServerClientOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertEqual([self sendAndParseMessageFromClient:&message output:&decoded], 0);
+    XCTAssertEqual(decoded.type, iTermMultiServerRPCTypeBatchLaunch);
+    XCTAssertEqual(decoded.payload.batchLaunch.count, 2);
+    for (int i = 0; i < 2; i++) {
+        const iTermMultiServerRequestLaunch *expected = &launches[i];
+        const iTermMultiServerRequestLaunch *actual = &decoded.payload.batchLaunch.launches[i];
+        XCTAssertEqual(strcmp(actual->path, expected->path), 0);
+        XCTAssertEqual(actual->argc, expected->argc);
+        for (int j = 0; j < expected->argc; j++) {
+            XCTAssertEqual(strcmp(actual->argv[j], expected->argv[j]), 0);
+        }
+        XCTAssertEqual(actual->envc, expected->envc);
+        for (int j = 0; j < expected->envc; j++) {
+            XCTAssertEqual(strcmp(actual->envp[j], expected->envp[j]), 0);
+        }
+        XCTAssertEqual(actual->columns, expected->columns);
+        XCTAssertEqual(actual->rows, expected->rows);
+        XCTAssertEqual(actual->pixel_width, expected->pixel_width);
+        XCTAssertEqual(actual->pixel_height, expected->pixel_height);
+        XCTAssertEqual(actual->isUTF8, expected->isUTF8);
+        XCTAssertEqual(strcmp(actual->pwd, expected->pwd), 0);
+        XCTAssertEqual(actual->uniqueId, expected->uniqueId);
+    }
+    iTermMultiServerClientOriginatedMessageFree(&decoded);
+}
+
+- (void)testEmptyBatchLaunchRequestIsRejected {
+    iTermMultiServerClientOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeBatchLaunch,
+        .payload = {
+            .batchLaunch = {
+                .count = 0,
+                .launches = NULL
+            }
+        }
+    };
+    iTermMultiServerClientOriginatedMessage decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    XCTAssertNotEqual([self sendAndParseMessageFromClient:&message output:&decoded], 0);
+    iTermMultiServerClientOriginatedMessageFree(&decoded);
+}
+
+// File descriptors go only to the launches that succeeded, in order.
+- (void)testBatchLaunchResponseAssignsFileDescriptorsToSuccessfulLaunches {
+    int first[2];
+    int second[2];
+    XCTAssertEqual(pipe(first), 0);
+    XCTAssertEqual(pipe(second), 0);
+    iTermMultiServerResponseLaunch responses[] = {
+        { .status = 0, .pid = 100, .fd = first[0], .uniqueId = 1, .tty = "/dev/ttys001" },
+        { .status = -1, .pid = 0, .fd = -1, .uniqueId = 2, .tty = "" },
+        { .status = 0, .pid = 102, .fd = second[0], .uniqueId = 3, .tty = "/dev/ttys003" }
+    };
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeBatchLaunch,
+        .payload = {
+            .batchLaunch = {
+                .count = 3,
+                .launches = responses
+            }
+        }
+    };
+    const int fds[] = { first[0], second[0] };
+    iTermClientServerProtocolMessage received;
+    [self sendMessageFromServer:&message fileDescriptors:fds count:2 received:&received];
+
+    iTermMultiServerServerOriginatedMessage decoded;
+    XCTAssertEqual(iTermMultiServerProtocolParseMessageFromServer(&received, &decoded), 0);
+    iTermClientServerProtocolMessageFree(&received);
+
+    XCTAssertEqual(decoded.payload.batchLaunch.count, 3);
+    const iTermMultiServerResponseLaunch *launches = decoded.payload.batchLaunch.launches;
+    XCTAssertEqual(launches[0].pid, 100);
+    XCTAssertEqual(launches[0].uniqueId, 1);
+    XCTAssertEqual(strcmp(launches[0].tty, "/dev/ttys001"), 0);
+    [self assertFileDescriptor:launches[0].fd isReadEndOfPipeWithWriteEnd:first[1]];
+
+    XCTAssertEqual(launches[1].status, -1);
+    XCTAssertEqual(launches[1].uniqueId, 2);
+    XCTAssertEqual(launches[1].fd, -1);
+
+    XCTAssertEqual(launches[2].pid, 102);
+    XCTAssertEqual(launches[2].uniqueId, 3);
+    [self assertFileDescriptor:launches[2].fd isReadEndOfPipeWithWriteEnd:second[1]];
+
+    close(launches[0].fd);
+    close(launches[2].fd);
+    iTermMultiServerServerOriginatedMessageFree(&decoded);
+    close(first[0]);
+    close(first[1]);
+    close(second[0]);
+    close(second[1]);
+}
+
+// If the number of file descriptors doesn't match the number of successful launches, they can't be
+// matched up. The parser must close the ones it received rather than leak them.
+- (void)testBatchLaunchResponseWithWrongNumberOfFileDescriptorsClosesThem {
+    int first[2];
+    XCTAssertEqual(pipe(first), 0);
+    iTermMultiServerResponseLaunch responses[] = {
+        { .status = 0, .pid = 100, .fd = first[0], .uniqueId = 1, .tty = "/dev/ttys001" },
+        { .status = 0, .pid = 101, .fd = -1, .uniqueId = 2, .tty = "/dev/ttys002" }
+    };
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeBatchLaunch,
+        .payload = {
+            .batchLaunch = {
+                .count = 2,
+                .launches = responses
+            }
+        }
+    };
+    iTermClientServerProtocolMessage received;
+    [self sendMessageFromServer:&message fileDescriptors:first count:1 received:&received];
+
+    int receivedFDs[ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE];
+    int count = 0;
+    XCTAssertEqual(iTermMultiServerProtocolGetFileDescriptors(&received,
+                                                              receivedFDs,
+                                                              ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE,
+                                                              &count), 0);
+    XCTAssertEqual(count, 1);
+    XCTAssertNotEqual(fcntl(receivedFDs[0], F_GETFD), -1);
+
+    iTermMultiServerServerOriginatedMessage decoded;
+    XCTAssertNotEqual(iTermMultiServerProtocolParseMessageFromServer(&received, &decoded), 0);
+    iTermClientServerProtocolMessageFree(&received);
+    iTermMultiServerServerOriginatedMessageFree(&decoded);
+
+    const int rc = fcntl(receivedFDs[0], F_GETFD);
+    const int error = errno;
+    XCTAssertEqual(rc, -1);
+    XCTAssertEqual(error, EBADF);
+    close(first[0]);
+    close(first[1]);
+}
+
+#pragma mark - Output Buffer
+
+- (void)testOutputBufferReturnsBytesInOrder {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 16 };
+    [self appendString:@"hello " to:&buffer];
+    [self appendString:@"world" to:&buffer];
+    XCTAssertEqual(buffer.length, 11);
+    XCTAssertEqualObjects([self drainOutputBuffer:&buffer chunkSize:16], [self dataWithString:@"hello world"]);
+    XCTAssertEqual(buffer.length, 0);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+- (void)testOutputBufferDropsOldestBytesOnOverflow {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 8 };
+    [self appendString:@"abcdef" to:&buffer];
+    [self appendString:@"ghijkl" to:&buffer];
+    XCTAssertEqual(buffer.length, 8);
+    XCTAssertEqualObjects([self drainOutputBuffer:&buffer chunkSize:8], [self dataWithString:@"efghijkl"]);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+- (void)testOutputBufferKeepsTailOfOversizedAppend {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 4 };
+    [self appendString:@"xy" to:&buffer];
+    [self appendString:@"abcdefghij" to:&buffer];
+    XCTAssertEqual(buffer.length, 4);
+    XCTAssertEqualObjects([self drainOutputBuffer:&buffer chunkSize:4], [self dataWithString:@"ghij"]);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+- (void)testOutputBufferPeekStopsAtWraparound {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 8 };
+    [self appendString:@"abcdef" to:&buffer];
+    iTermMultiServerOutputBufferConsume(&buffer, 4);
+    [self appendString:@"ghijk" to:&buffer];
+
+    // "efgh" sits at the end of the storage and "ijk" at the beginning.
+    const char *bytes;
+    size_t length = iTermMultiServerOutputBufferPeek(&buffer, 100, &bytes);
+    XCTAssertEqualObjects([NSData dataWithBytes:bytes length:length], [self dataWithString:@"efgh"]);
+    iTermMultiServerOutputBufferConsume(&buffer, length);
+    length = iTermMultiServerOutputBufferPeek(&buffer, 100, &bytes);
+    XCTAssertEqualObjects([NSData dataWithBytes:bytes length:length], [self dataWithString:@"ijk"]);
+    iTermMultiServerOutputBufferConsume(&buffer, length);
+    XCTAssertEqual(iTermMultiServerOutputBufferPeek(&buffer, 100, &bytes), 0);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+- (void)testOutputBufferOverflowAfterWraparound {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 8 };
+    for (int i = 0; i < 10; i++) {
+        [self appendString:@"0123456789" to:&buffer];
+        iTermMultiServerOutputBufferConsume(&buffer, 3);
+    }
+    [self appendString:@"abc" to:&buffer];
+    XCTAssertEqualObjects([self drainOutputBuffer:&buffer chunkSize:3], [self dataWithString:@"56789abc"]);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+- (void)testFreedOutputBufferCanBeReused {
+    iTermMultiServerOutputBuffer buffer = { .capacity = 8 };
+    [self appendString:@"abc" to:&buffer];
+    iTermMultiServerOutputBufferFree(&buffer);
+    XCTAssertEqual(buffer.length, 0);
+    XCTAssertTrue(buffer.bytes == NULL);
+
+    [self appendString:@"xyz" to:&buffer];
+    XCTAssertEqualObjects([self drainOutputBuffer:&buffer chunkSize:8], [self dataWithString:@"xyz"]);
+    iTermMultiServerOutputBufferFree(&buffer);
+}
+
+@end
@@ -0,0 +1,220 @@
+//
+//  iTermMultiServerStressTest.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermFileDescriptorMultiClient.h"
+#import "iTermResult.h"
+#import "iTermThreadSafety.h"
+#import "iTermTTYState.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+// Launches and reaps thousands of short-lived shells through a real multi-server daemon while a
+// population of long-lived children stays attached, and checks that the cost of a batch doesn't
+// grow as the daemon churns through children. Also checks that launches requested all at once,
+// which are sent in batches, each get their own child.
+@interface iTermMultiServerStressTest : XCTestCase<iTermFileDescriptorMultiClientDelegate>
+@end
+
+static const int iTermMultiServerStressTestLongLivedChildren = 100;
+static const int iTermMultiServerStressTestShortLivedChildren = 2000;
+static const int iTermMultiServerStressTestBatchSize = 50;
+
+// These must outlive the launch callbacks.
+static const char *iTermMultiServerStressTestShortLivedArgv[] = { "/bin/sh", "-c", "exit 0", NULL };
+static const char *iTermMultiServerStressTestLongLivedArgv[] = { "/bin/sh", "-c", "exec sleep 600", NULL };
+static const char *iTermMultiServerStressTestEnvironment[] = { "PATH=/usr/bin:/bin", NULL };
+
+@implementation iTermMultiServerStressTest {
+    iTermFileDescriptorMultiClient *_client;
+    NSString *_socketPath;
+    NSMutableArray<iTermFileDescriptorMultiClientChild *> *_longLivedChildren;
+
+    // Pids of children that were launched and haven't terminated yet. tearDown kills them so a
+    // failed test doesn't leave them behind.
+    NSMutableSet<NSNumber *> *_livePIDs;
+
+    // Fulfilled once for each child that terminates and is waited on.
+    XCTestExpectation *_reaped;
+}
+
+- (void)setUp {
+    // Socket paths have a short length limit, so keep the name short.
+    _socketPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"mss-%d.socket", getpid()]] retain];
+    _longLivedChildren = [[NSMutableArray alloc] init];
+    _livePIDs = [[NSMutableSet alloc] init];
+    _client = [[iTermFileDescriptorMultiClient alloc] initWithPath:_socketPath];
+    _client.delegate = self;
+
+    XCTestExpectation *connected = [self expectationWithDescription:@"connected"];
+    [_client attachToOrLaunchNewDaemonWithCallback:[[[iTermThread main] newCallbackWithBlock:^(id state, NSNumber *ok) {
+        XCTAssertTrue(ok.boolValue);
+        [connected fulfill];
+    }] autorelease]];
+    [self waitForExpectations:@[ connected ] timeout:30];
+}
+
+- (void)tearDown {
+    // The daemon outlives its client, so kill it along with any children it still has.
+    for (NSNumber *pid in _livePIDs) {
+        kill(pid.intValue, SIGKILL);
+    }
+    if (_client.serverPID > 0) {
+        kill(_client.serverPID, SIGKILL);
+    }
+    [_livePIDs release];
+    _livePIDs = nil;
+    _client.delegate = nil;
+    [_client release];
+    _client = nil;
+    [_longLivedChildren release];
+    [[NSFileManager defaultManager] removeItemAtPath:_socketPath error:nil];
+    [_socketPath release];
+}
+
+- (void)launchWithArgv:(const char **)argv
+              launched:(XCTestExpectation *)launched
+            completion:(void (^)(iTermFileDescriptorMultiClientChild *child))completion {
+    iTermTTYState ttyState;
+    iTermTTYStateInit(&ttyState, iTermTTYCellSizeMake(80, 25), iTermTTYPixelSizeMake(0, 0), 1);
+    [_client launchChildWithExecutablePath:argv[0]
+                                      argv:argv
+                               environment:iTermMultiServerStressTestEnvironment
+                                       pwd:"/"
+                                  ttyState:ttyState
+                                  callback:[[[iTermThread main] newCallbackWithBlock:^(id state, iTermResult<iTermFileDescriptorMultiClientChild *> *result) {
+        [result handleObject:^(iTermFileDescriptorMultiClientChild *child) {
+            [_livePIDs addObject:@(child.pid)];
+            if (completion) {
+                completion(child);
+            }
+            [launched fulfill];
+        } error:^(NSError *error) {
+            XCTFail(@"Launch failed: %@", error);
+            [launched fulfill];
+        }];
+    }] autorelease]];
+}
+
+#pragma mark - iTermFileDescriptorMultiClientDelegate
+
+- (void)fileDescriptorMultiClient:(iTermFileDescriptorMultiClient *)client
+                 didDiscoverChild:(iTermFileDescriptorMultiClientChild *)child {
+}
+
+- (void)fileDescriptorMultiClient:(iTermFileDescriptorMultiClient *)client
+                childDidTerminate:(iTermFileDescriptorMultiClientChild *)child {
+    [_livePIDs removeObject:@(child.pid)];
+    XCTestExpectation *reaped = _reaped;
+    [client waitForChild:child
+      removePreemptively:NO
+                callback:[[[iTermThread main] newCallbackWithBlock:^(id state, iTermResult<NSNumber *> *status) {
+        [status handleObject:^(NSNumber *value) {
+            [reaped fulfill];
+        } error:^(NSError *error) {
+            XCTFail(@"Wait failed: %@", error);
+            [reaped fulfill];
+        }];
+    }] autorelease]];
+}
+
+- (void)fileDescriptorMultiClientDidClose:(iTermFileDescriptorMultiClient *)client {
+}
+
+#pragma mark - Tests
+
+- (void)testLaunchAndReapThousandsOfShells {
+    XCTestExpectation *longLivedLaunched = [self expectationWithDescription:@"long-lived children launched"];
+    longLivedLaunched.expectedFulfillmentCount = iTermMultiServerStressTestLongLivedChildren;
+    for (int i = 0; i < iTermMultiServerStressTestLongLivedChildren; i++) {
+        [self launchWithArgv:iTermMultiServerStressTestLongLivedArgv
+                    launched:longLivedLaunched
+                  completion:^(iTermFileDescriptorMultiClientChild *child) {
+            [_longLivedChildren addObject:child];
+        }];
+    }
+    [self waitForExpectations:@[ longLivedLaunched ] timeout:60];
+
+    NSMutableArray<NSNumber *> *durations = [NSMutableArray array];
+    const int numberOfBatches = iTermMultiServerStressTestShortLivedChildren / iTermMultiServerStressTestBatchSize;
+    for (int batch = 0; batch < numberOfBatches; batch++) {
+        XCTestExpectation *launched = [self expectationWithDescription:@"launched"];
+        launched.expectedFulfillmentCount = iTermMultiServerStressTestBatchSize;
+        _reaped = [self expectationWithDescription:@"reaped"];
+        _reaped.expectedFulfillmentCount = iTermMultiServerStressTestBatchSize;
+
+        const NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        for (int i = 0; i < iTermMultiServerStressTestBatchSize; i++) {
+            [self launchWithArgv:iTermMultiServerStressTestShortLivedArgv
+                        launched:launched
+                      completion:nil];
+        }
+        [self waitForExpectations:@[ launched, _reaped ] timeout:60];
+        [durations addObject:@([NSDate timeIntervalSinceReferenceDate] - start)];
+    }
+
+    // Kill the long-lived children and make sure they're reaped too.
+    _reaped = [self expectationWithDescription:@"long-lived children reaped"];
+    _reaped.expectedFulfillmentCount = iTermMultiServerStressTestLongLivedChildren;
+    for (iTermFileDescriptorMultiClientChild *child in _longLivedChildren) {
+        kill(child.pid, SIGKILL);
+    }
+    [self waitForExpectations:@[ _reaped ] timeout:60];
+    _reaped = nil;
+
+    // Skip the first batch, which includes warmup.
+    const double early = [durations[1] doubleValue];
+    const double late = [durations.lastObject doubleValue];
+    NSLog(@"Launched and reaped %d shells alongside %d long-lived children. Second batch took %.0fms, last batch took %.0fms",
+          iTermMultiServerStressTestShortLivedChildren,
+          iTermMultiServerStressTestLongLivedChildren,
+          early * 1000,
+          late * 1000);
+    XCTAssertLessThan(late, early * 4 + 0.5);
+}
+
+// Like restoring an arrangement with many panes: every launch is requested at once, so all but the
+// first are sent in batch launch requests. Each must still get its own child and pty.
+- (void)testSimultaneousLaunchesAreBatched {
+    const int count = 60;
+    NSMutableArray<iTermFileDescriptorMultiClientChild *> *children = [NSMutableArray array];
+    XCTestExpectation *launched = [self expectationWithDescription:@"launched"];
+    launched.expectedFulfillmentCount = count;
+    for (int i = 0; i < count; i++) {
+        [self launchWithArgv:iTermMultiServerStressTestLongLivedArgv
+                    launched:launched
+                  completion:^(iTermFileDescriptorMultiClientChild *child) {
+            [children addObject:child];
+        }];
+    }
+    [self waitForExpectations:@[ launched ] timeout:60];
+
+    XCTAssertEqual(children.count, count);
+    NSMutableSet<NSNumber *> *pids = [NSMutableSet set];
+    NSMutableSet<NSNumber *> *fds = [NSMutableSet set];
+    for (iTermFileDescriptorMultiClientChild *child in children) {
+        XCTAssertGreaterThan(child.pid, 0);
+        XCTAssertGreaterThanOrEqual(child.fd, 0);
+        XCTAssertTrue(isatty(child.fd));
+        [pids addObject:@(child.pid)];
+        [fds addObject:@(child.fd)];
+    }
+    XCTAssertEqual(pids.count, count);
+    XCTAssertEqual(fds.count, count);
+
+    _reaped = [self expectationWithDescription:@"reaped"];
+    _reaped.expectedFulfillmentCount = count;
+    for (iTermFileDescriptorMultiClientChild *child in children) {
+        kill(child.pid, SIGKILL);
+    }
+    [self waitForExpectations:@[ _reaped ] timeout:60];
+    _reaped = nil;
+}
+
+@end
@@ -67,12 +67,17 @@ static const double kFloatingPointTolerance = 0.00001;
     BOOL _isAtShellPrompt;
     iTermInstrumentedPasteHelper *_helper;
     WarningBlockType _warningBlock;
+    // Negative to pace pastes with the timer.
+    NSInteger _writeBufferRoom;
+    int _numberOfWriteBufferRoomRequests;
 }
 
 - (void)setUp {
     _writeBuffer = [[[NSMutableString alloc] init] autorelease];
     _shouldBracket = NO;
     _isAtShellPrompt = NO;
+    _writeBufferRoom = -1;
+    _numberOfWriteBufferRoomRequests = 0;
     _helper = [[[iTermInstrumentedPasteHelper alloc] init] autorelease];
     _helper.delegate = self;
     [iTermWarning setWarningHandler:self];
@@ -538,6 +543,45 @@ static const double kFloatingPointTolerance = 0.00001;
     XCTAssert(fabs(_helper.duration - expectedDuration) < kFloatingPointTolerance);
 }
 
+- (void)testFlowControlledPasteString {
+    _writeBufferRoom = 1000;
+    NSString *test = [@" " stringRepeatedTimes:2500];
+    [_helper pasteString:test
+                  slowly:NO
+        escapeShellChars:NO
+                isUpload:NO
+            tabTransform:kTabTransformNone
+            spacesPerTab:0];
+    // Each chunk fills the write buffer and then waits for it to drain instead of using a timer.
+    XCTAssertNil(_helper.timer);
+    XCTAssertEqual(_writeBuffer.length, 1000);
+    XCTAssertEqual(_numberOfWriteBufferRoomRequests, 1);
+    XCTAssertTrue(_helper.isPasting);
+
+    [_helper writeBufferDidGainRoom];
+    XCTAssertEqual(_writeBuffer.length, 2000);
+    [_helper writeBufferDidGainRoom];
+    XCTAssertEqualObjects(_writeBuffer, test);
+    XCTAssertEqual(_numberOfWriteBufferRoomRequests, 2);
+    XCTAssertFalse(_helper.isPasting);
+    XCTAssertEqual(_helper.duration, 0);
+}
+
+- (void)testSlowPasteIsNotFlowControlled {
+    _writeBufferRoom = 1000;
+    NSString *test = [@" " stringRepeatedTimes:20];
+    [_helper pasteString:test
+                  slowly:YES
+        escapeShellChars:NO
+                isUpload:NO
+            tabTransform:kTabTransformNone
+            spacesPerTab:0];
+    [self runTimer];
+    XCTAssertEqualObjects(_writeBuffer, test);
+    XCTAssertEqual(_numberOfWriteBufferRoomRequests, 0);
+    XCTAssert(fabs(_helper.duration - 0.125) < kFloatingPointTolerance);
+}
+
 #pragma mark - iTermPasteHelperDelegate
 
 - (void)pasteHelperWriteString:(NSString *)string {
@@ -584,6 +628,14 @@ static const double kFloatingPointTolerance = 0.00001;
     return nil;
 }
 
+- (NSInteger)pasteHelperWriteBufferRoom {
+    return _writeBufferRoom;
+}
+
+- (void)pasteHelperNotifyWhenWriteBufferHasRoom {
+    _numberOfWriteBufferRoomRequests++;
+}
+
 
 #pragma mark - iTermWarningHandler
 
@@ -0,0 +1,111 @@
+//
+//  iTermPipelineMetricsTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#import "iTermPipelineMetrics.h"
+
+// Triggers don't run in the test host, so nothing else records into this stage.
+static const iTermPipelineStage iTermPipelineMetricsTestStage = iTermPipelineStageTriggerMicroseconds;
+
+@interface iTermPipelineMetricsTests : XCTestCase
+@end
+
+@implementation iTermPipelineMetricsTests
+
+- (void)setUp {
+    [iTermPipelineMetrics reset];
+}
+
+- (void)tearDown {
+    [iTermPipelineMetrics reset];
+}
+
+#pragma mark - Buckets
+
+- (void)testSmallValuesHaveExactBuckets {
+    for (uint64_t value = 0; value < 16; value++) {
+        XCTAssertEqual(iTermPipelineMetricsBucketForValue(value), (int)value);
+        XCTAssertEqual(iTermPipelineMetricsLowerBoundOfBucket((int)value), value);
+    }
+}
+
+- (void)testBucketBoundaries {
+    const int lastBucket = iTermPipelineMetricsBucketForValue(UINT64_MAX);
+    for (int bucket = 0; bucket < lastBucket; bucket++) {
+        const uint64_t lowerBound = iTermPipelineMetricsLowerBoundOfBucket(bucket);
+        const uint64_t nextLowerBound = iTermPipelineMetricsLowerBoundOfBucket(bucket + 1);
+        XCTAssertLessThan(lowerBound, nextLowerBound);
+        // The first and last values in the bucket map back to it.
+        XCTAssertEqual(iTermPipelineMetricsBucketForValue(lowerBound), bucket);
+        XCTAssertEqual(iTermPipelineMetricsBucketForValue(nextLowerBound - 1), bucket);
+        if (bucket >= 16) {
+            // Eight buckets per power of two: no bucket is wider than 12.5% of its lower bound.
+            XCTAssertLessThanOrEqual((nextLowerBound - lowerBound) * 8, lowerBound);
+        }
+    }
+}
+
+- (void)testPowersOfTwoStartBuckets {
+    for (int exponent = 4; exponent <= 40; exponent++) {
+        const uint64_t value = 1ULL << exponent;
+        const int bucket = iTermPipelineMetricsBucketForValue(value);
+        XCTAssertEqual(iTermPipelineMetricsLowerBoundOfBucket(bucket), value);
+        XCTAssertEqual(iTermPipelineMetricsBucketForValue(value - 1), bucket - 1);
+    }
+}
+
+- (void)testHugeValuesAreClampedToLastBucket {
+    const int lastBucket = iTermPipelineMetricsBucketForValue((1ULL << 41) - 1);
+    XCTAssertEqual(iTermPipelineMetricsBucketForValue(1ULL << 41), lastBucket);
+    XCTAssertEqual(iTermPipelineMetricsBucketForValue(1ULL << 60), lastBucket);
+    XCTAssertEqual(iTermPipelineMetricsBucketForValue(UINT64_MAX), lastBucket);
+}
+
+#pragma mark - Percentiles
+
+- (void)testValueAtNTileWithNoSamples {
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:0.5 forStage:iTermPipelineMetricsTestStage], 0);
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:1 forStage:iTermPipelineMetricsTestStage], 0);
+}
+
+- (void)testValueAtNTileIsExactForSmallValues {
+    for (NSNumber *value in @[ @3, @3, @3, @7 ]) {
+        iTermPipelineMetricsRecord(iTermPipelineMetricsTestStage, value.unsignedLongLongValue);
+    }
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:0 forStage:iTermPipelineMetricsTestStage], 3);
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:0.5 forStage:iTermPipelineMetricsTestStage], 3);
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:0.75 forStage:iTermPipelineMetricsTestStage], 3);
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:0.76 forStage:iTermPipelineMetricsTestStage], 7);
+    XCTAssertEqual([iTermPipelineMetrics valueAtNTile:1 forStage:iTermPipelineMetricsTestStage], 7);
+}
+
+- (void)testValueAtNTileIsWithinBucketPrecision {
+    for (uint64_t value = 1; value <= 1000; value++) {
+        iTermPipelineMetricsRecord(iTermPipelineMetricsTestStage, value);
+    }
+    for (NSNumber *ntile in @[ @0.5, @0.9, @0.99, @1 ]) {
+        const double expected = ntile.doubleValue * 1000;
+        const uint64_t actual = [iTermPipelineMetrics valueAtNTile:ntile.doubleValue
+                                                          forStage:iTermPipelineMetricsTestStage];
+        XCTAssertLessThanOrEqual(actual, expected);
+        XCTAssertGreaterThanOrEqual(actual, expected * 0.875);
+    }
+}
+
+- (void)testSnapshotReportsExactCountMeanAndMax {
+    for (uint64_t value = 1; value <= 1000; value++) {
+        iTermPipelineMetricsRecord(iTermPipelineMetricsTestStage, value);
+    }
+    NSDictionary<NSString *, NSNumber *> *summary = [iTermPipelineMetrics snapshot][@"trigger_us"];
+    XCTAssertEqualObjects(summary[@"count"], @1000);
+    XCTAssertEqual(summary[@"mean"].doubleValue, 500.5);
+    XCTAssertEqualObjects(summary[@"max"], @1000);
+    XCTAssertEqual(summary[@"p50"].unsignedLongLongValue,
+                   [iTermPipelineMetrics valueAtNTile:0.5 forStage:iTermPipelineMetricsTestStage]);
+}
+
+@end
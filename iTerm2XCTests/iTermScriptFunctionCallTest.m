@@ -7,6 +7,7 @@
 
 #import <XCTest/XCTest.h>
 #import "iTermBuiltInFunctions.h"
+#import "iTermCompiledExpression.h"
 #import "iTermExpressionEvaluator.h"
 #import "iTermExpressionParser.h"
 #import "iTermScriptFunctionCall.h"
@@ -478,6 +479,46 @@
     XCTAssertEqualObjects(actual, expected);
 }
 
+- (void)testCompiledInterpolatedStringBindsToEachScope {
+    iTermCompiledExpression *compiled =
+    [iTermCompiledExpression compiledInterpolatedString:@"\\(greeting), \\(add(x: one, y: array[2])) \\(name?)"];
+    XCTAssertEqual(compiled, [iTermCompiledExpression compiledInterpolatedString:@"\\(greeting), \\(add(x: one, y: array[2])) \\(name?)"]);
+    NSSet *expectedDependencies = [NSSet setWithArray:@[ @"greeting", @"one", @"array", @"name" ]];
+    XCTAssertEqualObjects(compiled.dependencies, expectedDependencies);
+    XCTAssertTrue(compiled.containsFunctionCall);
+
+    NSString *(^evaluate)(iTermVariableScope *) = ^NSString *(iTermVariableScope *scope) {
+        __block id output;
+        iTermParsedExpression *parsedExpression = [compiled parsedExpressionWithScope:scope
+                                                                     escapingFunction:nil
+                                                                               strict:YES];
+        [[[iTermExpressionEvaluator alloc] initWithParsedExpression:parsedExpression
+                                                         invocation:@"test"
+                                                              scope:scope] evaluateWithTimeout:0 completion:^(iTermExpressionEvaluator * _Nonnull evaluator) {
+            output = evaluator.error ? evaluator.error : evaluator.value;
+        }];
+        return output;
+    };
+
+    [_scope setValue:@"hello" forVariableNamed:@"greeting"];
+    [_scope setValue:@1 forVariableNamed:@"one"];
+    [_scope setValue:@[@0, @1, @2, @3] forVariableNamed:@"array"];
+    XCTAssertEqualObjects(evaluate(_scope), @"hello, 3 ");
+
+    iTermVariableScope *otherScope = [[iTermVariableScope alloc] init];
+    [otherScope addVariables:[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextNone owner:self]
+                toScopeNamed:nil];
+    [otherScope setValue:@"bye" forVariableNamed:@"greeting"];
+    [otherScope setValue:@10 forVariableNamed:@"one"];
+    [otherScope setValue:@[@0, @1, @20] forVariableNamed:@"array"];
+    [otherScope setValue:@"you" forVariableNamed:@"name"];
+    XCTAssertEqualObjects(evaluate(otherScope), @"bye, 30 you");
+
+    // Errors that depend on the scope are found when binding, not when compiling.
+    [otherScope setValue:@[] forVariableNamed:@"array"];
+    XCTAssertTrue([evaluate(otherScope) isKindOfClass:[NSError class]]);
+}
+
 #pragma mark - iTermObject
 
 - (iTermBuiltInFunctions *)objectMethodRegistry {
@@ -10,6 +10,7 @@
 #import "iTermCommandHistoryEntryMO.h"
 #import "iTermHostRecordMO.h"
 #import "iTermShellHistoryController.h"
+#import "NSArray+iTerm.h"
 #import "NSStringITerm.h"
 #import "VT100RemoteHost.h"
 #import "VT100ScreenMark.h"
@@ -455,6 +456,36 @@ static NSTimeInterval kDefaultTime = 10000000;
     XCTAssertEqual(entries.count, 0);
 }
 
+- (void)testSearchCommandEntriesByPrefixIgnoresCaseAndRanksByUse {
+    iTermShellHistoryControllerForTesting *historyController =
+        [[[iTermShellHistoryControllerForTesting alloc] initWithGuid:_guid] autorelease];
+    VT100RemoteHost *remoteHost = [[[VT100RemoteHost alloc] init] autorelease];
+    remoteHost.username = @"user1";
+    remoteHost.hostname = @"host1";
+
+    historyController.currentTime = 0;
+    for (NSString *command in @[ @"Make", @"make test", @"ls", @"make test", @"make", @"MAKE" ]) {
+        [historyController addCommand:command
+                               onHost:remoteHost
+                          inDirectory:@"/directory1"
+                             withMark:[[[VT100ScreenMark alloc] init] autorelease]];
+        historyController.currentTime = historyController.currentTime + 1;
+    }
+
+    NSArray<iTermCommandHistoryEntryMO *> *entries =
+        [historyController commandHistoryEntriesWithPrefix:@"mAk" onHost:remoteHost];
+    NSArray<NSString *> *commands = [entries mapWithBlock:^id(iTermCommandHistoryEntryMO *entry) {
+        return entry.command;
+    }];
+    // "make test" was used twice. The rest were used once and are ordered by recency.
+    NSArray<NSString *> *expected = @[ @"make test", @"MAKE", @"make", @"Make" ];
+    XCTAssertEqualObjects(commands, expected);
+
+    entries = [historyController commandHistoryEntriesWithPrefix:@"MAKE " onHost:remoteHost];
+    XCTAssertEqual(entries.count, 1);
+    XCTAssertEqualObjects(entries.firstObject.numberOfUses, @2);
+}
+
 - (void)testSearchCommandUsesByPrefix {
     iTermShellHistoryControllerForTesting *historyController =
         [[[iTermShellHistoryControllerForTesting alloc] initWithGuid:_guid] autorelease];
@@ -0,0 +1,140 @@
+//
+//  iTermSixelDecoderTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+#include "iTermSixelDecoder.h"
+
+@interface iTermSixelDecoderTests : XCTestCase
+
+@end
+
+@implementation iTermSixelDecoderTests
+
+- (NSData *)dataWithString:(NSString *)string {
+    return [string dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (NSData *)rgbaForDecoder:(iTermSixelDecoder *)decoder {
+    const int width = iTermSixelDecoderGetWidth(decoder);
+    const int height = iTermSixelDecoderGetHeight(decoder);
+    NSMutableData *rgba = [NSMutableData dataWithLength:width * height * 4];
+    iTermSixelDecoderCopyRGBA(decoder, 0, height, rgba.mutableBytes);
+    return rgba;
+}
+
+- (uint32_t)pixelAtX:(int)x y:(int)y inData:(NSData *)rgba width:(int)width {
+    uint32_t pixel;
+    memcpy(&pixel, rgba.bytes + (y * width + x) * 4, sizeof(pixel));
+    return pixel;
+}
+
+- (uint32_t)red:(int)r green:(int)g blue:(int)b alpha:(int)a {
+    const unsigned char bytes[4] = { r, g, b, a };
+    uint32_t pixel;
+    memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+- (void)testDecodesColorsAndSize {
+    NSData *data = [self dataWithString:@"\x1bP0;1q\"1;1;4;12#1;2;100;0;0#1!3~-#2;2;0;0;100#2N\x1b\\"];
+    iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, data.bytes, data.length));
+    XCTAssertEqual(iTermSixelDecoderGetWidth(decoder), 4);
+    XCTAssertEqual(iTermSixelDecoderGetHeight(decoder), 12);
+    XCTAssertTrue(iTermSixelDecoderHasDeclaredSize(decoder));
+
+    NSData *rgba = [self rgbaForDecoder:decoder];
+    const uint32_t red = [self red:255 green:0 blue:0 alpha:255];
+    const uint32_t blue = [self red:0 green:0 blue:255 alpha:255];
+    const uint32_t clear = 0;
+    XCTAssertEqual([self pixelAtX:0 y:0 inData:rgba width:4], red);
+    XCTAssertEqual([self pixelAtX:2 y:5 inData:rgba width:4], red);
+    XCTAssertEqual([self pixelAtX:3 y:0 inData:rgba width:4], clear);
+    // N is 0b001111: the top four rows of the second band.
+    XCTAssertEqual([self pixelAtX:0 y:9 inData:rgba width:4], blue);
+    XCTAssertEqual([self pixelAtX:0 y:10 inData:rgba width:4], clear);
+    XCTAssertEqual([self pixelAtX:1 y:6 inData:rgba width:4], clear);
+    iTermSixelDecoderFree(decoder);
+}
+
+- (void)testOpaqueBackgroundUnlessRequested {
+    NSData *data = [self dataWithString:@"\x1bPq#1;2;100;100;100#1@\x1b\\"];
+    iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, data.bytes, data.length));
+    XCTAssertFalse(iTermSixelDecoderHasDeclaredSize(decoder));
+    XCTAssertEqual(iTermSixelDecoderGetWidth(decoder), 1);
+    XCTAssertEqual(iTermSixelDecoderGetHeight(decoder), 1);
+    NSData *rgba = [self rgbaForDecoder:decoder];
+    XCTAssertEqual([self pixelAtX:0 y:0 inData:rgba width:1], [self red:255 green:255 blue:255 alpha:255]);
+    iTermSixelDecoderFree(decoder);
+}
+
+- (void)testBandsCompleteAsDataArrives {
+    iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+    NSData *first = [self dataWithString:@"\x1bP0;1q\"1;1;2;18#1~~-~"];
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, first.bytes, first.length));
+    XCTAssertEqual(iTermSixelDecoderGetNumberOfCompleteRows(decoder), 6);
+
+    NSData *second = [self dataWithString:@"~-~~"];
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, second.bytes, second.length));
+    XCTAssertEqual(iTermSixelDecoderGetNumberOfCompleteRows(decoder), 12);
+
+    NSData *end = [self dataWithString:@"\x1b\\"];
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, end.bytes, end.length));
+    XCTAssertEqual(iTermSixelDecoderGetNumberOfCompleteRows(decoder), 18);
+    iTermSixelDecoderFree(decoder);
+}
+
+// Splitting the input anywhere, even within a parameter, must not change the result.
+- (void)testSplitInputDecodesIdentically {
+    NSData *data = [self dataWithString:@"\x1bP0;1q\"1;1;30;24#1;1;120;50;100#2;2;10;20;30#1!12~$#2!7@-#1!25N-!3~\x1b\\"];
+    iTermSixelDecoder *whole = iTermSixelDecoderCreate();
+    XCTAssertTrue(iTermSixelDecoderAppend(whole, data.bytes, data.length));
+    NSData *expected = [self rgbaForDecoder:whole];
+    iTermSixelDecoderFree(whole);
+
+    for (NSUInteger split = 1; split < data.length; split++) {
+        iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+        XCTAssertTrue(iTermSixelDecoderAppend(decoder, data.bytes, split));
+        XCTAssertTrue(iTermSixelDecoderAppend(decoder, data.bytes + split, data.length - split));
+        XCTAssertEqualObjects([self rgbaForDecoder:decoder], expected);
+        iTermSixelDecoderFree(decoder);
+    }
+}
+
+- (void)testHugeDimensionsAreClipped {
+    NSData *data = [self dataWithString:@"\x1bPq\"1;1;99999;99999!99999~\x1b\\"];
+    iTermSixelDecoder *decoder = iTermSixelDecoderCreate();
+    XCTAssertTrue(iTermSixelDecoderAppend(decoder, data.bytes, data.length));
+    XCTAssertEqual(iTermSixelDecoderGetWidth(decoder), iTermSixelDecoderMaximumDimension);
+    XCTAssertEqual(iTermSixelDecoderGetHeight(decoder), iTermSixelDecoderMaximumDimension);
+    iTermSixelDecoderFree(decoder);
+}
+
+// The vectorized expansion must agree with a plain table lookup for every index and for lengths
+// that aren't a multiple of the vector width.
+- (void)testExpandPixels {
+    uint32_t palette[256];
+    for (int i = 0; i < 256; i++) {
+        palette[i] = (uint32_t)i * 2654435761u;
+    }
+    const size_t count = 1031;
+    unsigned char indices[count];
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = (unsigned char)(i * 7 + i / 256);
+    }
+    uint32_t rgba[count];
+    for (size_t length = 0; length <= count; length += (length < 40 ? 1 : 97)) {
+        memset(rgba, 0, sizeof(rgba));
+        iTermSixelExpandPixels(indices, length, palette, rgba);
+        for (size_t i = 0; i < count; i++) {
+            XCTAssertEqual(rgba[i], i < length ? palette[indices[i]] : 0);
+        }
+    }
+}
+
+@end
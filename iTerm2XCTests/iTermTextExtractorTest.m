@@ -12,6 +12,7 @@
 #import "iTermMalloc.h"
 #import "iTermPreferences.h"
 #import "iTermSelectorSwizzler.h"
+#import "iTermTextExtractionBuffer.h"
 #import "iTermTextExtractor.h"
 #import "NSStringITerm.h"
 #import "ScreenChar.h"
@@ -164,6 +165,62 @@ static const NSInteger kUnicodeVersion = 9;
     XCTAssertEqual(match.absEndY, 0);
 }
 
+// Capture groups come from the match that contains the click, including groups that didn't
+// participate, and rules without actions are skipped when an action is required.
+- (void)testSmartSelectionRuleSemantics {
+    _lines = @[ @"see foo:12 and bar:34 here" ];
+    iTermTextExtractor *extractor = [iTermTextExtractor textExtractorWithDataSource:self];
+    VT100GridWindowedRange range;
+    NSDictionary *withActions = @{ kRegexKey: @"([a-z]+):([0-9]+)(x)?",
+                                   kPrecisionKey: kHighPrecision,
+                                   kActionsKey: @[ @{} ] };
+    NSDictionary *noActions = @{ kRegexKey: @"\\S+ and \\S+",
+                                 kPrecisionKey: kVeryHighPrecision };
+
+    SmartMatch *match = [extractor smartSelectionAt:VT100GridCoordMake(16, 0)
+                                          withRules:@[ withActions, noActions ]
+                                     actionRequired:YES
+                                              range:&range
+                                   ignoringNewlines:NO];
+    XCTAssertNotNil(match);
+    XCTAssertEqual(match.startX, 15);
+    XCTAssertEqual(match.endX, 21);
+    XCTAssertEqualObjects(match.components, (@[ @"bar:34", @"bar", @"34", @"" ]));
+
+    match = [extractor smartSelectionAt:VT100GridCoordMake(16, 0)
+                              withRules:@[ withActions, noActions ]
+                         actionRequired:NO
+                                  range:&range
+                       ignoringNewlines:NO];
+    XCTAssertEqualObjects(match.components, (@[ @"foo:12 and bar:34" ]));
+}
+
+- (void)testExtractionBufferGrowsAtBothEnds {
+    iTermTextExtractionBuffer *buffer = [iTermTextExtractionBuffer checkOut];
+    // Enough to force several reallocations in each direction.
+    for (int i = 0; i < 500; i++) {
+        const unichar before = 'a' + i % 26;
+        const unichar after = 'A' + i % 26;
+        [buffer prependCharacters:&before length:1 coord:VT100GridCoordMake(-i - 1, 0)];
+        [buffer appendCharacters:&after length:1 coord:VT100GridCoordMake(i, 0)];
+    }
+    XCTAssertEqual(buffer.length, 1000);
+    NSString *string = buffer.string;
+    for (int i = 0; i < 1000; i++) {
+        const int x = i - 500;
+        const unichar expected = x < 0 ? 'a' + (-x - 1) % 26 : 'A' + x % 26;
+        XCTAssertEqual([string characterAtIndex:i], expected);
+        XCTAssertEqual([buffer coordAtIndex:i].x, x);
+    }
+    [buffer checkIn];
+
+    // The same storage is handed back out, empty.
+    iTermTextExtractionBuffer *reused = [iTermTextExtractionBuffer checkOut];
+    XCTAssertEqual(reused, buffer);
+    XCTAssertEqual(reused.length, 0);
+    [reused checkIn];
+}
+
 // TODO(georgen): Support windowed ranges.
 - (NSString *)stringForRange:(VT100GridWindowedRange)range {
     NSMutableString *string = [NSMutableString string];
@@ -450,11 +507,10 @@ static const NSInteger kUnicodeVersion = 9;
                                 continuationChars:[NSMutableIndexSet indexSet]
                               convertNullsToSpace:NO];
     XCTAssertEqualObjects(prefix.string, @"\u2716\ufe0e htt");
-    XCTAssertEqual(prefix.coords.count, prefix.string.length);
+    XCTAssertEqual(prefix.gridCoords.count, prefix.string.length);
     int expected[] = { 0, 0, 1, 2, 3, 4 };
     for (int i = 0; i < sizeof(expected) / sizeof(*expected); i++) {
-        NSValue *value = prefix.coords[i];
-        VT100GridCoord coord = [value gridCoordValue];
+        VT100GridCoord coord = [prefix.gridCoords coordAtIndex:i];
         XCTAssertEqual(expected[i], coord.x);
         XCTAssertEqual(0, coord.y);
     }
@@ -0,0 +1,40 @@
+//
+//  iTermVariablePathTests.m
+//  iTerm2XCTests
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "iTermVariablePath.h"
+
+@interface iTermVariablePathTests : XCTestCase
+@end
+
+@implementation iTermVariablePathTests
+
+- (void)testEqualStringsShareAnInstance {
+    iTermVariablePath *path = [iTermVariablePath pathWithString:@"session.name"];
+    NSString *string = [NSString stringWithFormat:@"session.%@", @"name"];
+    XCTAssertTrue([iTermVariablePath pathWithString:string] == path);
+    XCTAssertEqualObjects(path.head, @"session");
+    XCTAssertTrue(path.tail == [iTermVariablePath pathWithString:@"name"]);
+}
+
+// User variables are named by programs running in the terminal, so interning must not keep every
+// path ever seen alive.
+- (void)testUnreferencedPathsAreFreed {
+    NSPointerArray *weakPaths = [NSPointerArray weakObjectsPointerArray];
+    @autoreleasepool {
+        for (int i = 0; i < 100; i++) {
+            NSString *string = [NSString stringWithFormat:@"user.iTermVariablePathTests%d", i];
+            [weakPaths addPointer:[iTermVariablePath pathWithString:string]];
+        }
+    }
+    for (NSUInteger i = 0; i < weakPaths.count; i++) {
+        XCTAssertTrue([weakPaths pointerAtIndex:i] == NULL);
+    }
+}
+
+@end
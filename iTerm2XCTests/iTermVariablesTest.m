@@ -140,6 +140,60 @@
     XCTAssertEqualObjects(@234, [vars2 discouragedValueForVariableName:@"v"]);
 }
 
+- (void)testVersionChangesWhenValueChanges {
+    iTermVariables *vars = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextSession owner:self] autorelease];
+    iTermVariables *child = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextNone owner:self] autorelease];
+    iTermVariableScope *scope = [[[iTermVariableScope alloc] init] autorelease];
+    [scope addVariables:vars toScopeNamed:nil];
+    [scope setValue:child forVariableNamed:@"child"];
+    [scope setValue:@1 forVariableNamed:@"child.v"];
+    [scope setValue:@1 forVariableNamed:@"w"];
+
+    const NSUInteger version = [scope versionForVariableName:@"child.v"];
+    XCTAssertEqualObjects(@1, [scope valueForVariableName:@"child.v"]);
+
+    // Setting the same value or a different variable leaves the version alone.
+    [scope setValue:@1 forVariableNamed:@"child.v"];
+    [scope setValue:@2 forVariableNamed:@"w"];
+    XCTAssertEqual(version, [scope versionForVariableName:@"child.v"]);
+
+    [scope setValue:@2 forVariableNamed:@"child.v"];
+    const NSUInteger secondVersion = [scope versionForVariableName:@"child.v"];
+    XCTAssertGreaterThan(secondVersion, version);
+    XCTAssertEqualObjects(@2, [scope valueForVariableName:@"child.v"]);
+
+    // Replacing an intermediate changes the version and what the path resolves to.
+    iTermVariables *otherChild = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextNone owner:self] autorelease];
+    [otherChild setValue:@3 forVariableNamed:@"v"];
+    [scope setValue:otherChild forVariableNamed:@"child"];
+    XCTAssertGreaterThan([scope versionForVariableName:@"child.v"], secondVersion);
+    XCTAssertEqualObjects(@3, [scope valueForVariableName:@"child.v"]);
+}
+
+// Defining variables elsewhere, as other sessions do all the time, must not disturb a path.
+- (void)testVersionIgnoresUnrelatedVariables {
+    iTermVariables *vars = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextSession owner:self] autorelease];
+    iTermVariables *child = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextNone owner:self] autorelease];
+    iTermVariableScope *scope = [[[iTermVariableScope alloc] init] autorelease];
+    [scope addVariables:vars toScopeNamed:nil];
+    [scope setValue:child forVariableNamed:@"child"];
+    [scope setValue:@1 forVariableNamed:@"child.v"];
+    const NSUInteger version = [scope versionForVariableName:@"child.v"];
+
+    iTermVariables *unrelated = [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextSession owner:self] autorelease];
+    [unrelated setValue:@1 forVariableNamed:@"x"];
+    [unrelated setValue:nil forVariableNamed:@"x"];
+    @autoreleasepool {
+        [[[iTermVariables alloc] initWithContext:iTermVariablesSuggestionContextNone owner:self] release];
+    }
+    XCTAssertEqual(version, [scope versionForVariableName:@"child.v"]);
+
+    // Defining a variable in a frame the path starts from does change it.
+    [scope setValue:@2 forVariableNamed:@"w"];
+    XCTAssertGreaterThan([scope versionForVariableName:@"child.v"], version);
+    XCTAssertEqualObjects(@1, [scope valueForVariableName:@"child.v"]);
+}
+
 #pragma mark - iTermObject
 
 - (iTermBuiltInFunctions *)objectMethodRegistry {
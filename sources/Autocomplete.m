@@ -2,6 +2,7 @@
 #import "Autocomplete.h"
 #import "iTermAdvancedSettingsModel.h"
 #import "iTermApplicationDelegate.h"
+#import "iTermAutocompleteIndex.h"
 #import "iTermCommandHistoryEntryMO+Additions.h"
 #import "iTermController.h"
 #import "iTermShellHistoryController.h"
@@ -11,7 +12,6 @@
 #import "PasteboardHistory.h"
 #import "PopupModel.h"
 #import "PTYTextView.h"
-#import "SearchResult.h"
 #import "VT100Screen.h"
 
 #define AcLog DLog
@@ -37,31 +37,12 @@ const int kMaxResultContextWords = 4;
     int startX_;
     long long startY_;  // absolute coord
 
-    // Context for searches while populating unfilteredModel.
-    FindContext *findContext_;
-
-    // Timer for doing async searches for prefix.
-    NSTimer* populateTimer_;
-
-    // Cursor location to begin next search.
-    int x_;
-    long long y_;  // absolute coord
-
-    // Number of matches found so far
-    int matchCount_;
-
     // Text from previous autocompletes that were followed by -[more];
     NSMutableString* moreText_;
 
     // Previous state from calls to -[more] so that -[less] can go back in time.
     NSMutableArray* stack_;
 
-    // SearchResults from doing a find operation
-    NSMutableArray* findResults_;
-
-    // Result of previous search
-    BOOL more_;
-
     // Character set for word separators
     NSCharacterSet *wordSeparatorCharacterSet_;
 }
@@ -84,21 +65,20 @@ const int kMaxResultContextWords = 4;
     prefix_ = [[NSMutableString alloc] init];
     context_ = [[NSMutableArray alloc] init];
     stack_ = [[NSMutableArray alloc] init];
-    findResults_ = [[NSMutableArray alloc] init];
-    findContext_ = [[FindContext alloc] init];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(autocompleteIndexDidCatchUp:)
+                                                 name:VT100ScreenAutocompleteIndexDidCatchUpNotification
+                                               object:nil];
     return self;
 }
 
 - (void)dealloc
 {
-    [findResults_ release];
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
     [stack_ release];
     [moreText_ release];
     [context_ release];
     [prefix_ release];
-    [populateTimer_ invalidate];
-    [populateTimer_ release];
-    [findContext_ release];
     [wordSeparatorCharacterSet_ release];
     [super dealloc];
 }
@@ -327,31 +307,116 @@ const int kMaxResultContextWords = 4;
     }
 }
 
+// Returns the word at the end of |string| as iTermAutocompleteIndex divides words, or an empty
+// string if it ends in whitespace.
+- (NSString *)_lastWordOfString:(NSString *)string
+{
+    NSInteger i = [string length];
+    if (i == 0 ||
+        [[NSCharacterSet whitespaceCharacterSet] characterIsMember:[string characterAtIndex:i - 1]]) {
+        return @"";
+    }
+    if ([wordSeparatorCharacterSet_ characterIsMember:[string characterAtIndex:i - 1]]) {
+        return [string substringFromIndex:i - 1];
+    }
+    while (i > 0 && ![wordSeparatorCharacterSet_ characterIsMember:[string characterAtIndex:i - 1]]) {
+        --i;
+    }
+    return [string substringFromIndex:i];
+}
+
+- (void)_processIndexMatches
+{
+    VT100Screen* screen = [[self delegate] popupVT100Screen];
+
+    // Only the last word of a multi-word prefix (as after -more) is looked up.
+    NSString *lastWord = [self _lastWordOfString:prefix_];
+    VT100GridCoord coord = VT100GridCoordMake(startX_, (int)(startY_ - [screen scrollbackOverflow]));
+    NSArray<iTermAutocompleteIndexMatch *> *matches =
+        [screen autocompleteMatchesWithPrefix:lastWord
+                                       before:coord
+                                 maximumCount:[AutocompleteView maxOptions] * 2];
+    AcLog(@"Index has %d matches for '%@'", (int)[matches count], lastWord);
+
+    NSCharacterSet* nonWhitespace = [[NSCharacterSet whitespaceCharacterSet] invertedSet];
+    int resultNumber = 0;
+    for (iTermAutocompleteIndexMatch *match in matches) {
+        NSString *word = [match word];
+        if ([word length] < [lastWord length]) {
+            continue;
+        }
+        BOOL fullMatch = ([word length] == [lastWord length]);
+        NSMutableArray<NSString *> *candidates = [NSMutableArray array];
+        if (fullMatch) {
+            // Offer the words that followed it.
+            for (NSString *follower in [match followers]) {
+                if (whitespaceBeforeCursor_ && [follower hasPrefix:@" "]) {
+                    [candidates addObject:[follower substringFromIndex:1]];
+                } else {
+                    [candidates addObject:follower];
+                }
+            }
+        } else if (!whitespaceBeforeCursor_) {
+            // Offer the rest of the word. If there's whitespace before the cursor then only full
+            // matches are interesting.
+            [candidates addObject:[word substringFromIndex:[lastWord length]]];
+        }
+
+        // Repeated hits raise the score of words that occur often, like separate search results did.
+        int hits = MAX(1, MIN(3, (int)round([match weight])));
+        int joiningPrefixLength = fullMatch ? 0 : (int)[prefix_ length];
+        for (int i = 0; i < [candidates count]; i++) {
+            NSString *candidate = candidates[i];
+            if ([candidate rangeOfCharacterFromSet:nonWhitespace].location == NSNotFound) {
+                continue;
+            }
+            AcLog(@"Candidate suffix is '%@'", candidate);
+            for (int j = 0; j < (i == 0 ? hits : 1); j++) {
+                PopupEntry* e = [PopupEntry entryWithString:candidate
+                                                      score:[self scoreResultNumber:resultNumber + i
+                                                                       queryContext:context_
+                                                                      resultContext:[match context]
+                                                                joiningPrefixLength:joiningPrefixLength
+                                                                               word:candidate]];
+                if (whitespaceBeforeCursor_) {
+                    [e setPrefix:[NSString stringWithFormat:@"%@ ", prefix_]];
+                } else {
+                    [e setPrefix:prefix_];
+                }
+                [[self unfilteredModel] addHit:e];
+            }
+        }
+        ++resultNumber;
+    }
+}
+
 - (void)refresh {
     [self.delegate popupIsSearching:YES];
     [[self unfilteredModel] removeAllObjects];
-    findContext_.substring = nil;
-    VT100Screen* screen = [[self delegate] popupVT100Screen];
-
-    x_ = startX_;
-    y_ = startY_ - [screen scrollbackOverflow];
 
     [self _processPasteboardHistory];
 
     AcLog(@"Searching for '%@'", prefix_);
-    matchCount_ = 0;
-    [findResults_ removeAllObjects];
-    more_ = YES;
-    [screen setFindString:prefix_
-         forwardDirection:NO
-                     mode:iTermFindModeCaseInsensitiveSubstring
-              startingAtX:x_
-              startingAtY:y_
-               withOffset:1
-                inContext:findContext_
-          multipleResults:YES];
-
-    [self _doPopulateMore];
+    [self _processIndexMatches];
+
+    [self reloadData:YES];
+    // Older history may not be indexed yet. In that case keep searching, and look again when it is.
+    const BOOL searching = ![[[self delegate] popupVT100Screen] autocompleteIndexIsCaughtUp];
+    if (self.unfilteredModel.count == 0 && !searching) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self closePopupWindow];
+        });
+    } else {
+        [self.delegate popupIsSearching:searching];
+    }
+}
+
+- (void)autocompleteIndexDidCatchUp:(NSNotification *)notification {
+    if (notification.object != [[self delegate] popupVT100Screen] || ![[self window] isVisible]) {
+        return;
+    }
+    AcLog(@"Index caught up. Search again for '%@'", prefix_);
+    [self refresh];
 }
 
 - (void)onClose {
@@ -359,11 +424,6 @@ const int kMaxResultContextWords = 4;
     [stack_ removeAllObjects];
     [moreText_ release];
     moreText_ = nil;
-
-    if (populateTimer_) {
-        [populateTimer_ invalidate];
-        populateTimer_ = nil;
-    }
     [super onClose];
 }
 
@@ -456,234 +516,6 @@ const int kMaxResultContextWords = 4;
     }
 }
 
-- (void)_populateMore:(id)sender
-{
-    if (populateTimer_ == nil) {
-        return;
-    }
-    populateTimer_ = nil;
-    [self _doPopulateMore];
-}
-
-- (void)_doPopulateMore
-{
-    VT100Screen* screen = [[self delegate] popupVT100Screen];
-
-    struct timeval begintime;
-    gettimeofday(&begintime, NULL);
-    NSCharacterSet* nonWhitespace = [[NSCharacterSet whitespaceCharacterSet] invertedSet];
-
-    iTermTextExtractor *extractor = [self textExtractor];
-    do {
-        int startX;
-        int startY;
-        int endX;
-        int endY;
-
-        findContext_.hasWrapped = YES;
-        AcLog(@"Continue search...");
-
-        NSDate* cs = [NSDate date];
-        if ([findResults_ count] == 0) {
-            assert(more_);
-            AcLog(@"Do another search");
-            more_ = [screen continueFindAllResults:findResults_
-                                            inContext:findContext_];
-        }
-        AcLog(@"This iteration found %d results in %lf sec", (int) [findResults_ count], [[NSDate date] timeIntervalSinceDate:cs]);
-        NSDate* ps = [NSDate date];
-        int n = 0;
-        while ([findResults_ count] > 0 && [[NSDate date] timeIntervalSinceDate:cs] < 0.15) {
-            ++n;
-            SearchResult* result = [findResults_ objectAtIndex:0];
-
-            startX = result.startX;
-            startY = result.absStartY - [screen totalScrollbackOverflow];
-            endX = result.endX;
-            endY = result.absEndY - [screen totalScrollbackOverflow];
-
-            [findResults_ removeObjectAtIndex:0];
-
-            AcLog(@"Found match at %d-%d, line %d", startX, endX, startY);
-            VT100GridWindowedRange range;
-            // Get the word that includes the match.
-            range = [extractor rangeForWordAt:VT100GridCoordMake(startX, startY)
-                                maximumLength:kReasonableMaximumWordLength];
-            NSString *immutableWord = [extractor contentInRange:range
-                                              attributeProvider:nil
-                                                     nullPolicy:kiTermTextExtractorNullPolicyFromStartToFirst
-                                                            pad:NO
-                                             includeLastNewline:NO
-                                         trimTrailingWhitespace:NO
-                                                   cappedAtSize:-1
-                                                   truncateTail:YES
-                                              continuationChars:nil
-                                                         coords:nil];
-            NSMutableString* firstWord = [NSMutableString stringWithString:immutableWord];
-            while ([firstWord length] < [prefix_ length]) {
-                range = [extractor rangeForWordAt:range.coordRange.end
-                                    maximumLength:kReasonableMaximumWordLength];
-                NSString* part = [extractor contentInRange:range
-                                         attributeProvider:nil
-                                                nullPolicy:kiTermTextExtractorNullPolicyFromStartToFirst
-                                                       pad:NO
-                                        includeLastNewline:NO
-                                    trimTrailingWhitespace:NO
-                                              cappedAtSize:-1
-                                              truncateTail:YES
-                                         continuationChars:nil
-                                                    coords:nil];
-                if ([part length] == 0) {
-                    break;
-                }
-                [firstWord appendString:part];
-            }
-            NSString* word = firstWord;
-            AcLog(@"Matching word is %@", word);
-            NSRange wordRange = [word rangeOfString:prefix_ options:(NSCaseInsensitiveSearch|NSAnchoredSearch)];
-            if (wordRange.location == 0) {
-                // Result has prefix_ as prefix.
-                // Set fullMatch to true if the word we found is equal to prefix, or false if word just has prefix as its prefix.
-                BOOL fullMatch = (wordRange.length == [word length]);
-
-                // Grab the context before the match.
-                NSMutableArray* resultContext = [NSMutableArray arrayWithCapacity:kMaxResultContextWords];
-                AcLog(@"Word before what we want is in x=[%d to %d]", startX, endX);
-                [self appendContextAtX:startX y:(int)startY into:resultContext maxWords:kMaxResultContextWords];
-
-                if (fullMatch) {
-                    // Grab the word after the match (presumably containing non-word characters)
-                    ++endX;
-                    if (endX >= [screen width]) {
-                        endX -= [screen width];
-                        ++endY;
-                    }
-
-                    range = [extractor rangeForWordAt:VT100GridCoordMake(endX, endY)
-                                        maximumLength:kReasonableMaximumWordLength];
-                    word = [extractor contentInRange:range
-                                   attributeProvider:nil
-                                          nullPolicy:kiTermTextExtractorNullPolicyFromStartToFirst
-                                                 pad:NO
-                                  includeLastNewline:NO
-                              trimTrailingWhitespace:NO
-                                        cappedAtSize:-1
-                                        truncateTail:YES
-                                   continuationChars:nil
-                                              coords:nil];
-                    AcLog(@"First candidate is at %@", VT100GridWindowedRangeDescription(range));
-                    if ([word rangeOfCharacterFromSet:nonWhitespace].location == NSNotFound) {
-                        // word after match is all whitespace. Grab the next word.
-                        if (range.coordRange.end.x == [screen width]) {
-                            range.coordRange.end.x = 0;
-                            ++range.coordRange.end.y;
-                        }
-                        if (range.coordRange.end.y < [screen numberOfLines]) {
-                            range = [extractor rangeForWordAt:range.coordRange.end
-                                                maximumLength:kReasonableMaximumWordLength];
-                            word = [extractor contentInRange:range
-                                           attributeProvider:nil
-                                                  nullPolicy:kiTermTextExtractorNullPolicyFromStartToFirst
-                                                         pad:NO
-                                          includeLastNewline:NO
-                                      trimTrailingWhitespace:NO
-                                                cappedAtSize:-1
-                                                truncateTail:YES
-                                           continuationChars:nil
-                                                      coords:nil];
-                            if (!whitespaceBeforeCursor_) {
-                                // Prepend a space if one is needed
-                                word = [NSString stringWithFormat:@" %@", word];
-                            }
-                            AcLog(@"Replacement candidate is at %@: '%@'",
-                                  VT100GridWindowedRangeDescription(range), word);
-                        } else {
-                            AcLog(@"Hit end of screen.");
-                        }
-                    }
-                } else if (!whitespaceBeforeCursor_) {
-                    // Get suffix of word after match. If there's whitespace before the cursor then only
-                    // full matches are interesting.
-                    word = [word substringWithRange:NSMakeRange(wordRange.length, [word length] - wordRange.length)];
-                } else {
-                    // Not a full match and there is whitespace before the cursor.
-                    word = @"";
-                }
-
-                if ([word rangeOfCharacterFromSet:nonWhitespace].location != NSNotFound) {
-                    // Found a non-whitespace word after the match.
-                    AcLog(@"Candidate suffix is '%@'", word);
-                    int joiningPrefixLength;
-                    if (fullMatch) {
-                        joiningPrefixLength = 0;
-                    } else {
-                        joiningPrefixLength = [prefix_ length];
-                    }
-                    PopupEntry* e = [PopupEntry entryWithString:word score:[self scoreResultNumber:matchCount_++
-                                                                                      queryContext:context_
-                                                                                     resultContext:resultContext
-                                                                               joiningPrefixLength:joiningPrefixLength
-                                                                                              word:word]];
-                    if (whitespaceBeforeCursor_) {
-                        [e setPrefix:[NSString stringWithFormat:@"%@ ", prefix_]];
-                    } else {
-                        [e setPrefix:prefix_];
-                    }
-                    [[self unfilteredModel] addHit:e];
-                } else {
-                    AcLog(@"No candidate here.");
-                }
-                x_ = startX;
-                y_ = startY + [screen scrollbackOverflow];
-                AcLog(@"Update x,y to %d,%d", (int) x_, (int) y_);
-            } else {
-                // Match started in the middle of a word.
-                AcLog(@"Search found %@ which doesn't start the same as our search term %@", word, prefix_);
-                x_ = startX;
-                y_ = startY + [screen scrollbackOverflow];
-            }
-        }
-        AcLog(@"This iteration processed %d results in %lf sec", n, [[NSDate date] timeIntervalSinceDate:ps]);
-
-        if (!more_ && [findResults_ count] == 0) {
-            AcLog(@"no more and no unprocessed results");
-            if (populateTimer_) {
-               [populateTimer_ invalidate];
-               populateTimer_ = nil;
-            }
-            break;
-        }
-
-        // Don't spend more than 150ms outside of event loop.
-        struct timeval endtime;
-        gettimeofday(&endtime, NULL);
-        int ms_diff = (endtime.tv_sec - begintime.tv_sec) * 1000 +
-            (endtime.tv_usec - begintime.tv_usec) / 1000;
-        AcLog(@"ms_diff=%d", ms_diff);
-        if (ms_diff > 150) {
-            // Out of time. Reschedule and try again.
-            AcLog(@"Schedule timer");
-            populateTimer_ = [NSTimer scheduledTimerWithTimeInterval:0.01
-                                                              target:self
-                                                            selector:@selector(_populateMore:)
-                                                            userInfo:nil
-                                                             repeats:NO];
-            break;
-        }
-    } while (more_ || [findResults_ count] > 0);
-    AcLog(@"While loop exited. Nothing more to do.");
-    [self reloadData:YES];
-    if (!populateTimer_) {
-        if (self.unfilteredModel.count == 0) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self closePopupWindow];
-            });
-        } else {
-            [self.delegate popupIsSearching:NO];
-        }
-    }
-}
-
 - (void)addCommandEntries:(NSArray<iTermCommandHistoryEntryMO *> *)entries
                   context:(NSString *)context {
     int i = 0;
@@ -32,6 +32,8 @@
 #import "DVRDecoder.h"
 #import "DVREncoder.h"
 
+@class DVRStreamWriter;
+
 @interface DVR : NSObject
 
 // Get timestamp of first/last frame. Times are in microseconds since 1970.
@@ -40,6 +42,12 @@
 @property(nonatomic, readonly) BOOL readOnly;
 @property(nonatomic, readonly) BOOL empty;
 @property(nonatomic, readonly) NSDictionary *dictionaryValue;
+// Bytes of frames appended divided by bytes stored.
+@property(nonatomic, readonly) double compressionRatio;
+
+// If set, every frame appended from now on is also written here. The next frame is a key frame so
+// the stream can be decoded from its start.
+@property(nonatomic, retain) DVRStreamWriter *streamWriter;
 
 // Allocates a circular buffer of the given size in bytes to store screen
 // contents. Somewhat more memory is used because there's some per-frame
@@ -47,6 +55,10 @@
 - (instancetype)initWithBufferCapacity:(int)bytes;
 - (BOOL)loadDictionary:(NSDictionary *)dict;
 
+// Replaces the contents with a recording made by DVRStreamWriter. The file is mapped rather than
+// read, so it may be larger than memory. The DVR becomes read-only.
+- (BOOL)loadStreamAtPath:(NSString *)path;
+
 // Save the screen state into the DVR.
 //   frameLines: An array of screen lines that DVREncoder understands.
 //   length: Number of bytes in buffer.
@@ -29,6 +29,7 @@
 
 #import "DVR.h"
 #import "DVRIndexEntry.h"
+#import "DVRStream.h"
 #import "NSData+iTerm.h"
 #import "ScreenChar.h"
 #include <sys/time.h>
@@ -60,6 +61,7 @@
     [decoders_ release];
     [encoder_ release];
     [buffer_ release];
+    [_streamWriter release];
     [super dealloc];
 }
 
@@ -90,6 +92,29 @@
                    length:length
                cleanLines:cleanLines
                      info:info];
+    if (_streamWriter) {
+        const long long key = [buffer_ lastKey];
+        DVRIndexEntry *entry = [buffer_ entryForKey:key];
+        [_streamWriter appendFrame:[buffer_ blockForKey:key]
+                            length:entry->frameLength
+                              info:&entry->info];
+        if (_streamWriter.needsKeyFrame) {
+            [encoder_ requestKeyFrame];
+        }
+    }
+}
+
+- (void)setStreamWriter:(DVRStreamWriter *)streamWriter {
+    if (streamWriter == _streamWriter) {
+        return;
+    }
+    [_streamWriter release];
+    _streamWriter = [streamWriter retain];
+    [encoder_ requestKeyFrame];
+}
+
+- (double)compressionRatio {
+    return encoder_.compressionRatio;
 }
 
 - (DVRDecoder*)getDecoder
@@ -137,12 +162,13 @@
 
 - (NSDictionary *)dictionaryValueFrom:(long long)from to:(long long)to {
     DVR *dvr;
-    if (from == self.firstTimeStamp && to == self.lastTimeStamp) {
+    if (from == self.firstTimeStamp && to == self.lastTimeStamp && !buffer_.isMapped) {
         dvr = self;
     } else {
         dvr = [[self copyWithFramesFrom:from to:to] autorelease];
     }
-    return @{ @"version": @1,
+    // Version 2 added copy sequences and compressed key frames.
+    return @{ @"version": @2,
               @"capacity": @(dvr->capacity_),
               @"buffer": dvr->buffer_.dictionaryValue };
 }
@@ -151,7 +177,8 @@
     if (!dict) {
         return NO;
     }
-    if ([dict[@"version"] integerValue] != 1) {
+    const NSInteger version = [dict[@"version"] integerValue];
+    if (version != 1 && version != 2) {
         return NO;
     }
     int capacity = [dict[@"capacity"] intValue];
@@ -182,6 +209,29 @@
     return YES;
 }
 
+- (BOOL)loadStreamAtPath:(NSString *)path {
+    DVRStreamReader *reader = [[[DVRStreamReader alloc] initWithPath:path] autorelease];
+    if (!reader) {
+        return NO;
+    }
+
+    [buffer_ release];
+    buffer_ = [[DVRBuffer alloc] initWithMappedData:reader.data entries:reader.entries];
+    // This is the capacity used when exporting, which copies the frames into a new DVR.
+    capacity_ = (int)MIN(buffer_.capacity, INT_MAX);
+
+    [decoders_ release];
+    decoders_ = [[NSMutableArray alloc] init];
+
+    [encoder_ release];
+    encoder_ = [DVREncoder alloc];
+    [encoder_ initWithBuffer:buffer_];
+
+    _empty = buffer_.isEmpty;
+    readOnly_ = YES;
+    return YES;
+}
+
 - (instancetype)copyWithFramesFrom:(long long)from to:(long long)to {
     DVR *theCopy = [[DVR alloc] initWithBufferCapacity:capacity_];
     DVRDecoder *decoder = [self getDecoder];
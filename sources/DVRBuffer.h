@@ -33,17 +33,29 @@
 // Sequences in a diff frame begin with one byte indicating the type of content
 // that follows. The values come from this enum:
 enum {
+    // Followed by an int giving the number of bytes that are unchanged.
     kSameSequence,
-    kDiffSequence
+    // Followed by an int giving the number of bytes and then the bytes themselves.
+    kDiffSequence,
+    // Followed by an int giving the number of bytes and an int giving the offset in the previous
+    // frame to copy them from. Used for lines that moved, as when scrolling.
+    kCopySequence
 };
 
 // Types of frames that DVREncoder and DVRDecoder use.
 struct timeval;
 typedef enum {
     DVRFrameTypeKeyFrame,
-    DVRFrameTypeDiffFrame
+    DVRFrameTypeDiffFrame,
+    // An int giving the uncompressed length followed by a key frame compressed with zlib.
+    DVRFrameTypeCompressedKeyFrame
 } DVRFrameType;
 
+NS_INLINE BOOL DVRFrameTypeIsKeyFrame(int frameType) {
+    return (frameType == DVRFrameTypeKeyFrame ||
+            frameType == DVRFrameTypeCompressedKeyFrame);
+}
+
 @interface DVRBuffer : NSObject
 
 // Returns first/last used keys.
@@ -59,6 +71,13 @@ typedef enum {
 
 - (instancetype)initWithBufferCapacity:(long long)capacity;
 
+// A read-only buffer whose storage is `data`, typically a mapped file. Each entry's position is an
+// offset in `data`. Entries must be in order of timestamp and begin with a key frame.
+- (instancetype)initWithMappedData:(NSData *)data entries:(NSArray<DVRIndexEntry *> *)entries;
+
+// Was this created with -initWithMappedData:entries:?
+@property(nonatomic, readonly, getter=isMapped) BOOL mapped;
+
 // Reserve a chunk of memory. Returns true if blocks had to be freed to make room.
 // You can get a pointer to the reserved memory with -[scratch].
 - (BOOL)reserve:(long long)length;
@@ -66,9 +85,9 @@ typedef enum {
 
 - (ptrdiff_t)offsetOfPointer:(char *)pointer;
 
-// Allocate a block. Returns the assigned key. You must have called -[reserve] first.
-// length may less than reserved amount.
-- (long long)allocateBlock:(long long)length;
+// Allocate a block for a frame described by info. Returns the assigned key. You must have called
+// -[reserve] first. length may less than reserved amount.
+- (long long)allocateBlock:(long long)length info:(const DVRFrameInfo *)info;
 
 // Free the first block.
 - (void)deallocateBlock;
@@ -84,5 +103,12 @@ typedef enum {
 - (BOOL)loadFromDictionary:(NSDictionary *)dict;
 - (DVRIndexEntry *)firstEntryWithTimestampAfter:(long long)timestamp;
 
+// Returns the key of the first frame whose timestamp is at least `timestamp`, or -1 if there is
+// none. Takes O(log n) time.
+- (long long)firstKeyWithTimestampAtLeast:(long long)timestamp;
+
+// Returns the key of the nearest key frame at or before `key`, or -1 if it has been freed.
+- (long long)keyFrameKeyForKey:(long long)key;
+
 @end
 
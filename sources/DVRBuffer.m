@@ -29,9 +29,16 @@
 #import "DVRBuffer.h"
 
 #import "iTermMalloc.h"
-#import "NSArray+iTerm.h"
 #import "NSDictionary+iTerm.h"
 
+// What seeking needs to know about a frame.
+typedef struct {
+    long long timestamp;
+
+    // Key of the nearest key frame at or before this frame, or -1 if there is none.
+    long long keyFrameKey;
+} DVRSeekRecord;
+
 @implementation DVRBuffer {
     // Points to start of large circular buffer.
     char* store_;
@@ -42,8 +49,15 @@
     // Total size of storage in bytes.
     long long capacity_;
 
-    // Maps a frame key number to DVRIndexEntry*.
-    NSMutableDictionary* index_;
+    // Index entries in order of key. The entry for key k is at index k - firstKey_.
+    NSMutableArray<DVRIndexEntry *> *entries_;
+
+    // Circular buffer of seek records in order of key, parallel to entries_. The record for key k
+    // is at (seekHead_ + k - firstKey_) % seekCapacity_. They are kept unboxed so a binary search
+    // doesn't touch the entries.
+    DVRSeekRecord *seekRecords_;
+    long long seekCapacity_;
+    long long seekHead_;
 
     // First key in index.
     long long firstKey_;
@@ -62,6 +76,9 @@
 
     // Non-inclusive end of circular buffer's used regino.
     long long end_;
+
+    // Owns store_ for a mapped buffer. Nil otherwise.
+    NSData *mappedData_;
 }
 
 - (instancetype)initWithBufferCapacity:(long long)maxsize
@@ -70,7 +87,7 @@
     if (self) {
         capacity_ = maxsize;
         store_ = iTermMalloc(maxsize);
-        index_ = [[NSMutableDictionary alloc] init];
+        entries_ = [[NSMutableArray alloc] init];
         firstKey_ = 0;
         nextKey_ = 0;
         begin_ = 0;
@@ -79,19 +96,44 @@
     return self;
 }
 
+- (instancetype)initWithMappedData:(NSData *)data entries:(NSArray<DVRIndexEntry *> *)entries {
+    self = [super init];
+    if (self) {
+        mappedData_ = [data retain];
+        capacity_ = data.length;
+        store_ = (char *)data.bytes;
+        entries_ = [[NSMutableArray alloc] initWithCapacity:entries.count];
+        for (DVRIndexEntry *entry in entries) {
+            assert(entry->position >= 0 && entry->position + entry->frameLength <= capacity_);
+            [self appendEntry:entry];
+        }
+        begin_ = 0;
+        end_ = capacity_;
+    }
+    return self;
+}
+
 - (void)dealloc
 {
-    [index_ release];
-    index_ = nil;
-    free(store_);
+    [entries_ release];
+    entries_ = nil;
+    free(seekRecords_);
+    if (mappedData_) {
+        [mappedData_ release];
+    } else {
+        free(store_);
+    }
     [super dealloc];
 }
 
+- (BOOL)isMapped {
+    return mappedData_ != nil;
+}
+
 - (NSDictionary *)exportedIndex {
     NSMutableDictionary *dict = [NSMutableDictionary dictionary];
-    for (NSNumber *key in index_) {
-        DVRIndexEntry *entry = index_[key];
-        dict[key] = entry.dictionaryValue;
+    for (long long key = firstKey_; key < nextKey_; key++) {
+        dict[@(key)] = [self entryForKey:key].dictionaryValue;
     }
     return dict;
 }
@@ -117,17 +159,23 @@
     scratch_ = 0;
 
     NSDictionary *indexDict = dict[@"index"];
-    for (NSNumber *key in indexDict) {
-        NSDictionary *value = indexDict[key];
-        DVRIndexEntry *entry = [DVRIndexEntry entryFromDictionaryValue:value];
+    const long long firstKey = [dict[@"firstKey"] longLongValue];
+    const long long nextKey = [dict[@"nextKey"] longLongValue];
+    if (firstKey < 0 || nextKey < firstKey || nextKey - firstKey != indexDict.count) {
+        return NO;
+    }
+    [entries_ removeAllObjects];
+    seekHead_ = 0;
+    firstKey_ = firstKey;
+    nextKey_ = firstKey;
+    for (long long key = firstKey; key < nextKey; key++) {
+        DVRIndexEntry *entry = [DVRIndexEntry entryFromDictionaryValue:indexDict[@(key)]];
         if (!entry) {
             return NO;
         }
-        index_[key] = entry;
+        [self appendEntry:entry];
     }
 
-    firstKey_ = [dict[@"firstKey"] longLongValue];
-    nextKey_ = [dict[@"nextKey"] longLongValue];
     begin_ = [dict[@"begin"] longLongValue];
     if (begin_ >= store.length || begin_ < 0) {
         begin_ = 0;
@@ -141,6 +189,7 @@
 
 - (BOOL)reserve:(long long)length
 {
+    assert(!mappedData_);
     BOOL hadToFree = NO;
     while (![self hasSpaceAvailable:length]) {
         assert(nextKey_ > firstKey_);
@@ -159,28 +208,61 @@
     return hadToFree;
 }
 
-- (long long)allocateBlock:(long long)length
+- (long long)allocateBlock:(long long)length info:(const DVRFrameInfo *)info
 {
     assert([self hasSpaceAvailable:length]);
     DVRIndexEntry* entry = [[DVRIndexEntry alloc] init];
     entry->position = scratch_ - store_;
     end_ = entry->position + length;
     entry->frameLength = length;
+    entry->info = *info;
     scratch_ = 0;
 
-    long long key = nextKey_++;
-    [index_ setObject:entry forKey:[NSNumber numberWithLongLong:key]];
+    long long key = [self appendEntry:entry];
     [entry release];
 
     return key;
 }
 
+// Adds an entry with the next key and returns the key.
+- (long long)appendEntry:(DVRIndexEntry *)entry {
+    const long long count = nextKey_ - firstKey_;
+    if (count == seekCapacity_) {
+        const long long newCapacity = MAX(16, seekCapacity_ * 2);
+        DVRSeekRecord *newRecords = iTermMalloc(newCapacity * sizeof(DVRSeekRecord));
+        for (long long i = 0; i < count; i++) {
+            newRecords[i] = seekRecords_[(seekHead_ + i) % seekCapacity_];
+        }
+        free(seekRecords_);
+        seekRecords_ = newRecords;
+        seekCapacity_ = newCapacity;
+        seekHead_ = 0;
+    }
+    const long long key = nextKey_++;
+    DVRSeekRecord *record = [self seekRecordForKey:key];
+    record->timestamp = entry->info.timestamp;
+    if (DVRFrameTypeIsKeyFrame(entry->info.frameType)) {
+        record->keyFrameKey = key;
+    } else if (count > 0) {
+        record->keyFrameKey = [self seekRecordForKey:key - 1]->keyFrameKey;
+    } else {
+        record->keyFrameKey = -1;
+    }
+    [entries_ addObject:entry];
+    return key;
+}
+
+- (DVRSeekRecord *)seekRecordForKey:(long long)key {
+    return &seekRecords_[(seekHead_ + key - firstKey_) % seekCapacity_];
+}
+
 - (void)deallocateBlock
 {
-    long long key = firstKey_++;
-    DVRIndexEntry* entry = [self entryForKey:key];
+    DVRIndexEntry* entry = [self entryForKey:firstKey_];
     begin_ = entry->position + entry->frameLength;
-    [index_ removeObjectForKey:[NSNumber numberWithLongLong:key]];
+    [entries_ removeObjectAtIndex:0];
+    firstKey_++;
+    seekHead_ = (seekHead_ + 1) % seekCapacity_;
 }
 
 - (void*)blockForKey:(long long)key
@@ -223,27 +305,48 @@
 
 - (DVRIndexEntry*)entryForKey:(long long)key
 {
-    assert(index_);
-    return [index_ objectForKey:[NSNumber numberWithLongLong:key]];
+    assert(entries_);
+    if (key < firstKey_ || key >= nextKey_) {
+        return nil;
+    }
+    return entries_[key - firstKey_];
+}
+
+- (long long)firstKeyWithTimestampAtLeast:(long long)timestamp {
+    // Binary search for the first record with a timestamp >= the target.
+    long long lo = firstKey_;
+    long long hi = nextKey_;
+    while (lo < hi) {
+        const long long mid = lo + (hi - lo) / 2;
+        if ([self seekRecordForKey:mid]->timestamp < timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == nextKey_) {
+        return -1;
+    }
+    return lo;
+}
+
+- (long long)keyFrameKeyForKey:(long long)key {
+    if (key < firstKey_ || key >= nextKey_) {
+        return -1;
+    }
+    const long long keyFrameKey = [self seekRecordForKey:key]->keyFrameKey;
+    if (keyFrameKey < firstKey_) {
+        return -1;
+    }
+    return keyFrameKey;
 }
 
 - (DVRIndexEntry *)firstEntryWithTimestampAfter:(long long)timestamp {
-    NSArray<NSNumber *> *frameNumbers = [[index_ allKeys] sortedArrayUsingSelector:@selector(compare:)];
-    NSArray<NSNumber *> *timestamps = [frameNumbers mapWithBlock:^NSNumber *(NSNumber *frameNumber) {
-        DVRIndexEntry *entry = index_[frameNumber];
-        return @(entry->info.timestamp);
-    }];
-    NSUInteger frameNumberIndex = [timestamps indexOfObject:@(timestamp + 1)
-                                              inSortedRange:NSMakeRange(0, frameNumbers.count)
-                                                    options:NSBinarySearchingInsertionIndex
-                                            usingComparator:
-                                   ^NSComparisonResult(NSNumber * _Nonnull timestamp1, NSNumber * _Nonnull timestamp2) {
-                                       return [timestamp1 compare:timestamp2];
-                                   }];
-    if (frameNumberIndex == NSNotFound || frameNumberIndex == index_.count) {
+    const long long key = [self firstKeyWithTimestampAtLeast:timestamp + 1];
+    if (key < 0) {
         return nil;
     }
-    return index_[frameNumbers[frameNumberIndex]];
+    return [self entryForKey:key];
 }
 
 - (char*)scratch
@@ -268,7 +371,7 @@
 
 - (BOOL)isEmpty
 {
-    return [index_ count] == 0;
+    return [entries_ count] == 0;
 }
 
 
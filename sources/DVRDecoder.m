@@ -32,6 +32,7 @@
 #import "DVRIndexEntry.h"
 #import "iTermMalloc.h"
 #import "LineBuffer.h"
+#include <zlib.h>
 
 //#if DEBUG
 //#define DVRDEBUG 1
@@ -50,6 +51,9 @@
     // Length of frame.
     int length_;
 
+    // Copy of the frame before the diff being applied, for copy sequences. length_ bytes.
+    char* previousFrame_;
+
     // Most recent frame's key (not timestamp).
     long long key_;
 }
@@ -70,21 +74,18 @@
     if (frame_) {
         free(frame_);
     }
+    free(previousFrame_);
     [super dealloc];
 }
 
 - (BOOL)seek:(long long)timestamp
 {
-    // TODO(georgen): Do a binary search
-    long long lastKey = [buffer_ lastKey];
-    for (long long key = [buffer_ firstKey]; key <= lastKey; ++key) {
-        DVRIndexEntry* entry = [buffer_ entryForKey:key];
-        if (entry->info.timestamp >= timestamp) {
-            [self _seekToEntryWithKey:key];
-            return YES;
-        }
+    const long long key = [buffer_ firstKeyWithTimestampAtLeast:timestamp];
+    if (key < 0) {
+        return NO;
     }
-    return NO;
+    [self _seekToEntryWithKey:key];
+    return YES;
 }
 
 - (char*)decodedFrame
@@ -190,22 +191,34 @@
         key = [buffer_ firstKey];
     }
     // Find the key frame before 'key'.
-    long long j = key;
-    while ([buffer_ entryForKey:j]->info.frameType != DVRFrameTypeKeyFrame) {
-        assert(j != [buffer_ firstKey]);
-        --j;
+    const long long keyFrameKey = [buffer_ keyFrameKeyForKey:key];
+    if (keyFrameKey < 0) {
+        DLog(@"No key frame for %lld", key);
+        return;
     }
 
-    [self _loadKeyFrameWithKey:j];
-
+    long long j;
+    if (key_ >= keyFrameKey && key_ <= key) {
+        // The current frame is between the key frame and the target, as when playing forward or
+        // dragging the slider to the right, so only the remaining diffs need to be applied.
+        j = key_;
+    } else {
+        key_ = -1;
+        if (![self _loadKeyFrameWithKey:keyFrameKey]) {
+            return;
+        }
+        j = keyFrameKey;
 #ifdef DVRDEBUG
-    [self debug:@"Key frame:" buffer:frame_ length:length_];
+        [self debug:@"Key frame:" buffer:frame_ length:length_];
 #endif
+    }
 
     // Apply all the diff frames up to key.
     while (j != key) {
         ++j;
         if (![self _loadDiffFrameWithKey:j]) {
+            // frame_ is partially updated so it doesn't correspond to any key.
+            key_ = -1;
             return;
         }
 #ifdef DVRDEBUG
@@ -218,24 +231,54 @@
 #endif
 }
 
-- (void)_loadKeyFrameWithKey:(long long)key
+// Returns NO if the input was broken.
+- (BOOL)_loadKeyFrameWithKey:(long long)key
 {
     DVRIndexEntry* entry = [buffer_ entryForKey:key];
-    if (length_ != entry->frameLength && frame_) {
+    char* data = [buffer_ blockForKey:key];
+    const BOOL compressed = (entry->info.frameType == DVRFrameTypeCompressedKeyFrame);
+    int length = entry->frameLength;
+    if (compressed) {
+        if (entry->frameLength < (int)sizeof(length)) {
+            return NO;
+        }
+        memcpy(&length, data, sizeof(length));
+        // A mapped buffer can be smaller than a decompressed frame, so bound it by the geometry.
+        const long long maxLength = ((long long)entry->info.width + 1) * MAX(0, entry->info.height) * sizeof(screen_char_t);
+        if (length <= 0 || length > maxLength) {
+            DLog(@"Bogus uncompressed length %d", length);
+            return NO;
+        }
+    }
+    if (length_ != length && frame_) {
         free(frame_);
         frame_ = 0;
+        free(previousFrame_);
+        previousFrame_ = 0;
     }
-    length_ = entry->frameLength;
+    length_ = length;
 #ifdef DVRDEBUG
     NSLog(@"Frame length is %d", length_);
 #endif
     if (!frame_) {
         frame_ = iTermMalloc(length_);
     }
-    char* data = [buffer_ blockForKey:key];
     info_ = entry->info;
     DLog(@"Frame with key %lld has size %dx%d", key, info_.width, info_.height);
-    memcpy(frame_,  data, length_);
+    if (!compressed) {
+        memcpy(frame_,  data, length_);
+        return YES;
+    }
+    uLongf decompressedLength = length_;
+    if (uncompress((Bytef *)frame_,
+                   &decompressedLength,
+                   (const Bytef *)data + sizeof(length),
+                   entry->frameLength - sizeof(length)) != Z_OK ||
+        decompressedLength != length_) {
+        DLog(@"Failed to decompress key frame %lld", key);
+        return NO;
+    }
+    return YES;
 }
 
 // Add two positive ints. Returns NO if it can't be done. Returns YES and places the result in
@@ -257,6 +300,28 @@ static BOOL NS_WARN_UNUSED_RESULT SafeIncr(int summand, int addend, int *sum) {
     return YES;
 }
 
+static BOOL DVRDiffHasCopySequence(const char *diff, int length) {
+    int i = 0;
+    while (i < length) {
+        const char type = diff[i++];
+        if (type == kCopySequence) {
+            return YES;
+        }
+        if (i + (int)sizeof(int) > length) {
+            return NO;
+        }
+        int n;
+        memcpy(&n, diff + i, sizeof(n));
+        i += sizeof(n);
+        if (type == kDiffSequence) {
+            if (!SafeIncr(i, n, &i)) {
+                return NO;
+            }
+        }
+    }
+    return NO;
+}
+
 // Returns NO if the input was broken.
 - (BOOL)_loadDiffFrameWithKey:(long long)key
 {
@@ -267,6 +332,14 @@ static BOOL NS_WARN_UNUSED_RESULT SafeIncr(int summand, int addend, int *sum) {
     info_ = entry->info;
     char* diff = [buffer_ blockForKey:key];
     int o = 0;
+    if (DVRDiffHasCopySequence(diff, entry->frameLength)) {
+        // Copy sequences refer to the frame as it was before this diff, and other sequences may
+        // overwrite their sources before they are applied.
+        if (!previousFrame_) {
+            previousFrame_ = iTermMalloc(length_);
+        }
+        memcpy(previousFrame_, frame_, length_);
+    }
     for (int i = 0; i < entry->frameLength; ) {
 #ifdef DVRDEBUG
         NSLog(@"Checking line at offset %d, address %p. type=%d", i, diff+i, (int)diff[i]);
@@ -309,6 +382,34 @@ static BOOL NS_WARN_UNUSED_RESULT SafeIncr(int summand, int addend, int *sum) {
                 }
                 break;
 
+            case kCopySequence: {
+                memcpy(&n, diff + i, sizeof(n));
+                if (!SafeIncr(i, sizeof(n), &i)) {
+                    return NO;
+                }
+                int source;
+                memcpy(&source, diff + i, sizeof(source));
+                if (!SafeIncr(i, sizeof(source), &i)) {
+                    return NO;
+                }
+                int proposedEnd;
+                int sourceEnd;
+                if (!SafeIncr(o, n, &proposedEnd) || !SafeIncr(source, n, &sourceEnd)) {
+                    return NO;
+                }
+                if (proposedEnd > length_ || sourceEnd > length_) {
+                    return NO;
+                }
+#ifdef DVRDEBUG
+                NSLog(@"%d bytes copied from offset %d to offset %d", n, source, o);
+#endif
+                memcpy(frame_ + o, previousFrame_ + source, n);
+                if (!SafeIncr(n, o, &o)) {
+                    return NO;
+                }
+                break;
+            }
+
             default:
                 NSLog(@"Unexpected block type %d", (int)diff[i-1]);
                 assert(0);
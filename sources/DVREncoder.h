@@ -8,7 +8,9 @@
  **  Project: iTerm2
  **
  **  Description: Encodes screen images into a DVRBuffer. Implements
- **    a basic key-frame + differential encoding scheme.
+ **    a basic key-frame + differential encoding scheme. Diff frames can
+ **    copy lines from the previous frame, so scrolling is cheap, and key
+ **    frames are compressed.
  **
  **  This program is free software; you can redistribute it and/or modify
  **  it under the terms of the GNU General Public License as published by
@@ -31,13 +33,16 @@
 
 @interface DVREncoder : NSObject
 
+// Bytes of frames appended divided by bytes stored, since this encoder was created.
+@property(nonatomic, readonly) double compressionRatio;
+
 - (instancetype)initWithBuffer:(DVRBuffer*)buffer;
 
 // Encoded a frame into the DVRBuffer. Call -[reserve:] first.
 //   frameLines: An array of screen lines
 //   length: number of bytes (not elements) in buffer.
 //   cleanLines: The line numbers that are unchanged from the last frame.
-//   info: screen state.
+//   info: screen state. If its timestamp is nonzero it is used instead of the current time.
 - (void)appendFrame:(NSArray *)frameLines
              length:(int)length
          cleanLines:(NSIndexSet *)cleanLines
@@ -48,4 +53,7 @@
 // invalidate nonexistent leading frames in all decoders.
 - (BOOL)reserve:(int)length;
 
+// Makes the next frame a key frame.
+- (void)requestKeyFrame;
+
 @end
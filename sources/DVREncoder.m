@@ -30,6 +30,7 @@
 #import "DVRIndexEntry.h"
 #include "LineBuffer.h"
 #include <sys/time.h>
+#include <zlib.h>
 
 //#if DEBUG
 //#define DVRDEBUG
@@ -46,6 +47,19 @@ static long long now()
     return result;
 }
 
+// FNV-1a over 32-bit words. Lines are arrays of screen_char_t so their length is a multiple of 4.
+static unsigned long long DVRHashLine(const char *line, int length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    const int numWords = length / sizeof(uint32_t);
+    for (int i = 0; i < numWords; i++) {
+        uint32_t word;
+        memcpy(&word, line + i * sizeof(word), sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 @implementation DVREncoder {
     // Underlying buffer to write to. Not owned by us.
     DVRBuffer* buffer_;
@@ -67,6 +81,20 @@ static long long now()
 
     // Number of bytes reserved.
     int reservation_;
+
+    // Hash of each line in lastFrame_.
+    NSMutableData *lastLineHashes_;
+
+    // How far the most recently moved line moved. When scrolling, most lines move by the same
+    // amount, so this is the best place to look for the next one.
+    int lastShift_;
+
+    // Bytes passed to -appendFrame: and bytes written to the buffer.
+    long long bytesIn_;
+    long long bytesOut_;
+
+    // If set, the next frame will be a key frame.
+    BOOL forceKeyFrame_;
 }
 
 - (instancetype)initWithBuffer:(DVRBuffer *)buffer {
@@ -83,6 +111,7 @@ static long long now()
 - (void)dealloc
 {
     [lastFrame_ release];
+    [lastLineHashes_ release];
     [buffer_ release];
     [super dealloc];
 }
@@ -104,25 +133,56 @@ static long long now()
              length:(int)length
          cleanLines:(NSIndexSet *)cleanLines
                info:(DVRFrameInfo*)info {
-    BOOL eligibleForDiff;
-    if (cleanLines.count > info->height * 0.8 &&
-        lastFrame_ &&
+    const int numLines = [frameLines count];
+    const int lineLength = numLines > 0 ? [frameLines[0] length] : 0;
+    bytesIn_ += length;
+
+    // sourceLines[y] is the line of the last frame that has the same contents as line y, or -1.
+    NSMutableData *sourceLinesData = [NSMutableData dataWithLength:numLines * sizeof(int)];
+    int *sourceLines = (int *)sourceLinesData.mutableBytes;
+    NSMutableData *hashesData = [NSMutableData dataWithLength:numLines * sizeof(unsigned long long)];
+    unsigned long long *hashes = (unsigned long long *)hashesData.mutableBytes;
+
+    BOOL eligibleForDiff = NO;
+    if (lastFrame_ &&
         length == [lastFrame_ length] &&
         info->width == lastInfo_.width &&
         info->height == lastInfo_.height &&
+        numLines * sizeof(unsigned long long) == lastLineHashes_.length &&
         bytesSinceLastKeyFrame_ < [buffer_ capacity] / 2) {
-        eligibleForDiff = YES;
+        const int reusableLines = [self findSourceLines:sourceLines
+                                                 hashes:hashes
+                                          forFrameLines:frameLines
+                                             lineLength:lineLength
+                                             cleanLines:cleanLines];
+        eligibleForDiff = (reusableLines > info->height * 0.8);
     } else {
-        eligibleForDiff = NO;
+        for (int y = 0; y < numLines; y++) {
+            hashes[y] = DVRHashLine([frameLines[y] bytes], lineLength);
+        }
     }
 
     const int kKeyFrameFrequency = 100;
 
-    if (!eligibleForDiff || count_++ % kKeyFrameFrequency == 0) {
+    if (!eligibleForDiff || forceKeyFrame_ || count_++ % kKeyFrameFrequency == 0) {
+        forceKeyFrame_ = NO;
         [self _appendKeyFrame:frameLines length:length info:info];
     } else {
-        [self _appendDiffFrame:frameLines length:length cleanLines:cleanLines info:info];
+        [self _appendDiffFrame:frameLines length:length sourceLines:sourceLines info:info];
+    }
+    [lastLineHashes_ release];
+    lastLineHashes_ = [hashesData retain];
+}
+
+- (double)compressionRatio {
+    if (bytesOut_ == 0) {
+        return 1;
     }
+    return (double)bytesIn_ / (double)bytesOut_;
+}
+
+- (void)requestKeyFrame {
+    forceKeyFrame_ = YES;
 }
 
 - (BOOL)reserve:(int)length
@@ -136,7 +196,7 @@ static long long now()
     while (![buffer_ isEmpty] && hadToFree) {
         DVRIndexEntry* entry = [buffer_ entryForKey:[buffer_ firstKey]];
         assert(entry);
-        if (entry->info.frameType == DVRFrameTypeKeyFrame) {
+        if (DVRFrameTypeIsKeyFrame(entry->info.frameType)) {
             break;
         } else {
             [buffer_ deallocateBlock];
@@ -173,22 +233,95 @@ static long long now()
     return data;
 }
 
-// Save a key frame into DVRBuffer.
+// Finds a line in the last frame with the same contents as each line of the new frame. Lines are
+// compared by hash and then by contents. Fills in `hashes` for the new frame. Returns the number of
+// lines that have a match.
+- (int)findSourceLines:(int *)sourceLines
+                hashes:(unsigned long long *)hashes
+         forFrameLines:(NSArray<NSData *> *)frameLines
+            lineLength:(int)lineLength
+            cleanLines:(NSIndexSet *)cleanLines {
+    const unsigned long long *lastHashes = (const unsigned long long *)lastLineHashes_.bytes;
+    const char *lastFrame = (const char *)lastFrame_.bytes;
+    const int numLines = [frameLines count];
+    int count = 0;
+    for (int y = 0; y < numLines; y++) {
+        if ([cleanLines containsIndex:y]) {
+            sourceLines[y] = y;
+            hashes[y] = lastHashes[y];
+            count++;
+            continue;
+        }
+        const char *line = [frameLines[y] bytes];
+        const unsigned long long hash = DVRHashLine(line, lineLength);
+        hashes[y] = hash;
+        sourceLines[y] = -1;
+
+        // Try the same line, then the line that would have scrolled here, then all the others.
+        const int preferred[] = { y, y + lastShift_ };
+        for (int i = -2; i < numLines; i++) {
+            const int j = i < 0 ? preferred[i + 2] : i;
+            if (j < 0 || j >= numLines || lastHashes[j] != hash) {
+                continue;
+            }
+            if (memcmp(lastFrame + j * lineLength, line, lineLength) == 0) {
+                sourceLines[y] = j;
+                if (j != y) {
+                    lastShift_ = j - y;
+                }
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// Save a key frame into DVRBuffer. It is compressed if that saves space.
 - (void)_appendKeyFrame:(NSArray *)frameLines length:(int)length info:(DVRFrameInfo*)info
 {
     [lastFrame_ release];
     lastFrame_ = [[self combinedFrameLines:frameLines] retain];
     assert(lastFrame_.length == length);
     char* scratch = [buffer_ scratch];
-    memcpy(scratch, [lastFrame_ mutableBytes], length);
-    [self _appendFrameImpl:scratch length:length type:DVRFrameTypeKeyFrame info:info];
+    const int compressedLength = [self _compressFrame:lastFrame_ dest:scratch maxSize:reservation_];
+    if (compressedLength > 0) {
+        [self _appendFrameImpl:scratch length:compressedLength type:DVRFrameTypeCompressedKeyFrame info:info];
+    } else {
+        memcpy(scratch, [lastFrame_ mutableBytes], length);
+        [self _appendFrameImpl:scratch length:length type:DVRFrameTypeKeyFrame info:info];
+    }
     bytesSinceLastKeyFrame_ = 0;
+    DLog(@"Compression ratio is now %0.2f", self.compressionRatio);
+}
+
+// Writes the frame's length followed by the frame compressed with zlib. Returns the number of bytes
+// used or -1 if it would not fit in maxSize or would not be smaller than the frame.
+- (int)_compressFrame:(NSData *)frame dest:(char *)scratch maxSize:(int)maxBytes {
+    const int length = frame.length;
+    if (maxBytes <= (int)sizeof(length)) {
+        return -1;
+    }
+    uLongf capacity = maxBytes - sizeof(length);
+    if (compress2((Bytef *)scratch + sizeof(length),
+                  &capacity,
+                  (const Bytef *)frame.bytes,
+                  length,
+                  Z_BEST_SPEED) != Z_OK) {
+        return -1;
+    }
+    const long long compressedLength = sizeof(length) + capacity;
+    if (compressedLength >= length) {
+        return -1;
+    }
+    memcpy(scratch, &length, sizeof(length));
+    return compressedLength;
 }
 
 // Save a diff frame into DVRBuffer.
 - (void)_appendDiffFrame:(NSArray *)frameLines
                   length:(int)length
-              cleanLines:(NSIndexSet *)cleanLines
+             sourceLines:(const int *)sourceLines
                     info:(DVRFrameInfo *)info {
     char* scratch = [buffer_ scratch];
 #ifdef DVRDEBUG
@@ -196,7 +329,7 @@ static long long now()
 #endif
     int diffBytes = [self _computeDiff:frameLines
                                 length:length
-                            cleanLines:cleanLines
+                           sourceLines:sourceLines
                                   dest:scratch
                                maxSize:reservation_];
     if (diffBytes < 0) {
@@ -217,6 +350,16 @@ static long long now()
 #endif
     [self _appendFrameImpl:scratch length:diffBytes type:DVRFrameTypeDiffFrame info:info];
     bytesSinceLastKeyFrame_ += diffBytes;
+
+    // Keep lastFrame_ current so the next frame can copy lines from it.
+    char *lastFrame = [lastFrame_ mutableBytes];
+    const int numLines = [frameLines count];
+    for (int y = 0; y < numLines; y++) {
+        if (sourceLines[y] != y) {
+            NSData *line = frameLines[y];
+            memcpy(lastFrame + y * line.length, line.bytes, line.length);
+        }
+    }
 }
 
 // Save a frame into DVRBuffer.
@@ -231,24 +374,27 @@ static long long now()
 #endif
 
     lastInfo_ = *info;
+    bytesOut_ += length;
 
-    long long key = [buffer_ allocateBlock:length];
+    DVRFrameInfo frameInfo = *info;
+    if (frameInfo.timestamp == 0) {
+        frameInfo.timestamp = now();
+    }
+    frameInfo.frameType = type;
+    long long key = [buffer_ allocateBlock:length info:&frameInfo];
 #ifdef DVRDEBUG
     NSLog(@"Commit frame with key %@", @(key));
 #endif
-    DVRIndexEntry* entry = [buffer_ entryForKey:key];
-    entry->info = *info;
-    entry->info.timestamp = now();
-    entry->info.frameType = type;
     DLog(@"Append frame with key %lld, size %dx%d", key, info->width, info->height);
 }
 
 // Calculate the diff between buffer,length and the previous frame. Saves results into
 // scratch. Won't use more than maxSize bytes in scratch. Returns number of bytes used or
 // -1 if the diff was larger than maxSize.
+// Each run of unchanged lines, lines moved together, or changed lines becomes one sequence.
 - (int)_computeDiff:(NSArray<NSData *> *)frameLines
              length:(int)length
-         cleanLines:(NSIndexSet *)cleanLines
+        sourceLines:(const int *)sourceLines
                dest:(char *)scratch
             maxSize:(int)maxBytes {
     assert(length == [lastFrame_ length]);
@@ -259,10 +405,23 @@ static long long now()
     NSLog(@"Computing diff");
 #endif
     const int numLines = [frameLines count];
-    const int numChars = numLines > 0 ? frameLines[0].length : 0;
-    for (int y = 0; y < numLines; y++) {
-        if ([cleanLines containsIndex:y]) {
-            if (o + 1 + sizeof(numChars) > maxBytes) {
+    const int lineLength = numLines > 0 ? frameLines[0].length : 0;
+    int y = 0;
+    while (y < numLines) {
+        const int source = sourceLines[y];
+        int runLength = 1;
+        if (source >= 0) {
+            while (y + runLength < numLines && sourceLines[y + runLength] == source + runLength) {
+                runLength++;
+            }
+        } else {
+            while (y + runLength < numLines && sourceLines[y + runLength] < 0) {
+                runLength++;
+            }
+        }
+        const int numBytes = runLength * lineLength;
+        if (source == y) {
+            if (o + 1 + sizeof(numBytes) > maxBytes) {
                 // Diff is too big.
                 return -1;
             }
@@ -270,27 +429,43 @@ static long long now()
             NSLog(@"Append samesequence at offset %@, address %p. No data is appended for samesequence.", @(o), scratch+o);
 #endif
             scratch[o++] = kSameSequence;
-            memcpy(scratch + o, &numChars, sizeof(numChars));
-            o += sizeof(numChars);
+            memcpy(scratch + o, &numBytes, sizeof(numBytes));
+            o += sizeof(numBytes);
+        } else if (source >= 0) {
+            const int sourceOffset = source * lineLength;
+            if (o + 1 + sizeof(numBytes) + sizeof(sourceOffset) > maxBytes) {
+                // Diff is too big.
+                return -1;
+            }
+#ifdef DVRDEBUG
+            NSLog(@"Append copysequence at offset %@ of length %@ from %@", @(o), @(numBytes), @(sourceOffset));
+#endif
+            scratch[o++] = kCopySequence;
+            memcpy(scratch + o, &numBytes, sizeof(numBytes));
+            o += sizeof(numBytes);
+            memcpy(scratch + o, &sourceOffset, sizeof(sourceOffset));
+            o += sizeof(sourceOffset);
         } else {
-            if (o + 1 + sizeof(numChars) + numChars > maxBytes) {
+            if (o + 1 + sizeof(numBytes) + numBytes > maxBytes) {
                 // Diff is too big.
                 return -1;
             }
 #ifdef DVRDEBUG
-            NSLog(@"Append diffsequence at offset %@ of length %@", @(o), @(numChars));
+            NSLog(@"Append diffsequence at offset %@ of length %@", @(o), @(numBytes));
 #endif
             scratch[o++] = kDiffSequence;
-            memcpy(scratch + o, &numChars, sizeof(numChars));
-            o += sizeof(numChars);
-            NSData *lineData = frameLines[y];
-            const char *frameLine = [lineData bytes];
-            memcpy(scratch + o, frameLine, numChars);
-            o += numChars;
+            memcpy(scratch + o, &numBytes, sizeof(numBytes));
+            o += sizeof(numBytes);
+            for (int i = 0; i < runLength; i++) {
+                const char *frameLine = [frameLines[y + i] bytes];
+                memcpy(scratch + o, frameLine, lineLength);
+                o += lineLength;
 #ifdef DVRDEBUG
-            [self debug:@"Encoder: diff " buffer:frameLine length:numChars];
+                [self debug:@"Encoder: diff " buffer:frameLine length:lineLength];
 #endif
+            }
         }
+        y += runLength;
     }
 #ifdef DVRDEBUG
     NSLog(@"Done computing diff");
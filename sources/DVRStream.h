@@ -0,0 +1,63 @@
+//
+//  DVRStream.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "DVRIndexEntry.h"
+
+// An instant replay recording that is appended to as frames are recorded, so it can hold hours of
+// history without keeping it in memory. Frames are stored exactly as DVREncoder produced them.
+//
+// All integers are little-endian. The file is:
+//   Header: "iTRS", uint32 version.
+//   Frame records: uint8 kind (1), int64 timestamp, int32 width, height, cursorX, cursorY,
+//     frameType, length, then `length` bytes of frame data.
+//   Index record, written on close: uint8 kind (2), uint64 count, count uint64 offsets of frame
+//     records.
+//   Trailer: uint64 offset of the index record, "iTRI".
+// A file that was not closed cleanly has no index. It is rebuilt by scanning the frame records.
+
+// A recording must begin with a key frame. Diff frames offered before the first key frame are
+// dropped.
+@interface DVRStreamWriter : NSObject
+
+@property (nonatomic, readonly) NSString *path;
+
+// When this many bytes are waiting to be written, frames are dropped until the next key frame.
+// Defaults to 16 MB.
+@property (nonatomic) NSUInteger maximumPendingBytes;
+
+// True after frames were dropped, once the backlog has drained enough to accept a key frame. The
+// DVR asks its encoder for one so the recording resumes.
+@property (nonatomic, readonly) BOOL needsKeyFrame;
+
+// Creates or truncates the file at `path`. Returns nil if it can't be opened.
+- (instancetype)initWithPath:(NSString *)path;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Copies the frame and writes it on a background queue. Diff frames are dropped until a key frame
+// arrives, both at the start and after frames were dropped because of a backlog.
+- (void)appendFrame:(const char *)bytes length:(int)length info:(const DVRFrameInfo *)info;
+
+// Waits for pending frames, writes the index, and closes the file. Further frames are ignored.
+// Called by dealloc if needed.
+- (void)close;
+
+@end
+
+@interface DVRStreamReader : NSObject
+
+// The file's contents, mapped into memory.
+@property (nonatomic, readonly) NSData *data;
+
+// One entry per frame in order. `position` is the offset of the frame data in `data`.
+@property (nonatomic, readonly) NSArray<DVRIndexEntry *> *entries;
+
+// Returns nil if the file can't be read or isn't a recording.
+- (instancetype)initWithPath:(NSString *)path;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,364 @@
+//
+//  DVRStream.m
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "DVRStream.h"
+
+#import "DebugLogging.h"
+#import "DVRBuffer.h"
+#include <fcntl.h>
+#include <libkern/OSByteOrder.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+static const char kDVRStreamMagic[4] = { 'i', 'T', 'R', 'S' };
+static const char kDVRStreamTrailerMagic[4] = { 'i', 'T', 'R', 'I' };
+static const uint32_t kDVRStreamVersion = 1;
+static const size_t kDVRStreamHeaderLength = sizeof(kDVRStreamMagic) + sizeof(uint32_t);
+
+enum {
+    kDVRStreamFrameRecord = 1,
+    kDVRStreamIndexRecord = 2
+};
+
+// kind, timestamp, and six int32s.
+static const size_t kDVRStreamFrameHeaderLength = 1 + sizeof(int64_t) + 6 * sizeof(int32_t);
+// Index offset and magic.
+static const size_t kDVRStreamTrailerLength = sizeof(uint64_t) + sizeof(kDVRStreamTrailerMagic);
+// Frames are dropped rather than queued beyond this, so a slow disk can't use unbounded memory.
+static const NSUInteger kDVRStreamDefaultMaximumPendingBytes = 16 * 1024 * 1024;
+
+static void DVRStreamAppendUInt8(NSMutableData *data, uint8_t value) {
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void DVRStreamAppendInt32(NSMutableData *data, int32_t value) {
+    const uint32_t le = OSSwapHostToLittleInt32((uint32_t)value);
+    [data appendBytes:&le length:sizeof(le)];
+}
+
+static void DVRStreamAppendInt64(NSMutableData *data, int64_t value) {
+    const uint64_t le = OSSwapHostToLittleInt64((uint64_t)value);
+    [data appendBytes:&le length:sizeof(le)];
+}
+
+static int32_t DVRStreamReadInt32(const char *bytes) {
+    uint32_t le;
+    memcpy(&le, bytes, sizeof(le));
+    return (int32_t)OSSwapLittleToHostInt32(le);
+}
+
+static int64_t DVRStreamReadInt64(const char *bytes) {
+    uint64_t le;
+    memcpy(&le, bytes, sizeof(le));
+    return (int64_t)OSSwapLittleToHostInt64(le);
+}
+
+static BOOL DVRStreamWriteFully(int fd, const void *bytes, size_t length) {
+    const char *p = bytes;
+    while (length > 0) {
+        const ssize_t n = write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        p += n;
+        length -= n;
+    }
+    return YES;
+}
+
+@implementation DVRStreamWriter {
+    int fd_;
+    dispatch_queue_t queue_;
+
+    // Bytes of records handed to queue_ and not yet written.
+    _Atomic NSUInteger pendingBytes_;
+
+    // These are accessed only on queue_.
+    unsigned long long offset_;
+    NSMutableData *recordOffsets_;
+    BOOL failed_;
+
+    // These are accessed only by the caller.
+    BOOL haveKeyFrame_;
+    BOOL closed_;
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        // Recordings contain everything that was on screen, so only the user may read them.
+        fd_ = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            DLog(@"Failed to open %@: %s", path, strerror(errno));
+            [self release];
+            return nil;
+        }
+        _maximumPendingBytes = kDVRStreamDefaultMaximumPendingBytes;
+        queue_ = dispatch_queue_create("com.iterm2.dvr-stream", DISPATCH_QUEUE_SERIAL);
+        recordOffsets_ = [[NSMutableData alloc] init];
+
+        NSMutableData *header = [NSMutableData dataWithBytes:kDVRStreamMagic length:sizeof(kDVRStreamMagic)];
+        DVRStreamAppendInt32(header, kDVRStreamVersion);
+        [self writeRecord:header isFrame:NO];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    // Pending writes retain self, so they have all finished by now.
+    if (!closed_) {
+        [self writeIndexAndClose];
+    }
+    dispatch_release(queue_);
+    [recordOffsets_ release];
+    [_path release];
+    [super dealloc];
+}
+
+- (void)appendFrame:(const char *)bytes length:(int)length info:(const DVRFrameInfo *)info {
+    if (closed_) {
+        return;
+    }
+    if (!haveKeyFrame_) {
+        if (!DVRFrameTypeIsKeyFrame(info->frameType)) {
+            DLog(@"Drop diff frame before key frame");
+            return;
+        }
+        haveKeyFrame_ = YES;
+    }
+    const NSUInteger pending = atomic_load_explicit(&pendingBytes_, memory_order_relaxed);
+    if (pending > 0 && pending + kDVRStreamFrameHeaderLength + length > _maximumPendingBytes) {
+        // Later diff frames depend on this one, so skip ahead to the next key frame.
+        DLog(@"Drop frame because %@ bytes are waiting to be written", @(pending));
+        haveKeyFrame_ = NO;
+        return;
+    }
+    NSMutableData *record = [NSMutableData dataWithCapacity:kDVRStreamFrameHeaderLength + length];
+    DVRStreamAppendUInt8(record, kDVRStreamFrameRecord);
+    DVRStreamAppendInt64(record, info->timestamp);
+    DVRStreamAppendInt32(record, info->width);
+    DVRStreamAppendInt32(record, info->height);
+    DVRStreamAppendInt32(record, info->cursorX);
+    DVRStreamAppendInt32(record, info->cursorY);
+    DVRStreamAppendInt32(record, info->frameType);
+    DVRStreamAppendInt32(record, length);
+    [record appendBytes:bytes length:length];
+    [self writeRecord:record isFrame:YES];
+}
+
+- (BOOL)needsKeyFrame {
+    return (!closed_ &&
+            !haveKeyFrame_ &&
+            atomic_load_explicit(&pendingBytes_, memory_order_relaxed) <= _maximumPendingBytes / 2);
+}
+
+- (void)close {
+    if (closed_) {
+        return;
+    }
+    closed_ = YES;
+    // Wait so the index is written even if the app is about to quit.
+    dispatch_sync(queue_, ^{
+        [self writeIndexAndClose];
+    });
+}
+
+#pragma mark - Private
+
+- (void)writeRecord:(NSData *)record isFrame:(BOOL)isFrame {
+    atomic_fetch_add_explicit(&pendingBytes_, record.length, memory_order_relaxed);
+    dispatch_async(queue_, ^{
+        atomic_fetch_sub_explicit(&pendingBytes_, record.length, memory_order_relaxed);
+        if (failed_) {
+            return;
+        }
+        if (!DVRStreamWriteFully(fd_, record.bytes, record.length)) {
+            DLog(@"Write to %@ failed: %s", _path, strerror(errno));
+            // The reader will recover the frames before the partial record.
+            failed_ = YES;
+            return;
+        }
+        if (isFrame) {
+            const uint64_t le = OSSwapHostToLittleInt64(offset_);
+            [recordOffsets_ appendBytes:&le length:sizeof(le)];
+        }
+        offset_ += record.length;
+    });
+}
+
+// Runs on queue_, or in dealloc when nothing else can be running.
+- (void)writeIndexAndClose {
+    if (fd_ < 0) {
+        return;
+    }
+    if (!failed_) {
+        NSMutableData *index = [NSMutableData data];
+        DVRStreamAppendUInt8(index, kDVRStreamIndexRecord);
+        DVRStreamAppendInt64(index, recordOffsets_.length / sizeof(uint64_t));
+        [index appendData:recordOffsets_];
+        DVRStreamAppendInt64(index, offset_);
+        [index appendBytes:kDVRStreamTrailerMagic length:sizeof(kDVRStreamTrailerMagic)];
+        if (!DVRStreamWriteFully(fd_, index.bytes, index.length)) {
+            DLog(@"Failed to write index to %@: %s", _path, strerror(errno));
+        }
+    }
+    close(fd_);
+    fd_ = -1;
+}
+
+@end
+
+@implementation DVRStreamReader
+
+- (instancetype)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        NSError *error = nil;
+        _data = [[NSData alloc] initWithContentsOfFile:path
+                                               options:NSDataReadingMappedAlways
+                                                 error:&error];
+        if (!_data) {
+            DLog(@"Failed to map %@: %@", path, error);
+            [self release];
+            return nil;
+        }
+        if (_data.length < kDVRStreamHeaderLength ||
+            memcmp(_data.bytes, kDVRStreamMagic, sizeof(kDVRStreamMagic)) ||
+            DVRStreamReadInt32((const char *)_data.bytes + sizeof(kDVRStreamMagic)) != kDVRStreamVersion) {
+            DLog(@"%@ is not a recording this version can read", path);
+            [self release];
+            return nil;
+        }
+        NSMutableArray<DVRIndexEntry *> *entries = [self entriesFromIndex];
+        if (!entries) {
+            DLog(@"%@ has no usable index. Scan its frames instead.", path);
+            entries = [self entriesFromScan];
+        }
+        _entries = [entries retain];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_data release];
+    [_entries release];
+    [super dealloc];
+}
+
+#pragma mark - Private
+
+// Returns nil if the trailer or index is missing or malformed.
+- (NSMutableArray<DVRIndexEntry *> *)entriesFromIndex {
+    const char *bytes = _data.bytes;
+    const unsigned long long length = _data.length;
+    if (length < kDVRStreamHeaderLength + kDVRStreamTrailerLength) {
+        return nil;
+    }
+    const unsigned long long trailerOffset = length - kDVRStreamTrailerLength;
+    if (memcmp(bytes + trailerOffset + sizeof(uint64_t), kDVRStreamTrailerMagic, sizeof(kDVRStreamTrailerMagic))) {
+        return nil;
+    }
+    const unsigned long long indexOffset = DVRStreamReadInt64(bytes + trailerOffset);
+    if (indexOffset < kDVRStreamHeaderLength ||
+        indexOffset > trailerOffset ||
+        trailerOffset - indexOffset < 1 + sizeof(uint64_t) ||
+        bytes[indexOffset] != kDVRStreamIndexRecord) {
+        return nil;
+    }
+    const unsigned long long count = DVRStreamReadInt64(bytes + indexOffset + 1);
+    const unsigned long long offsetsStart = indexOffset + 1 + sizeof(uint64_t);
+    if ((trailerOffset - offsetsStart) / sizeof(uint64_t) != count ||
+        (trailerOffset - offsetsStart) % sizeof(uint64_t) != 0) {
+        return nil;
+    }
+    NSMutableArray<DVRIndexEntry *> *entries = [NSMutableArray array];
+    for (unsigned long long i = 0; i < count; i++) {
+        const unsigned long long offset = DVRStreamReadInt64(bytes + offsetsStart + i * sizeof(uint64_t));
+        DVRIndexEntry *entry = [self entryForRecordAtOffset:offset limit:indexOffset];
+        if (!entry) {
+            return nil;
+        }
+        [self addEntry:entry toEntries:entries];
+    }
+    return entries;
+}
+
+// Reads frame records until the end of the file or the first one that is truncated or malformed,
+// as after a crash.
+- (NSMutableArray<DVRIndexEntry *> *)entriesFromScan {
+    NSMutableArray<DVRIndexEntry *> *entries = [NSMutableArray array];
+    unsigned long long offset = kDVRStreamHeaderLength;
+    while (YES) {
+        DVRIndexEntry *entry = [self entryForRecordAtOffset:offset limit:_data.length];
+        if (!entry) {
+            break;
+        }
+        [self addEntry:entry toEntries:entries];
+        offset = entry->position + entry->frameLength;
+    }
+    return entries;
+}
+
+// Returns nil if there isn't a well-formed frame record at `offset` that ends by `limit`.
+- (DVRIndexEntry *)entryForRecordAtOffset:(unsigned long long)offset limit:(unsigned long long)limit {
+    if (offset < kDVRStreamHeaderLength ||
+        offset > limit ||
+        limit - offset < kDVRStreamFrameHeaderLength) {
+        return nil;
+    }
+    const char *p = (const char *)_data.bytes + offset;
+    if (*p++ != kDVRStreamFrameRecord) {
+        return nil;
+    }
+    DVRFrameInfo info;
+    info.timestamp = DVRStreamReadInt64(p);
+    p += sizeof(int64_t);
+    info.width = DVRStreamReadInt32(p);
+    p += sizeof(int32_t);
+    info.height = DVRStreamReadInt32(p);
+    p += sizeof(int32_t);
+    info.cursorX = DVRStreamReadInt32(p);
+    p += sizeof(int32_t);
+    info.cursorY = DVRStreamReadInt32(p);
+    p += sizeof(int32_t);
+    info.frameType = DVRStreamReadInt32(p);
+    p += sizeof(int32_t);
+    const int32_t frameLength = DVRStreamReadInt32(p);
+
+    const unsigned long long position = offset + kDVRStreamFrameHeaderLength;
+    if (frameLength < 0 ||
+        limit - position < (unsigned long long)frameLength ||
+        info.width <= 0 ||
+        info.height <= 0 ||
+        (info.frameType != DVRFrameTypeDiffFrame && !DVRFrameTypeIsKeyFrame(info.frameType))) {
+        return nil;
+    }
+    DVRIndexEntry *entry = [[[DVRIndexEntry alloc] init] autorelease];
+    entry->info = info;
+    entry->position = position;
+    entry->frameLength = frameLength;
+    return entry;
+}
+
+- (void)addEntry:(DVRIndexEntry *)entry toEntries:(NSMutableArray<DVRIndexEntry *> *)entries {
+    DVRIndexEntry *previous = entries.lastObject;
+    if (!previous && !DVRFrameTypeIsKeyFrame(entry->info.frameType)) {
+        // Can't be decoded.
+        return;
+    }
+    // Seeking needs timestamps in order. The clock could have gone backwards while recording.
+    if (previous && entry->info.timestamp < previous->info.timestamp) {
+        entry->info.timestamp = previous->info.timestamp;
+    }
+    [entries addObject:entry];
+}
+
+@end
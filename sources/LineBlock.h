@@ -120,6 +120,13 @@ typedef struct {
 // Return a raw line
 - (screen_char_t *)rawLine:(int)linenum;
 
+// Returns the index of the first raw line that has not been dropped. Equal to numEntries - numRawLines.
+- (int)firstEntry;
+
+// Returns the characters of raw line |entry|, omitting any dropped from its start. |entry| must be
+// in [firstEntry, numEntries).
+- (const screen_char_t *)charactersOfRawLine:(int)entry length:(int *)lengthPtr;
+
 // NSLog the contents of the block. For debugging.
 - (void)dump:(int)rawOffset toDebugLog:(BOOL)toDebugLog;
 
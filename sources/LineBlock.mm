@@ -19,6 +19,7 @@ extern "C" {
 }
 #include <unordered_map>
 #include <vector>
+#include <zlib.h>
 
 static BOOL gEnableDoubleWidthCharacterLineCache = NO;
 static BOOL gUseCachingNumberOfLines = NO;
@@ -33,6 +34,21 @@ NSString *const kLineBlockIsPartialKey = @"Is Partial";
 NSString *const kLineBlockMetadataKey = @"Metadata";
 NSString *const kLineBlockMayHaveDWCKey = @"May Have Double Width Character";
 NSString *const kLineBlockGuid = @"GUID";
+NSString *const kLineBlockPackedKey = @"Packed";
+
+// The packed representation replaces the Cumulative Line Lengths and Metadata arrays, which were
+// slow to build and slow to restore because every value was boxed. It is a little-endian blob:
+//   uint8   version (kLineBlockPackedVersion)
+//   uint8   flags (kLineBlockPackedFlag*)
+//   varint  number of bytes in the raw buffer before compression
+//   varint  number of lines (N)
+//   varint  N line lengths (deltas of cumulative_line_lengths)
+//   N metadata records of kLineBlockPackedMetadataRecordSize bytes:
+//     uint16 continuation.code, uint8 backgroundColor, bgGreen, bgBlue, backgroundColorMode,
+//     float64 timestamp
+static const uint8_t kLineBlockPackedVersion = 1;
+static const uint8_t kLineBlockPackedFlagCompressedRawBuffer = 1 << 0;
+static const size_t kLineBlockPackedMetadataRecordSize = 14;
 
 static NSInteger LineBlockNextGeneration = -1;
 
@@ -73,6 +89,60 @@ struct iTermNumFullLinesCacheKeyHasher {
     }
 };
 
+#pragma mark - Packed Format
+
+static void LineBlockPackVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static BOOL LineBlockUnpackVarint(const uint8_t **pp, const uint8_t *end, uint64_t *valuePtr) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pp >= end) {
+            return NO;
+        }
+        const uint8_t byte = *(*pp)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *valuePtr = value;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static void LineBlockPackLittleEndian(std::vector<uint8_t> &out, uint64_t value, int numBytes) {
+    for (int i = 0; i < numBytes; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint64_t LineBlockUnpackLittleEndian(const uint8_t *p, int numBytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < numBytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+// Returns nil if compression fails or doesn't save space.
+static NSData *LineBlockCompressedData(const void *bytes, size_t length) {
+    uLongf capacity = compressBound(length);
+    NSMutableData *result = [NSMutableData dataWithLength:capacity];
+    if (compress2((Bytef *)result.mutableBytes, &capacity, (const Bytef *)bytes, length, Z_BEST_SPEED) != Z_OK) {
+        return nil;
+    }
+    if (capacity >= length) {
+        return nil;
+    }
+    result.length = capacity;
+    return result;
+}
+
 @implementation LineBlock {
     // The raw lines, end-to-end. There is no delimiter between each line.
     screen_char_t* raw_buffer;
@@ -173,10 +243,13 @@ NS_INLINE void iTermLineBlockDidChange(__unsafe_unretained LineBlock *lineBlock)
                                    kLineBlockStartOffsetKey,
                                    kLineBlockFirstEntryKey,
                                    kLineBlockBufferSizeKey,
-                                   kLineBlockCLLKey,
-                                   kLineBlockMetadataKey,
                                    kLineBlockIsPartialKey,
                                    kLineBlockMayHaveDWCKey ];
+        if (!dictionary[kLineBlockPackedKey]) {
+            // Legacy format
+            requiredKeys = [requiredKeys arrayByAddingObjectsFromArray:@[ kLineBlockCLLKey,
+                                                                          kLineBlockMetadataKey ]];
+        }
         for (NSString *requiredKey in requiredKeys) {
             if (!dictionary[requiredKey]) {
                 [self autorelease];
@@ -186,7 +259,6 @@ NS_INLINE void iTermLineBlockDidChange(__unsafe_unretained LineBlock *lineBlock)
         NSData *data = dictionary[kLineBlockRawBufferKey];
         buffer_size = [dictionary[kLineBlockBufferSizeKey] intValue];
         raw_buffer = (screen_char_t *)iTermMalloc(buffer_size * sizeof(screen_char_t));
-        memmove(raw_buffer, data.bytes, data.length);
         buffer_start = raw_buffer + [dictionary[kLineBlockBufferStartOffsetKey] intValue];
         start_offset = [dictionary[kLineBlockStartOffsetKey] intValue];
         first_entry = [dictionary[kLineBlockFirstEntryKey] intValue];
@@ -195,40 +267,135 @@ NS_INLINE void iTermLineBlockDidChange(__unsafe_unretained LineBlock *lineBlock)
             _guid = [dictionary[kLineBlockGuid] copy];
             DLog(@"Restore block %p with guid %@", self, _guid);
         }
-        NSArray *cllArray = dictionary[kLineBlockCLLKey];
-        cll_capacity = [cllArray count];
-        cumulative_line_lengths = (int*)iTermMalloc(sizeof(int) * cll_capacity);
-        [self commonInit];
-
-        NSArray *metadataArray = dictionary[kLineBlockMetadataKey];
-
-        for (int i = 0; i < cll_capacity; i++) {
-            cumulative_line_lengths[i] = [cllArray[i] intValue];
-            int j = 0;
-            NSArray *components = metadataArray[i];
-            metadata_[i].continuation.code = [components[j++] unsignedShortValue];
-            metadata_[i].continuation.backgroundColor = [components[j++] unsignedCharValue];
-            metadata_[i].continuation.bgGreen = [components[j++] unsignedCharValue];
-            metadata_[i].continuation.bgBlue = [components[j++] unsignedCharValue];
-            metadata_[i].continuation.backgroundColorMode = [components[j++] unsignedCharValue];
-            metadata_[i].timestamp = [components[j++] doubleValue];
-            metadata_[i].number_of_wrapped_lines = 0;
-            metadata_[i].generation = LineBlockNextGeneration--;
-            if (gEnableDoubleWidthCharacterLineCache) {
-                metadata_[i].double_width_characters = nil;
+        NSData *packed = dictionary[kLineBlockPackedKey];
+        if (packed) {
+            if (![self unpack:packed rawBuffer:data]) {
+                DLog(@"Failed to unpack block with guid %@", _guid);
+                [self autorelease];
+                return nil;
+            }
+        } else {
+            if (data.length > (NSUInteger)buffer_size * sizeof(screen_char_t)) {
+                DLog(@"Raw buffer of block with guid %@ overflows its size", _guid);
+                [self autorelease];
+                return nil;
             }
+            memmove(raw_buffer, data.bytes, data.length);
+            [self loadLegacyCumulativeLineLengths:dictionary[kLineBlockCLLKey]
+                                         metadata:dictionary[kLineBlockMetadataKey]];
         }
 
         cll_entries = cll_capacity;
         is_partial = [dictionary[kLineBlockIsPartialKey] boolValue];
         _mayHaveDoubleWidthCharacter = [dictionary[kLineBlockMayHaveDWCKey] boolValue];
+        [self retainComplexCharsInUse];
     }
     return self;
 }
 
+- (void)loadLegacyCumulativeLineLengths:(NSArray *)cllArray metadata:(NSArray *)metadataArray {
+    cll_capacity = [cllArray count];
+    cumulative_line_lengths = (int*)iTermMalloc(sizeof(int) * cll_capacity);
+    [self commonInit];
+
+    for (int i = 0; i < cll_capacity; i++) {
+        cumulative_line_lengths[i] = [cllArray[i] intValue];
+        int j = 0;
+        NSArray *components = metadataArray[i];
+        metadata_[i].continuation.code = [components[j++] unsignedShortValue];
+        metadata_[i].continuation.backgroundColor = [components[j++] unsignedCharValue];
+        metadata_[i].continuation.bgGreen = [components[j++] unsignedCharValue];
+        metadata_[i].continuation.bgBlue = [components[j++] unsignedCharValue];
+        metadata_[i].continuation.backgroundColorMode = [components[j++] unsignedCharValue];
+        metadata_[i].timestamp = [components[j++] doubleValue];
+        metadata_[i].number_of_wrapped_lines = 0;
+        metadata_[i].generation = LineBlockNextGeneration--;
+        if (gEnableDoubleWidthCharacterLineCache) {
+            metadata_[i].double_width_characters = nil;
+        }
+    }
+}
+
+// Reads the packed format straight into the block's own buffers, with no intermediate objects.
+// raw_buffer and buffer_size must already be set. Returns NO if the data is malformed.
+- (BOOL)unpack:(NSData *)packed rawBuffer:(NSData *)rawBufferData {
+    const uint8_t *p = (const uint8_t *)packed.bytes;
+    const uint8_t *end = p + packed.length;
+    if (packed.length < 2 || p[0] != kLineBlockPackedVersion) {
+        return NO;
+    }
+    const uint8_t flags = p[1];
+    p += 2;
+
+    uint64_t rawLength = 0;
+    uint64_t count = 0;
+    if (!LineBlockUnpackVarint(&p, end, &rawLength) ||
+        !LineBlockUnpackVarint(&p, end, &count)) {
+        return NO;
+    }
+    if (rawLength > (uint64_t)buffer_size * sizeof(screen_char_t) || count > INT_MAX) {
+        return NO;
+    }
+    if (flags & kLineBlockPackedFlagCompressedRawBuffer) {
+        uLongf destLength = rawLength;
+        if (uncompress((Bytef *)raw_buffer, &destLength, (const Bytef *)rawBufferData.bytes, rawBufferData.length) != Z_OK ||
+            destLength != rawLength) {
+            return NO;
+        }
+    } else {
+        if (rawBufferData.length != rawLength) {
+            return NO;
+        }
+        memmove(raw_buffer, rawBufferData.bytes, rawLength);
+    }
+
+    cll_capacity = (int)count;
+    cumulative_line_lengths = (int*)iTermMalloc(sizeof(int) * cll_capacity);
+    [self commonInit];
+
+    int cumulative = 0;
+    for (int i = 0; i < cll_capacity; i++) {
+        uint64_t length;
+        if (!LineBlockUnpackVarint(&p, end, &length) || length > INT_MAX - cumulative) {
+            return NO;
+        }
+        cumulative += (int)length;
+        cumulative_line_lengths[i] = cumulative;
+    }
+    if ((uint64_t)cumulative * sizeof(screen_char_t) != rawLength) {
+        // The line lengths must account for exactly the characters in the raw buffer.
+        return NO;
+    }
+    if ((size_t)(end - p) != (size_t)cll_capacity * kLineBlockPackedMetadataRecordSize) {
+        return NO;
+    }
+    for (int i = 0; i < cll_capacity; i++) {
+        metadata_[i].continuation.code = (unichar)LineBlockUnpackLittleEndian(p, 2);
+        metadata_[i].continuation.backgroundColor = p[2];
+        metadata_[i].continuation.bgGreen = p[3];
+        metadata_[i].continuation.bgBlue = p[4];
+        metadata_[i].continuation.backgroundColorMode = p[5];
+        const uint64_t timestampBits = LineBlockUnpackLittleEndian(p + 6, 8);
+        memcpy(&metadata_[i].timestamp, &timestampBits, sizeof(metadata_[i].timestamp));
+        metadata_[i].number_of_wrapped_lines = 0;
+        metadata_[i].generation = LineBlockNextGeneration--;
+        if (gEnableDoubleWidthCharacterLineCache) {
+            metadata_[i].double_width_characters = nil;
+        }
+        p += kLineBlockPackedMetadataRecordSize;
+    }
+    return YES;
+}
+
+// Complex chars between buffer_start and the end of the last line are referenced by this block.
+- (void)retainComplexCharsInUse {
+    ScreenCharRetainComplexChars(buffer_start, [self rawSpaceUsed] - start_offset);
+}
+
 - (void)dealloc
 {
     if (raw_buffer) {
+        ScreenCharReleaseComplexChars(buffer_start, [self rawSpaceUsed] - start_offset);
         free(raw_buffer);
     }
     if (cumulative_line_lengths) {
@@ -273,7 +440,8 @@ NS_INLINE void iTermLineBlockDidChange(__unsafe_unretained LineBlock *lineBlock)
     theCopy->cached_numlines = cached_numlines;
     theCopy->cached_numlines_width = cached_numlines_width;
     theCopy->_generation = _generation;
-    
+    [theCopy retainComplexCharsInUse];
+
     return theCopy;
 }
 
@@ -449,6 +617,7 @@ extern "C" int iTermLineBlockNumberOfFullLinesImpl(screen_char_t *buffer,
         return NO;
     }
     memcpy(raw_buffer + space_used, buffer, sizeof(screen_char_t) * length);
+    ScreenCharRetainComplexChars(buffer, length);
     // There's an edge case here. In the else clause, the line buffer looks like this originally:
     //   |xxxx| EOL_SOFT
     // Then append an empty line with EOL_HARD. The desired result is
@@ -893,6 +1062,7 @@ int OffsetOfWrappedLine(screen_char_t* p, int n, int length, int width, BOOL may
         --cll_entries;
         is_partial = NO;
     }
+    ScreenCharReleaseComplexChars(*ptr, *length);
 
     if (cll_entries == first_entry) {
         // Popped the last line. Reset everything.
@@ -950,6 +1120,17 @@ int OffsetOfWrappedLine(screen_char_t* p, int n, int length, int width, BOOL may
     return raw_buffer + start;
 }
 
+- (int)firstEntry {
+    return first_entry;
+}
+
+- (const screen_char_t *)charactersOfRawLine:(int)entry length:(int *)lengthPtr {
+    ITAssertWithMessage(entry >= first_entry && entry < cll_entries, @"Out of bounds");
+    const int start = [self _lineRawOffset:entry];
+    *lengthPtr = cumulative_line_lengths[entry] - start;
+    return raw_buffer + start;
+}
+
 - (void)changeBufferSize:(int)capacity {
     ITAssertWithMessage(capacity >= [self rawSpaceUsed], @"Truncating used space");
     capacity = MAX(1, capacity);
@@ -1018,6 +1199,7 @@ int OffsetOfWrappedLine(screen_char_t* p, int n, int length, int width, BOOL may
             } else {
                 cached_numlines -= orig_n;
             }
+            ScreenCharReleaseComplexChars(buffer_start, prev + offset);
             buffer_start += prev + offset;
             start_offset = buffer_start - raw_buffer;
             first_entry = i;
@@ -1039,6 +1221,7 @@ int OffsetOfWrappedLine(screen_char_t* p, int n, int length, int width, BOOL may
     }
 
     // Consumed the whole buffer.
+    ScreenCharReleaseComplexChars(buffer_start, [self rawSpaceUsed] - start_offset);
     cached_numlines_width = -1;
     cll_entries = 0;
     buffer_start = raw_buffer;
@@ -1555,38 +1738,49 @@ static int Search(NSString* needle,
     return NO;
 }
 
-- (NSArray *)cumulativeLineLengthsArray {
-    NSMutableArray *cllArray = [NSMutableArray array];
+- (NSData *)packedDataWithRawLength:(size_t)rawLength compressed:(BOOL)compressed {
+    std::vector<uint8_t> packed;
+    packed.reserve(16 + cll_entries * (2 + kLineBlockPackedMetadataRecordSize));
+    packed.push_back(kLineBlockPackedVersion);
+    packed.push_back(compressed ? kLineBlockPackedFlagCompressedRawBuffer : 0);
+    LineBlockPackVarint(packed, rawLength);
+    LineBlockPackVarint(packed, cll_entries);
+    int previous = 0;
     for (int i = 0; i < cll_entries; i++) {
-        [cllArray addObject:@(cumulative_line_lengths[i])];
+        LineBlockPackVarint(packed, cumulative_line_lengths[i] - previous);
+        previous = cumulative_line_lengths[i];
     }
-    return cllArray;
-}
-
-- (NSArray *)metadataArray {
-    NSMutableArray *metadataArray = [NSMutableArray array];
     for (int i = 0; i < cll_entries; i++) {
-        [metadataArray addObject:@[ @(metadata_[i].continuation.code),
-                                    @(metadata_[i].continuation.backgroundColor),
-                                    @(metadata_[i].continuation.bgGreen),
-                                    @(metadata_[i].continuation.bgBlue),
-                                    @(metadata_[i].continuation.backgroundColorMode),
-                                    @(metadata_[i].timestamp) ]];
-    }
-    return metadataArray;
+        const screen_char_t &continuation = metadata_[i].continuation;
+        LineBlockPackLittleEndian(packed, continuation.code, 2);
+        packed.push_back(continuation.backgroundColor);
+        packed.push_back(continuation.bgGreen);
+        packed.push_back(continuation.bgBlue);
+        packed.push_back(continuation.backgroundColorMode);
+        uint64_t timestampBits;
+        memcpy(&timestampBits, &metadata_[i].timestamp, sizeof(timestampBits));
+        LineBlockPackLittleEndian(packed, timestampBits, 8);
+    }
+    return [NSData dataWithBytes:packed.data() length:packed.size()];
 }
 
 - (NSDictionary *)dictionary {
-    NSData *rawBufferData = [NSData dataWithBytes:raw_buffer
-                                           length:[self rawSpaceUsed] * sizeof(screen_char_t)];
+    const size_t rawLength = [self rawSpaceUsed] * sizeof(screen_char_t);
+    NSData *rawBufferData = nil;
+    if ([iTermAdvancedSettingsModel compressScrollbackInRestorableState]) {
+        rawBufferData = LineBlockCompressedData(raw_buffer, rawLength);
+    }
+    const BOOL compressed = (rawBufferData != nil);
+    if (!compressed) {
+        rawBufferData = [NSData dataWithBytes:raw_buffer length:rawLength];
+    }
     return @{ kLineBlockRawBufferKey: rawBufferData,
               kLineBlockBufferStartOffsetKey: @(buffer_start - raw_buffer),
               kLineBlockStartOffsetKey: @(start_offset),
               kLineBlockFirstEntryKey: @(first_entry),
               kLineBlockBufferSizeKey: @(buffer_size),
-              kLineBlockCLLKey: [self cumulativeLineLengthsArray],
+              kLineBlockPackedKey: [self packedDataWithRawLength:rawLength compressed:compressed],
               kLineBlockIsPartialKey: @(is_partial),
-              kLineBlockMetadataKey: [self metadataArray],
               kLineBlockMayHaveDWCKey: @(_mayHaveDoubleWidthCharacter),
               kLineBlockGuid: _guid };
 }
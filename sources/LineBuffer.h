@@ -199,6 +199,23 @@
 
 - (int)numberOfWrappedLinesWithWidth:(int)width;
 
+// Raw lines are numbered in the order they were appended, starting at 0. Dropping lines does not
+// renumber those that remain. Returns the number of the first raw line that has not been dropped.
+- (long long)firstRawLineNumber;
+
+// Incremented each time a complete raw line is popped off the end, in full or in part. Its number
+// is given to the next raw line to be completed.
+@property(nonatomic, readonly) long long numberOfPoppedRawLines;
+
+// Calls |block| for up to |maximumCount| raw lines numbered |rawLineNumber| or later, except a last
+// line that is still partial. Characters dropped from the start of the first line are omitted.
+// Returns the number after the last line enumerated, which is where the next call should start.
+- (long long)enumerateCompleteRawLinesFromNumber:(long long)rawLineNumber
+                                    maximumCount:(long long)maximumCount
+                                           block:(void (^)(const screen_char_t *chars,
+                                                           int length,
+                                                           long long rawLineNumber))block;
+
 - (void)beginResizing;
 - (void)endResizing;
 
@@ -81,6 +81,9 @@ static const NSInteger kUnicodeVersion = 9;
 
     // Number of char that have been dropped
     long long droppedChars;
+
+    // Number of raw lines in blocks that have been removed from the head. Used to number raw lines.
+    long long _rawLinesInDroppedBlocks;
 }
 
 // Append a block
@@ -207,10 +210,12 @@ static int RawNumLines(LineBuffer* buffer, int width) {
                 toDrop = extra_lines;
             }
             int charsDropped;
+            const int entries = [block numEntries];
             int dropped = [block dropLines:toDrop withWidth:width chars:&charsDropped];
             totalDropped += dropped;
             droppedChars += charsDropped;
             if ([block isEmpty]) {
+                _rawLinesInDroppedBlocks += entries;
                 [_lineBlocks removeFirstBlock];
                 ++num_dropped_blocks;
                 if (_lineBlocks.count > 0) {
@@ -569,6 +574,10 @@ static int RawNumLines(LineBuffer* buffer, int width) {
     // If the line is partial the client will want to add a continuation marker so
     // tell him there's no EOL in that case.
     *includesEndOfLine = [block hasPartial] ? EOL_SOFT : EOL_HARD;
+    if (![block hasPartial]) {
+        // The last complete line becomes partial or goes away.
+        _numberOfPoppedRawLines += 1;
+    }
 
     // Pop the last up-to-width chars off the last line.
     int length;
@@ -1083,6 +1092,8 @@ NS_INLINE int TotalNumberOfRawLines(LineBuffer *self) {
     theCopy->num_wrapped_lines_cache = num_wrapped_lines_cache;
     theCopy->num_wrapped_lines_width = num_wrapped_lines_width;
     theCopy->droppedChars = droppedChars;
+    theCopy->_rawLinesInDroppedBlocks = _rawLinesInDroppedBlocks;
+    theCopy->_numberOfPoppedRawLines = _numberOfPoppedRawLines;
     theCopy.mayHaveDoubleWidthCharacter = _mayHaveDoubleWidthCharacter;
 
     return theCopy;
@@ -1203,6 +1214,8 @@ NS_INLINE int TotalNumberOfRawLines(LineBuffer *self) {
     theCopy->num_wrapped_lines_cache = num_wrapped_lines_cache;
     theCopy->num_wrapped_lines_width = num_wrapped_lines_width;
     theCopy->droppedChars = droppedChars;
+    theCopy->_rawLinesInDroppedBlocks = _rawLinesInDroppedBlocks;
+    theCopy->_numberOfPoppedRawLines = _numberOfPoppedRawLines;
 
     return theCopy;
 }
@@ -1245,10 +1258,51 @@ NS_INLINE int TotalNumberOfRawLines(LineBuffer *self) {
     theCopy->num_dropped_blocks += numDroppedBlocks;
     theCopy->num_wrapped_lines_width = -1;
     theCopy->droppedChars += [self numCharsInRangeOfBlocks:NSMakeRange(0, numDroppedBlocks)];
+    for (int i = 0; i < numDroppedBlocks; i++) {
+        theCopy->_rawLinesInDroppedBlocks += [_lineBlocks[i] numEntries];
+    }
 
     return theCopy;
 }
 
+- (long long)firstRawLineNumber {
+    if (_lineBlocks.count == 0) {
+        return _rawLinesInDroppedBlocks;
+    }
+    return _rawLinesInDroppedBlocks + [_lineBlocks[0] firstEntry];
+}
+
+- (long long)enumerateCompleteRawLinesFromNumber:(long long)rawLineNumber
+                                    maximumCount:(long long)maximumCount
+                                           block:(void (^)(const screen_char_t *chars,
+                                                           int length,
+                                                           long long rawLineNumber))block {
+    long long number = _rawLinesInDroppedBlocks;
+    long long remaining = maximumCount;
+    const int count = _lineBlocks.count;
+    for (int i = 0; i < count; i++) {
+        LineBlock *lineBlock = _lineBlocks[i];
+        const int numEntries = [lineBlock numEntries];
+        int end = numEntries;
+        if (i + 1 == count && [lineBlock hasPartial]) {
+            // The last line isn't finished yet.
+            end -= 1;
+        }
+        const long long first = MAX(rawLineNumber - number, [lineBlock firstEntry]);
+        for (long long entry = first; entry < end; entry++) {
+            if (remaining == 0) {
+                return number + entry;
+            }
+            remaining -= 1;
+            int length;
+            const screen_char_t *chars = [lineBlock charactersOfRawLine:(int)entry length:&length];
+            block(chars, length, number + entry);
+        }
+        number += end;
+    }
+    return number;
+}
+
 - (int)numberOfWrappedLinesWithWidth:(int)width {
     return [_lineBlocks numberOfWrappedLinesForWidth:width];
 }
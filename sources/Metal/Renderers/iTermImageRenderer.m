@@ -106,7 +106,8 @@ static NSString *const iTermImageRendererTextureMetadataKeyImageMissing = @"iTer
 - (id)keyForRun:(iTermMetalImageRun *)run {
     NSUInteger temp = run.code;
     int frame = ([run.imageInfo frameForTimestamp:_timestamp] & 0xffff);
-    return @(temp << 16 | frame);
+    const NSUInteger generation = (run.imageInfo.generation & 0xffffffff);
+    return @(generation << 32 | temp << 16 | frame);
 }
 
 - (id<MTLTexture>)newTextureForImageRun:(iTermMetalImageRun *)run {
@@ -25,6 +25,7 @@
 #import "iTermMetalFrameData.h"
 #import "iTermMarkRenderer.h"
 #import "iTermMetalRowData.h"
+#import "iTermPipelineMetrics.h"
 #import "iTermPreciseTimer.h"
 #import "iTermPreferences.h"
 #import "iTermTextRendererTransientState.h"
@@ -444,7 +445,9 @@ cellSizeWithoutSpacing:(CGSize)cellSizeWithoutSpacing
         return NO;
     }
 
+    const uint64_t frameBuildStart = iTermPipelineMetricsNow();
     iTermMetalFrameData *frameData = [self newFrameDataForView:view];
+    iTermPipelineMetricsRecordDuration(iTermPipelineStageFrameBuildMicroseconds, frameBuildStart);
     DLog(@"allocated metal frame %@", frameData);
     if (VT100GridSizeEquals(frameData.gridSize, VT100GridSizeMake(0, 0))) {
         DLog(@"  abort: 0x0 grid");
@@ -32,6 +32,7 @@
 #import "iTermPreferences.h"
 #import "iTermSwiftyStringParser.h"
 #import "iTermTuple.h"
+#import "iTermUnicodeTables.h"
 #import "iTermVariableScope.h"
 #import "NSArray+iTerm.h"
 #import "NSAttributedString+PSM.h"
@@ -63,14 +64,9 @@
         return NO;
     }
 
-    if ([[NSCharacterSet fullWidthCharacterSetForUnicodeVersion:version] longCharacterIsMember:unicode]) {
-        return YES;
-    }
-    if (ambiguousIsDoubleWidth &&
-        [[NSCharacterSet ambiguousWidthCharacterSetForUnicodeVersion:version] longCharacterIsMember:unicode]) {
-        return YES;
-    }
-    return NO;
+    return iTermUnicodeIsDoubleWidth(iTermUnicodePropertiesOfCharacter(unicode),
+                                     ambiguousIsDoubleWidth,
+                                     version);
 }
 
 + (NSString *)stringWithLongCharacter:(UTF32Char)longCharacter {
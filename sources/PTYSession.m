@@ -4,6 +4,7 @@
 #import "CapturedOutput.h"
 #import "Coprocess.h"
 #import "CVector.h"
+#import "DVRStream.h"
 #import "FakeWindow.h"
 #import "FileTransferManager.h"
 #import "ITAddressBookMgr.h"
@@ -73,6 +74,7 @@
 #import "iTermMouseCursor.h"
 #import "iTermNotificationCenter.h"
 #import "iTermPasteHelper.h"
+#import "iTermPipelineMetrics.h"
 #import "iTermPreferences.h"
 #import "iTermPrintGuard.h"
 #import "iTermProcessCache.h"
@@ -697,6 +699,13 @@ static const NSUInteger kMaxHosts = 100;
         dateFormatter.dateFormat = @"yyyyMMdd_HHmmss";
         [self.variablesScope setValue:[dateFormatter stringFromDate:_creationDate]
                      forVariableNamed:iTermVariableKeySessionCreationTimeString];
+        NSString *recordingDirectory = [iTermAdvancedSettingsModel instantReplayRecordingDirectory];
+        if (!synthetic && recordingDirectory.length) {
+            NSString *filename = [NSString stringWithFormat:@"%@-%@.itrs",
+                                  [dateFormatter stringFromDate:_creationDate], _guid];
+            NSString *path = [recordingDirectory.stringByExpandingTildeInPath stringByAppendingPathComponent:filename];
+            _screen.dvr.streamWriter = [[[DVRStreamWriter alloc] initWithPath:path] autorelease];
+        }
         [self.variablesScope setValue:[@(_autoLogId) stringValue] forVariableNamed:iTermVariableKeySessionAutoLogID];
         [self.variablesScope setValue:_guid forVariableNamed:iTermVariableKeySessionID];
         [self.variablesScope setValue:@"" forVariableNamed:iTermVariableKeySessionSelection];
@@ -2523,6 +2532,8 @@ ITERM_WEAKLY_REFERENCEABLE
     // deregister from the notification center
     [[NSNotificationCenter defaultCenter] removeObserver:self];
 
+    [_screen.dvr.streamWriter close];
+
     if (_liveSession) {
         [_liveSession terminate];
     }
@@ -2866,6 +2877,9 @@ ITERM_WEAKLY_REFERENCEABLE
 // This is run in PTYTask's thread. It parses the input here and then queues an async task to run
 // in the main thread to execute the parsed tokens.
 - (void)threadedReadTask:(char *)buffer length:(int)length {
+    iTermPipelineMetricsRecord(iTermPipelineStagePTYReadBytes, length);
+    const uint64_t parseStart = iTermPipelineMetricsNow();
+
     // Pass the input stream to the parser.
     [_terminal.parser putStreamData:buffer length:length];
 
@@ -2874,6 +2888,11 @@ ITERM_WEAKLY_REFERENCEABLE
     CVectorCreate(&vector, 100);
     [_terminal.parser addParsedTokensToVector:&vector];
 
+    if (length > 0) {
+        iTermPipelineMetricsRecord(iTermPipelineStageParseMicrosecondsPerKB,
+                                   iTermPipelineMetricsNanosecondsSince(parseStart) * 1024 / (1000 * (uint64_t)length));
+    }
+    iTermPipelineMetricsRecord(iTermPipelineStageTokensPerBatch, CVectorCount(&vector));
     if (CVectorCount(&vector) == 0) {
         CVectorDestroy(&vector);
         return;
@@ -2885,7 +2904,9 @@ ITERM_WEAKLY_REFERENCEABLE
 
     // This limits the number of outstanding execution blocks to prevent the main thread from
     // getting bogged down.
+    const uint64_t waitStart = iTermPipelineMetricsNow();
     dispatch_semaphore_wait(_executionSemaphore, DISPATCH_TIME_FOREVER);
+    iTermPipelineMetricsRecordDuration(iTermPipelineStageExecutionSemaphoreWaitMicroseconds, waitStart);
 
     [self retain];
     dispatch_retain(_executionSemaphore);
@@ -2893,7 +2914,9 @@ ITERM_WEAKLY_REFERENCEABLE
         if (_useAdaptiveFrameRate) {
             [_throughputEstimator addByteCount:length];
         }
+        const uint64_t executeStart = iTermPipelineMetricsNow();
         [self executeTokens:&vector bytesHandled:length];
+        iTermPipelineMetricsRecordDuration(iTermPipelineStageExecuteMicroseconds, executeStart);
         [_cadenceController didHandleInput];
 
         // Unblock the background thread; if it's ready, it can send the main thread more tokens
@@ -3039,6 +3062,7 @@ ITERM_WEAKLY_REFERENCEABLE
                         lineNumber:(long long)startAbsLineNumber {
     // If the trigger causes the session to get released, don't crash.
     [[self retain] autorelease];
+    const uint64_t start = iTermPipelineMetricsNow();
 
     for (iTermExpectation *expectation in [[_expect.expectations copy] autorelease]) {
         NSArray<NSString *> *capture = [stringLine.stringValue captureComponentsMatchedByRegex:expectation.regex];
@@ -3061,6 +3085,7 @@ ITERM_WEAKLY_REFERENCEABLE
             break;
         }
     }
+    iTermPipelineMetricsRecordDuration(iTermPipelineStageTriggerMicroseconds, start);
 }
 
 - (void)appendStringToTriggerLine:(NSString *)s {
@@ -3143,6 +3168,10 @@ ITERM_WEAKLY_REFERENCEABLE
     [self.variablesScope setValue:task.tty forVariableNamed:iTermVariableKeySessionTTY];
 }
 
+- (void)taskWriteBufferDidGainRoom:(PTYTask *)task {
+    [_pasteHelper writeBufferDidGainRoom];
+}
+
 - (void)tmuxDidDisconnect {
     DLog(@"tmuxDidDisconnect");
     if (_exited) {
@@ -3174,6 +3203,9 @@ ITERM_WEAKLY_REFERENCEABLE
 
 - (void)cleanUpAfterBrokenPipe {
     _exited = YES;
+    // A paste waiting for the pty to drain would wait forever. Now that the session has exited it
+    // falls back to its timer.
+    [_pasteHelper writeBufferDidGainRoom];
     [_logging stop];
     [[NSNotificationCenter defaultCenter] postNotificationName:PTYSessionTerminatedNotification object:self];
     [[NSNotificationCenter defaultCenter] postNotificationName:kCurrentSessionDidChange object:nil];
@@ -12040,6 +12072,17 @@ scrollToFirstResult:(BOOL)scrollToFirstResult {
     return self.variablesScope;
 }
 
+- (NSInteger)pasteHelperWriteBufferRoom {
+    if (self.tmuxMode != TMUX_NONE || _exited) {
+        return -1;
+    }
+    return _shell.writeBufferRoom;
+}
+
+- (void)pasteHelperNotifyWhenWriteBufferHasRoom {
+    [_shell notifyWhenWriteBufferHasRoom];
+}
+
 #pragma mark - iTermAutomaticProfileSwitcherDelegate
 
 - (NSString *)automaticProfileSwitcherSessionName {
@@ -30,6 +30,9 @@
 
 // Main thread
 - (void)taskDidChangeTTY:(PTYTask *)task;
+
+// Main thread. Called once after -notifyWhenWriteBufferHasRoom when the write buffer has drained.
+- (void)taskWriteBufferDidGainRoom:(PTYTask *)task;
 @end
 
 typedef NS_ENUM(NSUInteger, iTermJobManagerForkAndExecStatus) {
@@ -154,6 +157,8 @@ typedef NS_OPTIONS(NSUInteger, iTermJobManagerAttachResults) {
 @property(atomic, readonly) BOOL wantsWrite;
 @property(atomic, retain) Coprocess *coprocess;
 @property(atomic, readonly) BOOL writeBufferHasRoom;
+// Number of bytes that can be written before writeBufferHasRoom becomes NO.
+@property(atomic, readonly) NSInteger writeBufferRoom;
 @property(atomic, readonly) BOOL hasCoprocess;
 @property(nonatomic, readonly) BOOL passwordInput;
 @property(nonatomic) unichar pendingHighSurrogate;
@@ -183,6 +188,10 @@ typedef NS_OPTIONS(NSUInteger, iTermJobManagerAttachResults) {
 
 - (void)writeTask:(NSData*)data;
 
+// Calls the delegate's -taskWriteBufferDidGainRoom: on the main thread when the write buffer is at
+// most half full, which may be right away.
+- (void)notifyWhenWriteBufferHasRoom;
+
 // Cause the slave to receive a SIGWINCH and change the tty's window size. If `size` equals the
 // tty's current window size then no action is taken.
 - (void)setSize:(VT100GridSize)size viewSize:(NSSize)viewSize scaleFactor:(CGFloat)scaleFactor;
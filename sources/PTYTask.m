@@ -40,6 +40,9 @@
 #include <unistd.h>
 #include <util.h>
 
+// writeBufferHasRoom is NO once this many bytes are waiting to be written.
+static const NSInteger kPTYTaskMaxWriteBufferSize = 1024 * 10;
+
 static void HandleSigChld(int n) {
     // This is safe to do because write(2) is listed in the sigaction(2) man page
     // as allowed in a signal handler. Calling a method is *NOT* safe since something might
@@ -60,8 +63,9 @@ static void HandleSigChld(int n) {
     NSString* path;
     BOOL hasOutput;
 
-    NSLock* writeLock;  // protects writeBuffer
+    NSLock* writeLock;  // protects writeBuffer and _notifyWhenWriteBufferHasRoom
     NSMutableData* writeBuffer;
+    BOOL _notifyWhenWriteBufferHasRoom;
 
 
     Coprocess *coprocess_;  // synchronized (self)
@@ -218,11 +222,35 @@ static void HandleSigChld(int n) {
 }
 
 - (BOOL)writeBufferHasRoom {
-    const int kMaxWriteBufferSize = 1024 * 10;
+    return self.writeBufferRoom > 0;
+}
+
+- (NSInteger)writeBufferRoom {
+    [writeLock lock];
+    const NSInteger room = MAX(0, kPTYTaskMaxWriteBufferSize - (NSInteger)[writeBuffer length]);
+    [writeLock unlock];
+    return room;
+}
+
+- (void)notifyWhenWriteBufferHasRoom {
     [writeLock lock];
-    BOOL hasRoom = [writeBuffer length] < kMaxWriteBufferSize;
+    const BOOL hasRoom = [writeBuffer length] <= kPTYTaskMaxWriteBufferSize / 2;
+    _notifyWhenWriteBufferHasRoom = !hasRoom;
     [writeLock unlock];
-    return hasRoom;
+    if (hasRoom) {
+        [self notifyDelegateOfWriteBufferRoom];
+    }
+}
+
+- (void)notifyDelegateOfWriteBufferRoom {
+    __weak id<PTYTaskDelegate> delegate = self.delegate;
+    __weak __typeof(self) weakSelf = self;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        __strong __typeof(self) strongSelf = weakSelf;
+        if (strongSelf) {
+            [delegate taskWriteBufferDidGainRoom:strongSelf];
+        }
+    });
 }
 
 - (BOOL)hasCoprocess {
@@ -477,31 +505,62 @@ static void HandleSigChld(int n) {
     [self readTask:buffer length:bytesRead];
 }
 
+- (void)replayBufferedOutput:(NSData *)data {
+    DLog(@"Replay %@ bytes of buffered output for %@", @(data.length), @(self.pid));
+    const NSUInteger chunkSize = MAXRW * 4;
+    for (NSUInteger offset = 0; offset < data.length; offset += chunkSize) {
+        const NSUInteger length = MIN(chunkSize, data.length - offset);
+        hasOutput = YES;
+        [self readTask:(char *)data.bytes + offset length:(int)length];
+    }
+}
+
 - (void)processWrite {
     // Retain to prevent the object from being released during this method
     // Lock to protect the writeBuffer from the main thread
     [writeLock lock];
 
-    // Only write up to MAXRW bytes, then release control
+    // Write MAXRW bytes at a time until the pty stops accepting them or the buffer is empty. The
+    // buffer is small, so this doesn't starve other tasks, and it lets a paste go as fast as the
+    // pty can take it.
     char* ptr = [writeBuffer mutableBytes];
-    unsigned int length = [writeBuffer length];
-    if (length > MAXRW) {
-        length = MAXRW;
+    const NSUInteger bufferLength = [writeBuffer length];
+    NSUInteger totalWritten = 0;
+    while (totalWritten < bufferLength) {
+        const size_t length = MIN((NSUInteger)MAXRW, bufferLength - totalWritten);
+        const ssize_t written = write(self.fd, ptr + totalWritten, length);
+
+        // No data?
+        if ((written < 0) && (!(errno == EAGAIN || errno == EINTR))) {
+            [self brokenPipe];
+            break;
+        }
+        if (written <= 0) {
+            break;
+        }
+        totalWritten += written;
+        if ((size_t)written < length) {
+            // The pty is full.
+            break;
+        }
     }
-    ssize_t written = write(self.fd, [writeBuffer mutableBytes], length);
-
-    // No data?
-    if ((written < 0) && (!(errno == EAGAIN || errno == EINTR))) {
-        [self brokenPipe];
-    } else if (written > 0) {
+    if (totalWritten > 0) {
         // Shrink the writeBuffer
-        length = [writeBuffer length] - written;
-        memmove(ptr, ptr+written, length);
-        [writeBuffer setLength:length];
+        memmove(ptr, ptr + totalWritten, bufferLength - totalWritten);
+        [writeBuffer setLength:bufferLength - totalWritten];
+    }
+    const BOOL notify = (_notifyWhenWriteBufferHasRoom &&
+                         [writeBuffer length] <= kPTYTaskMaxWriteBufferSize / 2);
+    if (notify) {
+        _notifyWhenWriteBufferHasRoom = NO;
     }
 
     // Clean up locks
     [writeLock unlock];
+
+    if (notify) {
+        [self notifyDelegateOfWriteBufferRoom];
+    }
 }
 
 - (void)stopCoprocess {
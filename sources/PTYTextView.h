@@ -495,6 +495,13 @@ typedef void (^PTYTextViewDrawingHookBlock)(iTermTextDrawingHelper *);
 
 // Saving/printing
 - (void)saveDocumentAs:(id)sender;
+
+// Write plain text to a file a chunk at a time, without building one string for all of it. The
+// file is complete some time after these return; until then any existing file is left as it was.
+// They beep if the file can't be written.
+- (void)writeContentToPath:(NSString *)path encoding:(NSStringEncoding)encoding;
+// Writes the selection, or all the content if nothing is selected.
+- (void)writeSelectionOrContentToPath:(NSString *)path encoding:(NSStringEncoding)encoding;
 - (void)print:(id)sender;
 // aString is either an NSString or an NSAttributedString.
 - (void)printContent:(id)aString;
@@ -31,6 +31,9 @@
 #import "iTermSelectionScrollHelper.h"
 #import "iTermSetFindStringNotification.h"
 #import "iTermShellHistoryController.h"
+#import "iTermStreamingCopy.h"
+#import "iTermStreamingProgressSheet.h"
+#import "iTermStreamingTextExtractor.h"
 #import "iTermTextDrawingHelper.h"
 #import "iTermTextExtractor.h"
 #import "iTermTextViewAccessibilityHelper.h"
@@ -90,6 +93,9 @@
 
 #import <WebKit/WebKit.h>
 
+// Selections spanning at least this many lines are copied a chunk at a time.
+static const long long kMinimumLinesForStreamingCopy = 10000;
+
 @implementation iTermHighlightedRow
 
 - (instancetype)initWithAbsoluteLineNumber:(long long)row success:(BOOL)success {
@@ -159,6 +165,9 @@
     iTermScrollAccumulator *_scrollAccumulator;
 
     iTermRateLimitedUpdate *_shadowRateLimit;
+
+    // Copies a large selection to the pasteboard a chunk at a time.
+    iTermStreamingCopy *_streamingCopy;
 }
 
 
@@ -333,6 +342,8 @@
 }
 
 - (void)dealloc {
+    [_streamingCopy cancel];
+    [_streamingCopy release];
     [_mouseHandler release];
     [_selection release];
     [_oldSelection release];
@@ -1852,9 +1863,12 @@
     // are blinking should be set dirty.
     anythingIsBlinking = [self _markChangedSelectionAndBlinkDirty:redrawBlink width:WIDTH];
 
-    // Copy selection position to detect change in selected chars next call.
-    [_oldSelection release];
-    _oldSelection = [_selection copy];
+    // Copy selection position to detect change in selected chars next call. Copying is linear in
+    // the number of sub-selections, so don't do it when nothing changed.
+    if (_oldSelection.generation != _selection.generation) {
+        [_oldSelection release];
+        _oldSelection = [_selection copy];
+    }
 
     // Redraw lines with dirty characters
     int lineStart = [_dataSource numberOfLines] - [_dataSource height];
@@ -2146,6 +2160,9 @@
         }
 
         // Now mark chars whose selection status has changed as needing display.
+        if (_oldSelection.generation == _selection.generation) {
+            continue;
+        }
         const long long overflow = _dataSource.totalScrollbackOverflow;
         NSIndexSet *areSelected = [_selection selectedIndexesOnAbsoluteLine:y + overflow];
         NSIndexSet *wereSelected = [_oldSelection selectedIndexesOnAbsoluteLine:y + overflow];
@@ -2566,6 +2583,10 @@
     DLog(@"-[PTYTextView copy:] called");
     DLog(@"%@", [NSThread callStackSymbols]);
 
+    if (!_contextMenuHelper.savedSelectedText && [self selectionIsLargeEnoughToStream]) {
+        [self streamSelectionToPasteboard];
+        return;
+    }
     NSString *copyString = [self selectedText];
 
     if ([iTermAdvancedSettingsModel disallowCopyEmptyString] && copyString.length == 0) {
@@ -2582,6 +2603,69 @@
     [[PasteboardHistory sharedInstance] save:copyString];
 }
 
+- (BOOL)selectionIsLargeEnoughToStream {
+    if (![_selection hasSelection]) {
+        return NO;
+    }
+    const VT100GridAbsCoordRange range = _selection.spanningAbsRange;
+    return range.end.y - range.start.y + 1 >= kMinimumLinesForStreamingCopy;
+}
+
+// Copies the selection as plain text without building a string for all of it. The pasteboard is
+// claimed right away with a promise and the text is streamed to a temporary file. The text is too
+// big to be useful in paste history, so it isn't saved there.
+- (void)streamSelectionToPasteboard {
+    DLog(@"Streaming selection %@ to the pasteboard", _selection);
+    [_streamingCopy cancel];
+    [_streamingCopy release];
+    _streamingCopy = nil;
+    iTermStreamingTextExtractor *extractor =
+        [[[iTermStreamingTextExtractor alloc] initWithDataSource:_dataSource] autorelease];
+    extractor.includeLastNewline = [iTermPreferences boolForKey:kPreferenceKeyCopyLastNewline];
+    extractor.trimTrailingWhitespace = [iTermAdvancedSettingsModel trimWhitespaceOnCopy];
+    [extractor addRangesFromSelection:_selection];
+
+    iTermStreamingCopy *streamingCopy = [[iTermStreamingCopy alloc] initWithExtractor:extractor];
+    if (!streamingCopy) {
+        DLog(@"Beep: can't copy");
+        NSBeep();
+        return;
+    }
+    _streamingCopy = streamingCopy;
+    iTermStreamingProgressSheet *sheet =
+        [self streamingProgressSheetWithMessage:@"Copying…"
+                                      extractor:extractor
+                                  cancelHandler:^{
+                                      [streamingCopy cancel];
+                                  }];
+    streamingCopy.completion = ^(BOOL completed) {
+        [sheet close];
+        if (_streamingCopy == streamingCopy) {
+            [_streamingCopy release];
+            _streamingCopy = nil;
+        }
+        if (!completed) {
+            DLog(@"Streaming copy did not complete");
+        }
+    };
+    [streamingCopy writeToPasteboard:[NSPasteboard generalPasteboard]];
+}
+
+// Shows progress for a streaming extraction with a Cancel button, if it takes long enough to
+// notice. The caller closes the sheet when extraction finishes.
+- (iTermStreamingProgressSheet *)streamingProgressSheetWithMessage:(NSString *)message
+                                                         extractor:(iTermStreamingTextExtractor *)extractor
+                                                     cancelHandler:(void (^)(void))cancelHandler {
+    iTermStreamingProgressSheet *sheet =
+        [[[iTermStreamingProgressSheet alloc] initWithMessage:message
+                                                       window:self.window
+                                                cancelHandler:cancelHandler] autorelease];
+    extractor.progressHandler = ^(double fraction) {
+        sheet.progress = fraction;
+    };
+    return sheet;
+}
+
 - (IBAction)copyWithStyles:(id)sender {
     NSPasteboard *pboard = [NSPasteboard generalPasteboard];
 
@@ -2744,17 +2828,119 @@
                               coords:nil];
 }
 
-// Save method
-- (void)saveDocumentAs:(id)sender {
-    // We get our content of the textview or selection, if any
-    NSString *aString = [self selectedText];
-    if (!aString) {
-        aString = [self content];
+- (void)writeContentToPath:(NSString *)path encoding:(NSStringEncoding)encoding {
+    iTermStreamingTextExtractor *extractor =
+        [[[iTermStreamingTextExtractor alloc] initWithDataSource:_dataSource] autorelease];
+    // Same options as -contentWithAttributes:.
+    extractor.nullPolicy = kiTermTextExtractorNullPolicyTreatAsSpace;
+    extractor.includeLastNewline = YES;
+    extractor.encoding = encoding;
+    const long long overflow = [_dataSource totalScrollbackOverflow];
+    [extractor addRange:VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(0,
+                                                                                 overflow,
+                                                                                 [_dataSource width],
+                                                                                 overflow + [_dataSource numberOfLines] - 1),
+                                                      0, 0)
+                    eol:NO];
+    [self streamExtractor:extractor toPath:path];
+}
+
+- (void)writeSelectionOrContentToPath:(NSString *)path encoding:(NSStringEncoding)encoding {
+    if (_contextMenuHelper.savedSelectedText) {
+        NSData *data = [_contextMenuHelper.savedSelectedText dataUsingEncoding:encoding
+                                                            allowLossyConversion:YES];
+        if (![data writeToFile:path atomically:YES]) {
+            DLog(@"Beep: can't write to %@", path);
+            NSBeep();
+        }
+        return;
     }
+    if (![_selection hasSelection]) {
+        [self writeContentToPath:path encoding:encoding];
+        return;
+    }
+    iTermStreamingTextExtractor *extractor =
+        [[[iTermStreamingTextExtractor alloc] initWithDataSource:_dataSource] autorelease];
+    // Same options as -selectedText.
+    extractor.includeLastNewline = [iTermPreferences boolForKey:kPreferenceKeyCopyLastNewline];
+    extractor.trimTrailingWhitespace = [iTermAdvancedSettingsModel trimWhitespaceOnCopy];
+    extractor.encoding = encoding;
+    [extractor addRangesFromSelection:_selection];
+    [self streamExtractor:extractor toPath:path];
+}
+
+// Writes to a temporary file, which replaces the file at `path` only if extraction completes. A
+// cancel or failure leaves any existing file as it was.
+- (void)streamExtractor:(iTermStreamingTextExtractor *)extractor toPath:(NSString *)path {
+    DLog(@"Streaming text to %@", path);
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSURL *url = [NSURL fileURLWithPath:path];
+    NSError *error = nil;
+    NSURL *directory = [fileManager URLForDirectory:NSItemReplacementDirectory
+                                           inDomain:NSUserDomainMask
+                                  appropriateForURL:url
+                                             create:YES
+                                              error:&error];
+    if (!directory) {
+        DLog(@"Beep: can't get a temporary directory for %@: %@", path, error);
+        NSBeep();
+        return;
+    }
+    NSURL *temporaryURL = [directory URLByAppendingPathComponent:url.lastPathComponent];
+    NSFileHandle *fileHandle = nil;
+    if ([fileManager createFileAtPath:temporaryURL.path contents:nil attributes:nil]) {
+        fileHandle = [NSFileHandle fileHandleForWritingAtPath:temporaryURL.path];
+    }
+    if (!fileHandle) {
+        DLog(@"Beep: can't create %@", temporaryURL.path);
+        [fileManager removeItemAtURL:directory error:nil];
+        NSBeep();
+        return;
+    }
+    iTermStreamingProgressSheet *sheet =
+        [self streamingProgressSheetWithMessage:[NSString stringWithFormat:@"Saving “%@”…", url.lastPathComponent]
+                                      extractor:extractor
+                                  cancelHandler:^{
+                                      [extractor cancel];
+                                  }];
+    [extractor startWithSink:^BOOL(NSData *data) {
+        @try {
+            [fileHandle writeData:data];
+        } @catch (NSException *exception) {
+            DLog(@"Failed to write to %@: %@", temporaryURL.path, exception);
+            return NO;
+        }
+        return YES;
+    } completion:^(BOOL completed) {
+        [sheet close];
+        [fileHandle closeFile];
+        BOOL ok = completed;
+        if (ok) {
+            NSError *replaceError = nil;
+            if ([fileManager fileExistsAtPath:path]) {
+                ok = [fileManager replaceItemAtURL:url
+                                     withItemAtURL:temporaryURL
+                                    backupItemName:nil
+                                           options:0
+                                  resultingItemURL:nil
+                                             error:&replaceError];
+            } else {
+                ok = [fileManager moveItemAtURL:temporaryURL toURL:url error:&replaceError];
+            }
+            if (!ok) {
+                DLog(@"Can't move %@ to %@: %@", temporaryURL.path, path, replaceError);
+            }
+        }
+        [fileManager removeItemAtURL:directory error:nil];
+        if (!ok) {
+            DLog(@"Beep: can't write to %@", path);
+            NSBeep();
+        }
+    }];
+}
 
-    NSData *aData = [aString dataUsingEncoding:[_delegate textViewEncoding]
-                          allowLossyConversion:YES];
-
+// Save method
+- (void)saveDocumentAs:(id)sender {
     // initialize a save panel
     NSSavePanel *aSavePanel = [NSSavePanel savePanel];
     [aSavePanel setAccessoryView:nil];
@@ -2779,10 +2965,8 @@
     [NSSavePanel setDirectoryURL:[NSURL fileURLWithPath:path] onceForID:@"saveDocumentAs:" savePanel:aSavePanel];
     aSavePanel.nameFieldStringValue = nowStr;
     if ([aSavePanel runModal] == NSModalResponseOK) {
-        if (![aData writeToFile:aSavePanel.URL.path atomically:YES]) {
-            DLog(@"Beep: can't write to %@", aSavePanel.URL);
-            NSBeep();
-        }
+        // Writes the selection, if any, or else all the content.
+        [self writeSelectionOrContentToPath:aSavePanel.URL.path encoding:[_delegate textViewEncoding]];
     }
 }
 
@@ -21,6 +21,11 @@
 @property(nonatomic, assign) NSInteger bytesWritten;
 @property(nonatomic, readonly) PasteEvent *pasteEvent;
 
+// If set, chunks are sized by how much the pty can accept and are sent when it has room, rather
+// than using bytesPerCall and delayBetweenCalls. This is the case for normal-speed pastes unless
+// the user has changed their speed in user defaults.
+@property(nonatomic, readonly) BOOL isFlowControlled;
+
 - (instancetype)initWithPasteEvent:(PasteEvent *)pasteEvent;
 
 - (void)updateValues;
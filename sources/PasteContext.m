@@ -62,6 +62,19 @@
     }
 }
 
+- (BOOL)isFlowControlled {
+    if (_isUpload && [iTermAdvancedSettingsModel accelerateUploads]) {
+        return NO;
+    }
+    if (![_bytesPerCallKey isEqualToString:@"QuickPasteBytesPerCall"] ||
+        ![_delayBetweenCallsKey isEqualToString:@"QuickPasteDelayBetweenCalls"]) {
+        return NO;
+    }
+    NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+    return ([userDefaults objectForKey:_bytesPerCallKey] == nil &&
+            [userDefaults objectForKey:_delayBetweenCallsKey] == nil);
+}
+
 - (void)setBytesPerCall:(int)newBytesPerCall {
     _bytesPerCall = newBytesPerCall;
     if (_bytesPerCallKey) {
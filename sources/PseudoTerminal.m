@@ -9689,7 +9689,7 @@ static CGFloat iTermDimmingAmount(PSMTabBarControl *tabView) {
                                                          error:NULL];
                 [data writeToFile:url.path atomically:YES];
             } else {
-                [[self.currentSession.textview content] writeToFile:url.path atomically:NO encoding:NSUTF8StringEncoding error:nil];
+                [self.currentSession.textview writeContentToPath:url.path encoding:NSUTF8StringEncoding];
             }
         }
     }
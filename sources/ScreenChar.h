@@ -349,10 +349,18 @@ static inline BOOL ScreenCharHasDefaultAttributesAndColors(const screen_char_t s
 
 @end
 
-// Look up the string associated with a complex char's key.
+// Look up the string associated with a complex char's key. Safe to call from any thread without
+// locking. The result is autoreleased, so it stays valid even if the key is reused for another
+// string.
 NSString* ComplexCharToStr(int key);
 BOOL ComplexCharCodeIsSpacingCombiningMark(unichar code);
 
+// Line blocks hold references to the complex chars they contain. Once every key has been handed
+// out, keys are reused for new strings in the order they were assigned. A few of the oldest may be
+// passed over if line blocks still refer to them.
+void ScreenCharRetainComplexChars(const screen_char_t *chars, int length);
+void ScreenCharReleaseComplexChars(const screen_char_t *chars, int length);
+
 // Return a string with the contents of a screen char, which may or may not
 // be complex.
 NSString* ScreenCharToStr(const screen_char_t *const sct);
@@ -35,8 +35,10 @@
 #import "iTermAdvancedSettingsModel.h"
 #import "iTermImageInfo.h"
 #import "iTermMalloc.h"
+#import "iTermUnicodeTables.h"
 #import "NSArray+iTerm.h"
 #import "NSCharacterSet+iTerm.h"
+#include <stdatomic.h>
 
 static NSString *const kScreenCharComplexCharMapKey = @"Complex Char Map";
 static NSString *const kScreenCharSpacingCombiningMarksKey = @"Spacing Combining Marks";
@@ -47,18 +49,59 @@ static NSString *const kScreenCharHasWrappedKey = @"Has Wrapped";
 
 static NSInteger gScreenCharGeneration;
 
-// Maps codes to strings
-static NSMutableDictionary* complexCharMap;
-static NSMutableSet<NSNumber *> *spacingCombiningMarkCodeNumbers;
-// Maps strings to codes.
-static NSMutableDictionary* inverseComplexCharMap;
+// Complex chars are interned in a table that can be read from any thread without taking a lock.
+// Writers hold ComplexCharLock(). Keys are stored in a unichar so they can't grow past
+// kComplexCharKeyLimit.
+enum {
+    kComplexCharKeyLimit = 0xf000
+};
+
+typedef struct iTermComplexCharEntry {
+    NSString *string;  // retained
+    NSUInteger hash;
+    BOOL isSpacingCombiningMark;
+    struct iTermComplexCharEntry *nextRetired;
+} iTermComplexCharEntry;
+
+// Maps codes to entries. Entries are immutable once published. When a code is reused its old entry
+// is retired, and freed once no reader can still be looking at it.
+static _Atomic(iTermComplexCharEntry *) gComplexCharEntries[kComplexCharKeyLimit];
+
+// Number of threads between ComplexCharBeginRead() and ComplexCharEndRead(). Readers only look at
+// an entry in between, and retain anything they keep. An entry retired while this is zero can't be
+// seen by any reader, so it's safe to free.
+static _Atomic(uint32_t) gComplexCharActiveReaders;
+
+// Must hold the lock to access. Entries replaced while readers were active, waiting to be freed.
+static iTermComplexCharEntry *gComplexCharRetiredEntries;
+static BOOL gComplexCharRetiredEntriesScheduled;
+
+// Maps strings to codes with open addressing and linear probing. A slot holds a code, or one of the
+// two sentinels below. There are more than twice as many slots as codes.
+enum {
+    kComplexCharSlotCount = 1 << 17
+};
+static const uint16_t kComplexCharEmptySlot = 0;
+static const uint16_t kComplexCharDeletedSlot = 0xffff;
+static _Atomic(uint16_t) gComplexCharSlots[kComplexCharSlotCount];
+static NSUInteger gComplexCharDeletedSlotCount;
+
+// Number of references to each code held by line blocks.
+static _Atomic(uint32_t) gComplexCharReferenceCounts[kComplexCharKeyLimit];
+
+// When reusing codes, at most this many of the oldest are passed over because line blocks refer to
+// them. That bounds the work done while holding the lock. It also keeps reuse close to
+// oldest-first, which matters because references from the grid, the alternate screen, and instant
+// replay aren't counted. Those hold recently assigned codes.
+static const int kComplexCharMaximumSkippedKeys = 64;
+
 // Image info. Maps a NSNumber with the image's code to an ImageInfo object.
 static NSMutableDictionary<NSNumber *, iTermImageInfo *> *gImages;
 static NSMutableDictionary* gEncodableImageMap;
-// Next available code.
+// Next code to consider assigning. Also used for images.
 static int ccmNextKey = 1;
-// If ccmNextKey has wrapped then this is set to true and we have to delete old
-// strings before creating a new one with a recycled code.
+// Set once ccmNextKey has wrapped. After that, codes are reused oldest first, passing over a few
+// that line blocks still refer to.
 static BOOL hasWrapped = NO;
 
 typedef NS_ENUM(int, iTermTriState) {
@@ -169,12 +212,215 @@ iTermTriState iTermTriStateFromBool(BOOL b) {
 
 @end
 
-static void CreateComplexCharMapIfNeeded() {
-    if (!complexCharMap) {
-        complexCharMap = [[NSMutableDictionary alloc] initWithCapacity:1000];
-        spacingCombiningMarkCodeNumbers = [[NSMutableSet alloc] initWithCapacity:1000];
-        inverseComplexCharMap = [[NSMutableDictionary alloc] initWithCapacity:1000];
-        gScreenCharGeneration++;
+static NSObject *ComplexCharLock(void) {
+    static NSObject *lock;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        lock = [[NSObject alloc] init];
+    });
+    return lock;
+}
+
+static BOOL ComplexCharKeyIsReserved(int k) {
+    return k >= iTermBoxDrawingCodeMin && k <= iTermBoxDrawingCodeMax;
+}
+
+// Callers that don't hold the lock must be between ComplexCharBeginRead() and ComplexCharEndRead().
+static iTermComplexCharEntry *ComplexCharEntry(int key) {
+    if (key <= 0 || key >= kComplexCharKeyLimit) {
+        return NULL;
+    }
+    // Sequentially consistent so it can't be ordered before the reader count increments.
+    return atomic_load_explicit(&gComplexCharEntries[key], memory_order_seq_cst);
+}
+
+static void ComplexCharBeginRead(void) {
+    atomic_fetch_add_explicit(&gComplexCharActiveReaders, 1, memory_order_seq_cst);
+}
+
+static void ComplexCharEndRead(void) {
+    atomic_fetch_sub_explicit(&gComplexCharActiveReaders, 1, memory_order_release);
+}
+
+// Returns the code for `str` or -1. This doesn't lock, so a concurrent writer can cause a false
+// miss. Writers call it while holding the lock so their results are exact.
+static int ComplexCharFindKey(NSString *str, NSUInteger hash) {
+    int result = -1;
+    ComplexCharBeginRead();
+    NSUInteger i = hash & (kComplexCharSlotCount - 1);
+    for (NSUInteger probes = 0; probes < kComplexCharSlotCount; probes++) {
+        const uint16_t key = atomic_load_explicit(&gComplexCharSlots[i], memory_order_acquire);
+        if (key == kComplexCharEmptySlot) {
+            break;
+        }
+        if (key != kComplexCharDeletedSlot) {
+            iTermComplexCharEntry *entry = ComplexCharEntry(key);
+            if (entry && entry->hash == hash && [entry->string isEqualToString:str]) {
+                result = key;
+                break;
+            }
+        }
+        i = (i + 1) & (kComplexCharSlotCount - 1);
+    }
+    ComplexCharEndRead();
+    return result;
+}
+
+// Must hold the lock.
+static void ComplexCharInsertSlot(int key, NSUInteger hash) {
+    NSUInteger i = hash & (kComplexCharSlotCount - 1);
+    while (YES) {
+        const uint16_t existing = atomic_load_explicit(&gComplexCharSlots[i], memory_order_relaxed);
+        if (existing == kComplexCharEmptySlot || existing == kComplexCharDeletedSlot) {
+            if (existing == kComplexCharDeletedSlot) {
+                gComplexCharDeletedSlotCount--;
+            }
+            atomic_store_explicit(&gComplexCharSlots[i], (uint16_t)key, memory_order_release);
+            return;
+        }
+        i = (i + 1) & (kComplexCharSlotCount - 1);
+    }
+}
+
+// Must hold the lock. Readers that race with this may miss entries, which only sends them to the
+// locked path.
+static void ComplexCharRebuildSlots(void) {
+    DLog(@"Rebuilding complex char slots with %@ deleted", @(gComplexCharDeletedSlotCount));
+    for (NSUInteger i = 0; i < kComplexCharSlotCount; i++) {
+        atomic_store_explicit(&gComplexCharSlots[i], kComplexCharEmptySlot, memory_order_relaxed);
+    }
+    gComplexCharDeletedSlotCount = 0;
+    for (int key = 1; key < kComplexCharKeyLimit; key++) {
+        iTermComplexCharEntry *entry = ComplexCharEntry(key);
+        if (entry) {
+            ComplexCharInsertSlot(key, entry->hash);
+        }
+    }
+}
+
+// Must hold the lock.
+static void ComplexCharRemoveSlot(int key, NSUInteger hash) {
+    NSUInteger i = hash & (kComplexCharSlotCount - 1);
+    while (YES) {
+        const uint16_t existing = atomic_load_explicit(&gComplexCharSlots[i], memory_order_relaxed);
+        if (existing == kComplexCharEmptySlot) {
+            return;
+        }
+        if (existing == key) {
+            atomic_store_explicit(&gComplexCharSlots[i], kComplexCharDeletedSlot, memory_order_release);
+            gComplexCharDeletedSlotCount++;
+            return;
+        }
+        i = (i + 1) & (kComplexCharSlotCount - 1);
+    }
+}
+
+// Must hold the lock. Frees the retired entries if no reader is active. Readers are only active
+// for an instant, so if one is, this tries again shortly.
+static void ComplexCharFreeRetiredEntries(void) {
+    if (!gComplexCharRetiredEntries) {
+        return;
+    }
+    // The entries were unpublished before this load, so a reader that starts after it can't find
+    // them, and one that ended before it has retained whatever it kept.
+    if (atomic_load_explicit(&gComplexCharActiveReaders, memory_order_seq_cst) != 0) {
+        if (!gComplexCharRetiredEntriesScheduled) {
+            gComplexCharRetiredEntriesScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.01 * NSEC_PER_SEC)),
+                           dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+                               @synchronized (ComplexCharLock()) {
+                                   gComplexCharRetiredEntriesScheduled = NO;
+                                   ComplexCharFreeRetiredEntries();
+                               }
+                           });
+        }
+        return;
+    }
+    while (gComplexCharRetiredEntries) {
+        iTermComplexCharEntry *entry = gComplexCharRetiredEntries;
+        gComplexCharRetiredEntries = entry->nextRetired;
+        [entry->string release];
+        free(entry);
+    }
+}
+
+// Must hold the lock. `entry` must no longer be published.
+static void ComplexCharRetireEntry(iTermComplexCharEntry *entry) {
+    entry->nextRetired = gComplexCharRetiredEntries;
+    gComplexCharRetiredEntries = entry;
+    ComplexCharFreeRetiredEntries();
+}
+
+// Must hold the lock. Publishes `str` under `key`, replacing whatever was there.
+static void ComplexCharSetEntry(int key, NSString *str, BOOL isSpacingCombiningMark) {
+    iTermComplexCharEntry *entry = iTermMalloc(sizeof(*entry));
+    entry->string = [str copy];
+    entry->hash = [entry->string hash];
+    entry->isSpacingCombiningMark = isSpacingCombiningMark;
+    entry->nextRetired = NULL;
+
+    iTermComplexCharEntry *old = ComplexCharEntry(key);
+    if (old) {
+        ComplexCharRemoveSlot(key, old->hash);
+    }
+    atomic_store_explicit(&gComplexCharEntries[key], entry, memory_order_seq_cst);
+    if (old) {
+        ComplexCharRetireEntry(old);
+    }
+    if (gComplexCharDeletedSlotCount > kComplexCharSlotCount / 4) {
+        ComplexCharRebuildSlots();
+    } else {
+        ComplexCharInsertSlot(key, entry->hash);
+    }
+    gScreenCharGeneration++;
+}
+
+// Must hold the lock. Advances ccmNextKey, skipping reserved keys.
+static int ComplexCharNextKey(void) {
+    int key;
+    do {
+        key = ccmNextKey++;
+        if (ccmNextKey >= kComplexCharKeyLimit) {
+            ccmNextKey = 1;
+            hasWrapped = YES;
+        }
+    } while (ComplexCharKeyIsReserved(key));
+    return key;
+}
+
+// Must hold the lock. Takes the oldest key that is unused or that no line block refers to, looking
+// at no more than kComplexCharMaximumSkippedKeys of them. If they are all referenced, takes the
+// oldest.
+static int ComplexCharAllocateKey(void) {
+    int candidate = -1;
+    for (int i = 0; i < kComplexCharMaximumSkippedKeys; i++) {
+        const int key = ComplexCharNextKey();
+        if (candidate < 0) {
+            candidate = key;
+        }
+        if (!ComplexCharEntry(key) ||
+            atomic_load_explicit(&gComplexCharReferenceCounts[key], memory_order_relaxed) == 0) {
+            return key;
+        }
+    }
+    DLog(@"The oldest %@ complex char keys are all referenced. Reusing %@",
+         @(kComplexCharMaximumSkippedKeys), @(candidate));
+    return candidate;
+}
+
+void ScreenCharRetainComplexChars(const screen_char_t *chars, int length) {
+    for (int i = 0; i < length; i++) {
+        if (chars[i].complexChar && !chars[i].image && chars[i].code < kComplexCharKeyLimit) {
+            atomic_fetch_add_explicit(&gComplexCharReferenceCounts[chars[i].code], 1, memory_order_relaxed);
+        }
+    }
+}
+
+void ScreenCharReleaseComplexChars(const screen_char_t *chars, int length) {
+    for (int i = 0; i < length; i++) {
+        if (chars[i].complexChar && !chars[i].image && chars[i].code < kComplexCharKeyLimit) {
+            atomic_fetch_sub_explicit(&gComplexCharReferenceCounts[chars[i].code], 1, memory_order_relaxed);
+        }
     }
 }
 
@@ -183,12 +429,19 @@ NSString *ComplexCharToStr(int key) {
         return ReplacementString();
     }
 
-    CreateComplexCharMapIfNeeded();
-    return [complexCharMap objectForKey:[NSNumber numberWithInt:key]];
+    ComplexCharBeginRead();
+    iTermComplexCharEntry *entry = ComplexCharEntry(key);
+    NSString *string = entry ? [entry->string retain] : nil;
+    ComplexCharEndRead();
+    return [string autorelease];
 }
 
 BOOL ComplexCharCodeIsSpacingCombiningMark(unichar code) {
-    return [spacingCombiningMarkCodeNumbers containsObject:@(code)];
+    ComplexCharBeginRead();
+    iTermComplexCharEntry *entry = ComplexCharEntry(code);
+    const BOOL result = entry && entry->isSpacingCombiningMark;
+    ComplexCharEndRead();
+    return result;
 }
 
 NSString *ScreenCharToStr(const screen_char_t *const sct) {
@@ -237,10 +490,6 @@ UTF32Char CharToLongChar(unichar code, BOOL isComplex)
     }
 }
 
-static BOOL ComplexCharKeyIsReserved(int k) {
-    return k >= iTermBoxDrawingCodeMin && k <= iTermBoxDrawingCodeMax;
-}
-
 static void AllocateImageMapsIfNeeded(void) {
     if (!gImages) {
         gImages = [[NSMutableDictionary alloc] init];
@@ -256,9 +505,9 @@ screen_char_t ImageCharForNewImage(NSString *name,
                                    NSEdgeInsets inset) {
     AllocateImageMapsIfNeeded();
     int newKey;
-    do {
-        newKey = ccmNextKey++;
-    } while (ComplexCharKeyIsReserved(newKey));
+    @synchronized (ComplexCharLock()) {
+        newKey = ComplexCharNextKey();
+    }
 
     screen_char_t c;
     memset(&c, 0, sizeof(c));
@@ -312,49 +561,36 @@ VT100GridCoord GetPositionOfImageInChar(screen_char_t c) {
 
 int GetOrSetComplexChar(NSString *str,
                         iTermTriState isSpacingCombiningMark) {
-    CreateComplexCharMapIfNeeded();
-    NSNumber *number = inverseComplexCharMap[str];
-    if (number) {
-        return [number intValue];
+    const NSUInteger hash = [str hash];
+    int key = ComplexCharFindKey(str, hash);
+    if (key >= 0) {
+        return key;
     }
 
-    gScreenCharGeneration++;
-    int newKey;
-    do {
-        newKey = ccmNextKey++;
-    } while (ComplexCharKeyIsReserved(newKey));
-
-    number = @(newKey);
-    if (hasWrapped) {
-        NSString* oldStr = complexCharMap[number];
-        if (oldStr) {
-            [inverseComplexCharMap removeObjectForKey:oldStr];
-            [spacingCombiningMarkCodeNumbers removeObject:number];
-        }
-    }
+    BOOL scm = NO;
     switch (isSpacingCombiningMark) {
         case iTermTriStateTrue:
-            [spacingCombiningMarkCodeNumbers addObject:number];
+            scm = YES;
             break;
         case iTermTriStateFalse:
             break;
         case iTermTriStateOther: {
             NSCharacterSet *scmSet = [NSCharacterSet spacingCombiningMarksForUnicodeVersion:12];
-            if ([str rangeOfCharacterFromSet:scmSet].location != NSNotFound) {
-                [spacingCombiningMarkCodeNumbers addObject:number];
-            }
+            scm = ([str rangeOfCharacterFromSet:scmSet].location != NSNotFound);
+        }
+    }
+    @synchronized (ComplexCharLock()) {
+        key = ComplexCharFindKey(str, hash);
+        if (key >= 0) {
+            return key;
         }
+        key = ComplexCharAllocateKey();
+        ComplexCharSetEntry(key, str, scm);
     }
-    complexCharMap[number] = str;
-    inverseComplexCharMap[str] = number;
     if ([iTermAdvancedSettingsModel restoreWindowContents]) {
         [NSApp invalidateRestorableState];
     }
-    if (ccmNextKey == 0xf000) {
-        ccmNextKey = 1;
-        hasWrapped = YES;
-    }
-    return newKey;
+    return key;
 }
 
 int AppendToComplexChar(int key, unichar codePoint) {
@@ -362,7 +598,7 @@ int AppendToComplexChar(int key, unichar codePoint) {
         return UNICODE_REPLACEMENT_CHAR;
     }
 
-    NSString* str = [complexCharMap objectForKey:[NSNumber numberWithInt:key]];
+    NSString* str = ComplexCharToStr(key);
     if ([str length] == kMaxParts) {
         NSLog(@"Warning: char <<%@>> with key %d reached max length %d", str,
               key, kMaxParts);
@@ -576,8 +812,16 @@ NSString *DebugStringForScreenChar(screen_char_t c) {
             @(c.underline), @(c.strikethrough), @(c.underlineStyle), @(c.unused)];
 }
 
+NS_INLINE BOOL IsOwnCluster(unichar c) {
+    return (iTermUnicodePropertiesOfCharacter(c) & iTermUnicodePropertyOwnCluster) != 0;
+}
+
 // Convert a string into an array of screen characters, dealing with surrogate
 // pairs, combining marks, nonspacing marks, and double-width characters.
+//
+// Runs of characters that are each their own grapheme cluster are converted directly. Everything
+// else goes through -enumerateComposedCharacters:, a region at a time. A region ends between two
+// characters that are both their own clusters, since no cluster can span that boundary.
 void StringToScreenChars(NSString *s,
                          screen_char_t *buf,
                          screen_char_t fg,
@@ -590,99 +834,150 @@ void StringToScreenChars(NSString *s,
                          NSInteger unicodeVersion) {
     __block NSInteger j = 0;
     __block BOOL foundCursor = NO;
-    NSCharacterSet *ignorableCharacters = [NSCharacterSet ignorableCharactersForUnicodeVersion:unicodeVersion];
-    NSCharacterSet *spacingCombiningMarks = [NSCharacterSet spacingCombiningMarksForUnicodeVersion:12];
-
-    [s enumerateComposedCharacters:^(NSRange range,
-                                     unichar baseBmpChar,
-                                     NSString *composedOrNonBmpChar,
-                                     BOOL *stop) {
-        if (cursorIndex && !foundCursor && NSLocationInRange(*cursorIndex, range)) {
-            foundCursor = YES;
-            *cursorIndex = j;
+    const NSUInteger length = s.length;
+
+    unichar stackBuffer[256];
+    unichar *heapBuffer = NULL;
+    const unichar *chars = CFStringGetCharactersPtr((CFStringRef)s);
+    if (!chars) {
+        unichar *temp = stackBuffer;
+        if (length > sizeof(stackBuffer) / sizeof(*stackBuffer)) {
+            heapBuffer = iTermMalloc(length * sizeof(unichar));
+            temp = heapBuffer;
         }
+        [s getCharacters:temp range:NSMakeRange(0, length)];
+        chars = temp;
+    }
 
-        BOOL isDoubleWidth = NO;
-        BOOL spacingCombiningMark = NO;
-        InitializeScreenChar(buf + j, fg, bg);
-
-        // Set the code and the complex flag. Also return early if no cell should be used by this
-        // grapheme cluster. Set the isDoubleWidth flag.
-        if (!composedOrNonBmpChar) {
-            if ([ignorableCharacters characterIsMember:baseBmpChar]) {
-                return;
-            } else if ([spacingCombiningMarks characterIsMember:baseBmpChar]) {
-                composedOrNonBmpChar = [NSString stringWithLongCharacter:baseBmpChar];
-                baseBmpChar = 0;
-                spacingCombiningMark = YES;
-            } else if (baseBmpChar >= ITERM2_PRIVATE_BEGIN && baseBmpChar <= ITERM2_PRIVATE_END) {
-                // Convert private range characters into the replacement character.
-                baseBmpChar = UNICODE_REPLACEMENT_CHAR;
-            } else if (IsLowSurrogate(baseBmpChar)) {
-                // Low surrogate without high surrogate.
-                baseBmpChar = UNICODE_REPLACEMENT_CHAR;
-            } else if (IsHighSurrogate(baseBmpChar) && NSMaxRange(range) != s.length) {
-                // High surrogate not followed by low surrogate.
-                baseBmpChar = UNICODE_REPLACEMENT_CHAR;
+    NSUInteger i = 0;
+    while (i < length) {
+        // Fast path: a character that can't combine with its neighbors.
+        while (i < length && IsOwnCluster(chars[i]) && (i + 1 == length || IsOwnCluster(chars[i + 1]))) {
+            if (cursorIndex && !foundCursor && (NSUInteger)*cursorIndex == i) {
+                foundCursor = YES;
+                *cursorIndex = j;
             }
-            if (!composedOrNonBmpChar) {
-                buf[j].code = baseBmpChar;
-                buf[j].complexChar = NO;
-
-                isDoubleWidth = [NSString isDoubleWidthCharacter:baseBmpChar
-                                          ambiguousIsDoubleWidth:ambiguousIsDoubleWidth
-                                                  unicodeVersion:unicodeVersion];
+            InitializeScreenChar(buf + j, fg, bg);
+            buf[j].code = chars[i];
+            if (iTermUnicodeIsDoubleWidth(iTermUnicodePropertiesOfCharacter(chars[i]),
+                                          ambiguousIsDoubleWidth,
+                                          unicodeVersion)) {
+                j++;
+                buf[j] = buf[j - 1];
+                buf[j].code = DWC_RIGHT;
+                if (foundDwc) {
+                    *foundDwc = YES;
+                }
             }
+            j++;
+            i++;
         }
-        if (composedOrNonBmpChar) {
-            const NSUInteger composedLength = composedOrNonBmpChar.length;
-            // Ensure the string is not longer than what we support.
-            if (composedLength > kMaxParts) {
-                composedOrNonBmpChar = [composedOrNonBmpChar substringToIndex:kMaxParts];
-
-                // Ensure a high surrogate isn't left dangling at the end.
-                if (CFStringIsSurrogateHighCharacter([composedOrNonBmpChar characterAtIndex:kMaxParts - 1])) {
-                    composedOrNonBmpChar = [composedOrNonBmpChar substringToIndex:kMaxParts - 1];
-                }
+        if (i == length) {
+            break;
+        }
+
+        NSUInteger end = i + 1;
+        while (end < length && !(IsOwnCluster(chars[end - 1]) && IsOwnCluster(chars[end]))) {
+            end++;
+        }
+        const NSUInteger offset = i;
+        NSString *region = (offset == 0 && end == length) ? s : [s substringWithRange:NSMakeRange(offset, end - offset)];
+        [region enumerateComposedCharacters:^(NSRange range,
+                                              unichar baseBmpChar,
+                                              NSString *composedOrNonBmpChar,
+                                              BOOL *stop) {
+            range.location += offset;
+            if (cursorIndex && !foundCursor && NSLocationInRange(*cursorIndex, range)) {
+                foundCursor = YES;
+                *cursorIndex = j;
             }
-            SetComplexCharInScreenChar(buf + j, composedOrNonBmpChar, normalization, spacingCombiningMark);
-            NSInteger next = 1;
-            UTF32Char baseChar = [composedOrNonBmpChar characterAtIndex:0];
-            if (IsHighSurrogate(baseChar) && composedLength > 1) {
-                baseChar = DecodeSurrogatePair(baseChar, [composedOrNonBmpChar characterAtIndex:1]);
-                next += 1;
-                if (composedLength == 2 && [ignorableCharacters longCharacterIsMember:baseChar]) {
+
+            BOOL isDoubleWidth = NO;
+            BOOL spacingCombiningMark = NO;
+            InitializeScreenChar(buf + j, fg, bg);
+
+            // Set the code and the complex flag. Also return early if no cell should be used by this
+            // grapheme cluster. Set the isDoubleWidth flag.
+            if (!composedOrNonBmpChar) {
+                const iTermUnicodeProperties properties = iTermUnicodePropertiesOfCharacter(baseBmpChar);
+                if (properties & iTermUnicodePropertyIgnorable) {
                     return;
+                } else if (properties & iTermUnicodePropertySpacingCombiningMark) {
+                    composedOrNonBmpChar = [NSString stringWithLongCharacter:baseBmpChar];
+                    baseBmpChar = 0;
+                    spacingCombiningMark = YES;
+                } else if (baseBmpChar >= ITERM2_PRIVATE_BEGIN && baseBmpChar <= ITERM2_PRIVATE_END) {
+                    // Convert private range characters into the replacement character.
+                    baseBmpChar = UNICODE_REPLACEMENT_CHAR;
+                } else if (IsLowSurrogate(baseBmpChar)) {
+                    // Low surrogate without high surrogate.
+                    baseBmpChar = UNICODE_REPLACEMENT_CHAR;
+                } else if (IsHighSurrogate(baseBmpChar) && NSMaxRange(range) != length) {
+                    // High surrogate not followed by low surrogate.
+                    baseBmpChar = UNICODE_REPLACEMENT_CHAR;
+                }
+                if (!composedOrNonBmpChar) {
+                    buf[j].code = baseBmpChar;
+                    buf[j].complexChar = NO;
+
+                    isDoubleWidth = iTermUnicodeIsDoubleWidth(iTermUnicodePropertiesOfCharacter(baseBmpChar),
+                                                              ambiguousIsDoubleWidth,
+                                                              unicodeVersion);
                 }
             }
-            isDoubleWidth = [NSString isDoubleWidthCharacter:baseChar
-                                      ambiguousIsDoubleWidth:ambiguousIsDoubleWidth
-                                              unicodeVersion:unicodeVersion];
-            if (!isDoubleWidth && composedLength > next) {
-                const unichar peek = [composedOrNonBmpChar characterAtIndex:next];
-                if (peek == 0xfe0f) {
-                    // VS16
-                    if ([[NSCharacterSet emojiAcceptingVS16] characterIsMember:baseChar] &&
-                        [iTermAdvancedSettingsModel vs16Supported]) {
-                        isDoubleWidth = YES;
+            if (composedOrNonBmpChar) {
+                const NSUInteger composedLength = composedOrNonBmpChar.length;
+                // Ensure the string is not longer than what we support.
+                if (composedLength > kMaxParts) {
+                    composedOrNonBmpChar = [composedOrNonBmpChar substringToIndex:kMaxParts];
+
+                    // Ensure a high surrogate isn't left dangling at the end.
+                    if (CFStringIsSurrogateHighCharacter([composedOrNonBmpChar characterAtIndex:kMaxParts - 1])) {
+                        composedOrNonBmpChar = [composedOrNonBmpChar substringToIndex:kMaxParts - 1];
+                    }
+                }
+                SetComplexCharInScreenChar(buf + j, composedOrNonBmpChar, normalization, spacingCombiningMark);
+                NSInteger next = 1;
+                UTF32Char baseChar = [composedOrNonBmpChar characterAtIndex:0];
+                if (IsHighSurrogate(baseChar) && composedLength > 1) {
+                    baseChar = DecodeSurrogatePair(baseChar, [composedOrNonBmpChar characterAtIndex:1]);
+                    next += 1;
+                    if (composedLength == 2 &&
+                        (iTermUnicodePropertiesOfCharacter(baseChar) & iTermUnicodePropertyIgnorable)) {
+                        return;
+                    }
+                }
+                isDoubleWidth = iTermUnicodeIsDoubleWidth(iTermUnicodePropertiesOfCharacter(baseChar),
+                                                          ambiguousIsDoubleWidth,
+                                                          unicodeVersion);
+                if (!isDoubleWidth && composedLength > next) {
+                    const unichar peek = [composedOrNonBmpChar characterAtIndex:next];
+                    if (peek == 0xfe0f) {
+                        // VS16
+                        if ([[NSCharacterSet emojiAcceptingVS16] characterIsMember:baseChar] &&
+                            [iTermAdvancedSettingsModel vs16Supported]) {
+                            isDoubleWidth = YES;
+                        }
                     }
                 }
             }
-        }
 
-        // Append a DWC_RIGHT if the base character is double-width.
-        if (isDoubleWidth) {
-            j++;
-            buf[j] = buf[j - 1];
-            buf[j].code = DWC_RIGHT;
-            buf[j].complexChar = NO;
-            if (foundDwc) {
-                *foundDwc = YES;
+            // Append a DWC_RIGHT if the base character is double-width.
+            if (isDoubleWidth) {
+                j++;
+                buf[j] = buf[j - 1];
+                buf[j].code = DWC_RIGHT;
+                buf[j].complexChar = NO;
+                if (foundDwc) {
+                    *foundDwc = YES;
+                }
             }
-        }
 
-        j++;
-    }];
+            j++;
+        }];
+        i = end;
+    }
+    free(heapBuffer);
     *len = j;
     if (cursorIndex && !foundCursor && *cursorIndex >= s.length) {
         // We were asked for the position of the cursor to the right
@@ -734,12 +1029,33 @@ NSInteger ScreenCharGeneration(void) {
 }
 
 NSDictionary *ScreenCharEncodedRestorableState(void) {
-    return @{ kScreenCharComplexCharMapKey: complexCharMap ?: @{},
-              kScreenCharSpacingCombiningMarksKey: spacingCombiningMarkCodeNumbers.allObjects ?: @[],
-              kScreenCharInverseComplexCharMapKey: inverseComplexCharMap ?: @{},
+    NSMutableDictionary *complexCharMap = [NSMutableDictionary dictionary];
+    NSMutableDictionary *inverseComplexCharMap = [NSMutableDictionary dictionary];
+    NSMutableArray<NSNumber *> *spacingCombiningMarks = [NSMutableArray array];
+    int nextKey;
+    BOOL wrapped;
+    @synchronized (ComplexCharLock()) {
+        for (int key = 1; key < kComplexCharKeyLimit; key++) {
+            iTermComplexCharEntry *entry = ComplexCharEntry(key);
+            if (!entry) {
+                continue;
+            }
+            complexCharMap[@(key)] = entry->string;
+            // Kept for older versions, which need both maps.
+            inverseComplexCharMap[entry->string] = @(key);
+            if (entry->isSpacingCombiningMark) {
+                [spacingCombiningMarks addObject:@(key)];
+            }
+        }
+        nextKey = ccmNextKey;
+        wrapped = hasWrapped;
+    }
+    return @{ kScreenCharComplexCharMapKey: complexCharMap,
+              kScreenCharSpacingCombiningMarksKey: spacingCombiningMarks,
+              kScreenCharInverseComplexCharMapKey: inverseComplexCharMap,
               kScreenCharImageMapKey: gEncodableImageMap ?: @{},
-              kScreenCharCCMNextKeyKey: @(ccmNextKey),
-              kScreenCharHasWrappedKey: @(hasWrapped) };
+              kScreenCharCCMNextKeyKey: @(nextKey),
+              kScreenCharHasWrappedKey: @(wrapped) };
 }
 
 void ScreenCharGarbageCollectImages(void) {
@@ -757,22 +1073,20 @@ void ScreenCharClearProvisionalFlagForImageWithCode(int code) {
 
 void ScreenCharDecodeRestorableState(NSDictionary *state) {
     NSDictionary *stateComplexCharMap = state[kScreenCharComplexCharMapKey];
-    CreateComplexCharMapIfNeeded();
-    for (id key in stateComplexCharMap) {
-        if (!complexCharMap[key]) {
-            complexCharMap[key] = stateComplexCharMap[key];
-        }
-    }
-    NSArray<NSString *> *spacingCombiningMarksArray = state[kScreenCharSpacingCombiningMarksKey];
-    for (NSNumber *number in spacingCombiningMarksArray) {
-        [spacingCombiningMarkCodeNumbers addObject:number];
-    }
-
-    NSDictionary *stateInverseMap = state[kScreenCharInverseComplexCharMapKey];
-    for (id key in stateInverseMap) {
-        if (!inverseComplexCharMap[key]) {
-            inverseComplexCharMap[key] = stateInverseMap[key];
+    NSSet<NSNumber *> *spacingCombiningMarks = [NSSet setWithArray:state[kScreenCharSpacingCombiningMarksKey] ?: @[]];
+    // The inverse map is derived from the complex char map so there's no need to read it.
+    @synchronized (ComplexCharLock()) {
+        for (NSNumber *number in stateComplexCharMap) {
+            const int key = number.intValue;
+            NSString *string = stateComplexCharMap[number];
+            if (key <= 0 || key >= kComplexCharKeyLimit || ComplexCharEntry(key) ||
+                ![string isKindOfClass:[NSString class]]) {
+                continue;
+            }
+            ComplexCharSetEntry(key, string, [spacingCombiningMarks containsObject:number]);
         }
+        ccmNextKey = MAX(1, MIN(kComplexCharKeyLimit - 1, [state[kScreenCharCCMNextKeyKey] intValue]));
+        hasWrapped = [state[kScreenCharHasWrappedKey] boolValue];
     }
     NSDictionary *imageMap = state[kScreenCharImageMapKey];
     AllocateImageMapsIfNeeded();
@@ -785,8 +1099,6 @@ void ScreenCharDecodeRestorableState(NSDictionary *state) {
             DLog(@"Decoded restorable state for image %@: %@", key, info);
         }
     }
-    ccmNextKey = [state[kScreenCharCCMNextKeyKey] intValue];
-    hasWrapped = [state[kScreenCharHasWrappedKey] boolValue];
 }
 
 static NSString *ScreenCharColorDescription(unsigned int red,
@@ -27,6 +27,9 @@ extern NSString *const kCoprocessStatusChangeNotification;
 // Called on any thread
 - (void)brokenPipe;
 - (void)writeTask:(NSData *)data;
+// Processes output that was read from the fd by someone else before the task was registered.
+// Called on a background thread.
+- (void)replayBufferedOutput:(NSData *)data;
 
 @end
 
@@ -10,9 +10,9 @@
 #import "DVRIndexEntry.h"
 #import "ScreenChar.h"
 #import "VT100GridTypes.h"
+#import "VT100LineInfo.h"
 
 @class LineBuffer;
-@class VT100LineInfo;
 @class VT100Terminal;
 @protocol iTermEncoderAdapter;
 
@@ -265,7 +265,9 @@
 // TODO: write a test for this
 - (void)insertChar:(screen_char_t)c at:(VT100GridCoord)pos times:(int)num;
 
-// Returns an array of NSData for lines in order (corresponding with lines on screen).
+// Returns an array of NSData for lines in order (corresponding with lines on screen). The data
+// point into the grid's storage without copying, so they are only valid until the grid is next
+// modified or resized.
 - (NSArray *)orderedLines;
 
 // Restore saved state excluding screen contents.
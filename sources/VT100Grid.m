@@ -10,6 +10,7 @@
 
 #import "DebugLogging.h"
 #import "iTermEncoderAdapter.h"
+#import "iTermMalloc.h"
 #import "LineBuffer.h"
 #import "NSArray+iTerm.h"
 #import "NSDictionary+iTerm.h"
@@ -24,15 +25,13 @@ static NSString *const kGridScrollRegionColumnsKey = @"Scroll Region Columns";
 static NSString *const kGridUseScrollRegionColumnsKey = @"Use Scroll Region Columns";
 static NSString *const kGridSizeKey = @"Size";
 
-@interface VT100Grid ()
-@property(nonatomic, readonly) NSArray *lines;  // Warning: not in order found on screen!
-@end
-
 @implementation VT100Grid {
     VT100GridSize size_;
-    int screenTop_;  // Index into lines_ and dirty_ of first line visible in the grid.
-    NSMutableArray<NSMutableData *> *lines_;  // Array of NSMutableData. Each data has size_.width+1 screen_char_t's.
-    NSMutableArray<VT100LineInfo *> *lineInfos_;  // Array of VT100LineInfo.
+    int screenTop_;  // Row in _slab and _lineInfos of the first line visible in the grid.
+    // size_.height rows of size_.width+1 screen_char_t's each in one allocation, used as a ring
+    // that starts at screenTop_.
+    screen_char_t *_slab;
+    VT100LineInfo *_lineInfos;  // size_.height entries, parallel to the rows of _slab.
     id<VT100GridDelegate> delegate_;
     VT100GridCoord cursor_;
     VT100GridRange scrollRegionRows_;
@@ -49,7 +48,6 @@ static NSString *const kGridSizeKey = @"Size";
 @synthesize scrollRegionCols = scrollRegionCols_;
 @synthesize useScrollRegionCols = useScrollRegionCols_;
 @synthesize allDirty = allDirty_;
-@synthesize lines = lines_;
 @synthesize savedDefaultChar = savedDefaultChar_;
 @synthesize cursor = cursor_;
 @synthesize delegate = delegate_;
@@ -80,16 +78,27 @@ static NSString *const kGridSizeKey = @"Size";
         }
         [self setSize:[NSDictionary castFrom:dictionary[@"size"]].gridSize];
         assert(size_.width > 0 && size_.height > 0);
-        lines_ = [[NSArray castFrom:dictionary[@"lines"]] mutableCopy];
+        const size_t lineLength = (size_.width + 1) * sizeof(screen_char_t);
+        [[NSArray castFrom:dictionary[@"lines"]] enumerateObjectsUsingBlock:^(id obj,
+                                                                              NSUInteger idx,
+                                                                              BOOL * _Nonnull stop) {
+            if (idx >= size_.height) {
+                DLog(@"Too many lines");
+                *stop = YES;
+                return;
+            }
+            NSData *data = [NSData castFrom:obj];
+            memmove([self screenCharsAtLineNumber:(int)idx], data.bytes, MIN(data.length, lineLength));
+        }];
         [[NSArray castFrom:dictionary[@"timestamps"]] enumerateObjectsUsingBlock:^(NSNumber *timestamp,
                                                                                    NSUInteger idx,
                                                                                    BOOL * _Nonnull stop) {
-            if (idx >= lineInfos_.count) {
+            if (idx >= size_.height) {
                 DLog(@"Too many lineInfos");
                 *stop = YES;
                 return;
             }
-            lineInfos_[idx].timestamp = timestamp.doubleValue;
+            [self lineInfoAtLineNumber:(int)idx]->timestamp = [NSNumber castFrom:timestamp].doubleValue;
         }];
         cursor_ = [NSDictionary castFrom:dictionary[@"cursor"]].gridCoord;
         scrollRegionRows_ = [NSDictionary castFrom:dictionary[@"scrollRegionRows"]].gridRange;
@@ -105,31 +114,23 @@ static NSString *const kGridSizeKey = @"Size";
 }
 
 - (void)dealloc {
-    [lines_ release];
-    [lineInfos_ release];
+    free(_slab);
+    free(_lineInfos);
     [cachedDefaultLine_ release];
     [resultLine_ release];
     [super dealloc];
 }
 
-- (NSMutableData *)lineDataAtLineNumber:(int)lineNumber {
-    if (lineNumber >= 0 && lineNumber < size_.height) {
-        return [lines_ objectAtIndex:(screenTop_ + lineNumber) % size_.height];
-    } else {
-        return nil;
-    }
-}
-
 - (screen_char_t *)screenCharsAtLineNumber:(int)lineNumber {
     assert(lineNumber >= 0);
-    return [[lines_ objectAtIndex:(screenTop_ + lineNumber) % size_.height] mutableBytes];
+    return _slab + (size_t)((screenTop_ + lineNumber) % size_.height) * (size_.width + 1);
 }
 
 - (VT100LineInfo *)lineInfoAtLineNumber:(int)lineNumber {
     if (lineNumber >= 0 && lineNumber < size_.height) {
-        return [lineInfos_ objectAtIndex:(screenTop_ + lineNumber) % size_.height];
+        return &_lineInfos[(screenTop_ + lineNumber) % size_.height];
     } else {
-        return nil;
+        return NULL;
     }
 }
 
@@ -140,9 +141,13 @@ static NSString *const kGridSizeKey = @"Size";
         allDirty_ = NO;
     }
     VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:coord.y];
-    [lineInfo setDirty:dirty
-               inRange:VT100GridRangeMake(coord.x, 1)
-       updateTimestamp:updateTimestamp];
+    if (lineInfo) {
+        VT100LineInfoSetDirty(lineInfo,
+                              size_.width,
+                              dirty,
+                              VT100GridRangeMake(coord.x, 1),
+                              updateTimestamp);
+    }
 }
 
 - (void)markCharsDirty:(BOOL)dirty inRectFrom:(VT100GridCoord)from to:(VT100GridCoord)to {
@@ -153,9 +158,13 @@ static NSString *const kGridSizeKey = @"Size";
     }
     for (int y = from.y; y <= to.y; y++) {
         VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:y];
-        [lineInfo setDirty:dirty
-                   inRange:VT100GridRangeMake(from.x, to.x - from.x + 1)
-           updateTimestamp:YES];
+        if (lineInfo) {
+            VT100LineInfoSetDirty(lineInfo,
+                                  size_.width,
+                                  dirty,
+                                  VT100GridRangeMake(from.x, to.x - from.x + 1),
+                                  YES);
+        }
     }
 }
 
@@ -185,7 +194,7 @@ static NSString *const kGridSizeKey = @"Size";
         return YES;
     }
     VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:coord.y];
-    return [lineInfo isDirtyAtOffset:coord.x];
+    return lineInfo && VT100LineInfoIsDirtyAtOffset(lineInfo, size_.width, coord.x);
 }
 
 - (NSIndexSet *)dirtyIndexesOnLine:(int)line {
@@ -193,7 +202,7 @@ static NSString *const kGridSizeKey = @"Size";
         return [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, self.size.width)];
     }
     VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:line];
-    return [lineInfo dirtyIndexes];
+    return lineInfo ? VT100LineInfoDirtyIndexes(lineInfo) : nil;
 }
 
 - (BOOL)isAnyCharDirty {
@@ -201,8 +210,7 @@ static NSString *const kGridSizeKey = @"Size";
         return YES;
     }
     for (int y = 0; y < size_.height; y++) {
-        VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:y];
-        if ([lineInfo anyCharIsDirty]) {
+        if (VT100LineInfoAnyCharIsDirty(&_lineInfos[y])) {
             return YES;
         }
     }
@@ -211,7 +219,7 @@ static NSString *const kGridSizeKey = @"Size";
 
 - (VT100GridRange)dirtyRangeForLine:(int)y {
     VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:y];
-    return [lineInfo dirtyRange];
+    return lineInfo ? VT100LineInfoDirtyRange(lineInfo) : VT100GridRangeMake(0, 0);
 }
 
 - (int)cursorX {
@@ -319,7 +327,7 @@ static NSString *const kGridSizeKey = @"Size";
                         length:currentLineLength
                        partial:isPartial
                          width:size_.width
-                     timestamp:[[self lineInfoAtLineNumber:i] timestamp]
+                     timestamp:[self timestampForLine:i]
                   continuation:line[size_.width]];
 #ifdef DEBUG_RESIZEDWIDTH
         NSLog(@"Appended a line. now have %d lines for width %d\n",
@@ -331,11 +339,13 @@ static NSString *const kGridSizeKey = @"Size";
 }
 
 - (NSTimeInterval)timestampForLine:(int)y {
-    return [[self lineInfoAtLineNumber:y] timestamp];
+    VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:y];
+    return lineInfo ? lineInfo->timestamp : 0;
 }
 
 - (NSInteger)generationForLine:(int)y {
-    return [[self lineInfoAtLineNumber:y] generation];
+    VT100LineInfo *lineInfo = [self lineInfoAtLineNumber:y];
+    return lineInfo ? lineInfo->generation : 0;
 }
 
 - (int)lengthOfLineNumber:(int)lineNumber {
@@ -390,10 +400,7 @@ static NSString *const kGridSizeKey = @"Size";
     screenTop_ = (screenTop_ + 1) % size_.height;
     _haveScrolled = YES;
     // Empty contents of last line on screen.
-    NSMutableData *lastLineData = [self lineDataAtLineNumber:(size_.height - 1)];
-    if (lastLineData) {  // This if statement is just to quiet the analyzer.
-        [self clearLineData:lastLineData];
-    }
+    [self clearLine:[self screenCharsAtLineNumber:size_.height - 1] width:size_.width];
 
     if (lineBuffer) {
         // Mark new line at bottom of screen dirty.
@@ -1158,21 +1165,34 @@ static NSString *const kGridSizeKey = @"Size";
         }
 
         // Move lines.
-        for (int iteration = 0; (iteration < sourceHeight &&
-                                 sourceIndex < size_.height &&
-                                 destIndex < size_.height &&
-                                 sourceIndex >= 0 &&
-                                 destIndex >= 0);
-             iteration++) {
-            screen_char_t *sourceLine = [self screenCharsAtLineNumber:sourceIndex];
-            screen_char_t *targetLine = [self screenCharsAtLineNumber:destIndex];
-
-            memmove(targetLine + rect.origin.x,
-                    sourceLine + rect.origin.x,
-                    (rect.size.width + continuation) * sizeof(screen_char_t));
-
-            sourceIndex -= direction;
-            destIndex -= direction;
+        const int firstSource = direction > 0 ? rect.origin.y : rect.origin.y - distance;
+        const int firstDest = firstSource + distance;
+        if (rect.origin.x == 0 &&
+            continuation &&
+            sourceHeight > 0 &&
+            firstSource >= 0 &&
+            firstDest >= 0 &&
+            firstSource + sourceHeight <= size_.height &&
+            firstDest + sourceHeight <= size_.height) {
+            // Whole lines are moving, so move them in bulk.
+            [self moveLinesFrom:firstSource to:firstDest count:sourceHeight];
+        } else {
+            for (int iteration = 0; (iteration < sourceHeight &&
+                                     sourceIndex < size_.height &&
+                                     destIndex < size_.height &&
+                                     sourceIndex >= 0 &&
+                                     destIndex >= 0);
+                 iteration++) {
+                screen_char_t *sourceLine = [self screenCharsAtLineNumber:sourceIndex];
+                screen_char_t *targetLine = [self screenCharsAtLineNumber:destIndex];
+
+                memmove(targetLine + rect.origin.x,
+                        sourceLine + rect.origin.x,
+                        (rect.size.width + continuation) * sizeof(screen_char_t));
+
+                sourceIndex -= direction;
+                destIndex -= direction;
+            }
         }
 
         [self markCharsDirty:YES
@@ -1404,7 +1424,7 @@ static NSString *const kGridSizeKey = @"Size";
                                 includesEndOfLine:&cont
                                         timestamp:&timestamp
                                      continuation:&continuation]);
-        [[self lineInfoAtLineNumber:destLineNumber] setTimestamp:timestamp];
+        [self lineInfoAtLineNumber:destLineNumber]->timestamp = timestamp;
         if (cont && dest[size_.width - 1].code == 0 && prevLineStartsWithDoubleWidth) {
             // If you pop a soft-wrapped line that's a character short and the
             // line below it starts with a DWC, it's safe to conclude that a DWC
@@ -1538,7 +1558,7 @@ static NSString *const kGridSizeKey = @"Size";
             if (line[x].complexChar) c = 'U';
             [dump appendFormat:@"%c", c];
         }
-        NSDate* date = [NSDate dateWithTimeIntervalSinceReferenceDate:[[self lineInfoAtLineNumber:y] timestamp]];
+        NSDate* date = [NSDate dateWithTimeIntervalSinceReferenceDate:[self timestampForLine:y]];
         [dump appendFormat:@"  | %@", [fmt stringFromDate:date]];
         if (y != size_.height - 1) {
             [dump appendString:@"\n"];
@@ -1659,8 +1679,11 @@ static NSString *const kGridSizeKey = @"Size";
 
 - (NSArray *)orderedLines {
     NSMutableArray *array = [NSMutableArray array];
+    const NSUInteger length = (size_.width + 1) * sizeof(screen_char_t);
     for (int i = 0; i < size_.height; i++) {
-        [array addObject:[self lineDataAtLineNumber:i]];
+        [array addObject:[NSData dataWithBytesNoCopy:[self screenCharsAtLineNumber:i]
+                                              length:length
+                                        freeWhenDone:NO]];
     }
     return array;
 }
@@ -1696,8 +1719,8 @@ static NSString *const kGridSizeKey = @"Size";
 }
 
 - (void)resetTimestamps {
-    for (VT100LineInfo *info in lineInfos_) {
-        info.timestamp = 0;
+    for (int i = 0; i < size_.height; i++) {
+        _lineInfos[i].timestamp = 0;
     }
 }
 
@@ -1730,11 +1753,12 @@ static NSString *const kGridSizeKey = @"Size";
 }
 
 - (void)encode:(id<iTermEncoderAdapter>)encoder {
-    NSArray<NSNumber *> *timestamps = [lineInfos_ mapWithBlock:^id(VT100LineInfo *anObject) {
-        return @(anObject.timestamp);
+    NSArray<NSNumber *> *timestamps = [[NSArray sequenceWithRange:NSMakeRange(0, size_.height)] mapWithBlock:^id(NSNumber *i) {
+        return @([self timestampForLine:i.intValue]);
     }];
+    const NSUInteger length = (size_.width + 1) * sizeof(screen_char_t);
     NSArray<NSData *> *lines = [[NSArray sequenceWithRange:NSMakeRange(0, size_.height)] mapWithBlock:^id(NSNumber *i) {
-        return [self lineDataAtLineNumber:i.intValue];
+        return [NSData dataWithBytes:[self screenCharsAtLineNumber:i.intValue] length:length];
     }];
     [encoder mergeDictionary:@{
         @"size": [NSDictionary dictionaryWithGridSize:size_],
@@ -1750,20 +1774,52 @@ static NSString *const kGridSizeKey = @"Size";
 
 #pragma mark - Private
 
-- (NSMutableArray *)linesWithSize:(VT100GridSize)size {
-    NSMutableArray *lines = [[[NSMutableArray alloc] init] autorelease];
-    for (int i = 0; i < size.height; i++) {
-        [lines addObject:[[[self defaultLineOfWidth:size.width] mutableCopy] autorelease]];
-    }
-    return lines;
-}
+// Replaces the line storage with size.height default lines.
+- (void)allocateLinesWithSize:(VT100GridSize)size {
+    free(_slab);
+    free(_lineInfos);
+    screenTop_ = 0;
 
-- (NSMutableArray *)lineInfosWithSize:(VT100GridSize)size {
-    NSMutableArray *dirty = [NSMutableArray array];
+    const size_t lineLength = size.width + 1;
+    _slab = iTermMalloc(MAX(1, size.height) * lineLength * sizeof(screen_char_t));
+    _lineInfos = iTermMalloc(MAX(1, size.height) * sizeof(VT100LineInfo));
+    const screen_char_t *defaultLine = [[self defaultLineOfWidth:size.width] bytes];
     for (int i = 0; i < size.height; i++) {
-        [dirty addObject:[[[VT100LineInfo alloc] initWithWidth:size_.width] autorelease]];
+        memcpy(_slab + i * lineLength, defaultLine, lineLength * sizeof(screen_char_t));
+        VT100LineInfoInitialize(&_lineInfos[i]);
+    }
+}
+
+// Moves `count` whole lines, including their continuation marks, from line number `source` to
+// line number `dest`. Runs that don't cross the end of the ring move with a single memmove.
+// Line metadata is not moved; callers mark the destination dirty.
+- (void)moveLinesFrom:(int)source to:(int)dest count:(int)count {
+    const int height = size_.height;
+    const size_t lineLength = size_.width + 1;
+    if (dest < source) {
+        int i = 0;
+        while (i < count) {
+            const int s = (screenTop_ + source + i) % height;
+            const int d = (screenTop_ + dest + i) % height;
+            const int n = MIN(count - i, MIN(height - s, height - d));
+            memmove(_slab + d * lineLength,
+                    _slab + s * lineLength,
+                    n * lineLength * sizeof(screen_char_t));
+            i += n;
+        }
+    } else {
+        // Work from the end so overlapping lines are read before they are overwritten.
+        int i = count;
+        while (i > 0) {
+            const int s = (screenTop_ + source + i - 1) % height;
+            const int d = (screenTop_ + dest + i - 1) % height;
+            const int n = MIN(i, MIN(s + 1, d + 1));
+            memmove(_slab + (d - n + 1) * lineLength,
+                    _slab + (s - n + 1) * lineLength,
+                    n * lineLength * sizeof(screen_char_t));
+            i -= n;
+        }
     }
-    return dirty;
 }
 
 - (screen_char_t)defaultChar {
@@ -1845,11 +1901,12 @@ static NSString *const kGridSizeKey = @"Size";
 }
 
 - (void)clearLineData:(NSMutableData *)line {
-    int length = (int)([line length] / sizeof(screen_char_t));
-    // Clear length+1 so that continuation is set properly
-    [self clearScreenChars:[line mutableBytes] inRange:VT100GridRangeMake(0, length)];
-    screen_char_t *chars = (screen_char_t *)[line mutableBytes];
-    int width = [line length] / sizeof(screen_char_t) - 1;
+    [self clearLine:[line mutableBytes] width:(int)([line length] / sizeof(screen_char_t)) - 1];
+}
+
+- (void)clearLine:(screen_char_t *)chars width:(int)width {
+    // Clear width+1 so that continuation is set properly
+    [self clearScreenChars:chars inRange:VT100GridRangeMake(0, width + 1)];
     chars[width].code = EOL_HARD;
 }
 
@@ -1869,7 +1926,7 @@ static NSString *const kGridSizeKey = @"Size";
                     length:len
                    partial:(continuationMark != EOL_HARD)
                      width:size_.width
-                 timestamp:[[self lineInfoAtLineNumber:0] timestamp]
+                 timestamp:[self timestampForLine:0]
               continuation:line[size_.width]];
     int dropped;
     if (!unlimitedScrollback) {
@@ -1916,10 +1973,7 @@ static NSString *const kGridSizeKey = @"Size";
 - (void)setSize:(VT100GridSize)newSize {
     if (newSize.width != size_.width || newSize.height != size_.height) {
         size_ = newSize;
-        [lines_ release];
-        [lineInfos_ release];
-        lines_ = [[self linesWithSize:newSize] retain];
-        lineInfos_ = [[self lineInfosWithSize:newSize] retain];
+        [self allocateLinesWithSize:newSize];
         scrollRegionRows_.location = MIN(scrollRegionRows_.location, size_.width - 1);
         scrollRegionRows_.length = MIN(scrollRegionRows_.length,
                                        size_.width - scrollRegionRows_.location);
@@ -2139,16 +2193,8 @@ static void DumpBuf(screen_char_t* p, int n) {
 - (id)copyWithZone:(NSZone *)zone {
     VT100Grid *theCopy = [[VT100Grid alloc] initWithSize:size_
                                                 delegate:delegate_];
-    [theCopy->lines_ release];
-    theCopy->lines_ = [[NSMutableArray alloc] init];
-    for (NSObject *line in lines_) {
-        [theCopy->lines_ addObject:[[line mutableCopy] autorelease]];
-    }
-    [theCopy->lineInfos_ release];
-    theCopy->lineInfos_ = [[NSMutableArray alloc] init];
-    for (VT100LineInfo *line in lineInfos_) {
-        [theCopy->lineInfos_ addObject:[[line copy] autorelease]];
-    }
+    memcpy(theCopy->_slab, _slab, size_.height * (size_.width + 1) * sizeof(screen_char_t));
+    memcpy(theCopy->_lineInfos, _lineInfos, size_.height * sizeof(VT100LineInfo));
     theCopy->screenTop_ = screenTop_;
     theCopy->cursor_ = cursor_;  // Don't use property to avoid delegate call
     theCopy.scrollRegionRows = scrollRegionRows_;
@@ -48,15 +48,30 @@ typedef NS_ENUM(NSInteger, VT100TerminalUnits) {
 - (instancetype)initWithSixelData:(NSData *)data
                       scaleFactor:(CGFloat)scaleFactor;
 
+// For a sixel image that arrives in pieces. See -appendSixelData:toGrid:.
+- (instancetype)initWithSixelIdentifier:(NSString *)identifier
+                            scaleFactor:(CGFloat)scaleFactor;
+
 - (instancetype)initWithNativeImageNamed:(NSString *)name
                            spanningWidth:(int)width
                              scaleFactor:(CGFloat)scaleFactor;
 
 - (instancetype)init NS_UNAVAILABLE;
 
+// Nonnil for a sixel image that arrives in pieces.
+@property (nullable, nonatomic, readonly) NSString *sixelIdentifier;
+
 - (void)appendBase64EncodedData:(NSString *)data;
 - (void)writeToGrid:(VT100Grid *)grid;
 
+// Decodes a piece of a sixel image that ends with a complete band. Once the image's size is known
+// it is written to the grid and redrawn as more bands arrive. Returns YES if this call wrote it.
+- (BOOL)appendSixelData:(NSData *)data toGrid:(VT100Grid *)grid;
+
+// Decodes the last piece and replaces what has been shown with the finished image, writing it to
+// the grid if that hasn't happened yet. Returns YES if this call wrote it.
+- (BOOL)finishSixelData:(NSData *)data toGrid:(VT100Grid *)grid;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -11,6 +11,8 @@
 #import "iTermAdvancedSettingsModel.h"
 #import "iTermImage.h"
 #import "iTermImageInfo.h"
+#import "iTermSandboxedWorkerClient.h"
+#include "iTermSixelDecoder.h"
 #import "NSData+iTerm.h"
 #import "NSImage+iTerm.h"
 #import "ScreenChar.h"
@@ -60,6 +62,15 @@
     return self;
 }
 
+- (instancetype)initWithImage:(iTermImage *)image data:(NSData *)data {
+    self = [super init];
+    if (self) {
+        _image = image;
+        _data = data;
+    }
+    return self;
+}
+
 - (void)broke {
     _isBroken = YES;
     DLog(@"Image is broken");
@@ -84,7 +95,18 @@
 @property (nonatomic) CGFloat scaleFactor;
 @end
 
-@implementation VT100InlineImageHelper
+@implementation VT100InlineImageHelper {
+    // The pieces of a streamed sixel image so far, which become the image's data when it's done.
+    NSMutableData *_sixelPayload;
+    // RGBA of the bands decoded so far.
+    NSMutableData *_sixelCanvas;
+    NSSize _sixelCanvasSize;
+    // Set if the worker failed. The image is then decoded all at once when it's done.
+    BOOL _sixelStreamFailed;
+    BOOL _sixelStreamFinished;
+    BOOL _wroteSixelImage;
+    unichar _sixelCode;
+}
 
 - (instancetype)initWithName:(NSString *)name
                        width:(int)width
@@ -131,6 +153,30 @@
     return self;
 }
 
+- (instancetype)initWithSixelIdentifier:(NSString *)identifier
+                            scaleFactor:(CGFloat)scaleFactor {
+    self = [self initWithName:@"Sixel Image"
+                        width:0
+                   widthUnits:kVT100TerminalUnitsAuto
+                       height:0
+                  heightUnits:kVT100TerminalUnitsAuto
+                  scaleFactor:scaleFactor
+          preserveAspectRatio:YES
+                        inset:NSEdgeInsetsZero
+                 preconfirmed:YES];
+    if (self) {
+        _sixelIdentifier = [identifier copy];
+        _sixelPayload = [NSMutableData data];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_sixelIdentifier && !_sixelStreamFinished && !_sixelStreamFailed) {
+        [iTermSandboxedWorkerClient cancelSixelImageWithIdentifier:_sixelIdentifier];
+    }
+}
+
 - (instancetype)initWithNativeImageNamed:(NSString *)name
                            spanningWidth:(int)width
                              scaleFactor:(CGFloat)scaleFactor {
@@ -164,9 +210,72 @@
 }
 
 - (void)writeToGrid:(VT100Grid *)grid {
-    DLog(@"Write image %@ at %@", _name, VT100GridCoordDescription(grid.cursor));
+    [self writeDecodedImage:[self decodedImage] toGrid:grid];
+}
+
+- (BOOL)appendSixelData:(NSData *)data toGrid:(VT100Grid *)grid {
+    [_sixelPayload appendData:data];
+    if (_sixelStreamFailed) {
+        return NO;
+    }
+    iTermSixelBands *bands = [iTermSandboxedWorkerClient appendSixelData:data
+                                                   toImageWithIdentifier:_sixelIdentifier];
+    if (![self addSixelBands:bands]) {
+        DLog(@"Streaming sixel image %@ failed. It will be decoded when complete.", _sixelIdentifier);
+        [iTermSandboxedWorkerClient cancelSixelImageWithIdentifier:_sixelIdentifier];
+        _sixelStreamFailed = YES;
+        _sixelCanvas = nil;
+        return NO;
+    }
+    if (!bands.rgba) {
+        return NO;
+    }
+    if (_wroteSixelImage) {
+        SetDecodedImage(_sixelCode, [self sixelCanvasImage], nil);
+        [grid markAllCharsDirty:YES];
+        return NO;
+    }
+    if (!bands.declaredSize) {
+        // The number of cells the image takes depends on its size, which isn't known until the end.
+        return NO;
+    }
+    VT100DecodedImage *decodedImage = [[VT100DecodedImage alloc] initWithImage:[self sixelCanvasImage]
+                                                                          data:nil];
+    _sixelCode = [self writeDecodedImage:decodedImage toGrid:grid];
+    _wroteSixelImage = YES;
+    return YES;
+}
+
+- (BOOL)finishSixelData:(NSData *)data toGrid:(VT100Grid *)grid {
+    [_sixelPayload appendData:data];
+    iTermImage *image = nil;
+    if (!_sixelStreamFailed) {
+        image = [iTermSandboxedWorkerClient finishSixelData:data
+                                      toImageWithIdentifier:_sixelIdentifier];
+    }
+    _sixelStreamFinished = YES;
+    _sixelCanvas = nil;
+
+    VT100DecodedImage *decodedImage;
+    if (image) {
+        decodedImage = [[VT100DecodedImage alloc] initWithImage:image data:_sixelPayload];
+    } else {
+        decodedImage = [[VT100DecodedImage alloc] initWithSixelData:_sixelPayload];
+    }
+    _sixelPayload = nil;
+    if (!_wroteSixelImage) {
+        [self writeDecodedImage:decodedImage toGrid:grid];
+        return YES;
+    }
+    GetImageInfo(_sixelCode).broken = decodedImage.isBroken;
+    SetDecodedImage(_sixelCode, decodedImage.image, decodedImage.data);
+    [grid markAllCharsDirty:YES];
+    return NO;
+}
 
-    VT100DecodedImage *decodedImage = [self decodedImage];
+// Returns the code of the image.
+- (unichar)writeDecodedImage:(VT100DecodedImage *)decodedImage toGrid:(VT100Grid *)grid {
+    DLog(@"Write image %@ at %@", _name, VT100GridCoordDescription(grid.cursor));
 
     screen_char_t c;
     int width;
@@ -187,6 +296,54 @@
     SetDecodedImage(c.code, decodedImage.image, decodedImage.data);
     [self.delegate inlineImageSetMarkOnScreenLine:grid.cursor.y + 1
                                              code:c.code];
+    return c.code;
+}
+
+#pragma mark - Streamed Sixel Images
+
+// Copies newly decoded rows into the canvas. Returns NO if the worker failed or its reply makes no
+// sense.
+- (BOOL)addSixelBands:(iTermSixelBands *)bands {
+    if (!bands) {
+        return NO;
+    }
+    const NSSize size = bands.size;
+    if (size.width < 1 || size.width > iTermSixelDecoderMaximumDimension ||
+        size.height < _sixelCanvasSize.height || size.height > iTermSixelDecoderMaximumDimension) {
+        DLog(@"Bogus size %@", NSStringFromSize(size));
+        return NO;
+    }
+    const NSUInteger bytesPerRow = (NSUInteger)size.width * 4;
+    if (size.width != _sixelCanvasSize.width) {
+        // The worker starts over from the first row when the width changes.
+        _sixelCanvas = [NSMutableData dataWithLength:bytesPerRow * size.height];
+    } else {
+        _sixelCanvas.length = bytesPerRow * size.height;
+    }
+    _sixelCanvasSize = size;
+    if (!bands.rgba) {
+        return YES;
+    }
+    const NSUInteger offset = bands.firstRow * bytesPerRow;
+    if (bands.firstRow < 0 ||
+        bands.rgba.length % bytesPerRow != 0 ||
+        offset + bands.rgba.length > _sixelCanvas.length) {
+        DLog(@"Rows starting at %@ of length %@ don't fit in %@",
+             @(bands.firstRow), @(bands.rgba.length), NSStringFromSize(size));
+        return NO;
+    }
+    memcpy(_sixelCanvas.mutableBytes + offset, bands.rgba.bytes, bands.rgba.length);
+    return YES;
+}
+
+- (iTermImage *)sixelCanvasImage {
+    NSImage *image = [NSImage imageWithRawData:_sixelCanvas
+                                          size:_sixelCanvasSize
+                                 bitsPerSample:8
+                               samplesPerPixel:4
+                                      hasAlpha:YES
+                                colorSpaceName:NSDeviceRGBColorSpace];
+    return [iTermImage imageWithNativeImage:image];
 }
 
 #pragma mark - Decoding
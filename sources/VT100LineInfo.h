@@ -9,16 +9,29 @@
 #import <Foundation/Foundation.h>
 #import "VT100GridTypes.h"
 
-@interface VT100LineInfo : NSObject <NSCopying>
+// Per-line metadata for VT100Grid. The grid keeps one of these for each row in a flat array that
+// parallels its character storage, so it is a plain struct rather than an object.
+typedef struct {
+    NSTimeInterval timestamp;
+    NSInteger generation;
+    // Half-open range of dirty columns. Both are -1 when the line is clean.
+    int start;
+    int bound;
+} VT100LineInfo;
 
-@property(nonatomic, assign) NSTimeInterval timestamp;
-@property(nonatomic, readonly) NSInteger generation;
+void VT100LineInfoInitialize(VT100LineInfo *info);
+void VT100LineInfoSetDirty(VT100LineInfo *info,
+                           int width,
+                           BOOL dirty,
+                           VT100GridRange range,
+                           BOOL updateTimestamp);
+BOOL VT100LineInfoIsDirtyAtOffset(const VT100LineInfo *info, int width, int x);
+NSIndexSet *VT100LineInfoDirtyIndexes(const VT100LineInfo *info);
 
-- (instancetype)initWithWidth:(int)width;
-- (void)setDirty:(BOOL)dirty inRange:(VT100GridRange)range updateTimestamp:(BOOL)updateTimestamp;
-- (BOOL)isDirtyAtOffset:(int)x;
-- (BOOL)anyCharIsDirty;
-- (VT100GridRange)dirtyRange;
-- (NSIndexSet *)dirtyIndexes;
+NS_INLINE VT100GridRange VT100LineInfoDirtyRange(const VT100LineInfo *info) {
+    return VT100GridRangeMake(info->start, info->bound - info->start);
+}
 
-@end
+NS_INLINE BOOL VT100LineInfoAnyCharIsDirty(const VT100LineInfo *info) {
+    return info->start >= 0;
+}
@@ -8,102 +8,66 @@
 
 #import "VT100LineInfo.h"
 
-@implementation VT100LineInfo {
-    int width_;
-    NSTimeInterval timestamp_;
-    int start_;
-    int bound_;
-}
-
 static NSInteger VT100LineInfoNextGeneration = 1;
 
-@synthesize timestamp = timestamp_;
-
-- (instancetype)initWithWidth:(int)width {
-    self = [super init];
-    if (self) {
-        width_ = width;
-        start_ = -1;
-        bound_ = -1;
-        [self setDirty:NO inRange:VT100GridRangeMake(0, width) updateTimestamp:NO];
-    }
-    return self;
-}
-
-- (void)dealloc {
-    [super dealloc];
+void VT100LineInfoInitialize(VT100LineInfo *info) {
+    info->timestamp = 0;
+    info->generation = 0;
+    info->start = -1;
+    info->bound = -1;
 }
 
-- (void)setDirty:(BOOL)dirty inRange:(VT100GridRange)range updateTimestamp:(BOOL)updateTimestamp {
+void VT100LineInfoSetDirty(VT100LineInfo *info,
+                           int width,
+                           BOOL dirty,
+                           VT100GridRange range,
+                           BOOL updateTimestamp) {
 #ifdef ITERM_DEBUG
     assert(range.location >= 0);
     assert(range.length >= 0);
-    assert(range.location + range.length <= width_);
+    assert(range.location + range.length <= width);
 #endif
-    const VT100GridRange before = [self dirtyRange];
+    const VT100GridRange before = VT100LineInfoDirtyRange(info);
     if (dirty && updateTimestamp) {
-        [self updateTimestamp];
+        info->timestamp = [NSDate timeIntervalSinceReferenceDate];
     }
     if (dirty) {
-        if (start_ < 0) {
-            start_ = range.location;
-            bound_ = range.location + range.length;
+        if (info->start < 0) {
+            info->start = range.location;
+            info->bound = range.location + range.length;
         } else {
-            start_ = MIN(start_, range.location);
-            bound_ = MAX(bound_, range.location + range.length);
+            info->start = MIN(info->start, range.location);
+            info->bound = MAX(info->bound, range.location + range.length);
         }
-    } else if (start_ >= 0) {
+    } else if (info->start >= 0) {
         // Unset part of the dirty region.
         int clearBound = range.location + range.length;
-        if (range.location <= start_) {
-            if (clearBound >= bound_) {
-                start_ = bound_ = -1;
-            } else if (clearBound > start_) {
-                start_ = clearBound;
+        if (range.location <= info->start) {
+            if (clearBound >= info->bound) {
+                info->start = info->bound = -1;
+            } else if (clearBound > info->start) {
+                info->start = clearBound;
             }
-        } else if (range.location < bound_ && clearBound >= bound_) {
+        } else if (range.location < info->bound && clearBound >= info->bound) {
             // Clear the right-hand part of the dirty region
-            bound_ = range.location;
+            info->bound = range.location;
         }
     }
-    const VT100GridRange after = [self dirtyRange];
+    const VT100GridRange after = VT100LineInfoDirtyRange(info);
     if (dirty && !VT100GridRangeEqualsRange(before, after)) {
-        _generation = VT100LineInfoNextGeneration++;
+        info->generation = VT100LineInfoNextGeneration++;
     }
 }
 
-- (VT100GridRange)dirtyRange {
-    return VT100GridRangeMake(start_, bound_ - start_);
-}
-
-- (void)updateTimestamp {
-    self.timestamp = [NSDate timeIntervalSinceReferenceDate];
-}
-
-- (BOOL)isDirtyAtOffset:(int)x {
+BOOL VT100LineInfoIsDirtyAtOffset(const VT100LineInfo *info, int width, int x) {
 #if ITERM_DEBUG
-    assert(x >= 0 && x < width_);
+    assert(x >= 0 && x < width);
 #else
-    x = MIN(width_ - 1, MAX(0, x));
+    x = MIN(width - 1, MAX(0, x));
 #endif
-    return x >= start_ && x < bound_;
-}
-
-- (NSIndexSet *)dirtyIndexes {
-    return [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(start_, bound_ - start_)];
+    return x >= info->start && x < info->bound;
 }
 
-- (BOOL)anyCharIsDirty {
-    return start_ >= 0;
+NSIndexSet *VT100LineInfoDirtyIndexes(const VT100LineInfo *info) {
+    return [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(info->start, info->bound - info->start)];
 }
-
-- (id)copyWithZone:(NSZone *)zone {
-    VT100LineInfo *theCopy = [[VT100LineInfo alloc] initWithWidth:width_];
-    theCopy->start_ = start_;
-    theCopy->bound_ = bound_;
-    theCopy->timestamp_ = timestamp_;
-
-    return theCopy;
-}
-
-@end
@@ -10,6 +10,7 @@
 
 @class DVR;
 @class iTermNotificationController;
+@class iTermAutocompleteIndexMatch;
 @class iTermMark;
 @class iTermStringLine;
 @class LineBuffer;
@@ -27,6 +28,9 @@ extern NSString * const kHighlightBackgroundColor;
 
 // Key into dictionaryValue to get screen state.
 extern NSString *const kScreenStateKey;
+// Posted with the screen as the object when its autocomplete index catches up with the scrollback
+// buffer after a lookup found it behind.
+extern NSString *const VT100ScreenAutocompleteIndexDidCatchUpNotification;
 
 extern int kVT100ScreenMinColumns;
 extern int kVT100ScreenMinRows;
@@ -141,6 +145,9 @@ extern const NSInteger VT100ScreenBigFileDownloadThreshold;
 // Load a frame from a dvr decoder.
 - (void)setFromFrame:(screen_char_t*)s len:(int)len info:(DVRFrameInfo)info;
 
+// Like -saveToDvr: but records the frame at `timestamp` (microseconds since 1970) rather than now.
+- (void)saveToDvr:(NSIndexSet *)cleanLines timestamp:(long long)timestamp;
+
 // Save the position of the end of the scrollback buffer without the screen appended.
 - (void)storeLastPositionInLineBufferAsFindContextSavedPosition;
 
@@ -167,6 +174,18 @@ extern const NSInteger VT100ScreenBigFileDownloadThreshold;
 - (iTermStringLine *)stringLineAsStringAtAbsoluteLineNumber:(long long)absoluteLineNumber
                                                    startPtr:(long long *)startAbsLineNumber;
 
+// Words beginning with |prefix| that appear before |coord|, which is in the same coordinates as
+// -getLineAtIndex:. Words on the screen come first, followed by those in the scrollback buffer, each
+// most recent first. Up to |maximumCount| of each.
+- (NSArray<iTermAutocompleteIndexMatch *> *)autocompleteMatchesWithPrefix:(NSString *)prefix
+                                                                    before:(VT100GridCoord)coord
+                                                              maximumCount:(NSInteger)maximumCount;
+
+// NO while the index used by the method above is still working through the scrollback buffer, in
+// which case its matches leave out older history until
+// VT100ScreenAutocompleteIndexDidCatchUpNotification is posted.
+@property(nonatomic, readonly) BOOL autocompleteIndexIsCaughtUp;
+
 - (void)toggleAlternateScreen;
 
 #pragma mark - Marks and notes
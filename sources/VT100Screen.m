@@ -6,6 +6,7 @@
 #import "DVR.h"
 #import "IntervalTree.h"
 #import "iTermAdvancedSettingsModel.h"
+#import "iTermAutocompleteIndex.h"
 #import "iTermCapturedOutputMark.h"
 #import "iTermColorMap.h"
 #import "iTermNotificationController.h"
@@ -40,6 +41,7 @@
 #import <apr-1/apr_base64.h>
 
 NSString *const kScreenStateKey = @"Screen State";
+NSString *const VT100ScreenAutocompleteIndexDidCatchUpNotification = @"VT100ScreenAutocompleteIndexDidCatchUpNotification";
 
 NSString *const kScreenStateTabStopsKey = @"Tab Stops";
 NSString *const kScreenStateTerminalKey = @"Terminal State";
@@ -66,6 +68,8 @@ int kVT100ScreenMinRows = 2;
 static const int kDefaultScreenColumns = 80;
 static const int kDefaultScreenRows = 25;
 static const int kDefaultMaxScrollbackLines = 1000;
+// Lines of history added to the autocomplete index per pass on the main thread.
+static const long long kAutocompleteIndexLinesPerUpdate = 10000;
 
 NSString * const kHighlightForegroundColor = @"kHighlightForegroundColor";
 NSString * const kHighlightBackgroundColor = @"kHighlightBackgroundColor";
@@ -153,6 +157,8 @@ const NSInteger VT100ScreenBigFileDownloadThreshold = 1024 * 1024 * 1024;
     BOOL _shellIntegrationInstalled;
 
     VT100InlineImageHelper *_inlineImageHelper;
+    // Draws a sixel image that arrives in pieces.
+    VT100InlineImageHelper *_sixelImageHelper;
     NSTimeInterval lastBell_;
     BOOL _cursorVisible;
     // Line numbers containing animated GIFs that need to be redrawn for the next frame.
@@ -170,6 +176,11 @@ const NSInteger VT100ScreenBigFileDownloadThreshold = 1024 * 1024 * 1024;
 
     iTermOrderEnforcer *_setWorkingDirectoryOrderEnforcer;
     iTermOrderEnforcer *_currentDirectoryDidChangeOrderEnforcer;
+
+    // Words in linebuffer_ for autocomplete. Created lazily and discarded when linebuffer_ is replaced.
+    iTermAutocompleteIndex *_autocompleteIndex;
+    // Is a pass to catch _autocompleteIndex up with linebuffer_ pending?
+    BOOL _autocompleteIndexUpdateScheduled;
 }
 
 @synthesize terminal = terminal_;
@@ -234,6 +245,7 @@ const NSInteger VT100ScreenBigFileDownloadThreshold = 1024 * 1024 * 1024;
     [tabStops_ release];
     [printBuffer_ release];
     [linebuffer_ release];
+    [_autocompleteIndex release];
     [dvr_ release];
     [terminal_ release];
     [findContext_ release];
@@ -241,6 +253,7 @@ const NSInteger VT100ScreenBigFileDownloadThreshold = 1024 * 1024 * 1024;
     [intervalTree_ release];
     [markCache_ release];
     [_inlineImageHelper release];
+    [_sixelImageHelper release];
     [_lastCommandMark release];
     _temporaryDoubleBuffer.delegate = nil;
     [_temporaryDoubleBuffer reset];
@@ -1180,6 +1193,8 @@ const NSInteger VT100ScreenBigFileDownloadThreshold = 1024 * 1024 * 1024;
 - (void)clearScrollbackBuffer {
     [linebuffer_ release];
     linebuffer_ = [[LineBuffer alloc] init];
+    [_autocompleteIndex release];
+    _autocompleteIndex = nil;
     [linebuffer_ setMaxLines:maxScrollbackLines_];
     [delegate_ screenClearHighlights];
     [currentGrid_ markAllCharsDirty:YES];
@@ -2134,11 +2149,16 @@ basedAtAbsoluteLineNumber:(long long)absoluteLineNumber
 }
 
 - (void)saveToDvr:(NSIndexSet *)cleanLines {
+    [self saveToDvr:cleanLines timestamp:0];
+}
+
+- (void)saveToDvr:(NSIndexSet *)cleanLines timestamp:(long long)timestamp {
     if (!dvr_) {
         return;
     }
 
-    DVRFrameInfo info;
+    DVRFrameInfo info = { 0 };
+    info.timestamp = timestamp;
     info.cursorX = currentGrid_.cursorX;
     info.cursorY = currentGrid_.cursorY;
     info.height = currentGrid_.size.height;
@@ -2889,6 +2909,71 @@ basedAtAbsoluteLineNumber:(long long)absoluteLineNumber
                                                   length:data.length / sizeof(screen_char_t)] autorelease];
 }
 
+- (NSArray<iTermAutocompleteIndexMatch *> *)autocompleteMatchesWithPrefix:(NSString *)prefix
+                                                                    before:(VT100GridCoord)coord
+                                                              maximumCount:(NSInteger)maximumCount {
+    NSString *wordCharacters =
+        [iTermPreferences stringForKey:kPreferenceKeyCharactersConsideredPartOfAWordForSelection] ?: @"";
+    if (![_autocompleteIndex.wordCharacters isEqualToString:wordCharacters]) {
+        [_autocompleteIndex release];
+        _autocompleteIndex = [[iTermAutocompleteIndex alloc] initWithWordCharacters:wordCharacters];
+    }
+    [self updateAutocompleteIndex];
+
+    // The screen changes too often to be worth indexing, so scan it each time. Its words are the
+    // most recent, so they go first.
+    iTermAutocompleteIndex *screenIndex =
+        [[[iTermAutocompleteIndex alloc] initWithWordCharacters:wordCharacters] autorelease];
+    const int width = self.width;
+    for (int y = self.numberOfScrollbackLines; y <= coord.y && y < self.numberOfLines; y++) {
+        screen_char_t *line = [self getLineAtIndex:y];
+        if (y == coord.y) {
+            [screenIndex addCharacters:line length:MAX(0, MIN(width, coord.x)) partial:NO];
+        } else {
+            [screenIndex addCharacters:line length:width partial:(line[width].code != EOL_HARD)];
+        }
+    }
+    NSMutableArray<iTermAutocompleteIndexMatch *> *matches = [NSMutableArray array];
+    [matches addObjectsFromArray:[screenIndex matchesWithPrefix:prefix maximumCount:maximumCount]];
+    [matches addObjectsFromArray:[_autocompleteIndex matchesWithPrefix:prefix maximumCount:maximumCount]];
+    return matches;
+}
+
+- (BOOL)autocompleteIndexIsCaughtUp {
+    return !_autocompleteIndexUpdateScheduled;
+}
+
+// Indexing a long history all at once would stall the main thread, so it's done a slice at a time.
+// Until it catches up, matches come from the part that's been indexed. Returns YES if it has
+// caught up.
+- (BOOL)updateAutocompleteIndex {
+    if (!_autocompleteIndex) {
+        return YES;
+    }
+    if ([_autocompleteIndex updateWithLineBuffer:linebuffer_
+                                    maximumLines:kAutocompleteIndexLinesPerUpdate]) {
+        return YES;
+    }
+    if (_autocompleteIndexUpdateScheduled) {
+        return NO;
+    }
+    _autocompleteIndexUpdateScheduled = YES;
+    __weak __typeof(self) weakSelf = self;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [weakSelf autocompleteIndexUpdateDidFire];
+    });
+    return NO;
+}
+
+- (void)autocompleteIndexUpdateDidFire {
+    _autocompleteIndexUpdateScheduled = NO;
+    if ([self updateAutocompleteIndex]) {
+        // Let an open autocomplete popup look again now that all of the history is indexed.
+        [[NSNotificationCenter defaultCenter] postNotificationName:VT100ScreenAutocompleteIndexDidCatchUpNotification
+                                                            object:self];
+    }
+}
+
 #pragma mark - VT100TerminalDelegate
 
 - (void)terminalAppendString:(NSString *)string {
@@ -4202,6 +4287,30 @@ basedAtAbsoluteLineNumber:(long long)absoluteLineNumber
     [self crlf];
 }
 
+- (void)terminalAppendSixelBands:(NSData *)data identifier:(NSString *)identifier {
+    if (![_sixelImageHelper.sixelIdentifier isEqualToString:identifier]) {
+        [_sixelImageHelper release];
+        _sixelImageHelper = [[VT100InlineImageHelper alloc] initWithSixelIdentifier:identifier
+                                                                        scaleFactor:[delegate_ screenBackingScaleFactor]];
+        _sixelImageHelper.delegate = self;
+    }
+    if ([_sixelImageHelper appendSixelData:data toGrid:currentGrid_]) {
+        [self crlf];
+    }
+}
+
+- (void)terminalFinishSixelImageWithData:(NSData *)data identifier:(NSString *)identifier {
+    if (![_sixelImageHelper.sixelIdentifier isEqualToString:identifier]) {
+        DLog(@"Finished sixel image %@ but the current one is %@", identifier, _sixelImageHelper.sixelIdentifier);
+        return;
+    }
+    if ([_sixelImageHelper finishSixelData:data toGrid:currentGrid_]) {
+        [self crlf];
+    }
+    [_sixelImageHelper release];
+    _sixelImageHelper = nil;
+}
+
 - (void)terminalDidChangeSendModifiers {
     // CSI u is too different from xterm's modifyOtherKeys to allow the terminal to change it with
     // xterm's control sequences. Lots of strange problems appear with vim. For example, mailing
@@ -5778,6 +5887,8 @@ static void SwapInt(int *a, int *b) {
         }
         [linebuffer_ release];
         linebuffer_ = lineBuffer;
+        [_autocompleteIndex release];
+        _autocompleteIndex = nil;
         int maxLinesToRestore;
         if ([iTermAdvancedSettingsModel runJobsInServers] && reattached) {
             maxLinesToRestore = currentGrid_.size.height;
@@ -5852,6 +5963,8 @@ static void SwapInt(int *a, int *b) {
         }
         [linebuffer_ release];
         linebuffer_ = lineBuffer;
+        [_autocompleteIndex release];
+        _autocompleteIndex = nil;
     }
     BOOL addedBanner = NO;
     if (includeRestorationBanner && [iTermAdvancedSettingsModel showSessionRestoredBanner]) {
@@ -7,24 +7,43 @@
 
 #import "VT100SixelParser.h"
 
+// Initial capacity of the accumulator. Sixel images are rarely tiny, so this avoids a cascade of
+// small reallocations at the start of every image.
+static const NSUInteger VT100SixelParserInitialCapacity = 64 * 1024;
+
+// Once this many bytes of complete bands have accumulated they are sent on in a DCS_SIXEL_BANDS
+// token so the image can be drawn while the rest arrives. Later pieces must be at least half as big
+// as all those sent before, so a huge image is sent in a few dozen pieces rather than thousands.
+static const NSUInteger VT100SixelParserMinimumBandsLength = 16 * 1024;
+
 @implementation VT100SixelParser {
+    // Holds the header the sandboxed worker expects (parameters followed by a newline) followed by
+    // the DCS introducer and the payload, so the finished buffer can be handed off without copying.
     NSMutableData *_accumulator;
-    NSArray<NSString *> *_parameters;
     BOOL _esc;
+
+    // Offset in the accumulator just past the last graphics new line, which ends a band.
+    NSUInteger _bandsEnd;
+    NSUInteger _lengthSent;
+    // Set once the first piece is sent.
+    NSString *_identifier;
 }
 
 - (instancetype)initWithParameters:(NSArray *)parameters {
     self = [super init];
     if (self) {
-        _accumulator = [NSMutableData data];
+        _accumulator = [NSMutableData dataWithCapacity:VT100SixelParserInitialCapacity];
+        NSData *joined = [[parameters componentsJoinedByString:@";"] dataUsingEncoding:NSUTF8StringEncoding];
+        if (joined) {
+            [_accumulator appendData:joined];
+        }
+        [_accumulator appendBytes:"\n" length:1];
         char escp[2] = "\x1bP";
         [_accumulator appendBytes:escp length:2];
-        if (parameters.count) {
-            NSString *joined = [parameters componentsJoinedByString:@";"];
-            [_accumulator appendData:[joined dataUsingEncoding:NSUTF8StringEncoding]];
+        if (parameters.count && joined) {
+            [_accumulator appendData:joined];
         }
         [_accumulator appendBytes:"q" length:1];
-        _parameters = [parameters copy];
     }
     return self;
 }
@@ -33,14 +52,41 @@
     return @"[SIXEL]";
 }
 
+// The parser unhooks after this is called, so ownership of the accumulator passes to the token.
 - (NSData *)combinedData {
-    NSString *joined = [[_parameters componentsJoinedByString:@";"] stringByAppendingString:@"\n"];
-    NSData *paramData = [joined dataUsingEncoding:NSUTF8StringEncoding];
-    NSMutableData *result = [paramData mutableCopy];
-    [result appendData:_accumulator];
+    NSData *result = _accumulator;
+    _accumulator = nil;
     return result;
 }
 
+// Puts the rest of the image in the token.
+- (void)finishWithToken:(VT100Token *)result {
+    if (_identifier) {
+        result->type = DCS_SIXEL_END;
+        result.string = _identifier;
+    } else {
+        result->type = DCS_SIXEL;
+    }
+    result.savedData = [self combinedData];
+}
+
+// Sends the complete bands in a token if there are enough of them. Returns YES if it did.
+- (BOOL)sendBandsIfNeededInToken:(VT100Token *)result {
+    if (_bandsEnd < MAX(VT100SixelParserMinimumBandsLength, _lengthSent / 2)) {
+        return NO;
+    }
+    if (!_identifier) {
+        _identifier = [[NSUUID UUID] UUIDString];
+    }
+    result->type = DCS_SIXEL_BANDS;
+    result.string = _identifier;
+    result.savedData = [_accumulator subdataWithRange:NSMakeRange(0, _bandsEnd)];
+    [_accumulator replaceBytesInRange:NSMakeRange(0, _bandsEnd) withBytes:NULL length:0];
+    _lengthSent += _bandsEnd;
+    _bandsEnd = 0;
+    return YES;
+}
+
 // Return YES if it should unhook.
 - (BOOL)handleInput:(iTermParserContext *)context
 support8BitControlCharacters:(BOOL)support8BitControlCharacters
@@ -59,8 +105,7 @@ support8BitControlCharacters:(BOOL)support8BitControlCharacters
             case VT100CC_C1_ST:
                 if (support8BitControlCharacters) {
                     iTermParserConsume(context);
-                    result->type = DCS_SIXEL;
-                    result.savedData = [self combinedData];
+                    [self finishWithToken:result];
                     return YES;
                 }
                 break;
@@ -82,13 +127,15 @@ support8BitControlCharacters:(BOOL)support8BitControlCharacters
             [self handleInputOfLength:n
                               context:context
                                 token:result];
-            continue;
+        } else {
+            // There is no forthcoming ESC or ST. Handle all the input.
+            [self handleInputOfLength:iTermParserLength(context)
+                              context:context
+                                token:result];
+        }
+        if ([self sendBandsIfNeededInToken:result]) {
+            return NO;
         }
-
-        // There is no forthcoming ESC or ST. Handle all the input.
-        [self handleInputOfLength:iTermParserLength(context)
-                          context:context
-                            token:result];
     }
     return NO;
 }
@@ -112,19 +159,30 @@ support8BitControlCharacters:(BOOL)support8BitControlCharacters
     _esc = NO;
     if (c != '\\') {
         // esc + something unexpected. Broken sequence.
-        result->type = VT100_NOTSUPPORT;
+        if (_identifier) {
+            // Part of the image has been drawn already, so finish it with what there is.
+            [self finishWithToken:result];
+        } else {
+            result->type = VT100_NOTSUPPORT;
+        }
         return YES;
     }
 
-    result->type = DCS_SIXEL;
-    result.savedData = [self combinedData];
+    [self finishWithToken:result];
     return YES;
 }
 
 - (void)handleInputOfLength:(int)length
                     context:(iTermParserContext *)context
                       token:(VT100Token *)result {
-    [_accumulator appendBytes:iTermParserPeekRawBytes(context, length)
+    const unsigned char *bytes = iTermParserPeekRawBytes(context, length);
+    for (int i = length - 1; i >= 0; i--) {
+        if (bytes[i] == '-') {
+            _bandsEnd = _accumulator.length + i + 1;
+            break;
+        }
+    }
+    [_accumulator appendBytes:bytes
                        length:length];
     iTermParserAdvanceMultiple(context, length);
     result->type = VT100_WAIT;
@@ -2209,6 +2209,14 @@ static const int kMaxScreenRows = 4096;
             [delegate_ terminalAppendSixelData:token.savedData];
             break;
 
+        case DCS_SIXEL_BANDS:
+            [delegate_ terminalAppendSixelBands:token.savedData identifier:token.string];
+            break;
+
+        case DCS_SIXEL_END:
+            [delegate_ terminalFinishSixelImageWithData:token.savedData identifier:token.string];
+            break;
+
         case DCS_DECRQSS:
             [delegate_ terminalSendReport:[[self decrqss:token.string] dataUsingEncoding:_encoding]];
             break;
@@ -436,6 +436,10 @@ typedef NS_ENUM(int, VT100TerminalColorIndex) {
 
 - (void)terminalAppendSixelData:(NSData *)sixelData;
 
+// A sixel image that arrives in pieces. The pieces of one image share an identifier.
+- (void)terminalAppendSixelBands:(NSData *)sixelData identifier:(NSString *)identifier;
+- (void)terminalFinishSixelImageWithData:(NSData *)sixelData identifier:(NSString *)identifier;
+
 - (void)terminalDidChangeSendModifiers;
 - (void)terminalClearCapturedOutput;
 
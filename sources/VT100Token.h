@@ -188,6 +188,10 @@ typedef enum {
     DCS_BEGIN_SYNCHRONIZED_UPDATE,
     DCS_END_SYNCHRONIZED_UPDATE,
     DCS_SIXEL,
+    // A large sixel image is sent in pieces so it can be shown as it arrives. Each piece ends with
+    // a complete band. string holds an identifier for the image and savedData holds the piece.
+    DCS_SIXEL_BANDS,
+    DCS_SIXEL_END,
     DCS_DECRQSS,
 
     // Toggle between ansi/vt52
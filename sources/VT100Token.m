@@ -202,6 +202,8 @@
                           @(VT100CSI_DECSLRM_OR_ANSICSI_SCP): @"VT100CSI_DECSLRM_OR_ANSICSI_SCP",
                           @(DCS_REQUEST_TERMCAP_TERMINFO):    @"DCS_REQUEST_TERMCAP_TERMINFO",
                           @(DCS_SIXEL):                       @"DCS_SIXEL",
+                          @(DCS_SIXEL_BANDS):                 @"DCS_SIXEL_BANDS",
+                          @(DCS_SIXEL_END):                   @"DCS_SIXEL_END",
                           @(DCS_DECRQSS):                     @"DCS_DECRQSS" };
     NSString *name = map[@(type)];
     if (name) {
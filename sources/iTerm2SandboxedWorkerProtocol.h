@@ -14,4 +14,24 @@
 - (void)decodeImageFromData:(NSData * _Nonnull)imageData withReply:(void (^_Nonnull)(iTermImage * _Nullable))reply;
 - (void)decodeImageFromSixelData:(NSData * _Nonnull)imageData withReply:(void (^_Nonnull)(iTermImage * _Nullable))reply;
 
+// Decodes a sixel image a piece at a time. The first piece for an identifier begins with the same
+// header as the data given to -decodeImageFromSixelData:withReply:. The reply gives the rows that
+// became complete as RGBA (nil if none did), the first of those rows, and the size of the image so
+// far. A width of 0 means decoding failed and the identifier is forgotten.
+- (void)appendSixelData:(NSData * _Nonnull)data
+  toImageWithIdentifier:(NSString * _Nonnull)identifier
+              withReply:(void (^_Nonnull)(NSData * _Nullable rgba,
+                                          NSInteger firstRow,
+                                          NSInteger width,
+                                          NSInteger height,
+                                          BOOL declaredSize))reply;
+
+// Appends the last piece, returns the finished image, and forgets the identifier.
+- (void)finishSixelData:(NSData * _Nonnull)data
+  toImageWithIdentifier:(NSString * _Nonnull)identifier
+              withReply:(void (^_Nonnull)(iTermImage * _Nullable))reply;
+
+// Forgets an image that won't be finished.
+- (void)cancelSixelImageWithIdentifier:(NSString * _Nonnull)identifier;
+
 @end
@@ -71,6 +71,7 @@ extern NSString *const iTermAdvancedSettingsDidChange;
 + (double)compactEdgeDragSize;
 + (double)compactMinimalTabBarHeight;
 + (NSString *)composerClearSequence;
++ (BOOL)compressScrollbackInRestorableState;
 + (BOOL)conservativeURLGuessing;
 + (BOOL)convertItalicsToReverseVideoForTmux;
 + (BOOL)convertTabDragToWindowDragForSolitaryTabInCompactOrMinimalTheme;
@@ -147,6 +148,8 @@ extern NSString *const iTermAdvancedSettingsDidChange;
 + (BOOL)includePasteHistoryInAdvancedPaste;
 + (BOOL)indicateBellsInDockBadgeLabel;
 + (double)indicatorFlashInitialAlpha;
++ (int)inlineImageMemoryBudgetMB;
++ (NSString *)instantReplayRecordingDirectory;
 + (double)invalidateShadowTimesPerSecond;
 + (BOOL)jiggleTTYSizeOnClearBuffer;
 + (BOOL)killJobsInServersOnQuit;
@@ -177,6 +180,7 @@ extern NSString *const iTermAdvancedSettingsDidChange;
 + (double)minRunningTime;
 + (int)minTabWidth;
 + (BOOL)multiserver;
++ (BOOL)multiserverBuffersOutputWhileDetached;
 + (BOOL)navigatePanesInReadingOrder;
 + (BOOL)neverWarnAboutMeta;
 + (BOOL)neverWarnAboutOverrides;
@@ -70,6 +70,7 @@
 #import "iTermOrphanServerAdopter.h"
 #import "iTermPasswordManagerWindowController.h"
 #import "iTermPasteHelper.h"
+#import "iTermPipelineMetrics.h"
 #import "iTermPreciseTimer.h"
 #import "iTermPreferences.h"
 #import "iTermProfilesMenuController.h"
@@ -1474,6 +1475,12 @@ static BOOL hasBecomeActive = NO;
     [pboard setString:copyString forType:NSPasteboardTypeString];
 }
 
+- (IBAction)copyPipelineMetrics:(id)sender {
+    NSPasteboard *pboard = [NSPasteboard generalPasteboard];
+    [pboard declareTypes:@[ NSPasteboardTypeString ] owner:self];
+    [pboard setString:[iTermPipelineMetrics stringValue] forType:NSPasteboardTypeString];
+}
+
 - (IBAction)checkForUpdatesFromMenu:(id)sender {
     [suUpdater checkForUpdates:(sender)];
 }
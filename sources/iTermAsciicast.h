@@ -0,0 +1,32 @@
+//
+//  iTermAsciicast.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class DVR;
+
+extern NSString *const iTermAsciicastErrorDomain;
+
+// Converts between instant replay recordings and asciicast v2 files, which other players and
+// tools understand. See https://docs.asciinema.org/manual/asciicast/v2/
+@interface iTermAsciicast : NSObject
+
+// Each frame between `from` and `to` (inclusive timestamps) becomes an output event that redraws
+// the lines that changed since the previous frame. Colors and the common text attributes are
+// kept; images are not.
++ (NSData *)dataFromDVR:(DVR *)dvr from:(long long)from to:(long long)to;
+
+// Plays the output and resize events through a terminal emulator and records a frame after each
+// one. Input and marker events are ignored. Frames too old to fit in the instant replay buffer
+// are lost.
++ (nullable DVR *)dvrFromData:(NSData *)data error:(out NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,310 @@
+//
+//  iTermAsciicast.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermAsciicast.h"
+
+#import "CVector.h"
+#import "DebugLogging.h"
+#import "DVR.h"
+#import "ScreenChar.h"
+#import "VT100Parser.h"
+#import "VT100Screen.h"
+#import "VT100Terminal.h"
+#import "VT100Token.h"
+
+NSString *const iTermAsciicastErrorDomain = @"com.iterm2.asciicast";
+
+@implementation iTermAsciicast
+
+#pragma mark - Export
+
++ (NSData *)dataFromDVR:(DVR *)dvr from:(long long)from to:(long long)to {
+    NSMutableData *result = [NSMutableData data];
+    DVRDecoder *decoder = [dvr getDecoder];
+    NSData *previousFrame = nil;
+    DVRFrameInfo previousInfo = { 0 };
+    long long start = 0;
+    if ([decoder seek:from]) {
+        do {
+            if (decoder.timestamp > to) {
+                break;
+            }
+            const DVRFrameInfo info = decoder.info;
+            NSData *frame = [NSData dataWithBytes:decoder.decodedFrame length:decoder.length];
+            const BOOL first = (previousInfo.width == 0);
+            if (first) {
+                start = info.timestamp;
+                [self appendJSONObject:@{ @"version": @2,
+                                          @"width": @(info.width),
+                                          @"height": @(info.height),
+                                          @"timestamp": @(start / 1000000) }
+                                toData:result];
+            }
+            const NSTimeInterval time = (info.timestamp - start) / 1000000.0;
+            if (!first && (info.width != previousInfo.width || info.height != previousInfo.height)) {
+                NSString *size = [NSString stringWithFormat:@"%dx%d", info.width, info.height];
+                [self appendJSONObject:@[ @(time), @"r", size ] toData:result];
+                // Redraw everything.
+                previousFrame = nil;
+            }
+            NSString *output = [self outputForFrame:frame
+                                               info:info
+                                      previousFrame:previousFrame
+                                       previousInfo:previousInfo];
+            if (output.length) {
+                [self appendJSONObject:@[ @(time), @"o", output ]
+                                toData:result];
+            }
+            previousFrame = frame;
+            previousInfo = info;
+        } while ([decoder next]);
+    }
+    [dvr releaseDecoder:decoder];
+    return result;
+}
+
++ (void)appendJSONObject:(id)object toData:(NSMutableData *)data {
+    NSError *error = nil;
+    NSData *json = [NSJSONSerialization dataWithJSONObject:object options:0 error:&error];
+    if (!json) {
+        DLog(@"Failed to encode %@: %@", object, error);
+        return;
+    }
+    [data appendData:json];
+    [data appendBytes:"\n" length:1];
+}
+
+// Returns the control sequences that change the previous frame into this one, or an empty string
+// if they look the same. If there is no previous frame the screen is cleared and fully drawn.
++ (NSString *)outputForFrame:(NSData *)frame
+                        info:(DVRFrameInfo)info
+               previousFrame:(NSData *)previousFrame
+                previousInfo:(DVRFrameInfo)previousInfo {
+    NSMutableString *output = [NSMutableString string];
+    if (!previousFrame) {
+        [output appendString:@"\033[0m\033[H\033[2J"];
+    }
+    const int lineLength = info.width + 1;
+    const screen_char_t *lines = frame.bytes;
+    const screen_char_t *previousLines = previousFrame.bytes;
+    for (int y = 0; y < info.height; y++) {
+        const screen_char_t *line = lines + y * lineLength;
+        if (previousLines &&
+            !memcmp(line, previousLines + y * lineLength, lineLength * sizeof(screen_char_t))) {
+            continue;
+        }
+        [output appendFormat:@"\033[%d;1H", y + 1];
+        NSString *lastSGR = nil;
+        for (int x = 0; x < info.width; x++) {
+            const screen_char_t c = line[x];
+            if (!c.complexChar && c.code == DWC_RIGHT) {
+                // Drawing the left half moved the cursor past this cell.
+                continue;
+            }
+            NSString *sgr = [self sgrForCharacter:c];
+            if (![sgr isEqualToString:lastSGR]) {
+                [output appendString:sgr];
+                lastSGR = sgr;
+            }
+            [output appendString:[self stringForCharacter:c]];
+        }
+        [output appendString:@"\033[0m\033[K"];
+    }
+    if (output.length == 0 &&
+        info.cursorX == previousInfo.cursorX &&
+        info.cursorY == previousInfo.cursorY) {
+        return @"";
+    }
+    [output appendFormat:@"\033[%d;%dH", info.cursorY + 1, info.cursorX + 1];
+    return output;
+}
+
++ (NSString *)stringForCharacter:(screen_char_t)c {
+    if (c.image) {
+        return @" ";
+    }
+    if (!c.complexChar) {
+        switch (c.code) {
+            case 0:
+            case TAB_FILLER:
+            case DWC_SKIP:
+            case BOGUS_CHAR:
+                return @" ";
+        }
+    }
+    return ScreenCharToStr(&c) ?: @" ";
+}
+
+// Returns a sequence that resets attributes and then sets those of `c`.
++ (NSString *)sgrForCharacter:(screen_char_t)c {
+    NSMutableString *sgr = [NSMutableString stringWithString:@"\033[0"];
+    [self appendColor:c.foregroundColor
+                green:c.fgGreen
+                 blue:c.fgBlue
+                 mode:c.foregroundColorMode
+                 base:30
+           brightBase:90
+            extension:38
+                   to:sgr];
+    [self appendColor:c.backgroundColor
+                green:c.bgGreen
+                 blue:c.bgBlue
+                 mode:c.backgroundColorMode
+                 base:40
+           brightBase:100
+            extension:48
+                   to:sgr];
+    if (c.bold) {
+        [sgr appendString:@";1"];
+    }
+    if (c.faint) {
+        [sgr appendString:@";2"];
+    }
+    if (c.italic) {
+        [sgr appendString:@";3"];
+    }
+    if (c.underline) {
+        [sgr appendString:@";4"];
+    }
+    if (c.blink) {
+        [sgr appendString:@";5"];
+    }
+    if (c.strikethrough) {
+        [sgr appendString:@";9"];
+    }
+    [sgr appendString:@"m"];
+    return sgr;
+}
+
++ (void)appendColor:(int)color
+              green:(int)green
+               blue:(int)blue
+               mode:(ColorMode)mode
+               base:(int)base
+         brightBase:(int)brightBase
+          extension:(int)extension
+                 to:(NSMutableString *)sgr {
+    switch (mode) {
+        case ColorModeNormal:
+            if (color < 8) {
+                [sgr appendFormat:@";%d", base + color];
+            } else if (color < 16) {
+                [sgr appendFormat:@";%d", brightBase + color - 8];
+            } else {
+                [sgr appendFormat:@";%d;5;%d", extension, color];
+            }
+            break;
+
+        case ColorMode24bit:
+            [sgr appendFormat:@";%d;2;%d;%d;%d", extension, color, green, blue];
+            break;
+
+        case ColorModeAlternate:
+        case ColorModeInvalid:
+            // Default colors.
+            break;
+    }
+}
+
+#pragma mark - Import
+
++ (void)setError:(out NSError **)error description:(NSString *)description {
+    if (error) {
+        *error = [NSError errorWithDomain:iTermAsciicastErrorDomain
+                                     code:0
+                                 userInfo:@{ NSLocalizedDescriptionKey: description }];
+    }
+}
+
++ (DVR *)dvrFromData:(NSData *)data error:(out NSError **)error {
+    NSString *string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    if (!string) {
+        [self setError:error description:@"The file is not UTF-8 text."];
+        return nil;
+    }
+    NSArray<NSString *> *lines = [string componentsSeparatedByString:@"\n"];
+    NSDictionary *header = [NSJSONSerialization JSONObjectWithData:[lines.firstObject dataUsingEncoding:NSUTF8StringEncoding]
+                                                           options:0
+                                                             error:nil];
+    if (![header isKindOfClass:[NSDictionary class]] ||
+        ![header[@"version"] isEqual:@2] ||
+        [header[@"width"] intValue] <= 0 ||
+        [header[@"height"] intValue] <= 0) {
+        [self setError:error description:@"The file is not an asciicast version 2 recording."];
+        return nil;
+    }
+
+    VT100Terminal *terminal = [[VT100Terminal alloc] init];
+    terminal.encoding = NSUTF8StringEncoding;
+    VT100Screen *screen = [[VT100Screen alloc] initWithTerminal:terminal];
+    terminal.delegate = screen;
+    [screen setSize:VT100GridSizeMake([header[@"width"] intValue], [header[@"height"] intValue])];
+    DVR *dvr = screen.dvr;
+
+    // The encoder substitutes the current time for a timestamp of 0, so never use it.
+    long long start = [header[@"timestamp"] longLongValue] * 1000000;
+    if (start <= 0) {
+        start = (long long)([[NSDate date] timeIntervalSince1970] * 1000000);
+    }
+    long long lastTimestamp = start;
+    [screen saveToDvr:nil timestamp:start];
+
+    for (NSUInteger i = 1; i < lines.count; i++) {
+        if (lines[i].length == 0) {
+            continue;
+        }
+        NSArray *event = [NSJSONSerialization JSONObjectWithData:[lines[i] dataUsingEncoding:NSUTF8StringEncoding]
+                                                         options:0
+                                                           error:nil];
+        if (![event isKindOfClass:[NSArray class]] ||
+            event.count < 3 ||
+            ![event[0] isKindOfClass:[NSNumber class]] ||
+            ![event[1] isKindOfClass:[NSString class]] ||
+            ![event[2] isKindOfClass:[NSString class]]) {
+            DLog(@"Skip malformed event on line %@: %@", @(i + 1), lines[i]);
+            continue;
+        }
+        NSString *type = event[1];
+        NSString *eventData = event[2];
+        if ([type isEqualToString:@"o"]) {
+            [self executeOutput:eventData terminal:terminal];
+        } else if ([type isEqualToString:@"r"]) {
+            int width = 0;
+            int height = 0;
+            if (sscanf(eventData.UTF8String, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                DLog(@"Skip malformed resize event %@", eventData);
+                continue;
+            }
+            [screen setSize:VT100GridSizeMake(width, height)];
+        } else {
+            continue;
+        }
+        // Seeking needs timestamps in order.
+        const long long timestamp = MAX(lastTimestamp, start + llround([event[0] doubleValue] * 1000000));
+        [screen saveToDvr:nil timestamp:timestamp];
+        lastTimestamp = timestamp;
+    }
+    return dvr;
+}
+
++ (void)executeOutput:(NSString *)output terminal:(VT100Terminal *)terminal {
+    NSData *data = [output dataUsingEncoding:NSUTF8StringEncoding];
+    [terminal.parser putStreamData:data.bytes length:data.length];
+
+    CVector vector;
+    CVectorCreate(&vector, 100);
+    [terminal.parser addParsedTokensToVector:&vector];
+    const int n = CVectorCount(&vector);
+    for (int i = 0; i < n; i++) {
+        // The parser returns tokens retained.
+        VT100Token *token = (__bridge_transfer VT100Token *)CVectorGet(&vector, i);
+        [terminal executeToken:token];
+    }
+    CVectorDestroy(&vector);
+}
+
+@end
@@ -0,0 +1,58 @@
+//
+//  iTermAutocompleteIndex.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "ScreenChar.h"
+
+@class LineBuffer;
+
+// A word found by iTermAutocompleteIndex.
+@interface iTermAutocompleteIndexMatch : NSObject
+
+@property(nonatomic, readonly) NSString *word;
+
+// Up to four words that preceded its most recent occurrence, nearest first.
+@property(nonatomic, readonly) NSArray<NSString *> *context;
+
+// Up to four distinct words that have followed it, most recent first. Those that were separated
+// from it by whitespace begin with a space.
+@property(nonatomic, readonly) NSArray<NSString *> *followers;
+
+// Each occurrence counts for 1, halving every 1000 lines since it was seen.
+@property(nonatomic, readonly) double weight;
+
+@end
+
+// Indexes the words in a session's history so autocomplete can look them up by prefix instead of
+// searching the line buffer. A word is a run of alphanumerics and the user's extra word
+// characters. Every other non-whitespace character is a word by itself, as in iTermTextExtractor.
+//
+// Lines are added in order. An index that follows a line buffer catches up with it when asked and
+// forgets words whose last occurrence has been dropped.
+@interface iTermAutocompleteIndex : NSObject
+
+// Characters considered part of a word in addition to alphanumerics.
+@property(nonatomic, readonly) NSString *wordCharacters;
+
+- (instancetype)initWithWordCharacters:(NSString *)wordCharacters NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Adds up to |maximumLines| of the complete raw lines appended to |lineBuffer| since the last call
+// and forgets words that only occurred in dropped lines. Lines popped off the end of the buffer are
+// indexed again once they're complete. Always pass the same line buffer. Returns YES if the index
+// has caught up with it.
+- (BOOL)updateWithLineBuffer:(LineBuffer *)lineBuffer maximumLines:(long long)maximumLines;
+
+// Adds a line that isn't in a line buffer, such as one on the screen. If |partial| then the next
+// line added continues it.
+- (void)addCharacters:(const screen_char_t *)chars length:(int)length partial:(BOOL)partial;
+
+// Up to |maximumCount| words beginning with |prefix|, ignoring case, most recently seen first.
+- (NSArray<iTermAutocompleteIndexMatch *> *)matchesWithPrefix:(NSString *)prefix
+                                                 maximumCount:(NSInteger)maximumCount;
+
+@end
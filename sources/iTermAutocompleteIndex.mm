@@ -0,0 +1,417 @@
+//
+//  iTermAutocompleteIndex.mm
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+extern "C" {
+#import "iTermAutocompleteIndex.h"
+
+#import "LineBuffer.h"
+}
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int kContextWords = 4;
+const int kMaxFollowers = 4;
+// An occurrence's contribution to a word's weight halves over this many lines.
+const double kHalfLife = 1000;
+
+enum iTermAutocompleteIndexClass {
+    iTermAutocompleteIndexClassWhitespace,
+    iTermAutocompleteIndexClassWord,
+    iTermAutocompleteIndexClassOther
+};
+
+struct iTermAutocompleteIndexFollower {
+    // Retained.
+    NSString *text;
+    bool separatedByWhitespace;
+};
+
+struct iTermAutocompleteIndexWord {
+    // The word folded with NSCaseInsensitiveSearch.
+    std::u16string folded;
+    // Retained.
+    NSString *text = nil;
+    // As of lastLine.
+    double weight = 0;
+    long long lastLine = 0;
+    // Words before the most recent occurrence, nearest first. Retained; may be nil.
+    NSString *context[kContextWords] = {};
+    std::vector<iTermAutocompleteIndexFollower> followers;
+
+    iTermAutocompleteIndexWord() = default;
+    iTermAutocompleteIndexWord(const iTermAutocompleteIndexWord &) = delete;
+    iTermAutocompleteIndexWord &operator=(const iTermAutocompleteIndexWord &) = delete;
+
+    ~iTermAutocompleteIndexWord() {
+        [text release];
+        for (int i = 0; i < kContextWords; i++) {
+            [context[i] release];
+        }
+        for (auto &follower : followers) {
+            [follower.text release];
+        }
+    }
+};
+
+typedef iTermAutocompleteIndexWord Word;
+
+bool iTermAutocompleteIndexWordLess(const Word *a, const Word *b) {
+    const int comparison = a->folded.compare(b->folded);
+    if (comparison != 0) {
+        return comparison < 0;
+    }
+    return std::less<const Word *>()(a, b);
+}
+
+std::u16string iTermAutocompleteIndexFold(NSString *string) {
+    NSString *folded = [string stringByFoldingWithOptions:NSCaseInsensitiveSearch locale:nil];
+    std::u16string result(folded.length, u'\0');
+    [folded getCharacters:(unichar *)&result[0] range:NSMakeRange(0, folded.length)];
+    return result;
+}
+
+}  // namespace
+
+@interface iTermAutocompleteIndexMatch ()
+@property(nonatomic, retain) NSString *word;
+@property(nonatomic, retain) NSArray<NSString *> *context;
+@property(nonatomic, retain) NSArray<NSString *> *followers;
+@property(nonatomic, assign) double weight;
+@end
+
+@implementation iTermAutocompleteIndexMatch
+
+- (void)dealloc {
+    [_word release];
+    [_context release];
+    [_followers release];
+    [super dealloc];
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p word=%@ weight=%f followers=%@>",
+            NSStringFromClass([self class]), self, _word, _weight, _followers];
+}
+
+@end
+
+@implementation iTermAutocompleteIndex {
+    NSCharacterSet *_whitespaceCharacterSet;
+    NSCharacterSet *_wordCharacterSet;
+    iTermAutocompleteIndexClass _asciiClasses[128];
+
+    // Owns the words. Keyed by the exact text.
+    std::unordered_map<std::u16string, std::unique_ptr<Word>> _words;
+    // Sorted by iTermAutocompleteIndexWordLess.
+    std::vector<Word *> _sorted;
+    // Words added since _sorted was last updated.
+    std::vector<Word *> _unsorted;
+
+    // Number of the line being added.
+    long long _line;
+    // Words on lines before this one have been dropped.
+    long long _firstLine;
+    // The line buffer's numberOfPoppedRawLines as of the last update.
+    long long _numberOfPoppedRawLines;
+
+    // The word being accumulated.
+    std::u16string _token;
+    // The word most recently added, or nullptr at the start.
+    Word *_previous;
+    // Was there whitespace after _previous?
+    BOOL _sawWhitespace;
+    // The words most recently added, nearest first. Retained; may be nil.
+    NSString *_recent[kContextWords];
+}
+
+- (instancetype)initWithWordCharacters:(NSString *)wordCharacters {
+    self = [super init];
+    if (self) {
+        _wordCharacters = [wordCharacters ?: @"" copy];
+        _whitespaceCharacterSet = [[NSCharacterSet whitespaceCharacterSet] retain];
+        NSMutableCharacterSet *wordCharacterSet = [[NSCharacterSet alphanumericCharacterSet] mutableCopy];
+        [wordCharacterSet addCharactersInString:_wordCharacters];
+        _wordCharacterSet = wordCharacterSet;
+        for (unichar c = 0; c < 128; c++) {
+            _asciiClasses[c] = [self uncachedClassOfCharacter:c];
+        }
+        _sawWhitespace = YES;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_wordCharacters release];
+    [_whitespaceCharacterSet release];
+    [_wordCharacterSet release];
+    for (int i = 0; i < kContextWords; i++) {
+        [_recent[i] release];
+    }
+    [super dealloc];
+}
+
+#pragma mark - APIs
+
+- (BOOL)updateWithLineBuffer:(LineBuffer *)lineBuffer maximumLines:(long long)maximumLines {
+    const long long popped = lineBuffer.numberOfPoppedRawLines - _numberOfPoppedRawLines;
+    if (popped > 0) {
+        // Each pop takes back a line number that the buffer will reuse. Lines that had been indexed
+        // are indexed again when they're complete, which adds a little to their words' weights.
+        _numberOfPoppedRawLines = lineBuffer.numberOfPoppedRawLines;
+        _line = MAX(_firstLine, _line - popped);
+    }
+    const long long firstLine = [lineBuffer firstRawLineNumber];
+    if (firstLine > _firstLine) {
+        _firstLine = firstLine;
+        [self removeWordsBeforeLine:firstLine];
+    }
+    __block long long count = 0;
+    _line = [lineBuffer enumerateCompleteRawLinesFromNumber:_line
+                                               maximumCount:maximumLines
+                                                      block:^(const screen_char_t *chars,
+                                                              int length,
+                                                              long long rawLineNumber) {
+                                                          _line = rawLineNumber;
+                                                          count += 1;
+                                                          [self addCharacters:chars
+                                                                       length:length
+                                                                      partial:NO];
+                                                      }];
+    return count < maximumLines;
+}
+
+- (void)addCharacters:(const screen_char_t *)chars length:(int)length partial:(BOOL)partial {
+    for (int i = 0; i < length; i++) {
+        const screen_char_t c = chars[i];
+        if (c.image) {
+            [self addWhitespace];
+            continue;
+        }
+        if (c.complexChar) {
+            NSString *string = ComplexCharToStr(c.code);
+            if (string.length == 0) {
+                [self addWhitespace];
+                continue;
+            }
+            std::u16string units(string.length, u'\0');
+            [string getCharacters:(unichar *)&units[0] range:NSMakeRange(0, string.length)];
+            [self addCharacters:(const unichar *)units.data()
+                          count:units.size()
+                          class:[self classOfCharacter:units[0]]];
+            continue;
+        }
+        const unichar code = c.code;
+        if (code == DWC_RIGHT || code == DWC_SKIP) {
+            // Belongs to the preceding character.
+            continue;
+        }
+        if (code == 0 || code == TAB_FILLER) {
+            [self addWhitespace];
+            continue;
+        }
+        [self addCharacters:&code count:1 class:[self classOfCharacter:code]];
+    }
+    if (!partial) {
+        [self addWhitespace];
+        _line += 1;
+    }
+}
+
+- (NSArray<iTermAutocompleteIndexMatch *> *)matchesWithPrefix:(NSString *)prefix
+                                                 maximumCount:(NSInteger)maximumCount {
+    if (prefix.length == 0 || maximumCount <= 0) {
+        return @[];
+    }
+    [self sortNewWords];
+
+    const std::u16string key = iTermAutocompleteIndexFold(prefix);
+    auto it = std::lower_bound(_sorted.begin(), _sorted.end(), key,
+                               [](const Word *word, const std::u16string &value) {
+                                   return word->folded < value;
+                               });
+    std::vector<Word *> words;
+    for (; it != _sorted.end() && (*it)->folded.compare(0, key.size(), key) == 0; ++it) {
+        words.push_back(*it);
+    }
+
+    const size_t count = std::min<size_t>(words.size(), maximumCount);
+    std::partial_sort(words.begin(), words.begin() + count, words.end(),
+                      [](const Word *a, const Word *b) {
+                          if (a->lastLine != b->lastLine) {
+                              return a->lastLine > b->lastLine;
+                          }
+                          return a->weight > b->weight;
+                      });
+
+    NSMutableArray<iTermAutocompleteIndexMatch *> *matches = [NSMutableArray arrayWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        Word *word = words[i];
+        iTermAutocompleteIndexMatch *match = [[[iTermAutocompleteIndexMatch alloc] init] autorelease];
+        match.word = word->text;
+
+        NSMutableArray<NSString *> *context = [NSMutableArray arrayWithCapacity:kContextWords];
+        for (int j = 0; j < kContextWords && word->context[j]; j++) {
+            [context addObject:word->context[j]];
+        }
+        match.context = context;
+
+        NSMutableArray<NSString *> *followers = [NSMutableArray arrayWithCapacity:word->followers.size()];
+        for (const auto &follower : word->followers) {
+            if (follower.separatedByWhitespace) {
+                [followers addObject:[@" " stringByAppendingString:follower.text]];
+            } else {
+                [followers addObject:follower.text];
+            }
+        }
+        match.followers = followers;
+        match.weight = word->weight * std::exp2((word->lastLine - _line) / kHalfLife);
+        [matches addObject:match];
+    }
+    return matches;
+}
+
+#pragma mark - Private
+
+- (iTermAutocompleteIndexClass)classOfCharacter:(unichar)c {
+    if (c < 128) {
+        return _asciiClasses[c];
+    }
+    return [self uncachedClassOfCharacter:c];
+}
+
+- (iTermAutocompleteIndexClass)uncachedClassOfCharacter:(unichar)c {
+    if ([_whitespaceCharacterSet characterIsMember:c]) {
+        return iTermAutocompleteIndexClassWhitespace;
+    }
+    if ([_wordCharacterSet characterIsMember:c]) {
+        return iTermAutocompleteIndexClassWord;
+    }
+    return iTermAutocompleteIndexClassOther;
+}
+
+- (void)addWhitespace {
+    [self finishWord];
+    _sawWhitespace = YES;
+}
+
+- (void)addCharacters:(const unichar *)characters
+                count:(NSUInteger)count
+                class:(iTermAutocompleteIndexClass)theClass {
+    switch (theClass) {
+        case iTermAutocompleteIndexClassWhitespace:
+            [self addWhitespace];
+            break;
+
+        case iTermAutocompleteIndexClassWord:
+            _token.append((const char16_t *)characters, count);
+            break;
+
+        case iTermAutocompleteIndexClassOther:
+            [self finishWord];
+            _token.append((const char16_t *)characters, count);
+            [self finishWord];
+            break;
+    }
+}
+
+- (void)finishWord {
+    if (_token.empty()) {
+        return;
+    }
+    Word *word;
+    auto it = _words.find(_token);
+    if (it == _words.end()) {
+        word = new Word;
+        word->text = [[NSString alloc] initWithCharacters:(const unichar *)_token.data()
+                                                   length:_token.size()];
+        word->folded = iTermAutocompleteIndexFold(word->text);
+        _words.emplace(_token, std::unique_ptr<Word>(word));
+        _unsorted.push_back(word);
+    } else {
+        word = it->second.get();
+        word->weight *= std::exp2((word->lastLine - _line) / kHalfLife);
+    }
+    _token.clear();
+
+    word->weight += 1;
+    word->lastLine = _line;
+    for (int i = 0; i < kContextWords; i++) {
+        [_recent[i] retain];
+        [word->context[i] release];
+        word->context[i] = _recent[i];
+    }
+    if (_previous) {
+        [self addFollower:word toWord:_previous];
+    }
+
+    [_recent[kContextWords - 1] release];
+    for (int i = kContextWords - 1; i > 0; i--) {
+        _recent[i] = _recent[i - 1];
+    }
+    _recent[0] = [word->text retain];
+
+    _previous = word;
+    _sawWhitespace = NO;
+}
+
+- (void)addFollower:(Word *)follower toWord:(Word *)word {
+    auto &followers = word->followers;
+    auto it = std::find_if(followers.begin(), followers.end(),
+                           [follower](const iTermAutocompleteIndexFollower &existing) {
+                               return existing.text == follower->text;
+                           });
+    if (it == followers.end()) {
+        if (followers.size() == kMaxFollowers) {
+            [followers.back().text release];
+            followers.pop_back();
+        }
+        followers.insert(followers.begin(), { [follower->text retain], (bool)_sawWhitespace });
+    } else {
+        iTermAutocompleteIndexFollower existing = *it;
+        existing.separatedByWhitespace = _sawWhitespace;
+        followers.erase(it);
+        followers.insert(followers.begin(), existing);
+    }
+}
+
+- (void)sortNewWords {
+    if (_unsorted.empty()) {
+        return;
+    }
+    std::sort(_unsorted.begin(), _unsorted.end(), iTermAutocompleteIndexWordLess);
+    const size_t middle = _sorted.size();
+    _sorted.insert(_sorted.end(), _unsorted.begin(), _unsorted.end());
+    std::inplace_merge(_sorted.begin(), _sorted.begin() + middle, _sorted.end(),
+                       iTermAutocompleteIndexWordLess);
+    _unsorted.clear();
+}
+
+- (void)removeWordsBeforeLine:(long long)line {
+    auto isStale = [line](const Word *word) {
+        return word->lastLine < line;
+    };
+    _sorted.erase(std::remove_if(_sorted.begin(), _sorted.end(), isStale), _sorted.end());
+    _unsorted.erase(std::remove_if(_unsorted.begin(), _unsorted.end(), isStale), _unsorted.end());
+    if (_previous && isStale(_previous)) {
+        _previous = nullptr;
+    }
+    for (auto it = _words.begin(); it != _words.end(); ) {
+        if (isStale(it->second.get())) {
+            it = _words.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+@end
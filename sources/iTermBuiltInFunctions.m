@@ -8,6 +8,7 @@
 #import "iTermBuiltInFunctions.h"
 
 #import "iTermAlertBuiltInFunction.h"
+#import "iTermPipelineMetricsBuiltInFunction.h"
 #import "iTermReflection.h"
 #import "iTermSetStatusBarComponentUnreadCountBuiltInFunction.h"
 #import "iTermVariableReference.h"
@@ -150,6 +151,7 @@ NSString *iTermNamespaceFromSignature(NSString *signature) {
     [iTermAlertBuiltInFunction registerBuiltInFunction];
     [iTermGetStringBuiltInFunction registerBuiltInFunction];
     [iTermSetStatusBarComponentUnreadCountBuiltInFunction registerBuiltInFunction];
+    [iTermPipelineMetricsBuiltInFunction registerBuiltInFunction];
 }
 
 + (instancetype)sharedInstance {
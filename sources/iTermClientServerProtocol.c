@@ -70,6 +70,10 @@ static size_t iTermClientServerProtocolParserBytesLeft(iTermClientServerProtocol
     return length - parser->offset;
 }
 
+int iTermClientServerProtocolParserHasMoreData(iTermClientServerProtocolMessageParser *parser) {
+    return iTermClientServerProtocolParserBytesLeft(parser) > 0;
+}
+
 static void iTermClientServerProtocolParserCopyAndAdvance(iTermClientServerProtocolMessageParser *parser,
                                                           void *out,
                                                           size_t size) {
@@ -175,6 +179,30 @@ int iTermClientServerProtocolParseTaggedStringArray(iTermClientServerProtocolMes
     return iTermClientServerProtocolParseStringArray(parser, tag, arrayOut, countOut);
 }
 
+int iTermClientServerProtocolParseTaggedData(iTermClientServerProtocolMessageParser *parser,
+                                             char **out,
+                                             size_t *lengthOut,
+                                             int tag) {
+    int actualTag;
+    if (iTermClientServerProtocolParseInt(parser, &actualTag, sizeof(actualTag))) {
+        return iTermClientServerProtocolErrorTagTruncated;
+    }
+    if (actualTag != tag) {
+        return iTermClientServerProtocolErrorUnexpectedTag;
+    }
+    size_t length;
+    if (iTermClientServerProtocolParseInt(parser, &length, sizeof(length))) {
+        return iTermClientServerProtocolErrorLengthTruncated;
+    }
+    if (iTermClientServerProtocolParserBytesLeft(parser) < length) {
+        return iTermClientServerProtocolErrorValueTruncated;
+    }
+    *out = malloc(MAX(1, length));
+    iTermClientServerProtocolParserCopyAndAdvance(parser, *out, length);
+    *lengthOut = length;
+    return 0;
+}
+
 #pragma mark - Encoding
 
 static size_t iTermClientServerProtocolEncoderBytesLeft(iTermClientServerProtocolMessageEncoder *encoder) {
@@ -253,6 +281,16 @@ int iTermClientServerProtocolEncodeTaggedStringArray(iTermClientServerProtocolMe
     return iTermClientServerProtocolEncodeStringArray(encoder, tag, array, count);
 }
 
+int iTermClientServerProtocolEncodeTaggedData(iTermClientServerProtocolMessageEncoder *encoder,
+                                              const char *bytes,
+                                              size_t length,
+                                              int tag) {
+    iTermClientServerProtocolEncodeInt(encoder, &tag, sizeof(tag));
+    iTermClientServerProtocolEncodeInt(encoder, &length, sizeof(length));
+    iTermClientServerProtocolEncoderCopyAndAdvance(encoder, bytes, length);
+    return 0;
+}
+
 void iTermEncoderCommit(iTermClientServerProtocolMessageEncoder *encoder) {
     encoder->message->ioVectors[0].iov_len = encoder->offset;
 }
@@ -13,7 +13,7 @@ extern const int ITERM_MULTISERVER_MAGIC;
 typedef struct {
     int valid;
     struct msghdr message;
-    iTermFileDescriptorControlMessage controlBuffer;
+    iTermFileDescriptorBatchControlMessage controlBuffer;
 
     // "real" storage that message iovectors may choose to use.
     struct iovec ioVectors[1];
@@ -36,6 +36,10 @@ void iTermClientServerProtocolMessageEnsureSpace(iTermClientServerProtocolMessag
 
 void iTermClientServerProtocolMessageFree(iTermClientServerProtocolMessage *message);
 
+// Returns nonzero if the parser has not reached the end of the message. Use this before parsing a
+// field that older peers don't send.
+int iTermClientServerProtocolParserHasMoreData(iTermClientServerProtocolMessageParser *parser);
+
 int iTermClientServerProtocolParseTaggedInt(iTermClientServerProtocolMessageParser *parser,
                                             void *out,
                                             size_t size,
@@ -50,6 +54,11 @@ int iTermClientServerProtocolParseTaggedStringArray(iTermClientServerProtocolMes
                                                     int *countOut,
                                                     int tag);
 
+int iTermClientServerProtocolParseTaggedData(iTermClientServerProtocolMessageParser *parser,
+                                             char **out,
+                                             size_t *lengthOut,
+                                             int tag);
+
 int iTermClientServerProtocolEncodeTaggedInt(iTermClientServerProtocolMessageEncoder *encoder,
                                              void *valuePtr,
                                              size_t size,
@@ -64,4 +73,9 @@ int iTermClientServerProtocolEncodeTaggedStringArray(iTermClientServerProtocolMe
                                                      int count,
                                                      int tag);
 
+int iTermClientServerProtocolEncodeTaggedData(iTermClientServerProtocolMessageEncoder *encoder,
+                                              const char *bytes,
+                                              size_t length,
+                                              int tag);
+
 void iTermEncoderCommit(iTermClientServerProtocolMessageEncoder *encoder);
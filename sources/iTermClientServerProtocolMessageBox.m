@@ -19,11 +19,16 @@
 + (instancetype)withMessage:(iTermMultiServerMessage *)message {
     iTermClientServerProtocolMessageBox *box = [[iTermClientServerProtocolMessageBox alloc] init];
     iTermClientServerProtocolMessageInitialize(&box->_protocolMessage);
-    if (message.fileDescriptor) {
-        box->_protocolMessage.controlBuffer.cm.cmsg_len = CMSG_LEN(sizeof(int));
+    NSArray<NSNumber *> *fileDescriptors = message.fileDescriptors;
+    if (fileDescriptors.count) {
+        assert(fileDescriptors.count <= ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE);
+        box->_protocolMessage.controlBuffer.cm.cmsg_len = CMSG_LEN(sizeof(int) * fileDescriptors.count);
         box->_protocolMessage.controlBuffer.cm.cmsg_level = SOL_SOCKET;
         box->_protocolMessage.controlBuffer.cm.cmsg_type = SCM_RIGHTS;
-        *((int *)CMSG_DATA(&box->_protocolMessage.controlBuffer.cm)) = message.fileDescriptor.intValue;
+        int *fds = (int *)CMSG_DATA(&box->_protocolMessage.controlBuffer.cm);
+        [fileDescriptors enumerateObjectsUsingBlock:^(NSNumber * _Nonnull fd, NSUInteger i, BOOL * _Nonnull stop) {
+            fds[i] = fd.intValue;
+        }];
     }
     iTermClientServerProtocolMessageEnsureSpace(&box->_protocolMessage, message.data.length);
     memmove(box->_protocolMessage.message.msg_iov[0].iov_base, message.data.bytes, message.data.length);
@@ -0,0 +1,33 @@
+//
+//  iTermCommandHistoryIndex.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+@class iTermCommandHistoryEntryMO;
+
+// An in-memory index of one host's command history entries for fast prefix search. Commands are
+// kept sorted by their case-folded text, so the entries with a given prefix are a contiguous
+// range, and separately sorted by rank, which is the order of -[iTermCommandHistoryEntryMO compare:].
+//
+// Entries are not retained. They belong to the host record's managed object context, so the index
+// must be discarded whenever entries are deleted or the object graph is reloaded.
+@interface iTermCommandHistoryIndex : NSObject
+
+- (instancetype)initWithEntries:(id<NSFastEnumeration>)entries NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Returns the entry whose command is exactly `command`, or nil.
+- (iTermCommandHistoryEntryMO *)entryWithCommand:(NSString *)command;
+
+// Adds an entry that isn't in the index yet, or updates the rank of one that is after its number
+// of uses or time of last use changed.
+- (void)updateEntry:(iTermCommandHistoryEntryMO *)entry;
+
+// Up to `limit` entries whose commands begin with `prefix`, ignoring case, best first.
+- (NSArray<iTermCommandHistoryEntryMO *> *)entriesWithPrefix:(NSString *)prefix limit:(NSInteger)limit;
+
+@end
@@ -0,0 +1,199 @@
+//
+//  iTermCommandHistoryIndex.mm
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+extern "C" {
+#import "iTermCommandHistoryIndex.h"
+
+#import "iTermCommandHistoryEntryMO.h"
+}
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct iTermCommandHistoryIndexRecord {
+    // The command folded with NSCaseInsensitiveSearch.
+    std::u16string folded;
+    // Not retained.
+    iTermCommandHistoryEntryMO *entry;
+    // Copied from the entry so ranking doesn't touch Core Data.
+    NSInteger uses;
+    NSTimeInterval lastUse;
+};
+
+typedef iTermCommandHistoryIndexRecord Record;
+
+// Orders records by folded command. Ties are broken so every record has exactly one position.
+bool iTermCommandHistoryIndexCommandLess(const Record *a, const Record *b) {
+    const int comparison = a->folded.compare(b->folded);
+    if (comparison != 0) {
+        return comparison < 0;
+    }
+    return std::less<void *>()(a->entry, b->entry);
+}
+
+// Best first, like -[iTermCommandHistoryEntryMO compare:].
+bool iTermCommandHistoryIndexRankLess(const Record *a, const Record *b) {
+    if (a->uses != b->uses) {
+        return a->uses > b->uses;
+    }
+    if (a->lastUse != b->lastUse) {
+        return a->lastUse > b->lastUse;
+    }
+    return iTermCommandHistoryIndexCommandLess(a, b);
+}
+
+std::u16string iTermCommandHistoryIndexFold(NSString *string) {
+    NSString *folded = [string ?: @"" stringByFoldingWithOptions:NSCaseInsensitiveSearch locale:nil];
+    std::u16string result(folded.length, u'\0');
+    [folded getCharacters:(unichar *)&result[0] range:NSMakeRange(0, folded.length)];
+    return result;
+}
+
+}  // namespace
+
+@implementation iTermCommandHistoryIndex {
+    // Sorted by iTermCommandHistoryIndexCommandLess.
+    std::vector<Record *> _byCommand;
+    // Sorted by iTermCommandHistoryIndexRankLess.
+    std::vector<Record *> _byRank;
+    // Owns the records.
+    std::unordered_map<void *, Record *> _records;
+}
+
+- (instancetype)initWithEntries:(id<NSFastEnumeration>)entries {
+    self = [super init];
+    if (self) {
+        for (iTermCommandHistoryEntryMO *entry in entries) {
+            Record *record = [self makeRecordForEntry:entry];
+            _records[entry] = record;
+            _byCommand.push_back(record);
+        }
+        std::sort(_byCommand.begin(), _byCommand.end(), iTermCommandHistoryIndexCommandLess);
+        _byRank = _byCommand;
+        std::sort(_byRank.begin(), _byRank.end(), iTermCommandHistoryIndexRankLess);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (auto &pair : _records) {
+        delete pair.second;
+    }
+    [super dealloc];
+}
+
+- (Record *)makeRecordForEntry:(iTermCommandHistoryEntryMO *)entry {
+    Record *record = new Record;
+    record->folded = iTermCommandHistoryIndexFold(entry.command);
+    record->entry = entry;
+    record->uses = entry.numberOfUses.integerValue;
+    record->lastUse = entry.timeOfLastUse.doubleValue;
+    return record;
+}
+
+- (iTermCommandHistoryEntryMO *)entryWithCommand:(NSString *)command {
+    const std::u16string folded = iTermCommandHistoryIndexFold(command);
+    auto it = std::lower_bound(_byCommand.begin(), _byCommand.end(), folded,
+                               [](const Record *record, const std::u16string &key) {
+                                   return record->folded < key;
+                               });
+    // Commands that differ only in case share a folded key.
+    for (; it != _byCommand.end() && (*it)->folded == folded; ++it) {
+        if ([(*it)->entry.command isEqualToString:command]) {
+            return (*it)->entry;
+        }
+    }
+    return nil;
+}
+
+- (void)updateEntry:(iTermCommandHistoryEntryMO *)entry {
+    auto existing = _records.find(entry);
+    if (existing == _records.end()) {
+        Record *record = [self makeRecordForEntry:entry];
+        _records[entry] = record;
+        _byCommand.insert(std::upper_bound(_byCommand.begin(), _byCommand.end(), record,
+                                           iTermCommandHistoryIndexCommandLess),
+                          record);
+        _byRank.insert(std::upper_bound(_byRank.begin(), _byRank.end(), record,
+                                        iTermCommandHistoryIndexRankLess),
+                       record);
+        return;
+    }
+
+    Record *record = existing->second;
+    auto position = std::lower_bound(_byRank.begin(), _byRank.end(), record,
+                                     iTermCommandHistoryIndexRankLess);
+    if (position != _byRank.end() && *position == record) {
+        _byRank.erase(position);
+    }
+    record->uses = entry.numberOfUses.integerValue;
+    record->lastUse = entry.timeOfLastUse.doubleValue;
+    _byRank.insert(std::upper_bound(_byRank.begin(), _byRank.end(), record,
+                                    iTermCommandHistoryIndexRankLess),
+                   record);
+}
+
+- (NSArray<iTermCommandHistoryEntryMO *> *)entriesWithPrefix:(NSString *)prefix limit:(NSInteger)limit {
+    if (limit <= 0) {
+        return @[];
+    }
+    const size_t max = limit;
+    std::vector<Record *> matches;
+    if (prefix.length == 0) {
+        matches.assign(_byRank.begin(), _byRank.begin() + std::min(max, _byRank.size()));
+    } else {
+        const std::u16string key = iTermCommandHistoryIndexFold(prefix);
+        auto begin = std::lower_bound(_byCommand.begin(), _byCommand.end(), key,
+                                      [](const Record *record, const std::u16string &value) {
+                                          return record->folded < value;
+                                      });
+        auto end = std::upper_bound(begin, _byCommand.end(), key,
+                                    [](const std::u16string &value, const Record *record) {
+                                        return record->folded.compare(0, value.size(), value) > 0;
+                                    });
+        const size_t count = end - begin;
+        if (count == 0) {
+            return @[];
+        }
+        // Sorting the matches costs about count * log(limit). Walking the ranked list until enough
+        // matches turn up costs about limit * size / count, which wins for short prefixes that
+        // match much of the history.
+        const double sortCost = count * std::log2(std::max<size_t>(2, std::min(count, max)));
+        const double walkCost = (double)std::min(count, max) * _byRank.size() / count;
+        if (walkCost < sortCost) {
+            for (Record *record : _byRank) {
+                if (record->folded.compare(0, key.size(), key) == 0) {
+                    matches.push_back(record);
+                    if (matches.size() == max) {
+                        break;
+                    }
+                }
+            }
+        } else {
+            matches.assign(begin, end);
+            if (matches.size() > max) {
+                std::partial_sort(matches.begin(), matches.begin() + max, matches.end(),
+                                  iTermCommandHistoryIndexRankLess);
+                matches.resize(max);
+            } else {
+                std::sort(matches.begin(), matches.end(), iTermCommandHistoryIndexRankLess);
+            }
+        }
+    }
+
+    NSMutableArray<iTermCommandHistoryEntryMO *> *result = [NSMutableArray arrayWithCapacity:matches.size()];
+    for (Record *record : matches) {
+        [result addObject:record->entry];
+    }
+    return result;
+}
+
+@end
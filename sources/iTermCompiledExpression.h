@@ -0,0 +1,47 @@
+//
+//  iTermCompiledExpression.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class iTermParsedExpression;
+@class iTermVariableScope;
+
+// An expression or interpolated string parsed once, independent of any scope. Variable references
+// are left as placeholders, so producing the iTermParsedExpression for a particular scope is a
+// walk over the tree rather than a reparse. Get one from the class methods, which cache by source
+// string.
+@interface iTermCompiledExpression : NSObject
+
+// Paths of all variables the expression refers to, including in function call arguments and
+// nested interpolated strings.
+@property (nonatomic, readonly) NSSet<NSString *> *dependencies;
+
+// If NO then the value depends only on `dependencies`.
+@property (nonatomic, readonly) BOOL containsFunctionCall;
+
+// A string like foo\(bar)baz.
++ (instancetype)compiledInterpolatedString:(NSString *)swifty;
+
+// An expression like bar or f(x: "\(bar)").
++ (instancetype)compiledExpression:(NSString *)expression;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Returns the same result as parsing the source string with `scope`. Variables are looked up
+// through `scope`, so a recording scope records them. `escapingFunction` and `strict` only affect
+// interpolated strings; see +[iTermExpressionParser parsedExpressionWithInterpolatedString:escapingFunction:scope:strict:].
+- (iTermParsedExpression *)parsedExpressionWithScope:(iTermVariableScope *)scope
+                                    escapingFunction:(NSString *(^ _Nullable)(NSString *string))escapingFunction
+                                              strict:(BOOL)strict;
+
+- (iTermParsedExpression *)parsedExpressionWithScope:(iTermVariableScope *)scope;
+
+@end
+
+NS_ASSUME_NONNULL_END
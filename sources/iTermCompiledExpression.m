@@ -0,0 +1,305 @@
+//
+//  iTermCompiledExpression.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermCompiledExpression.h"
+
+#import "DebugLogging.h"
+#import "iTermAdvancedSettingsModel.h"
+#import "iTermExpressionParser+Private.h"
+#import "iTermScriptFunctionCall+Private.h"
+#import "iTermTuple.h"
+#import "iTermVariableScope.h"
+#import "NSObject+iTerm.h"
+#import "NSStringITerm.h"
+
+@implementation iTermCompiledExpression {
+    // For an interpolated string with no interpolations, the whole value.
+    NSString *_literal;
+
+    // For an interpolated string, literal parts are NSStrings and interpolations are expressions
+    // with placeholders. Literals are kept separate because the escaping function applies to the
+    // values of interpolations but not to literals.
+    NSArray *_parts;
+
+    // For an expression, the expression with placeholders.
+    iTermParsedExpression *_expression;
+}
+
++ (NSCache<NSString *, iTermCompiledExpression *> *)cache {
+    static NSCache<NSString *, iTermCompiledExpression *> *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc] init];
+        // Titles, badges, and status bar components across all profiles.
+        cache.countLimit = 1024;
+    });
+    return cache;
+}
+
++ (instancetype)compiledInterpolatedString:(NSString *)swifty {
+    NSString *key = [@"s" stringByAppendingString:swifty];
+    iTermCompiledExpression *compiled = [self.cache objectForKey:key];
+    if (!compiled) {
+        compiled = [[self alloc] initWithInterpolatedString:swifty];
+        [self.cache setObject:compiled forKey:key];
+    }
+    return compiled;
+}
+
++ (instancetype)compiledExpression:(NSString *)expression {
+    NSString *key = [@"e" stringByAppendingString:expression];
+    iTermCompiledExpression *compiled = [self.cache objectForKey:key];
+    if (!compiled) {
+        compiled = [[self alloc] initWithExpression:expression];
+        [self.cache setObject:compiled forKey:key];
+    }
+    return compiled;
+}
+
+- (instancetype)initWithInterpolatedString:(NSString *)swifty {
+    self = [super init];
+    if (self) {
+        __block BOOL allLiterals = YES;
+        NSMutableArray *parts = [NSMutableArray array];
+        iTermVariableScope *placeholderScope = [[iTermVariablePlaceholderScope alloc] init];
+        [swifty enumerateSwiftySubstrings:^(NSUInteger index, NSString *substring, BOOL isLiteral, BOOL *stop) {
+            if (isLiteral) {
+                [parts addObject:[substring it_stringByExpandingBackslashEscapedCharacters]];
+                return;
+            }
+            allLiterals = NO;
+
+            // Use a new parser because this may be reached while another parser is parsing a
+            // nested interpolated string.
+            iTermExpressionParser *parser = [[iTermExpressionParser alloc] initWithStart:@"expression"];
+            iTermParsedExpression *expression = [parser parse:substring scope:placeholderScope];
+            [parts addObject:expression];
+            if (expression.expressionType == iTermParsedExpressionTypeError) {
+                // Syntax errors don't depend on the scope, so nothing after this matters.
+                *stop = YES;
+            }
+        }];
+        if (allLiterals) {
+            _literal = [swifty it_stringByExpandingBackslashEscapedCharacters];
+        } else {
+            _parts = parts;
+        }
+        [self analyze];
+    }
+    return self;
+}
+
+- (instancetype)initWithExpression:(NSString *)expressionString {
+    self = [super init];
+    if (self) {
+        iTermExpressionParser *parser = [[iTermExpressionParser alloc] initWithStart:@"expression"];
+        _expression = [parser parse:expressionString
+                              scope:[[iTermVariablePlaceholderScope alloc] init]];
+        [self analyze];
+    }
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p literal=%@ parts=%@ expression=%@>",
+            NSStringFromClass(self.class), self, _literal, _parts, _expression];
+}
+
+#pragma mark - Analysis
+
+- (void)analyze {
+    NSMutableSet<NSString *> *dependencies = [NSMutableSet set];
+    __block BOOL containsFunctionCall = NO;
+    void (^visit)(iTermParsedExpression *) = ^(iTermParsedExpression *expression) {
+        [self addDependenciesOfExpression:expression to:dependencies];
+        containsFunctionCall = containsFunctionCall || [expression containsAnyFunctionCall];
+    };
+    if (_expression) {
+        visit(_expression);
+    }
+    for (id part in _parts) {
+        if ([part isKindOfClass:[iTermParsedExpression class]]) {
+            visit(part);
+        }
+    }
+    _dependencies = dependencies;
+    _containsFunctionCall = containsFunctionCall;
+}
+
+- (void)addDependenciesOfExpression:(iTermParsedExpression *)expression
+                                 to:(NSMutableSet<NSString *> *)dependencies {
+    switch (expression.expressionType) {
+        case iTermParsedExpressionTypeVariableReference:
+        case iTermParsedExpressionTypeArrayLookup:
+            [dependencies addObject:expression.placeholder.path];
+            return;
+        case iTermParsedExpressionTypeFunctionCall:
+            [expression.functionCall enumerateParametersWithBlock:^(NSString *name,
+                                                                    iTermParsedExpression *argument,
+                                                                    BOOL *stop) {
+                [self addDependenciesOfExpression:argument to:dependencies];
+            }];
+            return;
+        case iTermParsedExpressionTypeArrayOfExpressions:
+            for (iTermParsedExpression *element in expression.arrayOfExpressions) {
+                [self addDependenciesOfExpression:element to:dependencies];
+            }
+            return;
+        case iTermParsedExpressionTypeInterpolatedString:
+            for (iTermParsedExpression *part in expression.interpolatedStringParts) {
+                [self addDependenciesOfExpression:part to:dependencies];
+            }
+            return;
+        case iTermParsedExpressionTypeNil:
+        case iTermParsedExpressionTypeArrayOfValues:
+        case iTermParsedExpressionTypeString:
+        case iTermParsedExpressionTypeNumber:
+        case iTermParsedExpressionTypeError:
+            return;
+    }
+}
+
+#pragma mark - Binding
+
+- (iTermParsedExpression *)parsedExpressionWithScope:(iTermVariableScope *)scope {
+    return [self parsedExpressionWithScope:scope escapingFunction:nil strict:NO];
+}
+
+- (iTermParsedExpression *)parsedExpressionWithScope:(iTermVariableScope *)scope
+                                    escapingFunction:(NSString *(^)(NSString *))escapingFunction
+                                              strict:(BOOL)strict {
+    if (_expression) {
+        return [self bindExpression:_expression scope:scope];
+    }
+    if (_literal) {
+        return [[iTermParsedExpression alloc] initWithString:_literal];
+    }
+    NSMutableArray<iTermParsedExpression *> *interpolatedParts = [NSMutableArray array];
+    for (id part in _parts) {
+        NSString *literal = [NSString castFrom:part];
+        if (literal) {
+            [interpolatedParts addObject:[[iTermParsedExpression alloc] initWithString:literal]];
+            continue;
+        }
+        iTermParsedExpression *expression = [self bindInterpolation:part
+                                                              scope:scope
+                                                   escapingFunction:escapingFunction
+                                                             strict:strict];
+        if (expression.expressionType == iTermParsedExpressionTypeError) {
+            return [[iTermParsedExpression alloc] initWithError:expression.error];
+        }
+        [interpolatedParts addObject:expression];
+    }
+    return [iTermExpressionParser parsedExpressionWithInterpolatedStringParts:interpolatedParts];
+}
+
+// Binds the expression inside \(…).
+- (iTermParsedExpression *)bindInterpolation:(iTermParsedExpression *)unbound
+                                       scope:(iTermVariableScope *)scope
+                            escapingFunction:(NSString *(^)(NSString *))escapingFunction
+                                      strict:(BOOL)strict {
+    iTermParsedExpression *expression = [self bindExpression:unbound scope:scope];
+    if (expression.expressionType == iTermParsedExpressionTypeString && escapingFunction) {
+        return [[iTermParsedExpression alloc] initWithString:escapingFunction(expression.string)];
+    }
+    if (!strict &&
+        expression.expressionType == iTermParsedExpressionTypeError &&
+        [unbound.object conformsToProtocol:@protocol(iTermExpressionParserPlaceholder)] &&
+        [iTermAdvancedSettingsModel laxNilPolicyInInterpolatedStrings]) {
+        // If the expression was a variable reference, replace it with empty string. This works
+        // around the annoyance of remembering to add question marks in interpolated strings,
+        // where you know the result you want is always an empty string.
+        return [[iTermParsedExpression alloc] initWithString:@""];
+    }
+    return expression;
+}
+
+// Replaces placeholders in `unbound` with values from `scope`, producing what the parser would
+// have produced given `scope`.
+- (iTermParsedExpression *)bindExpression:(iTermParsedExpression *)unbound
+                                    scope:(iTermVariableScope *)scope {
+    switch (unbound.expressionType) {
+        case iTermParsedExpressionTypeVariableReference: {
+            iTermTriple<id, NSString *, NSString *> *triple =
+            [iTermExpressionParser pathOrDereferencedArrayFromPath:unbound.placeholder.path
+                                                             index:nil
+                                                             scope:scope];
+            return [iTermExpressionParser parsedExpressionWithValue:triple.firstObject
+                                                        errorReason:triple.secondObject
+                                                               path:triple.thirdObject
+                                                           optional:unbound.optional];
+        }
+        case iTermParsedExpressionTypeArrayLookup: {
+            iTermExpressionParserArrayDereferencePlaceholder *placeholder = (id)unbound.placeholder;
+            iTermTriple<id, NSString *, NSString *> *triple =
+            [iTermExpressionParser pathOrDereferencedArrayFromPath:placeholder.path
+                                                             index:@(placeholder.index)
+                                                             scope:scope];
+            return [iTermExpressionParser parsedExpressionWithValue:triple.firstObject
+                                                        errorReason:triple.secondObject
+                                                               path:triple.thirdObject
+                                                           optional:unbound.optional];
+        }
+        case iTermParsedExpressionTypeFunctionCall: {
+            // Function calls hold evaluation state, so each binding gets its own.
+            iTermScriptFunctionCall *unboundCall = unbound.functionCall;
+            iTermScriptFunctionCall *call = [[iTermScriptFunctionCall alloc] init];
+            call.name = unboundCall.name;
+            call.namespace = unboundCall.namespace;
+            __block NSError *error = nil;
+            [unboundCall enumerateParametersWithBlock:^(NSString *name,
+                                                         iTermParsedExpression *argument,
+                                                         BOOL *stop) {
+                iTermParsedExpression *boundArgument = [self bindExpression:argument scope:scope];
+                if (boundArgument.expressionType == iTermParsedExpressionTypeError) {
+                    error = boundArgument.error;
+                    *stop = YES;
+                    return;
+                }
+                [call addParameterWithName:name parsedExpression:boundArgument];
+            }];
+            if (error) {
+                return [[iTermParsedExpression alloc] initWithError:error];
+            }
+            return [[iTermParsedExpression alloc] initWithFunctionCall:call];
+        }
+        case iTermParsedExpressionTypeArrayOfExpressions: {
+            NSMutableArray<iTermParsedExpression *> *elements = [NSMutableArray array];
+            for (iTermParsedExpression *element in unbound.arrayOfExpressions) {
+                [elements addObject:[self bindExpression:element scope:scope]];
+            }
+            return [[iTermParsedExpression alloc] initWithArrayOfExpressions:elements];
+        }
+        case iTermParsedExpressionTypeInterpolatedString: {
+            // A string literal with interpolations inside an expression. These never escape and
+            // are never strict. Literal parts are already strings so they bind to themselves.
+            NSMutableArray<iTermParsedExpression *> *parts = [NSMutableArray array];
+            for (iTermParsedExpression *part in unbound.interpolatedStringParts) {
+                iTermParsedExpression *expression = [self bindInterpolation:part
+                                                                      scope:scope
+                                                           escapingFunction:nil
+                                                                     strict:NO];
+                if (expression.expressionType == iTermParsedExpressionTypeError) {
+                    return [[iTermParsedExpression alloc] initWithError:expression.error];
+                }
+                [parts addObject:expression];
+            }
+            return [iTermExpressionParser parsedExpressionWithInterpolatedStringParts:parts];
+        }
+        case iTermParsedExpressionTypeNil:
+        case iTermParsedExpressionTypeArrayOfValues:
+        case iTermParsedExpressionTypeString:
+        case iTermParsedExpressionTypeNumber:
+        case iTermParsedExpressionTypeError:
+            // Immutable and independent of scope.
+            return unbound;
+    }
+    ITAssertWithMessage(NO, @"Unexpected expression type %@", @(unbound.expressionType));
+    return unbound;
+}
+
+@end
@@ -89,6 +89,19 @@
     return result;
 }
 
+- (BOOL)executeUpdate:(NSString *)sql withArguments:(NSArray *)arguments {
+    const BOOL result = [_db executeUpdate:sql withArgumentsInArray:arguments];
+    if (gDebugLogging) {
+        NSString *statement = [NSString stringWithFormat:@"%@ with arguments %@", sql, arguments];
+        NSLog(@"%@", statement);
+        DebugLogImpl(__FILE__,
+                     __LINE__,
+                     __FUNCTION__,
+                     statement);
+    }
+    return result;
+}
+
 - (NSNumber *)lastInsertRowId {
     const int64_t rowid = _db.lastInsertRowId;
     if (!rowid) {
@@ -161,6 +174,8 @@
         [self close];
         return NO;
     }
+    // Saves issue the same handful of statements over and over, so don't re-prepare them each time.
+    _db.shouldCacheStatements = YES;
 
     DLog(@"Opened db and passed integrity check.");
     return YES;
@@ -9,6 +9,7 @@
 
 #import "DebugLogging.h"
 #import "iTermAPIHelper.h"
+#import "iTermCompiledExpression.h"
 #import "iTermExpressionParser.h"
 #import "iTermScriptFunctionCall+Private.h"
 #import "iTermScriptHistory.h"
@@ -52,8 +53,7 @@
 - (instancetype)initWithExpressionString:(NSString *)expressionString
                                    scope:(iTermVariableScope *)scope {
     iTermParsedExpression *parsedExpression =
-    [[iTermExpressionParser expressionParser] parse:expressionString
-                                                scope:scope];
+    [[iTermCompiledExpression compiledExpression:expressionString] parsedExpressionWithScope:scope];
     return [self initWithParsedExpression:parsedExpression
                                invocation:expressionString
                                     scope:scope];
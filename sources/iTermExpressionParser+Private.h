@@ -15,6 +15,7 @@ NS_ASSUME_NONNULL_BEGIN
 @end
 
 @class CPSLRParser;
+@class iTermTriple<T1, T2, T3>;
 
 @interface iTermExpressionParser ()
 
@@ -22,6 +23,23 @@ NS_ASSUME_NONNULL_BEGIN
 + (id<CPTokenRecogniser>)stringRecognizerWithClass:(Class)theClass;
 + (void)setEscapeReplacerInStringRecognizer:(id)stringRecogniser;
 
+// Looks up a variable, or an element of an array-valued variable if `indexNumber` is nonnil.
+// Returns (value, error reason, path). With a placeholder scope the value is a placeholder.
++ (iTermTriple<id, NSString *, NSString *> *)pathOrDereferencedArrayFromPath:(NSString *)path
+                                                                       index:(nullable NSNumber *)indexNumber
+                                                                       scope:(iTermVariableScope *)scope;
+
+// Converts the result of -pathOrDereferencedArrayFromPath:index:scope: into an expression.
++ (iTermParsedExpression *)parsedExpressionWithValue:(nullable id)value
+                                         errorReason:(nullable NSString *)errorReason
+                                                path:(NSString *)path
+                                            optional:(BOOL)optional;
+
+// Joins adjacent string parts.
++ (iTermParsedExpression *)parsedExpressionWithInterpolatedStringParts:(NSArray<iTermParsedExpression *> *)interpolatedParts;
+
+- (instancetype)initWithStart:(NSString *)start;
+
 @end
 
 NS_ASSUME_NONNULL_END
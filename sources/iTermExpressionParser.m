@@ -9,7 +9,7 @@
 #import "iTermExpressionParser+Private.h"
 
 #import "CPParser+Cache.h"
-#import "iTermAdvancedSettingsModel.h"
+#import "iTermCompiledExpression.h"
 #import "iTermGrammarProcessor.h"
 #import "iTermParsedExpression+Tests.h"
 #import "iTermScriptFunctionCall+Private.h"
@@ -158,7 +158,7 @@
     return tokenizer;
 }
 
-- (id)initWithStart:(NSString *)start {
+- (instancetype)initWithStart:(NSString *)start {
     self = [super init];
     if (self) {
         _tokenizer = [iTermExpressionParser newTokenizer];
@@ -226,7 +226,7 @@
     return arg;
 }
 
-- (iTermParsedExpression *)parsedExpressionWithValue:(id)value
++ (iTermParsedExpression *)parsedExpressionWithValue:(id)value
                                          errorReason:(NSString *)errorReason
                                                 path:(NSString *)path
                                             optional:(BOOL)optional {
@@ -280,61 +280,23 @@
                                                  escapingFunction:(NSString *(^)(NSString *string))escapingFunction
                                                             scope:(iTermVariableScope *)scope
                                                            strict:(BOOL)strict {
-    __block BOOL allLiterals = YES;
-    __block NSError *error = nil;
-    NSMutableArray *interpolatedParts = [NSMutableArray array];
-    [swifty enumerateSwiftySubstrings:^(NSUInteger index, NSString *substring, BOOL isLiteral, BOOL *stop) {
-        if (isLiteral) {
-            NSString *escapedString = [substring it_stringByExpandingBackslashEscapedCharacters];
-            [interpolatedParts addObject:[[iTermParsedExpression alloc] initWithString:escapedString]];
-            return;
-        }
-        allLiterals = NO;
-
-        iTermExpressionParser *parser = [[iTermExpressionParser alloc] initWithStart:@"expression"];
-        iTermParsedExpression *expression = [parser parse:substring
-                                                    scope:scope];
-        if (expression.expressionType == iTermParsedExpressionTypeString && escapingFunction) {
-            NSString *escapedString = escapingFunction(expression.string);
-            [interpolatedParts addObject:[[iTermParsedExpression alloc] initWithString:escapedString]];
-            return;
-        }
-        if (!strict &&
-            [iTermAdvancedSettingsModel laxNilPolicyInInterpolatedStrings] &&
-            expression.expressionType == iTermParsedExpressionTypeError) {
-            // If the expression was a variable reference, replace it with empty string. This works
-            // around the annoyance of remembering to add question marks in interpolated strings,
-            // where you know the result you want is always an empty string.
-            iTermParsedExpression *expressionWithPlaceholders = [parser parse:substring
-                                                                        scope:[[iTermVariablePlaceholderScope alloc] init]];
-            if ([expressionWithPlaceholders.object conformsToProtocol:@protocol(iTermExpressionParserPlaceholder)]) {
-                expression = [[iTermParsedExpression alloc] initWithString:@""];
-            }
-        }
-        [interpolatedParts addObject:expression];
-        if (expression.expressionType == iTermParsedExpressionTypeError) {
-            error = expression.error;
-            *stop = YES;
-            return;
-        }
-    }];
-
-    if (error) {
-        return [[iTermParsedExpression alloc] initWithError:error];
-    }
-
-    if (allLiterals) {
-        return [[iTermParsedExpression alloc] initWithString:[swifty it_stringByExpandingBackslashEscapedCharacters]];
-    }
-    return [self parsedExpressionWithInterpolatedStringParts:interpolatedParts];
+    return [[iTermCompiledExpression compiledInterpolatedString:swifty] parsedExpressionWithScope:scope
+                                                                                 escapingFunction:escapingFunction
+                                                                                           strict:strict];
 }
 
 - (iTermTriple<id, NSString *, NSString *> *)pathOrDereferencedArrayFromPath:(NSString *)path
                                                                        index:(NSNumber *)indexNumber {
+    return [self.class pathOrDereferencedArrayFromPath:path index:indexNumber scope:_scope];
+}
+
++ (iTermTriple<id, NSString *, NSString *> *)pathOrDereferencedArrayFromPath:(NSString *)path
+                                                                       index:(NSNumber *)indexNumber
+                                                                       scope:(iTermVariableScope *)scope {
     if ([path isEqualToString:@"null"] && !indexNumber) {
         return [iTermTriple tripleWithObject:nil andObject:nil object:path];
     }
-    if (_scope.usePlaceholders) {
+    if (scope.usePlaceholders) {
         id placeholder;
         if (indexNumber) {
             placeholder = [[iTermExpressionParserArrayDereferencePlaceholder alloc] initWithPath:path index:indexNumber.integerValue];
@@ -345,7 +307,7 @@
                                    andObject:nil
                                       object:path];
     }
-    id untypedValue = [_scope valueForVariableName:path];
+    id untypedValue = [scope valueForVariableName:path];
     if (!untypedValue) {
         return [iTermTriple tripleWithObject:nil andObject:nil object:path];
     }
@@ -407,7 +369,7 @@
                            treeTransform:^id(CPSyntaxTree *syntaxTree) {
                                iTermTriple *triple = syntaxTree.children[0];
                                // Explicit nulls must be optional to signal the caller intended them to be null.
-                               return [weakSelf parsedExpressionWithValue:triple.firstObject
+                               return [iTermExpressionParser parsedExpressionWithValue:triple.firstObject
                                                               errorReason:triple.secondObject
                                                                      path:triple.thirdObject
                                                                  optional:[triple.thirdObject isEqualToString:@"null"]];
@@ -415,7 +377,7 @@
     [_grammarProcessor addProductionRule:@"expression ::= <path_or_dereferenced_array> '?'"
                            treeTransform:^id(CPSyntaxTree *syntaxTree) {
                                iTermTriple *triple = syntaxTree.children[0];
-                               return [weakSelf parsedExpressionWithValue:triple.firstObject
+                               return [iTermExpressionParser parsedExpressionWithValue:triple.firstObject
                                                               errorReason:triple.secondObject
                                                                      path:triple.thirdObject
                                                                  optional:YES];
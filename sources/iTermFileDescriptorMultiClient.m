@@ -9,6 +9,7 @@
 #import "iTermFileDescriptorMultiClient+MRR.h"
 
 #import "DebugLogging.h"
+#import "iTermAdvancedSettingsModel.h"
 #import "iTermClientServerProtocolMessageBox.h"
 #import "iTermFileDescriptorMultiClientState.h"
 #import "iTermFileDescriptorServer.h"
@@ -272,7 +273,10 @@ NSString *const iTermFileDescriptorMultiClientErrorDomain = @"iTermFileDescripto
         .type = iTermMultiServerRPCTypeHandshake,
         .payload = {
             .handshake = {
-                .maximumProtocolVersion = iTermMultiServerProtocolVersion2
+                .maximumProtocolVersion = iTermMultiServerProtocolVersion4,
+                .flags = ([iTermAdvancedSettingsModel multiserverBuffersOutputWhileDetached] ?
+                          iTermMultiServerHandshakeFlagBufferOutputWhileDetached :
+                          0)
             }
         }
     };
@@ -344,10 +348,14 @@ NSString *const iTermFileDescriptorMultiClientErrorDomain = @"iTermFileDescripto
                 return;
             }
             DLog(@"Got a valid handshake response for %@", socketPath);
-            if (boxedMessage.decoded->payload.handshake.protocolVersion != iTermMultiServerProtocolVersion2) {
+            const int protocolVersion = boxedMessage.decoded->payload.handshake.protocolVersion;
+            if (protocolVersion != iTermMultiServerProtocolVersion2 &&
+                protocolVersion != iTermMultiServerProtocolVersion3 &&
+                protocolVersion != iTermMultiServerProtocolVersion4) {
                 completion(state, NO, 0, -1);
                 return;
             }
+            ((iTermFileDescriptorMultiClientState *)state).protocolVersion = protocolVersion;
             completion(state,
                        YES,
                        boxedMessage.decoded->payload.handshake.numChildren,
@@ -390,6 +398,24 @@ NSString *const iTermFileDescriptorMultiClientErrorDomain = @"iTermFileDescripto
                 completion(state, NO);
                 return;
             }
+            if (box.decoded->type == iTermMultiServerRPCTypeReplay) {
+                // Output buffered while detached. The report for this child follows.
+                const iTermMultiServerReportReplay *replay = &box.decoded->payload.replay;
+                DLog(@"Got %@ bytes of replay for pid %@ from %@", @(replay->length), @(replay->pid), socketPath);
+                NSMutableData *data = state.replayedOutput[@(replay->pid)];
+                if (!data) {
+                    data = [NSMutableData data];
+                    state.replayedOutput[@(replay->pid)] = data;
+                }
+                [data appendBytes:replay->data length:replay->length];
+                [strongSelf->_thread dispatchAsync:^(iTermFileDescriptorMultiClientState * _Nullable state) {
+                    [strongSelf readInitialChildReports:numberOfChildren
+                                                  state:state
+                                                  block:block
+                                             completion:completion];
+                }];
+                return;
+            }
             if (box.decoded->type != iTermMultiServerRPCTypeReportChild) {
                 DLog(@"Unexpected message type when reading child reports for %@", socketPath);
                 completion(state, NO);
@@ -426,6 +452,8 @@ NSString *const iTermFileDescriptorMultiClientErrorDomain = @"iTermFileDescripto
     iTermFileDescriptorMultiClientChild *child =
     [[iTermFileDescriptorMultiClientChild alloc] initWithReport:report
                                                          thread:self->_thread];
+    child.bufferedOutput = state.replayedOutput[@(report->pid)];
+    [state.replayedOutput removeObjectForKey:@(report->pid)];
     [self addChild:child state:state attached:NO];
 }
 
@@ -450,6 +478,10 @@ static unsigned long long MakeUniqueID(void) {
 // a child report. The request and the child report are coupled by the unique
 // ID, but we may read other messages before getting the child report.
 // These C pointers live until the callback is run.
+// While another launch request is awaiting its response, the launch is
+// deferred and sent with any others in one batch launch request when that
+// response arrives. This is how restoring many sessions at once avoids a
+// round trip per launch without delaying a lone launch.
 - (void)launchChildWithExecutablePath:(const char *)path
                                  argv:(const char **)argv
                           environment:(const char **)environment
@@ -486,8 +518,56 @@ static unsigned long long MakeUniqueID(void) {
                                                                     callback:callback
                                                                       thread:_thread];
 
-    [self send:&message state:state callback:[_thread newCallbackWithBlock:^(iTermFileDescriptorMultiClientState *state,
-                                                                             NSNumber *result) {
+    if (state.protocolVersion >= iTermMultiServerProtocolVersion4 &&
+        state.numberOfLaunchRequestsInFlight > 0) {
+        DLog(@"Defer launch %@ to the next batch for %@", @(uniqueID), _socketPath);
+        [state.unsentLaunches addObject:@(uniqueID)];
+        return;
+    }
+    [self sendLaunchRequest:&message uniqueIDs:@[ @(uniqueID) ] state:state];
+}
+
+// Sends the launches deferred by launchChildWithExecutablePath:…, in as few batch launch requests
+// as possible.
+- (void)sendUnsentLaunchesWithState:(iTermFileDescriptorMultiClientState *)state {
+    while (state.unsentLaunches.count > 0) {
+        const NSUInteger count = MIN(state.unsentLaunches.count, iTermMultiServerMaximumBatchLaunchSize);
+        NSArray<NSNumber *> *uniqueIDs = [state.unsentLaunches subarrayWithRange:NSMakeRange(0, count)];
+        [state.unsentLaunches removeObjectsInRange:NSMakeRange(0, count)];
+
+        iTermMultiServerRequestLaunch launches[iTermMultiServerMaximumBatchLaunchSize];
+        int numberOfLaunches = 0;
+        for (NSNumber *uniqueID in uniqueIDs) {
+            iTermFileDescriptorMultiClientPendingLaunch *pendingLaunch = state.pendingLaunches[uniqueID];
+            if (pendingLaunch) {
+                launches[numberOfLaunches++] = pendingLaunch.launchRequest;
+            }
+        }
+        if (numberOfLaunches == 0) {
+            continue;
+        }
+        DLog(@"Send batch of %@ launches to %@", @(numberOfLaunches), _socketPath);
+        iTermMultiServerClientOriginatedMessage message = {
+            .type = iTermMultiServerRPCTypeBatchLaunch,
+            .payload = {
+                .batchLaunch = {
+                    .count = numberOfLaunches,
+                    .launches = launches
+                }
+            }
+        };
+        [self sendLaunchRequest:&message uniqueIDs:uniqueIDs state:state];
+    }
+}
+
+// Write a launch or batch launch request. If that fails, the pending launches
+// for `uniqueIDs` get a connection-lost error.
+- (void)sendLaunchRequest:(iTermMultiServerClientOriginatedMessage *)message
+                uniqueIDs:(NSArray<NSNumber *> *)uniqueIDs
+                    state:(iTermFileDescriptorMultiClientState *)state {
+    state.numberOfLaunchRequestsInFlight += 1;
+    [self send:message state:state callback:[_thread newCallbackWithBlock:^(iTermFileDescriptorMultiClientState *state,
+                                                                            NSNumber *result) {
         DLog(@"called back");
         const BOOL ok = result.boolValue;
         if (ok) {
@@ -496,14 +576,24 @@ static unsigned long long MakeUniqueID(void) {
         }
 
         DLog(@"Failed to write launch request.");
-        if (state.pendingLaunches[@(uniqueID)]) {
-            DLog(@"Invoke callback with connection-lost error.");
-            [state.pendingLaunches removeObjectForKey:@(uniqueID)];
-            [callback invokeWithObject:[iTermResult withError:[self connectionLostError]]];
+        state.numberOfLaunchRequestsInFlight = MAX(0, state.numberOfLaunchRequestsInFlight - 1);
+        for (NSNumber *uniqueID in uniqueIDs) {
+            iTermFileDescriptorMultiClientPendingLaunch *pendingLaunch = state.pendingLaunches[uniqueID];
+            if (pendingLaunch) {
+                DLog(@"Invoke callback for %@ with connection-lost error.", uniqueID);
+                [state.pendingLaunches removeObjectForKey:uniqueID];
+                [pendingLaunch cancelWithError:[self connectionLostError]];
+            }
         }
     }]];
 }
 
+// Called after handling a launch or batch launch response.
+- (void)didReceiveLaunchResponseWithState:(iTermFileDescriptorMultiClientState *)state {
+    state.numberOfLaunchRequestsInFlight = MAX(0, state.numberOfLaunchRequestsInFlight - 1);
+    [self sendUnsentLaunchesWithState:state];
+}
+
 // Called on job manager's queue via [self launchChildWithExecutablePath:…]
 - (iTermMultiServerClientOriginatedMessage)copyLaunchRequest:(iTermMultiServerClientOriginatedMessage)original {
     assert(original.type == iTermMultiServerRPCTypeLaunch);
@@ -575,6 +665,15 @@ static unsigned long long MakeUniqueID(void) {
     [pendingLaunch invalidate];
 }
 
+// Handle a batch launch response. Each launch is handled as though it had its own response.
+- (void)handleBatchLaunch:(iTermMultiServerResponseBatchLaunch)batchLaunch
+                    state:(iTermFileDescriptorMultiClientState *)state {
+    DLog(@"handleBatchLaunch: %@ launches for %@", @(batchLaunch.count), _socketPath);
+    for (int i = 0; i < batchLaunch.count; i++) {
+        [self handleLaunch:batchLaunch.launches[i] state:state];
+    }
+}
+
 #pragma mark - Wait for Child
 
 // Send a wait request. The response handler gets attached to the child to
@@ -864,6 +963,8 @@ static unsigned long long MakeUniqueID(void) {
     state.readFD = -1;
     state.writeFD = -1;
 
+    [state.unsentLaunches removeAllObjects];
+    state.numberOfLaunchRequestsInFlight = 0;
     NSDictionary<NSNumber *, iTermFileDescriptorMultiClientPendingLaunch *> *pendingLaunches = [state.pendingLaunches copy];
     [state.pendingLaunches removeAllObjects];
     [pendingLaunches enumerateKeysAndObjectsUsingBlock:
@@ -941,6 +1042,12 @@ static unsigned long long MakeUniqueID(void) {
 
         case iTermMultiServerRPCTypeLaunch:
             [self handleLaunch:decoded->payload.launch state:state];
+            [self didReceiveLaunchResponseWithState:state];
+            break;
+
+        case iTermMultiServerRPCTypeBatchLaunch:
+            [self handleBatchLaunch:decoded->payload.batchLaunch state:state];
+            [self didReceiveLaunchResponseWithState:state];
             break;
 
         case iTermMultiServerRPCTypeTermination:
@@ -950,6 +1057,7 @@ static unsigned long long MakeUniqueID(void) {
         case iTermMultiServerRPCTypeHello:  // Shouldn't happen at this point
         case iTermMultiServerRPCTypeHandshake:
         case iTermMultiServerRPCTypeReportChild:
+        case iTermMultiServerRPCTypeReplay:
             DLog(@"Close %@ because of unexpected message of type %@", _socketPath, @(decoded->type));
             [self closeWithState:state];
             break;
@@ -1104,11 +1212,16 @@ static unsigned long long MakeUniqueID(void) {
         [callback invokeWithObject:[iTermResult withError:self.ioError]];
         return;
     }
-    if (message.controlBuffer.cm.cmsg_len == CMSG_LEN(sizeof(int)) &&
-        message.controlBuffer.cm.cmsg_level == SOL_SOCKET &&
-        message.controlBuffer.cm.cmsg_type == SCM_RIGHTS) {
-        DLog(@"Got a file descriptor in message from %@", _socketPath);
-        [builder setFileDescriptor:*((int *)CMSG_DATA(&message.controlBuffer.cm))];
+    int fds[ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE];
+    int numberOfFileDescriptors = 0;
+    if (iTermMultiServerProtocolGetFileDescriptors(&message,
+                                                   fds,
+                                                   ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE,
+                                                   &numberOfFileDescriptors) == 0) {
+        DLog(@"Got %d file descriptor(s) in message from %@", numberOfFileDescriptors, _socketPath);
+        for (int i = 0; i < numberOfFileDescriptors; i++) {
+            [builder addFileDescriptor:fds[i]];
+        }
     }
 
     if (bytesRead == 0) {
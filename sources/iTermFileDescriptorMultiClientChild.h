@@ -24,6 +24,10 @@ NS_ASSUME_NONNULL_BEGIN
 @property (atomic, readonly) int fd;
 @property (atomic, readonly) NSString *tty;
 
+// Output the server read while no client was attached. It precedes anything read from fd. Whoever
+// attaches to the child should take it with -takeBufferedOutput.
+@property (atomic, copy, nullable) NSData *bufferedOutput;
+
 // Mutable properties. Must only be accessed on the child's thread.
 @property (nonatomic, readonly) BOOL hasTerminated;
 @property (nonatomic, readonly) BOOL haveWaited;  // only for non-preemptive waits
@@ -34,6 +38,9 @@ NS_ASSUME_NONNULL_BEGIN
                         thread:(iTermThread *)thread NS_DESIGNATED_INITIALIZER;
 - (instancetype)init NS_UNAVAILABLE;
 
+// Returns bufferedOutput and sets it to nil.
+- (NSData * _Nullable)takeBufferedOutput;
+
 - (void)addWaitCallback:(iTermCallback<id, iTermResult<NSNumber *> *> *)callback;
 - (void)invokeAllWaitCallbacks:(iTermResult<NSNumber *> *)status;
 
@@ -71,6 +71,14 @@
             self, @(self.pid), @(self.fd)];
 }
 
+- (NSData *)takeBufferedOutput {
+    @synchronized (self) {
+        NSData *result = self.bufferedOutput;
+        self.bufferedOutput = nil;
+        return result;
+    }
+}
+
 - (void)willWaitPreemptively {
     [_thread dispatchRecursiveSync:^(id _Nonnull state) {
         assert(!_haveSentPreemptiveWait);
@@ -19,8 +19,16 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic) int readFD;
 @property (nonatomic) int writeFD;
 @property (nonatomic) pid_t serverPID;
+// Negotiated in the handshake.
+@property (nonatomic) int protocolVersion;
+// Launch and batch launch requests that have been written but not yet answered.
+@property (nonatomic) NSInteger numberOfLaunchRequestsInFlight;
+// Unique IDs of pending launches deferred to the next batch launch request.
+@property (nonatomic, readonly) NSMutableArray<NSNumber *> *unsentLaunches;
 @property (nonatomic, readonly) NSMutableArray<iTermFileDescriptorMultiClientChild *> *children;
 @property (nonatomic, readonly) NSMutableDictionary<NSNumber *, iTermFileDescriptorMultiClientPendingLaunch *> *pendingLaunches;
+// pid -> output replayed during the handshake, for children not yet reported.
+@property (nonatomic, readonly) NSMutableDictionary<NSNumber *, NSMutableData *> *replayedOutput;
 @property (nonatomic, strong) dispatch_source_t daemonProcessSource;
 
 - (void)whenWritable:(void (^)(iTermFileDescriptorMultiClientState *state))block;
@@ -19,6 +19,8 @@
     if (self) {
         _children = [NSMutableArray array];
         _pendingLaunches = [NSMutableDictionary dictionary];
+        _replayedOutput = [NSMutableDictionary dictionary];
+        _unsentLaunches = [NSMutableArray array];
         _readFD = -1;
         _writeFD = -1;
         _serverPID = -1;
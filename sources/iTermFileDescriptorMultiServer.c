@@ -9,6 +9,7 @@
 
 #include "iTermCLogging.h"
 #include "iTermFileDescriptorServerShared.h"
+#include "iTermMultiServerOutputBuffer.h"
 
 #include <Availability.h>
 #include <Carbon/Carbon.h>
@@ -16,8 +17,10 @@
 #include <mach/mach.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/event.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #ifndef ITERM_SERVER
@@ -58,6 +61,9 @@ static int MakeBlocking(int fd);
 static int gPipe[2];
 static char *gPath;
 
+// Beyond this the oldest output is dropped, so a replay may begin in the middle of a sequence.
+static const size_t iTermMultiServerMaximumBufferedOutput = 1024 * 1024;
+
 typedef struct {
     iTermMultiServerClientOriginatedMessage messageWithLaunchRequest;
     pid_t pid;
@@ -66,10 +72,43 @@ typedef struct {
     int masterFd;  // Valid only if !terminated && !willTerminate
     int status;  // Only valid if terminated. Gives status from wait.
     const char *tty;
+
+    // Output read from masterFd while no client was attached. Its capacity is
+    // iTermMultiServerMaximumBufferedOutput.
+    iTermMultiServerOutputBuffer bufferedOutput;
+    int outputEOF;  // Nonzero once reading masterFd has failed. Stop buffering.
+
+    int exitWatched;  // Nonzero if gKqueue will report this child's exit.
+    int outputWatched;  // Nonzero while masterFd is registered with gKqueue for buffering.
 } iTermMultiServerChild;
 
+// Maps a pid to its index in `children`. Open addressing with linear probing. The capacity is a
+// power of two at least twice the number of children.
+typedef struct {
+    pid_t pid;  // 0 if the slot is empty.
+    int index;
+
+    // Number of other children with the same pid. This happens when a pid is reused before the
+    // client waits on the terminated child that last had it. `index` is the older one.
+    int duplicates;
+} iTermMultiServerChildIndexEntry;
+
 static iTermMultiServerChild *children;
 static int numberOfChildren;
+static int childrenCapacity;
+static iTermMultiServerChildIndexEntry *gChildIndex;
+static int gChildIndexCapacity;
+
+// Delivers child exits and fd readiness. -1 if unavailable, in which case select() and polling
+// every child on SIGCHLD are used instead.
+static int gKqueue = -1;
+
+// Version negotiated with the most recent client. A replay is sent only if that client can accept
+// one.
+static int gProtocolVersion = iTermMultiServerProtocolVersion2;
+
+// Whether the most recent client asked for output to be buffered while it is detached.
+static int gBufferOutputWhileDetached;
 static void CheckIfBootstrapPortIsDead(void);
 static void CleanUp(void);
 
@@ -93,6 +132,160 @@ static int GetNumberOfReportableChildren(void) {
     return n;
 }
 
+#pragma mark - Child Index
+
+static int ChildIndexHomeSlot(pid_t pid) {
+    return (int)(((uint32_t)pid * 2654435761u) & (gChildIndexCapacity - 1));
+}
+
+// Returns the slot holding pid or, if absent, the empty slot where it belongs.
+static int ChildIndexFindSlot(pid_t pid) {
+    const int mask = gChildIndexCapacity - 1;
+    int slot = ChildIndexHomeSlot(pid);
+    while (gChildIndex[slot].pid != 0 && gChildIndex[slot].pid != pid) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void ChildIndexInsert(pid_t pid, int index) {
+    const int slot = ChildIndexFindSlot(pid);
+    if (gChildIndex[slot].pid == pid) {
+        gChildIndex[slot].duplicates += 1;
+        return;
+    }
+    gChildIndex[slot].pid = pid;
+    gChildIndex[slot].index = index;
+    gChildIndex[slot].duplicates = 0;
+}
+
+static void ChildIndexReserve(int count) {
+    if (gChildIndexCapacity >= count * 2) {
+        return;
+    }
+    int capacity = gChildIndexCapacity ? gChildIndexCapacity : 64;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    iTermMultiServerChildIndexEntry *old = gChildIndex;
+    const int oldCapacity = gChildIndexCapacity;
+    gChildIndex = calloc(capacity, sizeof(*gChildIndex));
+    gChildIndexCapacity = capacity;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].pid != 0) {
+            const int slot = ChildIndexFindSlot(old[i].pid);
+            gChildIndex[slot] = old[i];
+        }
+    }
+    free(old);
+}
+
+static iTermMultiServerChildIndexEntry *ChildIndexLookup(pid_t pid) {
+    if (gChildIndexCapacity == 0) {
+        return NULL;
+    }
+    const int slot = ChildIndexFindSlot(pid);
+    if (gChildIndex[slot].pid != pid) {
+        return NULL;
+    }
+    return &gChildIndex[slot];
+}
+
+// Returns the index of a child other than `excluded` with the given pid. Only needed when pids
+// were reused, so a linear search is fine.
+static int FindOtherChildWithPID(pid_t pid, int excluded) {
+    for (int i = 0; i < numberOfChildren; i++) {
+        if (i != excluded && children[i].pid == pid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Removes the entry without leaving a tombstone by shifting later members of its probe sequence
+// back into the hole.
+static void ChildIndexRemove(pid_t pid, int index) {
+    iTermMultiServerChildIndexEntry *entry = ChildIndexLookup(pid);
+    if (!entry) {
+        return;
+    }
+    if (entry->duplicates > 0) {
+        entry->duplicates -= 1;
+        if (entry->index == index) {
+            entry->index = FindOtherChildWithPID(pid, index);
+        }
+        return;
+    }
+    const int mask = gChildIndexCapacity - 1;
+    int hole = (int)(entry - gChildIndex);
+    int j = hole;
+    while (1) {
+        j = (j + 1) & mask;
+        if (gChildIndex[j].pid == 0) {
+            break;
+        }
+        const int home = ChildIndexHomeSlot(gChildIndex[j].pid);
+        const int homeIsBetween = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!homeIsBetween) {
+            gChildIndex[hole] = gChildIndex[j];
+            hole = j;
+        }
+    }
+    gChildIndex[hole].pid = 0;
+}
+
+// Call after the child at `from` was moved to `to`.
+static void ChildIndexMove(pid_t pid, int from, int to) {
+    iTermMultiServerChildIndexEntry *entry = ChildIndexLookup(pid);
+    if (entry && entry->index == from) {
+        entry->index = to;
+    }
+}
+
+static int GetChildIndexByPID(pid_t pid) {
+    iTermMultiServerChildIndexEntry *entry = ChildIndexLookup(pid);
+    return entry ? entry->index : -1;
+}
+
+// Like GetChildIndexByPID but prefers a child that has not been reaped yet.
+static int GetLiveChildIndexByPID(pid_t pid) {
+    iTermMultiServerChildIndexEntry *entry = ChildIndexLookup(pid);
+    if (!entry) {
+        return -1;
+    }
+    if (!children[entry->index].terminated || entry->duplicates == 0) {
+        return entry->index;
+    }
+    for (int i = 0; i < numberOfChildren; i++) {
+        if (children[i].pid == pid && !children[i].terminated) {
+            return i;
+        }
+    }
+    return entry->index;
+}
+
+#pragma mark - Exit Notification
+
+static void WatchForExit(iTermMultiServerChild *child) {
+    child->exitWatched = 0;
+    if (gKqueue < 0) {
+        return;
+    }
+    struct kevent change;
+    EV_SET(&change, child->pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+    if (kevent(gKqueue, &change, 1, NULL, 0, NULL) < 0) {
+        FDLog(LOG_ERR, "Failed to watch pid %d for exit: %s", child->pid, strerror(errno));
+        return;
+    }
+    // If it exited before it was registered, the event might never come. Leave it to the SIGCHLD
+    // handler, which will have written to gPipe.
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, child->pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0) {
+        child->exitWatched = 1;
+    }
+}
+
 #pragma mark - Mutate Children
 
 static void LogChild(const iTermMultiServerChild *child) {
@@ -103,11 +296,11 @@ static void AddChild(const iTermMultiServerRequestLaunch *launch,
                      int masterFd,
                      const char *tty,
                      const iTermForkState *forkState) {
-    if (!children) {
-        children = calloc(1, sizeof(iTermMultiServerChild));
-    } else {
-        assert((numberOfChildren + 1) < SIZE_MAX / sizeof(iTermMultiServerChild));
-        children = realloc(children, (numberOfChildren + 1) * sizeof(iTermMultiServerChild));
+    if (numberOfChildren == childrenCapacity) {
+        const int capacity = childrenCapacity ? childrenCapacity * 2 : 16;
+        assert(capacity < SIZE_MAX / sizeof(iTermMultiServerChild));
+        children = realloc(children, capacity * sizeof(iTermMultiServerChild));
+        childrenCapacity = capacity;
     }
     const int i = numberOfChildren;
     numberOfChildren += 1;
@@ -137,6 +330,15 @@ static void AddChild(const iTermMultiServerRequestLaunch *launch,
     children[i].terminated = 0;
     children[i].status = 0;
     children[i].tty = strdup(tty);
+    children[i].bufferedOutput = (iTermMultiServerOutputBuffer){
+        .capacity = iTermMultiServerMaximumBufferedOutput
+    };
+    children[i].outputEOF = 0;
+    children[i].outputWatched = 0;
+    WatchForExit(&children[i]);
+
+    ChildIndexReserve(numberOfChildren);
+    ChildIndexInsert(children[i].pid, i);
 
     FDLog(LOG_DEBUG, "Added child %d:", i);
     LogChild(&children[i]);
@@ -154,6 +356,7 @@ static void FreeChild(int i) {
     }
     iTermMultiServerClientOriginatedMessageFree(&child->messageWithLaunchRequest);
     child->tty = NULL;
+    iTermMultiServerOutputBufferFree(&child->bufferedOutput);
 }
 
 static void RemoveChild(int i) {
@@ -161,19 +364,23 @@ static void RemoveChild(int i) {
     assert(i < numberOfChildren);
 
     FDLog(LOG_DEBUG, "Remove child %d", i);
+    const pid_t pid = children[i].pid;
     FreeChild(i);
-    if (numberOfChildren == 1) {
+    ChildIndexRemove(pid, i);
+
+    // Move the last child into the hole. Order doesn't matter.
+    const int last = numberOfChildren - 1;
+    if (i != last) {
+        children[i] = children[last];
+        ChildIndexMove(children[i].pid, last, i);
+    }
+    numberOfChildren -= 1;
+
+    if (numberOfChildren == 0) {
         free(children);
         children = NULL;
-    } else {
-        const int afterCount = numberOfChildren - i - 1;
-        memmove(children + i,
-                children + i + 1,
-                sizeof(*children) * afterCount);
-        children = realloc(children, sizeof(*children) * (numberOfChildren - 1));
+        childrenCapacity = 0;
     }
-
-    numberOfChildren -= 1;
 }
 
 #pragma mark - Launch
@@ -291,6 +498,88 @@ static int HandleLaunchRequest(int fd, const iTermMultiServerRequestLaunch *laun
                               launch->uniqueId);
 }
 
+// Forks every child in the batch before writing anything. Nothing waits on exec, so the children
+// exec concurrently while the rest of the batch is forked, and the client gets every file
+// descriptor in one message instead of one round trip per launch.
+static int HandleBatchLaunchRequest(int fd, const iTermMultiServerRequestBatchLaunch *batch) {
+    FDLog(LOG_DEBUG, "HandleBatchLaunchRequest fd=%d count=%d", fd, batch->count);
+    assert(batch->count > 0 && batch->count <= iTermMultiServerMaximumBatchLaunchSize);
+
+    iTermTTYState *ttyStates = calloc(batch->count, sizeof(*ttyStates));
+    iTermMultiServerResponseLaunch *responses = calloc(batch->count, sizeof(*responses));
+    int masterFds[iTermMultiServerMaximumBatchLaunchSize];
+    int numberOfMasterFds = 0;
+
+    for (int i = 0; i < batch->count; i++) {
+        const iTermMultiServerRequestLaunch *launch = &batch->launches[i];
+        iTermForkState forkState = {
+            .connectionFd = -1,
+            .deadMansPipe = { 0, 0 },
+        };
+        int error = 0;
+        const int masterFd = Launch(launch, &forkState, &ttyStates[i], &error);
+        if (masterFd < 0) {
+            responses[i] = (iTermMultiServerResponseLaunch){
+                .status = -1,
+                .pid = 0,
+                .fd = -1,
+                .uniqueId = launch->uniqueId,
+                .tty = ""
+            };
+            continue;
+        }
+        AddChild(launch, masterFd, ttyStates[i].tty, &forkState);
+        responses[i] = (iTermMultiServerResponseLaunch){
+            .status = 0,
+            .pid = forkState.pid,
+            .fd = masterFd,
+            .uniqueId = launch->uniqueId,
+            .tty = ttyStates[i].tty
+        };
+        masterFds[numberOfMasterFds++] = masterFd;
+    }
+
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeBatchLaunch,
+        .payload = {
+            .batchLaunch = {
+                .count = batch->count,
+                .launches = responses
+            }
+        }
+    };
+    ssize_t result = -1;
+    if (iTermMultiServerProtocolEncodeMessageFromServer(&message, &obj)) {
+        FDLog(LOG_ERR, "Error encoding batch launch response");
+    } else {
+        int error = 0;
+        if (numberOfMasterFds > 0) {
+            FDLog(LOG_DEBUG, "NOTE: sending %d file descriptors", numberOfMasterFds);
+            result = iTermFileDescriptorServerWriteLengthAndBufferAndFileDescriptors(fd,
+                                                                                     obj.ioVectors[0].iov_base,
+                                                                                     obj.ioVectors[0].iov_len,
+                                                                                     masterFds,
+                                                                                     numberOfMasterFds,
+                                                                                     &error);
+        } else {
+            FDLog(LOG_ERR, "ERROR: every launch in the batch failed. *not* sending file descriptors");
+            result = iTermFileDescriptorServerWriteLengthAndBuffer(fd,
+                                                                   obj.ioVectors[0].iov_base,
+                                                                   obj.ioVectors[0].iov_len,
+                                                                   &error);
+        }
+        if (result < 0) {
+            FDLog(LOG_ERR, "ERROR: HandleBatchLaunchRequest: Failed to send response with %s", strerror(error));
+        }
+    }
+    iTermClientServerProtocolMessageFree(&obj);
+    free(responses);
+    free(ttyStates);
+    return result == -1;
+}
+
 #pragma mark - Report Termination
 
 static int ReportTermination(int fd, pid_t pid) {
@@ -388,6 +677,27 @@ static pid_t WaitPidNoHang(pid_t pid, int *statusOut) {
     return result;
 }
 
+// Returns -1 if the termination could not be reported.
+static int ReapChildIfExited(int i, int connectionFd) {
+    if (children[i].terminated) {
+        return 0;
+    }
+    const pid_t pid = WaitPidNoHang(children[i].pid, &children[i].status);
+    if (pid > 0) {
+        FDLog(LOG_DEBUG, "Child with pid %d exited with status %d", (int)pid, children[i].status);
+        children[i].terminated = 1;
+        children[i].exitWatched = 0;
+        if (!children[i].willTerminate &&
+            connectionFd >= 0 &&
+            ReportTermination(connectionFd, children[i].pid)) {
+            FDLog(LOG_DEBUG, "ReportTermination returned an error");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Polls children whose exit isn't delivered by gKqueue. Called when SIGCHLD was received.
 static int WaitForAllProcesses(int connectionFd) {
     FDLog(LOG_DEBUG, "WaitForAllProcesses connectionFd=%d", connectionFd);
 
@@ -400,27 +710,112 @@ static int WaitForAllProcesses(int connectionFd) {
     if (rc < 0 && errno != EAGAIN) {
         FDLog(LOG_ERR, "Read of gPipe[0] failed with %s", strerror(errno));
     }
-    FDLog(LOG_DEBUG, "Done emptying pipe. Wait on non-terminated children.");
+    FDLog(LOG_DEBUG, "Done emptying pipe. Wait on non-terminated children whose exit isn't watched.");
     for (int i = 0; i < numberOfChildren; i++) {
-        if (children[i].terminated) {
+        if (children[i].exitWatched) {
             continue;
         }
-        const pid_t pid = WaitPidNoHang(children[i].pid, &children[i].status);
-        if (pid > 0) {
-            FDLog(LOG_DEBUG, "Child with pid %d exited with status %d", (int)pid, children[i].status);
-            children[i].terminated = 1;
-            if (!children[i].willTerminate &&
-                connectionFd >= 0 &&
-                ReportTermination(connectionFd, children[i].pid)) {
-                FDLog(LOG_DEBUG, "ReportTermination returned an error");
-                return -1;
-            }
+        if (ReapChildIfExited(i, connectionFd)) {
+            return -1;
         }
     }
     FDLog(LOG_DEBUG, "Finished making waitpid calls");
     return 0;
 }
 
+#pragma mark - Buffered Output
+
+// Stays well under the maximum message size that iTermMultiServerRead accepts.
+static const size_t iTermMultiServerReplayChunkSize = 256 * 1024;
+
+static int ShouldBufferOutput(const iTermMultiServerChild *child) {
+    return (gBufferOutputWhileDetached &&
+            !child->willTerminate &&
+            !child->outputEOF &&
+            child->masterFd >= 0);
+}
+
+static void DiscardBufferedOutput(iTermMultiServerChild *child) {
+    iTermMultiServerOutputBufferFree(&child->bufferedOutput);
+}
+
+// Called when masterFd is readable and no client is attached.
+static void BufferOutput(iTermMultiServerChild *child) {
+    char temp[65536];
+    ssize_t n;
+    do {
+        n = read(child->masterFd, temp, sizeof(temp));
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && errno == EAGAIN) {
+        // The last client made the file description nonblocking.
+        return;
+    }
+    if (n <= 0) {
+        // EIO once the slave side has been closed.
+        FDLog(LOG_DEBUG, "Stop buffering output of pid %d: read returned %d (%s)",
+              child->pid, (int)n, n < 0 ? strerror(errno) : "EOF");
+        child->outputEOF = 1;
+        if (child->outputWatched) {
+            struct kevent change;
+            EV_SET(&change, child->masterFd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            kevent(gKqueue, &change, 1, NULL, 0, NULL);
+            child->outputWatched = 0;
+        }
+        return;
+    }
+    iTermMultiServerOutputBufferAppend(&child->bufferedOutput, temp, n);
+}
+
+static int SendReplay(int fd, pid_t pid, const char *data, size_t length) {
+    iTermClientServerProtocolMessage obj;
+    iTermClientServerProtocolMessageInitialize(&obj);
+
+    iTermMultiServerServerOriginatedMessage message = {
+        .type = iTermMultiServerRPCTypeReplay,
+        .payload = {
+            .replay = {
+                .pid = pid,
+                .data = data,
+                .length = length
+            }
+        }
+    };
+    const int rc = iTermMultiServerProtocolEncodeMessageFromServer(&message, &obj);
+    if (rc) {
+        FDLog(LOG_ERR, "Failed to encode replay");
+        return -1;
+    }
+
+    int error;
+    ssize_t result = iTermFileDescriptorServerWriteLengthAndBuffer(fd,
+                                                                   obj.ioVectors[0].iov_base,
+                                                                   obj.ioVectors[0].iov_len,
+                                                                   &error);
+    if (result < 0) {
+        FDLog(LOG_ERR, "SendMsg failed with %s", strerror(error));
+    }
+    iTermClientServerProtocolMessageFree(&obj);
+    return result == -1;
+}
+
+// Sends the buffered output in chunks, oldest first. Whatever isn't sent successfully is kept.
+static int ReplayBufferedOutput(int fd, iTermMultiServerChild *child) {
+    FDLog(LOG_DEBUG, "Replay %d bytes of buffered output for pid %d",
+          (int)child->bufferedOutput.length, child->pid);
+    const char *bytes;
+    size_t length;
+    while ((length = iTermMultiServerOutputBufferPeek(&child->bufferedOutput,
+                                                      iTermMultiServerReplayChunkSize,
+                                                      &bytes)) > 0) {
+        if (SendReplay(fd, child->pid, bytes, length)) {
+            return -1;
+        }
+        iTermMultiServerOutputBufferConsume(&child->bufferedOutput, length);
+    }
+    DiscardBufferedOutput(child);
+    return 0;
+}
+
 #pragma mark - Report Children
 
 static int ReportChildren(int fd) {
@@ -432,6 +827,13 @@ static int ReportChildren(int fd) {
         if (children[i].willTerminate) {
             continue;
         }
+        if (gProtocolVersion < iTermMultiServerProtocolVersion3) {
+            // This client can't take it and a later one would see it out of order.
+            DiscardBufferedOutput(&children[i]);
+        } else if (ReplayBufferedOutput(fd, &children[i])) {
+            FDLog(LOG_ERR, "ReplayBufferedOutput returned an error code");
+            return -1;
+        }
         if (ReportChild(fd, &children[i], numberSent + 1 == numberOfReportableChildren)) {
             FDLog(LOG_ERR, "ReportChild returned an error code");
             return -1;
@@ -453,11 +855,21 @@ static int HandleHandshake(int fd, iTermMultiServerRequestHandshake *handshake)
         FDLog(LOG_ERR, "Maximum protocol version is too low: %d", handshake->maximumProtocolVersion);
         return -1;
     }
+    if (handshake->maximumProtocolVersion >= iTermMultiServerProtocolVersion4) {
+        gProtocolVersion = iTermMultiServerProtocolVersion4;
+        gBufferOutputWhileDetached = !!(handshake->flags & iTermMultiServerHandshakeFlagBufferOutputWhileDetached);
+    } else if (handshake->maximumProtocolVersion >= iTermMultiServerProtocolVersion3) {
+        gProtocolVersion = iTermMultiServerProtocolVersion3;
+        gBufferOutputWhileDetached = 1;
+    } else {
+        gProtocolVersion = iTermMultiServerProtocolVersion2;
+        gBufferOutputWhileDetached = 0;
+    }
     iTermMultiServerServerOriginatedMessage message = {
         .type = iTermMultiServerRPCTypeHandshake,
         .payload = {
             .handshake = {
-                .protocolVersion = iTermMultiServerProtocolVersion2,
+                .protocolVersion = gProtocolVersion,
                 .numChildren = GetNumberOfReportableChildren(),
                 .pid = getpid()
             }
@@ -487,15 +899,6 @@ static int HandleHandshake(int fd, iTermMultiServerRequestHandshake *handshake)
 
 #pragma mark - Wait
 
-static int GetChildIndexByPID(pid_t pid) {
-    for (int i = 0; i < numberOfChildren; i++) {
-        if (children[i].pid == pid) {
-            return i;
-        }
-    }
-    return -1;
-}
-
 static int HandleWait(int fd, iTermMultiServerRequestWait *wait) {
     FDLog(LOG_DEBUG, "Handle wait request for pid=%d preemptive=%d", wait->pid, wait->removePreemptively);
 
@@ -624,6 +1027,9 @@ static int ReadAndHandleRequest(int readFd, int writeFd) {
         case iTermMultiServerRPCTypeLaunch:
             result = HandleLaunchRequest(writeFd, &request.payload.launch);
             break;
+        case iTermMultiServerRPCTypeBatchLaunch:
+            result = HandleBatchLaunchRequest(writeFd, &request.payload.batchLaunch);
+            break;
         case iTermMultiServerRPCTypeTermination:
             FDLog(LOG_ERR, "Ignore termination message");
             break;
@@ -633,11 +1039,113 @@ static int ReadAndHandleRequest(int readFd, int writeFd) {
         case iTermMultiServerRPCTypeHello:
             FDLog(LOG_ERR, "Ignore hello");
             break;
+        case iTermMultiServerRPCTypeReplay:
+            FDLog(LOG_ERR, "Ignore replay");
+            break;
     }
     iTermMultiServerClientOriginatedMessageFree(&request);
     return result;
 }
 
+#pragma mark - Events
+
+static void UnwatchChildOutput(void) {
+    for (int i = 0; i < numberOfChildren; i++) {
+        if (!children[i].outputWatched) {
+            continue;
+        }
+        struct kevent change;
+        EV_SET(&change, children[i].masterFd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        kevent(gKqueue, &change, 1, NULL, 0, NULL);
+        children[i].outputWatched = 0;
+    }
+}
+
+// Registers the master fds of children whose output should be buffered. Returns 0 if any could
+// not be registered, in which case none are and the caller must select() on them instead.
+static int WatchChildOutput(void) {
+    if (gKqueue < 0) {
+        return 0;
+    }
+    for (int i = 0; i < numberOfChildren; i++) {
+        if (!ShouldBufferOutput(&children[i])) {
+            continue;
+        }
+        struct kevent change;
+        EV_SET(&change, children[i].masterFd, EVFILT_READ, EV_ADD, 0, 0, (void *)(intptr_t)children[i].pid);
+        if (kevent(gKqueue, &change, 1, NULL, 0, NULL) < 0) {
+            FDLog(LOG_ERR, "Can't watch output of pid %d with kqueue: %s", children[i].pid, strerror(errno));
+            UnwatchChildOutput();
+            return 0;
+        }
+        children[i].outputWatched = 1;
+    }
+    return 1;
+}
+
+static void HandleChildEvent(const struct kevent *event, int connectionFd, int *errorPtr) {
+    if (event->filter == EVFILT_PROC) {
+        const int i = GetLiveChildIndexByPID((pid_t)event->ident);
+        if (i >= 0 && ReapChildIfExited(i, connectionFd)) {
+            *errorPtr = 1;
+        }
+        return;
+    }
+    const int i = GetLiveChildIndexByPID((pid_t)(intptr_t)event->udata);
+    if (i >= 0 && children[i].outputWatched && children[i].masterFd == (int)event->ident) {
+        BufferOutput(&children[i]);
+    }
+}
+
+// Like iTermSelect but also handles child events registered with gKqueue: exits are reaped and
+// reported on connectionFd (if not negative) and watched output is buffered. Returns nonzero if
+// reporting a termination failed.
+static int WaitForEvents(int *fds, int count, int *results, int connectionFd) {
+    if (gKqueue < 0) {
+        iTermSelect(fds, count, results, 1);
+        return 0;
+    }
+    struct kevent changes[count];
+    for (int i = 0; i < count; i++) {
+        EV_SET(&changes[i], fds[i], EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, NULL);
+        results[i] = 0;
+    }
+    struct kevent events[64];
+    int n;
+    do {
+        FDLog(LOG_DEBUG, "Calling kevent...");
+        n = kevent(gKqueue, changes, count, events, sizeof(events) / sizeof(*events), NULL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        FDLog(LOG_ERR, "kevent failed with %s. Falling back to select.", strerror(errno));
+        iTermSelect(fds, count, results, 1);
+        return 0;
+    }
+    int error = 0;
+    for (int j = 0; j < n; j++) {
+        if (events[j].udata != NULL || events[j].filter == EVFILT_PROC) {
+            HandleChildEvent(&events[j], connectionFd, &error);
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (fds[i] == (int)events[j].ident) {
+                // EV_ERROR counts too, like select's error set.
+                results[i] = 1;
+            }
+        }
+    }
+    // One-shot registrations that didn't fire are still live. Remove them so a stale fd can't
+    // wake a later wait.
+    for (int i = 0; i < count; i++) {
+        if (!results[i]) {
+            struct kevent change;
+            EV_SET(&change, fds[i], EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            kevent(gKqueue, &change, 1, NULL, 0, NULL);
+        }
+    }
+    return error;
+}
+
 #pragma mark - Core
 
 static void AcceptAndReject(int socket) {
@@ -688,8 +1196,10 @@ static void SelectLoop(int acceptFd, int writeFd, int readFd) {
         static const int fdCount = 3;
         int fds[fdCount] = { gPipe[0], acceptFd, readFd };
         int results[fdCount];
-        FDLog(LOG_DEBUG, "Calling select()");
-        iTermSelect(fds, sizeof(fds) / sizeof(*fds), results, 1 /* wantErrors */);
+        FDLog(LOG_DEBUG, "Waiting for events");
+        if (WaitForEvents(fds, sizeof(fds) / sizeof(*fds), results, writeFd)) {
+            break;
+        }
         CheckIfBootstrapPortIsDead();
 
         if (results[2]) {
@@ -762,12 +1272,31 @@ static int MakeAndSendPipe(int unixDomainSocketFd) {
 static int iTermMultiServerAccept(int socketFd) {
     // incoming unix domain socket connection to get FDs
     int connectionFd = -1;
+    // Keep draining children's ptys while nobody else is reading them so they don't block on a
+    // full buffer.
+    const int outputWatched = WatchChildOutput();
     while (1) {
-        int fds[] = { socketFd, gPipe[0] };
-        int results[2] = { 0, 0 };
-        FDLog(LOG_DEBUG, "iTermMultiServerAccept calling iTermSelect...");
-        iTermSelect(fds, sizeof(fds) / sizeof(*fds), results, 1);
-        FDLog(LOG_DEBUG, "iTermSelect returned.");
+        const int maxCount = 2 + (outputWatched ? 0 : numberOfChildren);
+        int fds[maxCount];
+        int childIndexes[maxCount];
+        int results[maxCount];
+        int count = 0;
+        fds[count++] = socketFd;
+        fds[count++] = gPipe[0];
+        for (int i = 0; !outputWatched && i < numberOfChildren; i++) {
+            if (ShouldBufferOutput(&children[i])) {
+                childIndexes[count] = i;
+                fds[count++] = children[i].masterFd;
+            }
+        }
+        FDLog(LOG_DEBUG, "iTermMultiServerAccept waiting for events...");
+        WaitForEvents(fds, count, results, -1);
+        FDLog(LOG_DEBUG, "Done waiting for events.");
+        for (int j = 2; j < count; j++) {
+            if (results[j]) {
+                BufferOutput(&children[childIndexes[j]]);
+            }
+        }
         if (results[1]) {
             FDLog(LOG_DEBUG, "SIGCHLD pipe became readable while waiting for connection. Calling wait...");
             WaitForAllProcesses(-1);
@@ -782,6 +1311,7 @@ static int iTermMultiServerAccept(int socketFd) {
         }
         FDLog(LOG_DEBUG, "accept() returned %d error=%s", connectionFd, strerror(errno));
     }
+    UnwatchChildOutput();
     return connectionFd;
 }
 
@@ -964,6 +1494,11 @@ static int Initialize(char *path) {
     if (InitializeSignals()) {
         return 1;
     }
+
+    gKqueue = kqueue();
+    if (gKqueue < 0) {
+        FDLog(LOG_ERR, "kqueue() failed with %s. Will use select.", strerror(errno));
+    }
     chdir("/");
 
     return 0;
@@ -18,6 +18,14 @@ typedef union {
     char control[CMSG_SPACE(sizeof(int))];
 } iTermFileDescriptorControlMessage;
 
+// The most file descriptors that can be passed with a single message.
+#define ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE 16
+
+typedef union {
+    struct cmsghdr cm;
+    char control[CMSG_SPACE(sizeof(int) * ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE)];
+} iTermFileDescriptorBatchControlMessage;
+
 void iTermFileDescriptorServerLog(char *format, ...);
 int iTermFileDescriptorServerAcceptAndClose(int socketFd);
 int iTermFileDescriptorServerAccept(int socketFd);
@@ -28,6 +36,14 @@ ssize_t iTermFileDescriptorServerSendMessageAndFileDescriptor(int connectionFd,
                                                               size_t bufferSize,
                                                               int fdToSend);
 
+// Like iTermFileDescriptorServerSendMessageAndFileDescriptor but passes `count` file descriptors in
+// a single control message. `count` must be at most ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE.
+ssize_t iTermFileDescriptorServerSendMessageAndFileDescriptors(int connectionFd,
+                                                               void *buffer,
+                                                               size_t bufferSize,
+                                                               const int *fdsToSend,
+                                                               int count);
+
 ssize_t iTermFileDescriptorServerWriteLengthAndBuffer(int connectionFd,
                                                       void *buffer,
                                                       size_t bufferSize,
@@ -37,6 +53,12 @@ ssize_t iTermFileDescriptorServerWriteLengthAndBufferAndFileDescriptor(int conne
                                                                        size_t bufferSize,
                                                                        int fdToSend,
                                                                        int *errorOut);
+ssize_t iTermFileDescriptorServerWriteLengthAndBufferAndFileDescriptors(int connectionFd,
+                                                                        void *buffer,
+                                                                        size_t bufferSize,
+                                                                        const int *fdsToSend,
+                                                                        int count,
+                                                                        int *errorOut);
 
 ssize_t iTermFileDescriptorServerWrite(int fd, void *buffer, size_t bufferSize);
 
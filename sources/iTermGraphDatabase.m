@@ -10,6 +10,7 @@
 #import "DebugLogging.h"
 #import "FMDatabase.h"
 #import "NSArray+iTerm.h"
+#import "NSData+iTerm.h"
 #import "NSObject+iTerm.h"
 #import "iTermGraphDeltaEncoder.h"
 #import "iTermGraphTableTransformer.h"
@@ -18,6 +19,79 @@
 
 @class iTermGraphDatabaseState;
 
+// Node data at least this large (typically a LineBlock) is split into content-defined chunks that
+// are stored once in the Chunk table, keyed by their SHA-256, and referenced from NodeChunk. When a
+// node changes only the chunks whose content changed get written, so re-saving the growing last
+// block of a session costs about as much as the new output rather than the whole block.
+static const NSUInteger iTermGraphDatabaseChunkingThreshold = 16 * 1024;
+static const NSUInteger iTermGraphDatabaseMinChunkSize = 2 * 1024;
+static const NSUInteger iTermGraphDatabaseMaxChunkSize = 64 * 1024;
+// A boundary is placed where the low 13 bits of the rolling hash are 0, giving ~8k chunks.
+static const uint32_t iTermGraphDatabaseChunkBoundaryMask = (1 << 13) - 1;
+// Chunks no longer referenced by any node are deleted after this many saves, and at launch.
+static const NSInteger iTermGraphDatabaseSavesBetweenChunkCollection = 64;
+// Deleted nodes are removed with one statement per this many rows. Stays well under SQLite's
+// limit on the number of bound parameters.
+static const NSUInteger iTermGraphDatabaseDeleteBatchSize = 256;
+
+// Stored in Node.data in place of chunked data. It can't be confused with real data, which is
+// always a keyed archive.
+static NSData *iTermGraphDatabaseChunkedNodeMarker(void) {
+    static NSData *marker;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        marker = [@"iTermChunkedNode" dataUsingEncoding:NSUTF8StringEncoding];
+    });
+    return marker;
+}
+
+static BOOL iTermGraphDatabaseShouldChunkData(NSData *data) {
+    return data.length >= iTermGraphDatabaseChunkingThreshold;
+}
+
+// Gear hash table for content-defined chunking. It must never change or existing chunks would
+// stop being shared, so it comes from a fixed-seed generator.
+static const uint32_t *iTermGraphDatabaseGearTable(void) {
+    static uint32_t table[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        uint64_t state = 0x6954657232436864ULL;
+        for (int i = 0; i < 256; i++) {
+            // splitmix64
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            table[i] = (uint32_t)(z ^ (z >> 31));
+        }
+    });
+    return table;
+}
+
+// Splits data at content-defined boundaries so an insertion or append only changes the chunks
+// around it.
+static NSArray<NSData *> *iTermGraphDatabaseChunksOfData(NSData *data) {
+    const uint32_t *gear = iTermGraphDatabaseGearTable();
+    const unsigned char *bytes = data.bytes;
+    const NSUInteger length = data.length;
+    NSMutableArray<NSData *> *chunks = [NSMutableArray array];
+    NSUInteger start = 0;
+    uint32_t hash = 0;
+    for (NSUInteger i = 0; i < length; i++) {
+        hash = (hash << 1) + gear[bytes[i]];
+        const NSUInteger size = i + 1 - start;
+        if ((size >= iTermGraphDatabaseMinChunkSize && (hash & iTermGraphDatabaseChunkBoundaryMask) == 0) ||
+            size >= iTermGraphDatabaseMaxChunkSize) {
+            [chunks addObject:[data subdataWithRange:NSMakeRange(start, size)]];
+            start = i + 1;
+            hash = 0;
+        }
+    }
+    if (start < length) {
+        [chunks addObject:[data subdataWithRange:NSMakeRange(start, length - start)]];
+    }
+    return chunks;
+}
+
 @interface iTermGraphDatabaseState: iTermSynchronizedState<iTermGraphDatabaseState *>
 @property (nonatomic, strong) id<iTermDatabase> db;
 // Load complete means that the initial attempt to load the DB has finished. It may have failed, leaving
@@ -70,6 +144,8 @@
 
 @implementation iTermGraphDatabase {
     NSInteger _recoveryCount;
+    // Only accessed on _thread.
+    NSInteger _savesSinceChunkCollection;
     _Atomic int _updating;
     _Atomic int _invalid;
 }
@@ -184,6 +260,8 @@
 - (void)reallyInvalidate:(iTermGraphDatabaseState *)state {
     _invalid = YES;
     [state.db executeUpdate:@"delete from Node"];
+    [state.db executeUpdate:@"delete from NodeChunk"];
+    [state.db executeUpdate:@"delete from Chunk"];
     [state.db close];
     state.db = nil;
 }
@@ -301,7 +379,8 @@
              state:(iTermGraphDatabaseState *)state {
     DLog(@"Start saving");
     NSDate *start = [NSDate date];
-    const BOOL ok =
+    NSMutableArray<NSNumber *> *deletedRowIDs = [NSMutableArray array];
+    BOOL ok =
     [encoder enumerateRecords:^(iTermEncoderGraphRecord * _Nullable before,
                                 iTermEncoderGraphRecord * _Nullable after,
                                 NSNumber *parent,
@@ -313,19 +392,23 @@
                                          userInfo:nil];
         }
         if (before && !after) {
-            if (![state.db executeUpdate:@"delete from Node where rowid=?", before.rowid]) {
-                *stop = YES;
-                return;
-            }
+            // Closing a window deletes every node under it; do them in batches below.
+            [deletedRowIDs addObject:before.rowid];
             return;
         }
         if (!before && after) {
+            NSData *data = after.data ?: [NSData data];
+            const BOOL chunked = iTermGraphDatabaseShouldChunkData(data);
             if (![state.db executeUpdate:@"insert into Node (key, identifier, parent, data) values (?, ?, ?, ?)",
-                  after.key, after.identifier, parent, after.data ?: [NSData data]]) {
+                  after.key, after.identifier, parent, chunked ? iTermGraphDatabaseChunkedNodeMarker() : data]) {
                 *stop = YES;
                 return;
             }
             NSNumber *lastInsertRowID = state.db.lastInsertRowId;
+            if (chunked && ![self writeChunksOfData:data node:lastInsertRowID state:state]) {
+                *stop = YES;
+                return;
+            }
             if (parent.integerValue == 0) {
                 DLog(@"Insert root node with path %@, rowid %@", path, lastInsertRowID);
             }
@@ -352,23 +435,92 @@
                 }
             }
             assert(before.rowid.longLongValue == after.rowid.longLongValue);
-            if ([before.data isEqual:after.data]) {
+            NSData *data = after.data;
+            if ([before.data isEqual:data]) {
+                return;
+            }
+            // The node may have been chunked before even if it isn't now.
+            if (![state.db executeUpdate:@"delete from NodeChunk where node=?", before.rowid]) {
+                *stop = YES;
+                return;
+            }
+            const BOOL chunked = iTermGraphDatabaseShouldChunkData(data);
+            if (![state.db executeUpdate:@"update Node set data=? where rowid=?",
+                  chunked ? iTermGraphDatabaseChunkedNodeMarker() : data, before.rowid]) {
+                *stop = YES;
                 return;
             }
-            if (![state.db executeUpdate:@"update Node set data=? where rowid=?", after.data, before.rowid]) {
+            if (chunked && ![self writeChunksOfData:data node:before.rowid state:state]) {
                 *stop = YES;
             }
             return;
         }
         assert(NO);
     }];
+    if (ok) {
+        ok = [self deleteNodesWithRowIDs:deletedRowIDs state:state];
+    }
+    if (ok && ++_savesSinceChunkCollection >= iTermGraphDatabaseSavesBetweenChunkCollection) {
+        _savesSinceChunkCollection = 0;
+        [self deleteUnreferencedChunks:state];
+    }
     NSDate *end = [NSDate date];
     DLog(@"Save duration: %f0.1ms", (end.timeIntervalSinceNow - start.timeIntervalSinceNow) * 1000);
     return ok;
 }
 
+// Runs within a transaction.
+- (BOOL)deleteNodesWithRowIDs:(NSArray<NSNumber *> *)rowIDs
+                        state:(iTermGraphDatabaseState *)state {
+    for (NSUInteger start = 0; start < rowIDs.count; start += iTermGraphDatabaseDeleteBatchSize) {
+        NSArray<NSNumber *> *batch =
+            [rowIDs subarrayWithRange:NSMakeRange(start, MIN(iTermGraphDatabaseDeleteBatchSize, rowIDs.count - start))];
+        NSMutableArray<NSString *> *placeholders = [NSMutableArray arrayWithCapacity:batch.count];
+        for (NSUInteger i = 0; i < batch.count; i++) {
+            [placeholders addObject:@"?"];
+        }
+        NSString *list = [placeholders componentsJoinedByString:@", "];
+        if (![state.db executeUpdate:[NSString stringWithFormat:@"delete from Node where rowid in (%@)", list]
+                       withArguments:batch]) {
+            return NO;
+        }
+        if (![state.db executeUpdate:[NSString stringWithFormat:@"delete from NodeChunk where node in (%@)", list]
+                       withArguments:batch]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+// Runs within a transaction. Chunks already in the database (unchanged parts of this node, or
+// identical content elsewhere) are not written again.
+- (BOOL)writeChunksOfData:(NSData *)data
+                     node:(NSNumber *)rowid
+                    state:(iTermGraphDatabaseState *)state {
+    NSArray<NSData *> *chunks = iTermGraphDatabaseChunksOfData(data);
+    for (NSUInteger i = 0; i < chunks.count; i++) {
+        NSData *hash = chunks[i].it_sha256;
+        if (![state.db executeUpdate:@"insert or ignore into Chunk (hash, data) values (?, ?)", hash, chunks[i]]) {
+            return NO;
+        }
+        if (![state.db executeUpdate:@"insert into NodeChunk (node, seq, hash) values (?, ?, ?)", rowid, @(i), hash]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (void)deleteUnreferencedChunks:(iTermGraphDatabaseState *)state {
+    DLog(@"Delete unreferenced chunks");
+    [state.db executeUpdate:@"delete from NodeChunk where node not in (select rowid from Node)"];
+    [state.db executeUpdate:@"delete from Chunk where hash not in (select hash from NodeChunk)"];
+}
+
 - (BOOL)createTables:(iTermGraphDatabaseState *)state {
     [state.db executeUpdate:@"PRAGMA journal_mode=WAL"];
+    // In WAL mode this syncs only at checkpoints rather than on every commit. A crash of the app
+    // can't lose a committed save; only a power failure could roll back the most recent ones.
+    [state.db executeUpdate:@"PRAGMA synchronous=NORMAL"];
 
     if (![state.db executeUpdate:@"create table if not exists Node (key text not null, identifier text not null, parent integer not null, data blob)"]) {
         return NO;
@@ -389,6 +541,16 @@
      @"        parentNode.rowid is NULL and "
      @"        child.parent != 0"
      @"  )"];
+
+    if (![state.db executeUpdate:@"create table if not exists Chunk (hash blob primary key not null, data blob not null)"]) {
+        return NO;
+    }
+    if (![state.db executeUpdate:@"create table if not exists NodeChunk (node integer not null, seq integer not null, hash blob not null)"]) {
+        return NO;
+    }
+    [state.db executeUpdate:@"create index if not exists node_chunk_node_index on NodeChunk (node)"];
+    [state.db executeUpdate:@"create index if not exists node_chunk_hash_index on NodeChunk (hash)"];
+    [self deleteUnreferencedChunks:state];
     return YES;
 }
 
@@ -424,6 +586,7 @@
         DLog(@"Select done");
         [rs close];
     }
+    [self reassembleChunkedNodes:nodes state:state];
 
     DLog(@"Begin transforming");
     iTermGraphTableTransformer *transformer = [[iTermGraphTableTransformer alloc] initWithNodeRows:nodes];
@@ -440,5 +603,43 @@
     return record;
 }
 
+// Replaces the data of chunked node rows (as loaded in -load:error:) with the concatenation of
+// their chunks.
+- (void)reassembleChunkedNodes:(NSMutableArray<NSArray *> *)nodes
+                         state:(iTermGraphDatabaseState *)state {
+    NSData *marker = iTermGraphDatabaseChunkedNodeMarker();
+    const BOOL anyChunked = [nodes anyWithBlock:^BOOL(NSArray *row) {
+        return [row[4] isEqual:marker];
+    }];
+    if (!anyChunked) {
+        // Skip the join entirely for databases with no large nodes.
+        return;
+    }
+    NSMutableDictionary<NSNumber *, NSMutableData *> *assembled = [NSMutableDictionary dictionary];
+    FMResultSet *rs = [state.db executeQuery:@"select NodeChunk.node as node, Chunk.data as data "
+                                             @"from NodeChunk join Chunk on Chunk.hash = NodeChunk.hash "
+                                             @"order by NodeChunk.node, NodeChunk.seq"];
+    while ([rs next]) {
+        NSNumber *node = @([rs longLongIntForColumn:@"node"]);
+        NSMutableData *data = assembled[node];
+        if (!data) {
+            data = [NSMutableData data];
+            assembled[node] = data;
+        }
+        [data appendData:[rs dataForColumn:@"data"] ?: [NSData data]];
+    }
+    [rs close];
+    DLog(@"Reassembled %@ chunked nodes", @(assembled.count));
+
+    [nodes enumerateObjectsUsingBlock:^(NSArray * _Nonnull row, NSUInteger idx, BOOL * _Nonnull stop) {
+        if (![row[4] isEqual:marker]) {
+            return;
+        }
+        NSMutableArray *replacement = [row mutableCopy];
+        replacement[4] = assembled[row[3]] ?: [NSData data];
+        nodes[idx] = replacement;
+    }];
+}
+
 @end
 
@@ -0,0 +1,38 @@
+//
+//  iTermGridCoordArray.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "VT100GridTypes.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A growable array of VT100GridCoords stored contiguously, so unlike an NSArray of NSValues it
+// doesn't allocate per element. -removeAllCoords keeps the storage so an array can be reused.
+@interface iTermGridCoordArray : NSObject<NSCopying>
+@property (nonatomic, readonly) NSInteger count;
+
+// Valid until the array is next mutated.
+@property (nonatomic, readonly) const VT100GridCoord *coords NS_RETURNS_INNER_POINTER;
+
+@property (nonatomic, readonly) VT100GridCoord first;
+@property (nonatomic, readonly) VT100GridCoord last;
+
+- (VT100GridCoord)coordAtIndex:(NSInteger)index;
+- (void)appendCoord:(VT100GridCoord)coord;
+- (void)appendCoord:(VT100GridCoord)coord count:(NSInteger)count;
+- (void)appendCoordsFromArray:(iTermGridCoordArray *)other;
+- (void)removeRange:(NSRange)range;
+- (void)removeLast:(NSInteger)count;
+- (void)removeAllCoords;
+- (void)reverse;
+
+// For legacy callers. Allocates an NSValue per coord.
+- (NSArray<NSValue *> *)arrayOfValues;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,113 @@
+//
+//  iTermGridCoordArray.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermGridCoordArray.h"
+
+#import "DebugLogging.h"
+
+@implementation iTermGridCoordArray {
+    VT100GridCoord *_coords;
+    NSInteger _count;
+    NSInteger _capacity;
+}
+
+- (void)dealloc {
+    free(_coords);
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    iTermGridCoordArray *copy = [[iTermGridCoordArray alloc] init];
+    [copy appendCoordsFromArray:self];
+    return copy;
+}
+
+- (NSString *)description {
+    NSMutableArray<NSString *> *parts = [NSMutableArray array];
+    for (NSInteger i = 0; i < _count; i++) {
+        [parts addObject:VT100GridCoordDescription(_coords[i])];
+    }
+    return [NSString stringWithFormat:@"<%@: %p %@>",
+            NSStringFromClass([self class]), self, [parts componentsJoinedByString:@" "]];
+}
+
+- (const VT100GridCoord *)coords {
+    return _coords;
+}
+
+- (VT100GridCoord)coordAtIndex:(NSInteger)index {
+    ITAssertWithMessage(index >= 0 && index < _count, @"Index %@ out of bounds [0, %@)", @(index), @(_count));
+    return _coords[index];
+}
+
+- (VT100GridCoord)first {
+    return [self coordAtIndex:0];
+}
+
+- (VT100GridCoord)last {
+    return [self coordAtIndex:_count - 1];
+}
+
+- (void)reserve:(NSInteger)minimumCapacity {
+    if (minimumCapacity <= _capacity) {
+        return;
+    }
+    _capacity = MAX(minimumCapacity, MAX(16, _capacity * 2));
+    _coords = realloc(_coords, _capacity * sizeof(*_coords));
+}
+
+- (void)appendCoord:(VT100GridCoord)coord {
+    [self reserve:_count + 1];
+    _coords[_count++] = coord;
+}
+
+- (void)appendCoord:(VT100GridCoord)coord count:(NSInteger)count {
+    [self reserve:_count + count];
+    for (NSInteger i = 0; i < count; i++) {
+        _coords[_count++] = coord;
+    }
+}
+
+- (void)appendCoordsFromArray:(iTermGridCoordArray *)other {
+    const NSInteger otherCount = other.count;
+    [self reserve:_count + otherCount];
+    memmove(_coords + _count, other.coords, otherCount * sizeof(*_coords));
+    _count += otherCount;
+}
+
+- (void)removeRange:(NSRange)range {
+    ITAssertWithMessage(NSMaxRange(range) <= _count, @"Range %@ out of bounds [0, %@)", NSStringFromRange(range), @(_count));
+    memmove(_coords + range.location,
+            _coords + NSMaxRange(range),
+            (_count - NSMaxRange(range)) * sizeof(*_coords));
+    _count -= range.length;
+}
+
+- (void)removeLast:(NSInteger)count {
+    _count -= MIN(_count, MAX(0, count));
+}
+
+- (void)removeAllCoords {
+    _count = 0;
+}
+
+- (void)reverse {
+    for (NSInteger i = 0, j = _count - 1; i < j; i++, j--) {
+        const VT100GridCoord temp = _coords[i];
+        _coords[i] = _coords[j];
+        _coords[j] = temp;
+    }
+}
+
+- (NSArray<NSValue *> *)arrayOfValues {
+    NSMutableArray<NSValue *> *values = [NSMutableArray arrayWithCapacity:_count];
+    for (NSInteger i = 0; i < _count; i++) {
+        [values addObject:[NSValue valueWithGridCoord:_coords[i]]];
+    }
+    return values;
+}
+
+@end
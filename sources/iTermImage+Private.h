@@ -7,4 +7,7 @@
 
 @interface iTermImage ()
 @property (nonatomic, readwrite) NSSize size;
+@property (nonatomic, readwrite, copy) NSData *digest;
+
++ (NSData *)digestForData:(NSData *)data;
 @end
@@ -25,6 +25,10 @@
 @property(nonatomic, readonly) NSSize size;
 @property(nonatomic, readonly) NSMutableArray<NSImage *> *images;
 
+// SHA-256 of the data the image was decoded from. It is computed by the decoder, off the main
+// thread. Nil for images that weren't decoded from data.
+@property(nonatomic, readonly) NSData *digest;
+
 // Animated GIFs are not supported through this interface.
 + (instancetype)imageWithNativeImage:(NSImage *)image;
 
@@ -8,6 +8,7 @@
 
 #import "iTermImage.h"
 #import "iTermImage+Private.h"
+#import <CommonCrypto/CommonDigest.h>
 #import "DebugLogging.h"
 #import "NSData+iTerm.h"
 #import "NSImage+iTerm.h"
@@ -51,6 +52,12 @@ static const CGFloat kMaxDimension = 10000;
     return [iTermSandboxedWorkerClient imageFromSixelData:sixelData];
 }
 
++ (NSData *)digestForData:(NSData *)data {
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    return [NSData dataWithBytes:digest length:sizeof(digest)];
+}
+
 - (instancetype)init {
     self = [super init];
     if (self) {
@@ -74,12 +81,18 @@ static const CGFloat kMaxDimension = 10000;
         [imageDatas addObject:imageData];
     }
     [coder encodeObject:imageDatas forKey:@"images"];
+    [coder encodeObject:self.digest forKey:@"digest"];
 }
 
 - (nullable instancetype)initWithCoder:(nonnull NSCoder *)coder {
     @try {
         _delays = [coder decodeObjectOfClasses:[NSSet setWithArray:@[[NSMutableArray class], [NSNumber class]]] forKey:@"delays"];
         _size = [coder decodeSizeForKey:@"size"];
+        _digest = [coder decodeObjectOfClass:[NSData class] forKey:@"digest"];
+        if (_digest && _digest.length != CC_SHA256_DIGEST_LENGTH) {
+            DLog(@"Bogus digest %@", _digest);
+            return nil;
+        }
         if (_size.width <= 0 || _size.width >= kMaxDimension ||
             _size.height <= 0 || _size.height >= kMaxDimension) {
             DLog(@"Bogus size %@", NSStringFromSize(_size));
@@ -70,6 +70,10 @@ extern NSString *const iTermImageDidLoad;
 // During restoration, do we still need to find a mark?
 @property (nonatomic) BOOL provisional;
 
+// Incremented when -setImageFromImage:data: replaces the image, as happens while a sixel image is
+// drawn band by band. Renderers that cache the image include this in the cache key.
+@property (atomic, readonly) NSUInteger generation;
+
 // Used to create a new instance for a new image. This may remain an empty container until
 // -setImageFromImage: is called.
 - (instancetype)initWithCode:(unichar)code;
@@ -11,6 +11,7 @@
 #import "DebugLogging.h"
 #import "iTermAnimatedImageInfo.h"
 #import "iTermImage.h"
+#import "iTermImageStore.h"
 #import "FutureMethods.h"
 #import "NSData+iTerm.h"
 #import "NSImage+iTerm.h"
@@ -38,6 +39,12 @@ NSString *const iTermImageDidLoad = @"iTermImageDidLoad";
     NSString *_uniqueIdentifier;
     NSDictionary *_dictionary;
     void (^_queuedBlock)(void);
+    // Non-nil when the decoded image is shared through the image store. In that case _image is nil
+    // for still images so the store can evict the decoded frames.
+    // The Metal renderer reads the image from its own queue, so this, _image, _animatedImage,
+    // _embeddedImages, and _reloadingEvictedImage are guarded by @synchronized(self).
+    iTermImageStoreEntry *_storeEntry;
+    BOOL _reloadingEvictedImage;
 }
 
 - (instancetype)initWithCode:(unichar)code {
@@ -109,12 +116,25 @@ NSString *const iTermImageDidLoad = @"iTermImageDidLoad";
             [image autorelease];
             [_queuedBlock release];
             _queuedBlock = nil;
-            [_animatedImage autorelease];
-            _animatedImage = [[iTermAnimatedImageInfo alloc] initWithImage:image];
-            if (!_animatedImage) {
-                _image = [image retain];
+            iTermAnimatedImageInfo *animatedImage = [[iTermAnimatedImageInfo alloc] initWithImage:image];
+            iTermImageStoreEntry *entry = nil;
+            if (!animatedImage && image.digest && _data.length && !_broken) {
+                entry = [[iTermImageStore sharedInstance] retainEntryForData:_data
+                                                                      digest:image.digest
+                                                                       image:image];
             }
-            if (_image || _animatedImage) {
+            BOOL loaded;
+            @synchronized(self) {
+                [_animatedImage autorelease];
+                _animatedImage = animatedImage;
+                if (entry) {
+                    [self adoptStoreEntry:entry];
+                } else if (!_animatedImage) {
+                    _image = [image retain];
+                }
+                loaded = (_image || _animatedImage || _storeEntry);
+            }
+            if (loaded) {
                 DLog(@"Loaded %@", self.uniqueIdentifier);
                 [[NSNotificationCenter defaultCenter] postNotificationName:iTermImageDidLoad object:self];
             }
@@ -137,6 +157,7 @@ NSString *const iTermImageDidLoad = @"iTermImageDidLoad";
 }
 
 - (void)dealloc {
+    [self adoptStoreEntry:nil];
     [_filename release];
     [_image release];
     [_embeddedImages release];
@@ -190,14 +211,79 @@ NSString *const iTermImageDidLoad = @"iTermImageDidLoad";
     [_dictionary release];
     _dictionary = nil;
 
-    [_animatedImage autorelease];
-    _animatedImage = [[iTermAnimatedImageInfo alloc] initWithImage:image];
+    iTermImageStoreEntry *entry = nil;
+    if (image.digest && data.length && !_broken) {
+        // Identical images share one decoded copy and one copy of the data.
+        entry = [[iTermImageStore sharedInstance] retainEntryForData:data
+                                                              digest:image.digest
+                                                               image:image];
+        if (entry) {
+            data = entry.data;
+            image = entry.image ?: image;
+        }
+    }
+    iTermAnimatedImageInfo *animatedImage = [[iTermAnimatedImageInfo alloc] initWithImage:image];
+
+    @synchronized(self) {
+        [self adoptStoreEntry:entry];
+
+        [_animatedImage autorelease];
+        _animatedImage = animatedImage;
+
+        [_data autorelease];
+        _data = [data retain];
 
-    [_data autorelease];
-    _data = [data retain];
+        [_image autorelease];
+        if (_storeEntry && !_animatedImage) {
+            _image = nil;
+        } else {
+            _image = [image retain];
+        }
+        [_embeddedImages removeAllObjects];
+        _generation += 1;
+    }
+}
 
-    [_image autorelease];
-    _image = [image retain];
+// Takes ownership of a reference returned by -[iTermImageStore retainEntryForData:digest:image:]
+// and gives up the previous one, if any.
+- (void)adoptStoreEntry:(iTermImageStoreEntry *)entry {
+    if (_storeEntry) {
+        [[iTermImageStore sharedInstance] releaseEntry:_storeEntry];
+        [_storeEntry release];
+    }
+    _storeEntry = [entry retain];
+}
+
+// The store evicted our decoded frames. Decode them again in the background and notify observers
+// so the image gets redrawn, as is done for images loaded lazily after restoration. May be called
+// on any thread.
+- (void)reloadEvictedImageForEntry:(iTermImageStoreEntry *)entry {
+    @synchronized(self) {
+        if (_reloadingEvictedImage) {
+            return;
+        }
+        _reloadingEvictedImage = YES;
+    }
+    static dispatch_once_t onceToken;
+    static dispatch_queue_t queue;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("com.iterm2.EvictedImageDecoding", DISPATCH_QUEUE_SERIAL);
+    });
+    DLog(@"Reload evicted image for %@", self.uniqueIdentifier);
+    dispatch_async(queue, ^{
+        const BOOL ok = [entry decodeIfNeeded] != nil;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            BOOL current;
+            @synchronized(self) {
+                _reloadingEvictedImage = NO;
+                current = (entry == _storeEntry);
+            }
+            if (ok && current) {
+                [[iTermImageStore sharedInstance] touchEntry:entry];
+                [[NSNotificationCenter defaultCenter] postNotificationName:iTermImageDidLoad object:self];
+            }
+        });
+    });
 }
 
 - (NSString *)imageType {
@@ -229,14 +315,31 @@ NSString *const iTermImageDidLoad = @"iTermImageDidLoad";
     _animatedImage.paused = paused;
 }
 
+// Returns a strong reference, so the image stays valid for the caller even if the store evicts
+// it on another thread.
 - (iTermImage *)image {
     [self loadFromDictionaryIfNeeded];
-    return _image;
+    iTermImageStoreEntry *entry;
+    @synchronized(self) {
+        if (_image || !_storeEntry) {
+            return [[_image retain] autorelease];
+        }
+        entry = [[_storeEntry retain] autorelease];
+    }
+    iTermImage *image = entry.image;
+    if (image) {
+        [[iTermImageStore sharedInstance] touchEntry:entry];
+        return image;
+    }
+    [self reloadEvictedImageForEntry:entry];
+    return nil;
 }
 
 - (iTermAnimatedImageInfo *)animatedImage {
     [self loadFromDictionaryIfNeeded];
-    return _animatedImage;
+    @synchronized(self) {
+        return [[_animatedImage retain] autorelease];
+    }
 }
 
 - (NSImage *)imageWithCellSize:(CGSize)cellSize {
@@ -264,26 +367,30 @@ static NSSize iTermImageInfoGetSizeForRegionPreservingAspectRatio(const NSSize r
     }
 }
 
+// Called from the Metal renderer's queue as well as the main thread.
 - (NSImage *)imageWithCellSize:(CGSize)cellSize timestamp:(NSTimeInterval)timestamp {
-    if (!self.ready) {
+    const NSUInteger generation = self.generation;
+    iTermAnimatedImageInfo *animatedImage = self.animatedImage;
+    iTermImage *image = animatedImage ? nil : self.image;
+    if (!animatedImage && !image) {
         DLog(@"%@ not ready", self.uniqueIdentifier);
         return nil;
     }
-    if (!_embeddedImages) {
-        _embeddedImages = [[NSMutableDictionary alloc] init];
+    int frame = [animatedImage frameForTimestamp:timestamp];  // 0 if not animated
+    NSImage *embeddedImage;
+    @synchronized(self) {
+        embeddedImage = [[_embeddedImages[@(frame)] retain] autorelease];
     }
-    int frame = [self.animatedImage frameForTimestamp:timestamp];  // 0 if not animated
-    NSImage *embeddedImage = _embeddedImages[@(frame)];
 
     NSSize region = NSMakeSize(cellSize.width * _size.width,
                                cellSize.height * _size.height);
     if (!NSEqualSizes(embeddedImage.size, region)) {
         NSSize size;
         NSImage *theImage;
-        if (self.animatedImage) {
-            theImage = [self.animatedImage imageForFrame:frame];
+        if (animatedImage) {
+            theImage = [animatedImage imageForFrame:frame];
         } else {
-            theImage = [self.image.images firstObject];
+            theImage = [image.images firstObject];
         }
         if (_preserveAspectRatio) {
             size = iTermImageInfoGetSizeForRegionPreservingAspectRatio(region, theImage.size);
@@ -299,10 +406,18 @@ static NSSize iTermImageInfoGetSizeForRegionPreservingAspectRatio(const NSSize r
                                                   (region.height - size.height) / 2 + inset.bottom,
                                                   MAX(0, size.width - inset.left - inset.right),
                                                   MAX(0, size.height - inset.top - inset.bottom));
-        NSImage *canvas = [theImage safelyResizedImageWithSize:size destinationRect:destinationRect];
-        self.embeddedImages[@(frame)] = canvas;
+        embeddedImage = [theImage safelyResizedImageWithSize:size destinationRect:destinationRect];
+        @synchronized(self) {
+            // Don't cache a rendition of an image that was replaced in the meantime.
+            if (_generation == generation) {
+                if (!_embeddedImages) {
+                    _embeddedImages = [[NSMutableDictionary alloc] init];
+                }
+                _embeddedImages[@(frame)] = embeddedImage;
+            }
+        }
     }
-    return _embeddedImages[@(frame)];
+    return embeddedImage;
 }
 
 + (NSEdgeInsets)fractionalInsetsForPreservedAspectRatioWithDesiredSize:(NSSize)desiredSize
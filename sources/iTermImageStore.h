@@ -0,0 +1,73 @@
+//
+//  iTermImageStore.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class iTermImage;
+
+// One distinct image, identified by the SHA-256 of its encoded data. Every iTermImageInfo showing
+// the same bytes shares a single entry, and so a single decoded copy.
+@interface iTermImageStoreEntry : NSObject
+@property (nonatomic, readonly) NSData *digest;
+
+// Original encoded data (compressed image or sixel payload). Always retained so the decoded image
+// can be rebuilt after eviction.
+@property (nonatomic, readonly) NSData *data;
+
+// Decoded frames. nil after the entry has been evicted to stay within the memory budget; use
+// -decodeIfNeeded to bring it back. The getter returns a strong reference, so the frames stay
+// valid for the caller even if they are evicted on another thread.
+@property (nullable, atomic, readonly) iTermImage *image;
+
+// Estimated size of the decoded frames in bytes.
+@property (nonatomic, readonly) NSUInteger decodedCost;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Decodes the original data again if the image was evicted. This is slow and may block for a
+// long time, so it should be called off the main thread.
+- (nullable iTermImage *)decodeIfNeeded;
+@end
+
+// Content-addressed cache of decoded inline images. Identical images printed repeatedly
+// (spinners, logos) share one decoded copy. Decoded frames are evicted in least-recently-used
+// order when they exceed the memory budget; the encoded data is kept so they can be decoded again
+// on demand. Thread-safe: the Metal renderer touches entries from its own queue while the main
+// thread adds and removes them.
+@interface iTermImageStore : NSObject
+
+// Budget for decoded frames in bytes. Until it is assigned, it tracks the
+// inlineImageMemoryBudgetMB advanced setting, including later changes to it.
+@property (nonatomic) NSUInteger memoryBudget;
+
+// Total cost of decoded frames currently resident.
+@property (nonatomic, readonly) NSUInteger decodedBytes;
+
+@property (nonatomic, readonly) NSUInteger count;
+
++ (instancetype)sharedInstance;
+
+// Returns the canonical entry for this data, creating it with `image` if needed, and adds a
+// reference to it. Balance with -releaseEntry:. The digest is the SHA-256 of the data, which the
+// decoder computes (see -[iTermImage digest]) so it isn't hashed again here. Returns nil if an
+// entry with this digest holds different data.
+- (nullable iTermImageStoreEntry *)retainEntryForData:(NSData *)data
+                                               digest:(NSData *)digest
+                                                image:(iTermImage *)image;
+
+// Removes a reference. The entry is dropped from the store when nothing references it.
+- (void)releaseEntry:(iTermImageStoreEntry *)entry;
+
+// Marks the entry as recently used and makes its decoded image count against the budget again
+// after it has been re-decoded.
+- (void)touchEntry:(iTermImageStoreEntry *)entry;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,246 @@
+//
+//  iTermImageStore.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermImageStore.h"
+
+#import "DebugLogging.h"
+#import "iTermAdvancedSettingsModel.h"
+#import "iTermImage.h"
+#import "NSData+iTerm.h"
+
+// Sixel payloads handed to the sandboxed worker begin with the DCS parameters and a newline,
+// followed by ESC P. Compressed image formats never look like that.
+static BOOL iTermImageStoreDataIsSixel(NSData *data) {
+    const unsigned char *bytes = data.bytes;
+    const NSUInteger limit = MIN(data.length, 256);
+    for (NSUInteger i = 0; i < limit; i++) {
+        if (bytes[i] == '\n') {
+            return (i + 2 < data.length && bytes[i + 1] == 0x1b && bytes[i + 2] == 'P');
+        }
+    }
+    return NO;
+}
+
+static NSUInteger iTermImageStoreCostOfImage(iTermImage *image) {
+    NSUInteger cost = 0;
+    for (NSImage *frame in image.images) {
+        for (NSImageRep *rep in frame.representations) {
+            cost += (NSUInteger)rep.pixelsWide * (NSUInteger)rep.pixelsHigh * 4;
+        }
+    }
+    return cost;
+}
+
+@interface iTermImageStoreEntry()
+@property (nullable, atomic, strong, readwrite) iTermImage *image;
+@property (nonatomic) NSInteger referenceCount;
+@property (nonatomic) uint64_t lastUse;
+@property (nonatomic) BOOL resident;
+@property (nonatomic, readwrite) NSUInteger decodedCost;
+@property (nonatomic, readonly) BOOL evictable;
+@end
+
+@implementation iTermImageStoreEntry
+
+- (instancetype)initWithDigest:(NSData *)digest data:(NSData *)data image:(iTermImage *)image {
+    self = [super init];
+    if (self) {
+        _digest = [digest copy];
+        _data = [data copy];
+        _image = image;
+        _decodedCost = iTermImageStoreCostOfImage(image);
+    }
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p digest=%@ refs=%@ resident=%@ cost=%@>",
+            self.class, self, [_digest.it_hexEncoded substringToIndex:8], @(_referenceCount),
+            @(self.image != nil), @(_decodedCost)];
+}
+
+// Animated images are owned by iTermAnimatedImageInfo as well, so evicting them saves nothing.
+- (BOOL)evictable {
+    return self.image.delays.count == 0;
+}
+
+- (nullable iTermImage *)decodeIfNeeded {
+    iTermImage *image = self.image;
+    if (image) {
+        return image;
+    }
+    DLog(@"Re-decoding evicted image %@", self);
+    if (iTermImageStoreDataIsSixel(_data)) {
+        image = [iTermImage imageWithSixelData:_data];
+    } else {
+        image = [iTermImage imageWithCompressedData:_data];
+    }
+    self.image = image;
+    return image;
+}
+
+@end
+
+@implementation iTermImageStore {
+    NSMutableDictionary<NSData *, iTermImageStoreEntry *> *_entries;
+    uint64_t _clock;
+    NSUInteger _decodedBytes;
+    NSUInteger _memoryBudget;
+    // YES once memoryBudget has been assigned explicitly; otherwise the advanced setting is used.
+    BOOL _memoryBudgetOverridden;
+}
+
++ (instancetype)sharedInstance {
+    static iTermImageStore *instance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [[self alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [NSMutableDictionary dictionary];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(advancedSettingsDidChange:)
+                                                     name:iTermAdvancedSettingsDidChange
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSUInteger)count {
+    @synchronized(self) {
+        return _entries.count;
+    }
+}
+
+- (NSUInteger)decodedBytes {
+    @synchronized(self) {
+        return _decodedBytes;
+    }
+}
+
+- (NSUInteger)memoryBudget {
+    @synchronized(self) {
+        if (_memoryBudgetOverridden) {
+            return _memoryBudget;
+        }
+    }
+    return (NSUInteger)MAX(0, [iTermAdvancedSettingsModel inlineImageMemoryBudgetMB]) * 1024 * 1024;
+}
+
+- (void)setMemoryBudget:(NSUInteger)memoryBudget {
+    @synchronized(self) {
+        _memoryBudget = memoryBudget;
+        _memoryBudgetOverridden = YES;
+        [self evictIfNeeded];
+    }
+}
+
+- (nullable iTermImageStoreEntry *)retainEntryForData:(NSData *)data
+                                               digest:(NSData *)digest
+                                                image:(iTermImage *)image {
+    @synchronized(self) {
+        iTermImageStoreEntry *entry = _entries[digest];
+        if (!entry) {
+            entry = [[iTermImageStoreEntry alloc] initWithDigest:digest data:data image:image];
+            _entries[digest] = entry;
+            DLog(@"Add %@", entry);
+        } else if (![entry.data isEqualToData:data]) {
+            // The digest came from the sandboxed worker, so don't take its word for it.
+            DLog(@"Digest collision with %@", entry);
+            return nil;
+        } else if (!entry.image) {
+            // Adopt the freshly decoded copy rather than decoding again later.
+            entry.image = image;
+        }
+        entry.referenceCount += 1;
+        [self touchEntry:entry];
+        return entry;
+    }
+}
+
+- (void)releaseEntry:(iTermImageStoreEntry *)entry {
+    @synchronized(self) {
+        entry.referenceCount -= 1;
+        assert(entry.referenceCount >= 0);
+        if (entry.referenceCount > 0) {
+            return;
+        }
+        DLog(@"Remove %@", entry);
+        if (entry.resident) {
+            _decodedBytes -= entry.decodedCost;
+            entry.resident = NO;
+        }
+        [_entries removeObjectForKey:entry.digest];
+    }
+}
+
+- (void)touchEntry:(iTermImageStoreEntry *)entry {
+    @synchronized(self) {
+        entry.lastUse = ++_clock;
+        iTermImage *image = entry.image;
+        if (!image || entry.resident) {
+            return;
+        }
+        entry.resident = YES;
+        entry.decodedCost = iTermImageStoreCostOfImage(image);
+        _decodedBytes += entry.decodedCost;
+        [self evictIfNeeded];
+    }
+}
+
+#pragma mark - Private
+
+- (void)advancedSettingsDidChange:(NSNotification *)notification {
+    // A lowered budget takes effect right away rather than on the next image.
+    @synchronized(self) {
+        [self evictIfNeeded];
+    }
+}
+
+// Evicting is rare compared to lookups, so the entries are ordered only when it's needed.
+// The budget is fetched on each pass so changes to the advanced setting are honored. Call this
+// while synchronized on self.
+- (void)evictIfNeeded {
+    const NSUInteger memoryBudget = self.memoryBudget;
+    if (memoryBudget == 0 || _decodedBytes <= memoryBudget) {
+        return;
+    }
+    NSArray<iTermImageStoreEntry *> *candidates = [_entries.allValues filteredArrayUsingPredicate:
+                                                   [NSPredicate predicateWithBlock:^BOOL(iTermImageStoreEntry *entry, NSDictionary *bindings) {
+        return entry.resident && entry.evictable;
+    }]];
+    candidates = [candidates sortedArrayUsingComparator:^NSComparisonResult(iTermImageStoreEntry *lhs, iTermImageStoreEntry *rhs) {
+        if (lhs.lastUse == rhs.lastUse) {
+            return NSOrderedSame;
+        }
+        return lhs.lastUse < rhs.lastUse ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    for (iTermImageStoreEntry *entry in candidates) {
+        if (_decodedBytes <= memoryBudget) {
+            break;
+        }
+        if (entry.lastUse == _clock) {
+            // Never evict the image that is being added or drawn right now.
+            continue;
+        }
+        DLog(@"Evict %@", entry);
+        _decodedBytes -= entry.decodedCost;
+        entry.resident = NO;
+        entry.image = nil;
+    }
+}
+
+@end
@@ -33,6 +33,7 @@ static const int iTermMultiServerMaximumSupportedRestorationIdentifierVersion =
 @property (nonatomic) BOOL attached;
 @property (nonatomic) pid_t pid;
 @property (nonatomic) BOOL brokenPipe;
+@property (nonatomic, strong) NSData *bufferedOutput;
 @end
 
 @implementation iTermMultiServerJobManagerPartialAttachment
@@ -329,7 +330,14 @@ typedef struct {
     void (^finish)(iTermFileDescriptorMultiClientChild *) = ^(iTermFileDescriptorMultiClientChild *child) {
         [[iTermThread main] dispatchAsync:^(id  _Nullable state) {
             if (child != nil && !child.hasTerminated) {
-                [self didAttachToProcess:child.pid task:task state:state];
+                [self didAttachToProcess:child.pid
+                                    task:task
+                          bufferedOutput:[child takeBufferedOutput]
+                                   state:state];
+            } else if (child != nil) {
+                [self didAttachToTerminatedProcess:child.pid
+                                              task:task
+                                    bufferedOutput:[child takeBufferedOutput]];
             }
             iTermJobManagerAttachResults results = 0;
             if (child != nil) {
@@ -343,7 +351,6 @@ typedef struct {
     };
     [self beginAttachToServer:serverConnection
                 withProcessID:thePid
-                   brokenPipe:^{ [task brokenPipe]; }
                    completion:finish];
 }
 
@@ -357,11 +364,12 @@ typedef struct {
     iTermMultiServerJobManagerPartialAttachment *result = [[iTermMultiServerJobManagerPartialAttachment alloc] init];
     [self beginAttachToServer:serverConnection
                 withProcessID:thePid
-                   brokenPipe:^{ result.brokenPipe = YES; }
                    completion:^(iTermFileDescriptorMultiClientChild *child) {
         result.shouldRegister = (child != nil && !child.hasTerminated);
+        result.brokenPipe = (child != nil && child.hasTerminated);
         result.attached = (child != nil);
         result.pid = child.pid;
+        result.bufferedOutput = [child takeBufferedOutput];
         completion(result);
     }];
 }
@@ -379,9 +387,6 @@ typedef struct {
         dispatch_group_leave(group);
     }];
     dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
-    if (result.brokenPipe) {
-        [task brokenPipe];
-    }
     return [self finishAttaching:result task:task];
 }
 
@@ -391,7 +396,12 @@ typedef struct {
         assert(result.pid > 0);
         [self didAttachToProcess:result.pid
                             task:task
+                  bufferedOutput:result.bufferedOutput
                            state:[iTermMainThreadState sharedInstance]];
+    } else if (result.brokenPipe) {
+        [self didAttachToTerminatedProcess:result.pid
+                                      task:task
+                            bufferedOutput:result.bufferedOutput];
     }
     iTermJobManagerAttachResults results = 0;
     if (result.attached) {
@@ -400,15 +410,11 @@ typedef struct {
             results |= iTermJobManagerAttachResultsRegistered;
         }
     }
-    if (result.brokenPipe) {
-        [task brokenPipe];
-    }
     return results;
 }
 
 - (void)beginAttachToServer:(iTermGeneralServerConnection)serverConnection
               withProcessID:(NSNumber *)thePid
-                 brokenPipe:(void (^)(void))brokenPipe
                  completion:(void (^)(iTermFileDescriptorMultiClientChild *))completion {
     assert(serverConnection.type == iTermGeneralServerConnectionTypeMulti);
     DLog(@"begin attaching to server on socket %@ with pid %@", @(serverConnection.multi.number), @(serverConnection.multi.pid));
@@ -416,7 +422,6 @@ typedef struct {
         assert(state.child == nil);
         [self reallyAttachToServer:serverConnection
                     withProcessID:thePid
-                        brokenPipe:brokenPipe
                             state:state
                          callback:[self.thread newCallbackWithBlock:^(iTermMultiServerJobManagerState *state,
                                                                       iTermFileDescriptorMultiClientChild *child) {
@@ -425,19 +430,48 @@ typedef struct {
     }];
 }
 
-- (void)didAttachToProcess:(pid_t)pid task:(id<iTermTask>)task state:(iTermMainThreadState *)state {
+- (void)didAttachToProcess:(pid_t)pid
+                      task:(id<iTermTask>)task
+            bufferedOutput:(NSData *)bufferedOutput
+                     state:(iTermMainThreadState *)state {
     DLog(@"Did attach to process with pid %@", @(pid));
     [state check];
 
     [[iTermProcessCache sharedInstance] registerTrackedPID:pid];
-    DLog(@"Register task %@ after attaching", @(pid));
-    [[TaskNotifier sharedInstance] registerTask:task];
+    if (bufferedOutput.length == 0) {
+        DLog(@"Register task %@ after attaching", @(pid));
+        [[TaskNotifier sharedInstance] registerTask:task];
+    } else {
+        // Output the server saved while we were detached must be processed before anything newer
+        // is read from the fd. Processing can wait on the main thread, so it can't happen here.
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [task replayBufferedOutput:bufferedOutput];
+            DLog(@"Register task %@ after attaching and replaying", @(pid));
+            [[TaskNotifier sharedInstance] registerTask:task];
+        });
+    }
     [[iTermProcessCache sharedInstance] setNeedsUpdate:YES];
 }
 
+// The child exited while we were detached. Whatever it printed that the server saved goes through
+// the task before the exit is reported, so its last words aren't lost.
+- (void)didAttachToTerminatedProcess:(pid_t)pid
+                                task:(id<iTermTask>)task
+                      bufferedOutput:(NSData *)bufferedOutput {
+    DLog(@"Attached to terminated process with pid %@ and %@ bytes of buffered output",
+         @(pid), @(bufferedOutput.length));
+    if (bufferedOutput.length == 0) {
+        [task brokenPipe];
+        return;
+    }
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [task replayBufferedOutput:bufferedOutput];
+        [task brokenPipe];
+    });
+}
+
 - (void)reallyAttachToServer:(iTermGeneralServerConnection)serverConnection
                withProcessID:(NSNumber *)thePid
-                  brokenPipe:(void (^)(void))brokenPipe
                        state:(iTermMultiServerJobManagerState *)state
                     callback:(iTermCallback<id, iTermFileDescriptorMultiClientChild *> *)completionCallback {
     assert(serverConnection.type == iTermGeneralServerConnectionTypeMulti);
@@ -476,7 +510,7 @@ typedef struct {
                          ^(NSError * _Nonnull error) {
                             DLog(@"Failed to wait on child with pid %d: %@", pid, error);
                         }];
-                        brokenPipe();
+                        // The caller reports the exit after replaying whatever the child printed.
                         [completionCallback invokeWithObject:child];
                         return;
                     }]];
@@ -11,9 +11,11 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface iTermMultiServerMessage: NSObject
 @property (nonatomic, readonly) NSData *data;
+// The first of fileDescriptors, if any.
 @property (nonatomic, readonly) NSNumber *fileDescriptor;
+@property (nonatomic, readonly) NSArray<NSNumber *> *fileDescriptors;
 
-- (instancetype)initWithData:(NSData *)data fileDescriptor:(NSNumber *)fileDescriptor NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithData:(NSData *)data fileDescriptors:(NSArray<NSNumber *> *)fileDescriptors NS_DESIGNATED_INITIALIZER;
 - (instancetype)init NS_UNAVAILABLE;
 @end
 
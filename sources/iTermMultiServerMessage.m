@@ -10,29 +10,38 @@
 #import "DebugLogging.h"
 
 @implementation iTermMultiServerMessage {
-    NSNumber *_fileDescriptor;
+    NSArray<NSNumber *> *_fileDescriptors;
     BOOL _fileDescriptorAccessed;
 }
 
-- (instancetype)initWithData:(NSData *)data fileDescriptor:(NSNumber *)fileDescriptor {
+- (instancetype)initWithData:(NSData *)data fileDescriptors:(NSArray<NSNumber *> *)fileDescriptors {
     self = [super init];
     if (self) {
         _data = [data copy];
-        _fileDescriptor = fileDescriptor;
+        _fileDescriptors = [fileDescriptors copy];
     }
     return self;
 }
 
 - (void)dealloc {
-    if (!_fileDescriptorAccessed && _fileDescriptor && _fileDescriptor.intValue >= 0) {
-        DLog(@"File descriptor in message never accessed. Closing %d", _fileDescriptor.intValue);
-        close(_fileDescriptor.intValue);
+    if (_fileDescriptorAccessed) {
+        return;
+    }
+    for (NSNumber *fileDescriptor in _fileDescriptors) {
+        if (fileDescriptor.intValue >= 0) {
+            DLog(@"File descriptor in message never accessed. Closing %d", fileDescriptor.intValue);
+            close(fileDescriptor.intValue);
+        }
     }
 }
 
 - (NSNumber *)fileDescriptor {
+    return self.fileDescriptors.firstObject;
+}
+
+- (NSArray<NSNumber *> *)fileDescriptors {
     _fileDescriptorAccessed = YES;
-    return _fileDescriptor;
+    return _fileDescriptors;
 }
 
 @end
@@ -16,7 +16,7 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readonly) NSInteger length;
 
 - (void)appendBytes:(void *)bytes length:(NSInteger)length;
-- (void)setFileDescriptor:(int)fileDescriptor;
+- (void)addFileDescriptor:(int)fileDescriptor;
 @end
 
 NS_ASSUME_NONNULL_END
@@ -8,10 +8,11 @@
 #import "iTermMultiServerMessageBuilder.h"
 
 #import "DebugLogging.h"
+#import "iTermFileDescriptorServerShared.h"
 
 @implementation iTermMultiServerMessageBuilder {
     NSMutableData *_accumulator;
-    NSNumber *_fileDescriptor;
+    NSMutableArray<NSNumber *> *_fileDescriptors;
     iTermMultiServerMessage *_message;
 }
 
@@ -19,14 +20,18 @@
     self = [super init];
     if (self) {
         _accumulator = [NSMutableData data];
+        _fileDescriptors = [NSMutableArray array];
     }
     return self;
 }
 
 - (void)dealloc {
-    if (!_message && _fileDescriptor && _fileDescriptor.intValue >= 0) {
-        DLog(@"Close file descriptor %d in message that was never decoded", _fileDescriptor.intValue);
-        close(_fileDescriptor.intValue);
+    if (_message) {
+        return;
+    }
+    for (NSNumber *fileDescriptor in _fileDescriptors) {
+        DLog(@"Close file descriptor %d in message that was never decoded", fileDescriptor.intValue);
+        close(fileDescriptor.intValue);
     }
 }
 
@@ -35,8 +40,16 @@
                        length:length];
 }
 
-- (void)setFileDescriptor:(int)fileDescriptor {
-    _fileDescriptor = @(fileDescriptor);
+- (void)addFileDescriptor:(int)fileDescriptor {
+    if (fileDescriptor < 0) {
+        return;
+    }
+    if (_fileDescriptors.count == ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE) {
+        DLog(@"Too many file descriptors in message. Closing %d", fileDescriptor);
+        close(fileDescriptor);
+        return;
+    }
+    [_fileDescriptors addObject:@(fileDescriptor)];
 }
 
 - (NSInteger)length {
@@ -48,7 +61,7 @@
         return _message;
     }
     _message = [[iTermMultiServerMessage alloc] initWithData:_accumulator
-                                              fileDescriptor:_fileDescriptor];
+                                             fileDescriptors:_fileDescriptors];
     return _message;
 }
 
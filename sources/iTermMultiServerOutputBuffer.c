@@ -0,0 +1,78 @@
+//
+//  iTermMultiServerOutputBuffer.c
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#include "iTermMultiServerOutputBuffer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void iTermMultiServerOutputBufferAppend(iTermMultiServerOutputBuffer *buffer,
+                                        const char *bytes,
+                                        size_t length) {
+    const size_t capacity = buffer->capacity;
+    if (capacity == 0 || length == 0) {
+        return;
+    }
+    if (!buffer->bytes) {
+        buffer->bytes = malloc(capacity);
+        buffer->start = 0;
+        buffer->length = 0;
+    }
+    if (length > capacity) {
+        bytes += length - capacity;
+        length = capacity;
+    }
+    if (buffer->length + length > capacity) {
+        const size_t overflow = buffer->length + length - capacity;
+        buffer->start = (buffer->start + overflow) % capacity;
+        buffer->length -= overflow;
+    }
+    size_t end = (buffer->start + buffer->length) % capacity;
+    while (length > 0) {
+        const size_t n = length < capacity - end ? length : capacity - end;
+        memcpy(buffer->bytes + end, bytes, n);
+        bytes += n;
+        length -= n;
+        buffer->length += n;
+        end = (end + n) % capacity;
+    }
+}
+
+size_t iTermMultiServerOutputBufferPeek(const iTermMultiServerOutputBuffer *buffer,
+                                        size_t maxLength,
+                                        const char **bytesOut) {
+    if (buffer->length == 0) {
+        *bytesOut = NULL;
+        return 0;
+    }
+    size_t length = buffer->length;
+    if (length > buffer->capacity - buffer->start) {
+        length = buffer->capacity - buffer->start;
+    }
+    if (length > maxLength) {
+        length = maxLength;
+    }
+    *bytesOut = buffer->bytes + buffer->start;
+    return length;
+}
+
+void iTermMultiServerOutputBufferConsume(iTermMultiServerOutputBuffer *buffer, size_t length) {
+    assert(length <= buffer->length);
+    if (length == 0) {
+        return;
+    }
+    buffer->start = (buffer->start + length) % buffer->capacity;
+    buffer->length -= length;
+}
+
+void iTermMultiServerOutputBufferFree(iTermMultiServerOutputBuffer *buffer) {
+    free(buffer->bytes);
+    buffer->bytes = NULL;
+    buffer->start = 0;
+    buffer->length = 0;
+}
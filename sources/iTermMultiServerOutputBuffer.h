@@ -0,0 +1,39 @@
+//
+//  iTermMultiServerOutputBuffer.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#ifndef iTermMultiServerOutputBuffer_h
+#define iTermMultiServerOutputBuffer_h
+
+#include <stddef.h>
+
+// A fixed-capacity ring buffer of pty output. When it fills up the oldest bytes are dropped, so
+// the contents may begin in the middle of a sequence. Zero-initialize it and set `capacity`; the
+// storage is allocated on first append.
+typedef struct {
+    char *bytes;
+    size_t capacity;
+    size_t start;
+    size_t length;
+} iTermMultiServerOutputBuffer;
+
+void iTermMultiServerOutputBufferAppend(iTermMultiServerOutputBuffer *buffer,
+                                        const char *bytes,
+                                        size_t length);
+
+// Points *bytesOut at the oldest contiguous run of buffered bytes and returns its length, which is
+// at most maxLength. Returns 0 when the buffer is empty.
+size_t iTermMultiServerOutputBufferPeek(const iTermMultiServerOutputBuffer *buffer,
+                                        size_t maxLength,
+                                        const char **bytesOut);
+
+// Removes the oldest `length` bytes. `length` must not exceed buffer->length.
+void iTermMultiServerOutputBufferConsume(iTermMultiServerOutputBuffer *buffer, size_t length);
+
+// Releases the storage and empties the buffer. The capacity is kept.
+void iTermMultiServerOutputBufferFree(iTermMultiServerOutputBuffer *buffer);
+
+#endif /* iTermMultiServerOutputBuffer_h */
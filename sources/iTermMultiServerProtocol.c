@@ -27,6 +27,7 @@ typedef enum iTermMultiServerProtocolError {
     iTermMultiServerProtocolErrorBrokenHeader = 5,
 
     iTermMultiServerProtocolErrorHandshakeRequestMissingVersion = 100,
+    iTermMultiServerProtocolErrorHandshakeRequestMissingFlags = 101,
 
     iTermMultiServerProtocolErrorHandshakeResponseMissingVersion = 200,
     iTermMultiServerProtocolErrorHandshakeResponseMissingNumChildren = 201,
@@ -67,6 +68,16 @@ typedef enum iTermMultiServerProtocolError {
     iTermMultiServerProtocolErrorReportChildMissingTTY = 708,
 
     iTermMultiServerProtocolErrorTerminationMissingPID = 800,
+
+    iTermMultiServerProtocolErrorReplayMissingPID = 900,
+    iTermMultiServerProtocolErrorReplayMissingData = 901,
+
+    iTermMultiServerProtocolErrorBatchLaunchRequestMissingCount = 1000,
+    iTermMultiServerProtocolErrorBatchLaunchRequestInvalidCount = 1001,
+
+    iTermMultiServerProtocolErrorBatchLaunchResponseMissingCount = 1100,
+    iTermMultiServerProtocolErrorBatchLaunchResponseInvalidCount = 1101,
+    iTermMultiServerProtocolErrorBatchLaunchResponseWrongNumberOfFileDescriptors = 1102,
 } iTermMultiServerProtocolError;
 
 static int ParseHandshakeRequest(iTermClientServerProtocolMessageParser *parser,
@@ -74,6 +85,12 @@ static int ParseHandshakeRequest(iTermClientServerProtocolMessageParser *parser,
     if (iTermClientServerProtocolParseTaggedInt(parser, &out->maximumProtocolVersion, sizeof(out->maximumProtocolVersion), iTermMultiServerTagHandshakeRequestClientMaximumProtocolVersion)) {
         return iTermMultiServerProtocolErrorHandshakeRequestMissingVersion;
     }
+    if (out->maximumProtocolVersion >= iTermMultiServerProtocolVersion4 &&
+        iTermClientServerProtocolParserHasMoreData(parser)) {
+        if (iTermClientServerProtocolParseTaggedInt(parser, &out->flags, sizeof(out->flags), iTermMultiServerTagHandshakeRequestFlags)) {
+            return iTermMultiServerProtocolErrorHandshakeRequestMissingFlags;
+        }
+    }
     return 0;
 }
 
@@ -82,6 +99,11 @@ static int EncodeHandshakeRequest(iTermClientServerProtocolMessageEncoder *encod
     if (iTermClientServerProtocolEncodeTaggedInt(encoder, &handshake->maximumProtocolVersion, sizeof(handshake->maximumProtocolVersion), iTermMultiServerTagHandshakeRequestClientMaximumProtocolVersion)) {
         return iTermMultiServerProtocolErrorEncodingFailed;
     }
+    if (handshake->maximumProtocolVersion >= iTermMultiServerProtocolVersion4) {
+        if (iTermClientServerProtocolEncodeTaggedInt(encoder, &handshake->flags, sizeof(handshake->flags), iTermMultiServerTagHandshakeRequestFlags)) {
+            return iTermMultiServerProtocolErrorEncodingFailed;
+        }
+    }
     return 0;
 }
 
@@ -350,6 +372,129 @@ static int EncodeTermination(iTermClientServerProtocolMessageEncoder *encoder,
     return 0;
 }
 
+static int ParseReplay(iTermClientServerProtocolMessageParser *parser,
+                       iTermMultiServerReportReplay *out) {
+    if (iTermClientServerProtocolParseTaggedInt(parser, &out->pid, sizeof(out->pid), iTermMultiServerTagReplayPid)) {
+        return iTermMultiServerProtocolErrorReplayMissingPID;
+    }
+    if (iTermClientServerProtocolParseTaggedData(parser, (char **)&out->data, &out->length, iTermMultiServerTagReplayData)) {
+        return iTermMultiServerProtocolErrorReplayMissingData;
+    }
+    return 0;
+}
+
+static int EncodeReplay(iTermClientServerProtocolMessageEncoder *encoder,
+                        iTermMultiServerReportReplay *obj) {
+    if (iTermClientServerProtocolEncodeTaggedInt(encoder, &obj->pid, sizeof(obj->pid), iTermMultiServerTagReplayPid)) {
+        return iTermMultiServerProtocolErrorEncodingFailed;
+    }
+    if (iTermClientServerProtocolEncodeTaggedData(encoder, obj->data, obj->length, iTermMultiServerTagReplayData)) {
+        return iTermMultiServerProtocolErrorEncodingFailed;
+    }
+    return 0;
+}
+
+static int ParseBatchLaunchRequest(iTermClientServerProtocolMessageParser *parser,
+                                   iTermMultiServerRequestBatchLaunch *out) {
+    int count = 0;
+    if (iTermClientServerProtocolParseTaggedInt(parser, &count, sizeof(count), iTermMultiServerTagBatchLaunchRequestCount)) {
+        return iTermMultiServerProtocolErrorBatchLaunchRequestMissingCount;
+    }
+    if (count <= 0 || count > iTermMultiServerMaximumBatchLaunchSize) {
+        return iTermMultiServerProtocolErrorBatchLaunchRequestInvalidCount;
+    }
+    out->launches = calloc(count, sizeof(*out->launches));
+    out->count = count;
+    for (int i = 0; i < count; i++) {
+        const int rc = ParseLaunchReqest(parser, &out->launches[i]);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+static int EncodeBatchLaunchRequest(iTermClientServerProtocolMessageEncoder *encoder,
+                                    iTermMultiServerRequestBatchLaunch *batch) {
+    if (iTermClientServerProtocolEncodeTaggedInt(encoder, &batch->count, sizeof(batch->count), iTermMultiServerTagBatchLaunchRequestCount)) {
+        return iTermMultiServerProtocolErrorEncodingFailed;
+    }
+    for (int i = 0; i < batch->count; i++) {
+        const int rc = EncodeLaunchRequest(encoder, &batch->launches[i]);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+// File descriptors are taken from `message`'s control buffer and assigned, in order, to the
+// launches that succeeded.
+static int ParseBatchLaunchResponse(iTermClientServerProtocolMessageParser *parser,
+                                    iTermClientServerProtocolMessage *message,
+                                    iTermMultiServerResponseBatchLaunch *out) {
+    int count = 0;
+    if (iTermClientServerProtocolParseTaggedInt(parser, &count, sizeof(count), iTermMultiServerTagBatchLaunchResponseCount)) {
+        return iTermMultiServerProtocolErrorBatchLaunchResponseMissingCount;
+    }
+    if (count <= 0 || count > iTermMultiServerMaximumBatchLaunchSize) {
+        return iTermMultiServerProtocolErrorBatchLaunchResponseInvalidCount;
+    }
+    out->launches = calloc(count, sizeof(*out->launches));
+    out->count = count;
+    int numberOfSuccesses = 0;
+    for (int i = 0; i < count; i++) {
+        out->launches[i].fd = -1;
+        const int rc = ParseLaunchResponse(parser, &out->launches[i]);
+        if (rc) {
+            return rc;
+        }
+        if (out->launches[i].status == 0) {
+            numberOfSuccesses += 1;
+        }
+    }
+    if (numberOfSuccesses == 0) {
+        return 0;
+    }
+
+    int fds[iTermMultiServerMaximumBatchLaunchSize];
+    int numberOfFileDescriptors = 0;
+    const int rc = iTermMultiServerProtocolGetFileDescriptors(message,
+                                                              fds,
+                                                              iTermMultiServerMaximumBatchLaunchSize,
+                                                              &numberOfFileDescriptors);
+    if (rc) {
+        return rc;
+    }
+    if (numberOfFileDescriptors != numberOfSuccesses) {
+        for (int i = 0; i < numberOfFileDescriptors; i++) {
+            close(fds[i]);
+        }
+        return iTermMultiServerProtocolErrorBatchLaunchResponseWrongNumberOfFileDescriptors;
+    }
+    int j = 0;
+    for (int i = 0; i < count; i++) {
+        if (out->launches[i].status == 0) {
+            out->launches[i].fd = fds[j++];
+        }
+    }
+    return 0;
+}
+
+static int EncodeBatchLaunchResponse(iTermClientServerProtocolMessageEncoder *encoder,
+                                     iTermMultiServerResponseBatchLaunch *batch) {
+    if (iTermClientServerProtocolEncodeTaggedInt(encoder, &batch->count, sizeof(batch->count), iTermMultiServerTagBatchLaunchResponseCount)) {
+        return iTermMultiServerProtocolErrorEncodingFailed;
+    }
+    for (int i = 0; i < batch->count; i++) {
+        const int rc = EncodeLaunchResponse(encoder, &batch->launches[i]);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
 static int EncodeHello(iTermClientServerProtocolMessageEncoder *encoder,
                        iTermMultiServerHello *obj) {
     return 0;
@@ -380,10 +525,13 @@ int iTermMultiServerProtocolParseMessageFromClient(iTermClientServerProtocolMess
             return ParseLaunchReqest(&parser, &out->payload.launch);
         case iTermMultiServerRPCTypeWait:
             return ParseWaitRequest(&parser, &out->payload.wait);
+        case iTermMultiServerRPCTypeBatchLaunch:
+            return ParseBatchLaunchRequest(&parser, &out->payload.batchLaunch);
 
         case iTermMultiServerRPCTypeReportChild:  // Server-originated, no response.
         case iTermMultiServerRPCTypeTermination: // Server-originated, no response.
         case iTermMultiServerRPCTypeHello: // Server-originated, no response.
+        case iTermMultiServerRPCTypeReplay: // Server-originated, no response.
             return iTermMultiServerProtocolErrorUnexpectedType;
     }
     FDLog(LOG_DEBUG, "Parsed message with unknown type %d", (int)out->type);
@@ -409,6 +557,30 @@ int iTermMultiServerProtocolGetFileDescriptor(iTermClientServerProtocolMessage *
     return 0;
 }
 
+int iTermMultiServerProtocolGetFileDescriptors(iTermClientServerProtocolMessage *message,
+                                               int *receivedFileDescriptors,
+                                               int capacity,
+                                               int *countOut) {
+    // See the note in iTermMultiServerProtocolGetFileDescriptor about CMSG_FIRSTHDR.
+    struct cmsghdr *messageHeader = &message->controlBuffer.cm;
+    if (messageHeader->cmsg_len < CMSG_LEN(sizeof(int))) {
+        return iTermMultiServerProtocolErrorMissingFileDescriptor;
+    }
+    if (messageHeader->cmsg_level != SOL_SOCKET) {
+        return iTermMultiServerProtocolErrorBrokenHeader;
+    }
+    if (messageHeader->cmsg_type != SCM_RIGHTS) {
+        return iTermMultiServerProtocolErrorBrokenHeader;
+    }
+    const size_t count = (messageHeader->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (count > capacity) {
+        return iTermMultiServerProtocolErrorBrokenHeader;
+    }
+    memmove(receivedFileDescriptors, CMSG_DATA(messageHeader), count * sizeof(int));
+    *countOut = (int)count;
+    return 0;
+}
+
 int iTermMultiServerProtocolParseMessageFromServer(iTermClientServerProtocolMessage *message,
                                                    iTermMultiServerServerOriginatedMessage *out) {
     memset(out, 0, sizeof(*out));
@@ -449,6 +621,12 @@ int iTermMultiServerProtocolParseMessageFromServer(iTermClientServerProtocolMess
 
         case iTermMultiServerRPCTypeHello:  // Server-originated, no response.
             return ParseHello(&parser, &out->payload.hello);
+
+        case iTermMultiServerRPCTypeReplay:  // Server-originated, no response.
+            return ParseReplay(&parser, &out->payload.replay);
+
+        case iTermMultiServerRPCTypeBatchLaunch:  // Server-originated response to client-originated request
+            return ParseBatchLaunchResponse(&parser, message, &out->payload.batchLaunch);
     }
     return iTermMultiServerProtocolErrorUnknownType;
 }
@@ -477,9 +655,14 @@ int iTermMultiServerProtocolEncodeMessageFromClient(iTermMultiServerClientOrigin
             status = EncodeWaitRequest(&encoder, &obj->payload.wait);
             break;
 
+        case iTermMultiServerRPCTypeBatchLaunch:
+            status = EncodeBatchLaunchRequest(&encoder, &obj->payload.batchLaunch);
+            break;
+
         case iTermMultiServerRPCTypeReportChild:
         case iTermMultiServerRPCTypeTermination:
         case iTermMultiServerRPCTypeHello:
+        case iTermMultiServerRPCTypeReplay:
             break;
     }
     if (!status) {
@@ -517,6 +700,12 @@ int iTermMultiServerProtocolEncodeMessageFromServer(iTermMultiServerServerOrigin
         case iTermMultiServerRPCTypeHello:
             status = EncodeHello(&encoder, &obj->payload.hello);
             break;
+        case iTermMultiServerRPCTypeReplay:
+            status = EncodeReplay(&encoder, &obj->payload.replay);
+            break;
+        case iTermMultiServerRPCTypeBatchLaunch:
+            status = EncodeBatchLaunchResponse(&encoder, &obj->payload.batchLaunch);
+            break;
     }
     if (status) {
         FDLog(LOG_ERR, "Failed to encode message from server:");
@@ -559,6 +748,17 @@ static void FreeReportChild(iTermMultiServerReportChild *obj) {
 static void FreeHello(iTermMultiServerHello *obj) {
 }
 
+static void FreeReplay(iTermMultiServerReportReplay *obj) {
+    free((void *)obj->data);
+}
+
+static void FreeBatchLaunchRequest(iTermMultiServerRequestBatchLaunch *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        FreeLaunchRequest(&batch->launches[i]);
+    }
+    free(batch->launches);
+}
+
 static void FreeWaitRequest(iTermMultiServerRequestWait *wait) {
 }
 
@@ -575,6 +775,14 @@ static void FreeLaunchResponse(iTermMultiServerResponseLaunch *launch) {
     free((void *)launch->tty);
 }
 
+// Does not close file descriptors.
+static void FreeBatchLaunchResponse(iTermMultiServerResponseBatchLaunch *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        FreeLaunchResponse(&batch->launches[i]);
+    }
+    free(batch->launches);
+}
+
 void iTermMultiServerClientOriginatedMessageFree(iTermMultiServerClientOriginatedMessage *obj) {
     switch (obj->type) {
         case iTermMultiServerRPCTypeHandshake:
@@ -586,9 +794,13 @@ void iTermMultiServerClientOriginatedMessageFree(iTermMultiServerClientOriginate
         case iTermMultiServerRPCTypeWait:
             FreeWaitRequest(&obj->payload.wait);
             break;
+        case iTermMultiServerRPCTypeBatchLaunch:
+            FreeBatchLaunchRequest(&obj->payload.batchLaunch);
+            break;
         case iTermMultiServerRPCTypeReportChild:
         case iTermMultiServerRPCTypeTermination:
         case iTermMultiServerRPCTypeHello:
+        case iTermMultiServerRPCTypeReplay:
             break;
     }
     memset(obj, 0xAB, sizeof(*obj));
@@ -611,6 +823,12 @@ void iTermMultiServerServerOriginatedMessageFree(iTermMultiServerServerOriginate
         case iTermMultiServerRPCTypeHello:
             FreeHello(&obj->payload.hello);
             break;
+        case iTermMultiServerRPCTypeReplay:
+            FreeReplay(&obj->payload.replay);
+            break;
+        case iTermMultiServerRPCTypeBatchLaunch:
+            FreeBatchLaunchResponse(&obj->payload.batchLaunch);
+            break;
         case iTermMultiServerRPCTypeTermination:
             break;
     }
@@ -701,8 +919,9 @@ done:
 }
 
 static void LogHandshakeRequest(iTermMultiServerRequestHandshake *message) {
-    FDLog(LOG_DEBUG, "Handshake request [maximumProtocolVersion=%d]",
-          message->maximumProtocolVersion);
+    FDLog(LOG_DEBUG, "Handshake request [maximumProtocolVersion=%d flags=%d]",
+          message->maximumProtocolVersion,
+          message->flags);
 }
 
 static void LogLaunchRequest(iTermMultiServerRequestLaunch *message) {
@@ -727,6 +946,13 @@ static void LogLaunchRequest(iTermMultiServerRequestLaunch *message) {
     }
 }
 
+static void LogBatchLaunchRequest(iTermMultiServerRequestBatchLaunch *message) {
+    FDLog(LOG_DEBUG, "Batch launch request [count=%d]", message->count);
+    for (int i = 0; i < message->count; i++) {
+        LogLaunchRequest(&message->launches[i]);
+    }
+}
+
 static void LogWaitRequest(iTermMultiServerRequestWait *message) {
     FDLog(LOG_DEBUG, "Wait Request [pid=%d removePreemptively=%d]",
           message->pid, message->removePreemptively);
@@ -751,8 +977,13 @@ iTermMultiServerProtocolLogMessageFromClient(iTermMultiServerClientOriginatedMes
             LogWaitRequest(&message->payload.wait);
             break;
 
+        case iTermMultiServerRPCTypeBatchLaunch:
+            LogBatchLaunchRequest(&message->payload.batchLaunch);
+            break;
+
         case iTermMultiServerRPCTypeTermination:
         case iTermMultiServerRPCTypeHello:
+        case iTermMultiServerRPCTypeReplay:
             // Server-originated, no response.
             break;
     }
@@ -774,6 +1005,13 @@ static void LogLaunchResponse(iTermMultiServerResponseLaunch *message) {
           message->tty);
 }
 
+static void LogBatchLaunchResponse(iTermMultiServerResponseBatchLaunch *message) {
+    FDLog(LOG_DEBUG, "Batch launch response [count=%d]", message->count);
+    for (int i = 0; i < message->count; i++) {
+        LogLaunchResponse(&message->launches[i]);
+    }
+}
+
 static void LogReportChild(iTermMultiServerReportChild *message) {
     FDLog(LOG_DEBUG, "Report child [isLast=%d pid=%d path=%s isUTF8=%d pwd=%s terminated=%d tty=%s fd=%d argc=%d envc=%d]",
           message->isLast,
@@ -810,6 +1048,11 @@ static void LogHello(iTermMultiServerHello *message) {
     FDLog(LOG_DEBUG, "Hello");
 }
 
+static void LogReplay(iTermMultiServerReportReplay *message) {
+    FDLog(LOG_DEBUG, "Replay [pid=%d length=%d]",
+          message->pid, (int)message->length);
+}
+
 void
 iTermMultiServerProtocolLogMessageFromServer(iTermMultiServerServerOriginatedMessage *message) {
     switch (message->type) {
@@ -836,5 +1079,13 @@ iTermMultiServerProtocolLogMessageFromServer(iTermMultiServerServerOriginatedMes
         case iTermMultiServerRPCTypeHello:
             LogHello(&message->payload.hello);
             break;
+
+        case iTermMultiServerRPCTypeReplay:
+            LogReplay(&message->payload.replay);
+            break;
+
+        case iTermMultiServerRPCTypeBatchLaunch:
+            LogBatchLaunchResponse(&message->payload.batchLaunch);
+            break;
     }
 }
@@ -10,7 +10,24 @@
 enum {
     iTermMultiServerProtocolVersionRejected = -1,
     iTermMultiServerProtocolVersion1 = 1,
-    iTermMultiServerProtocolVersion2 = 2
+    iTermMultiServerProtocolVersion2 = 2,
+    // Adds iTermMultiServerRPCTypeReplay. The server reads from children's ptys while no client is
+    // attached and replays the output on the next attach.
+    iTermMultiServerProtocolVersion3 = 3,
+    // Adds iTermMultiServerRPCTypeBatchLaunch and iTermMultiServerRequestHandshake.flags. Output
+    // is buffered while detached only if the client sets
+    // iTermMultiServerHandshakeFlagBufferOutputWhileDetached.
+    iTermMultiServerProtocolVersion4 = 4
+};
+
+enum {
+    iTermMultiServerHandshakeFlagBufferOutputWhileDetached = 1 << 0
+};
+
+// The most launches a batch launch request may carry. Every successful launch's file descriptor is
+// passed in the response's single control message.
+enum {
+    iTermMultiServerMaximumBatchLaunchSize = ITERM_MAX_FILE_DESCRIPTORS_PER_MESSAGE
 };
 
 typedef enum {
@@ -57,11 +74,23 @@ typedef enum {
 
     iTermMultiServerTagTerminationPid,
     iTermMultiServerTagTerminationStatus,
+
+    iTermMultiServerTagReplayPid,
+    iTermMultiServerTagReplayData,
+
+    iTermMultiServerTagHandshakeRequestFlags,
+
+    iTermMultiServerTagBatchLaunchRequestCount,
+    iTermMultiServerTagBatchLaunchResponseCount,
 } iTermMultiServerTagLaunch;
 
 typedef struct {
     // iTermMultiServerTagHandshakeRequestClientMaximumProtocolVersion
     int maximumProtocolVersion;
+
+    // iTermMultiServerTagHandshakeRequestFlags
+    // Optional. Only sent when maximumProtocolVersion is at least 4.
+    int flags;
 } iTermMultiServerRequestHandshake;
 
 typedef struct {
@@ -129,6 +158,24 @@ typedef struct {
     const char *tty;
 } iTermMultiServerResponseLaunch;
 
+typedef struct {
+    // iTermMultiServerTagBatchLaunchRequestCount
+    int count;
+
+    // Each is encoded as a launch request.
+    iTermMultiServerRequestLaunch *launches;
+} iTermMultiServerRequestBatchLaunch;
+
+// NOTE: The PTY master file descriptors of the launches whose status is 0 are passed with this
+// message, in order, in a single control message.
+typedef struct {
+    // iTermMultiServerTagBatchLaunchResponseCount
+    int count;
+
+    // Each is encoded as a launch response. fd is -1 when status is nonzero.
+    iTermMultiServerResponseLaunch *launches;
+} iTermMultiServerResponseBatchLaunch;
+
 typedef struct {
     // iTermMultiServerTagWaitRequestPid
     pid_t pid;
@@ -205,6 +252,8 @@ typedef enum {
     iTermMultiServerRPCTypeReportChild,  // Server-originated, no response.
     iTermMultiServerRPCTypeTermination,  // Server-originated, no response.
     iTermMultiServerRPCTypeHello,  // Server-originated, no response.
+    iTermMultiServerRPCTypeReplay,  // Server-originated, no response. Protocol version 3 and later.
+    iTermMultiServerRPCTypeBatchLaunch,  // Client-originated, has response. Protocol version 4 and later.
 } iTermMultiServerRPCType;
 
 // You should send iTermMultiServerResponseWait after getting this.
@@ -213,12 +262,25 @@ typedef struct {
     pid_t pid;
 } iTermMultiServerReportTermination;
 
+// Output the server read from a child's pty while no client was attached. Zero or more of these
+// precede the iTermMultiServerRPCTypeReportChild for the same pid during the handshake. The
+// concatenation of their data should be processed before anything subsequently read from the fd.
+typedef struct {
+    // iTermMultiServerTagReplayPid
+    pid_t pid;
+
+    // iTermMultiServerTagReplayData
+    const char *data;
+    size_t length;
+} iTermMultiServerReportReplay;
+
 typedef struct {
     iTermMultiServerRPCType type;
     union {
         iTermMultiServerRequestHandshake handshake;
         iTermMultiServerRequestLaunch launch;
         iTermMultiServerRequestWait wait;
+        iTermMultiServerRequestBatchLaunch batchLaunch;
     } payload;
 } iTermMultiServerClientOriginatedMessage;
 
@@ -234,6 +296,8 @@ typedef struct {
         iTermMultiServerReportTermination termination;
         iTermMultiServerReportChild reportChild;
         iTermMultiServerHello hello;
+        iTermMultiServerReportReplay replay;
+        iTermMultiServerResponseBatchLaunch batchLaunch;
     } payload;
 } iTermMultiServerServerOriginatedMessage;
 
@@ -274,6 +338,14 @@ int __attribute__((warn_unused_result))
 iTermMultiServerProtocolGetFileDescriptor(iTermClientServerProtocolMessage *message,
                                           int *receivedFileDescriptorPtr);
 
+// Like iTermMultiServerProtocolGetFileDescriptor but accepts any number of file descriptors, up to
+// `capacity`. On success, sets *countOut to the number received. You own all of them.
+int __attribute__((warn_unused_result))
+iTermMultiServerProtocolGetFileDescriptors(iTermClientServerProtocolMessage *message,
+                                           int *receivedFileDescriptors,
+                                           int capacity,
+                                           int *countOut);
+
 void
 iTermMultiServerProtocolLogMessageFromClient(iTermMultiServerClientOriginatedMessage *message);
 
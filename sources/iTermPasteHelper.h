@@ -49,6 +49,15 @@ extern const NSInteger iTermQuickPasteBytesPerCallDefaultValue;
 
 - (iTermVariableScope *)pasteHelperScope;
 
+@optional
+// Number of bytes the pty can accept right now, or a negative number if writes can't be flow
+// controlled. When both of these are implemented, normal-speed pastes are paced by the pty rather
+// than by a timer.
+- (NSInteger)pasteHelperWriteBufferRoom;
+
+// Call -writeBufferDidGainRoom when the pty can accept more.
+- (void)pasteHelperNotifyWhenWriteBufferHasRoom;
+
 @end
 
 @interface iTermPasteHelper : NSObject
@@ -102,6 +111,9 @@ extern const NSInteger iTermQuickPasteBytesPerCallDefaultValue;
 // allows one more line to be pasted.
 - (void)unblock;
 
+// Call this when the pty can accept more input after -pasteHelperNotifyWhenWriteBufferHasRoom.
+- (void)writeBufferDidGainRoom;
+
 - (void)showAdvancedPasteWithFlags:(PTYSessionPasteFlags)flags;
 - (void)temporaryRightStatusBarComponentDidBecomeAvailable;
 
@@ -41,6 +41,8 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
     // Paste from the head of this string from a timer until it's empty.
     NSMutableString *_buffer;
     NSTimer *_timer;
+    // Waiting for -writeBufferDidGainRoom before pasting the next chunk.
+    BOOL _waitingForWriteBufferRoom;
     iTermPasteViewManager *_pasteViewManager;
 }
 
@@ -101,9 +103,10 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
 }
 
 - (void)abortAndCancelPendingEvents:(BOOL)cancel {
-    if (_timer) {
+    if (_timer || _waitingForWriteBufferRoom) {
         [_timer invalidate];
         _timer = nil;
+        _waitingForWriteBufferRoom = NO;
         if (cancel) {
             [_eventQueue removeAllObjects];
         }
@@ -117,7 +120,7 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
 }
 
 - (BOOL)isPasting {
-    return _timer != nil || _pasteContext.isBlocked;
+    return _timer != nil || _waitingForWriteBufferRoom || _pasteContext.isBlocked;
 }
 
 + (void)sanitizePasteEvent:(PasteEvent *)pasteEvent encoding:(NSStringEncoding)encoding {
@@ -429,12 +432,26 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
     [_pasteViewManager setRemainingLength:_buffer.length];
 }
 
+// Returns how many bytes the pty can accept, or -1 if the current paste is paced by a timer.
+- (NSInteger)writeBufferRoomForCurrentPasteContext {
+    if (!_pasteContext.isFlowControlled ||
+        ![_delegate respondsToSelector:@selector(pasteHelperWriteBufferRoom)] ||
+        ![_delegate respondsToSelector:@selector(pasteHelperNotifyWhenWriteBufferHasRoom)]) {
+        return -1;
+    }
+    return MAX(-1, [_delegate pasteHelperWriteBufferRoom]);
+}
+
 - (void)pasteNextChunkAndScheduleTimer {
     DLog(@"pasteNextChunkAndScheduleTimer");
     BOOL block = NO;
     NSRange range;
     range.location = 0;
-    range.length = MIN(_pasteContext.bytesPerCall, [_buffer length]);
+    const NSInteger room = [self writeBufferRoomForCurrentPasteContext];
+    const BOOL flowControlled = (room >= 0);
+    // Room is measured in bytes and the buffer in UTF-16 code units. Non-ASCII characters take
+    // more than one byte, so this can overfill the write buffer a bit, which is harmless.
+    range.length = MIN(flowControlled ? room : _pasteContext.bytesPerCall, [_buffer length]);
     if (range.length > 0) {
         if (_pasteContext.blockAtNewline) {
             // If there is a newline in the range about to be pasted, only paste up to and including
@@ -461,7 +478,13 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
     if ([_buffer length] > 0) {
         DLog(@"Schedule timer after %@", @(_pasteContext.delayBetweenCalls));
         [_pasteContext updateValues];
-        if (!block) {
+        if (!block && flowControlled) {
+            DLog(@"Wait for room in the write buffer");
+            [_timer invalidate];
+            _timer = nil;
+            _waitingForWriteBufferRoom = YES;
+            [_delegate pasteHelperNotifyWhenWriteBufferHasRoom];
+        } else if (!block) {
             [self scheduleNextPasteForCurrentPasteContext];
         } else {
             _pasteContext.isBlocked = YES;
@@ -496,6 +519,14 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
     }
 }
 
+- (void)writeBufferDidGainRoom {
+    if (!_waitingForWriteBufferRoom) {
+        return;
+    }
+    _waitingForWriteBufferRoom = NO;
+    [self pasteNextChunkAndScheduleTimer];
+}
+
 - (void)temporaryRightStatusBarComponentDidBecomeAvailable {
     [_pasteViewManager temporaryRightStatusBarComponentDidBecomeAvailable];
 }
@@ -505,7 +536,7 @@ const NSInteger iTermQuickPasteBytesPerCallDefaultValue = 768;
 
     _pasteContext = [[PasteContext alloc] initWithPasteEvent:pasteEvent];
     const int kPasteBytesPerSecond = 10000;  // This is a wild-ass guess.
-    const NSTimeInterval sumOfDelays =
+    const NSTimeInterval sumOfDelays = _pasteContext.isFlowControlled ? 0 :
         _pasteContext.delayBetweenCalls * _buffer.length / _pasteContext.bytesPerCall;
     const NSTimeInterval timeSpentWriting = _buffer.length / kPasteBytesPerSecond;
     const NSTimeInterval kMinEstimatedPasteTimeToShowIndicator = 3;
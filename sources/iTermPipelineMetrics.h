@@ -0,0 +1,61 @@
+//
+//  iTermPipelineMetrics.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Stages of the output pipeline that are always measured. Each stage's values are in the unit
+// its name ends with.
+typedef NS_ENUM(NSUInteger, iTermPipelineStage) {
+    iTermPipelineStagePTYReadBytes,
+    iTermPipelineStageParseMicrosecondsPerKB,
+    iTermPipelineStageTokensPerBatch,
+    iTermPipelineStageExecutionSemaphoreWaitMicroseconds,
+    iTermPipelineStageExecuteMicroseconds,
+    iTermPipelineStageTriggerMicroseconds,
+    iTermPipelineStageFrameBuildMicroseconds,
+
+    iTermPipelineStageCount
+};
+
+// A timestamp for iTermPipelineMetricsNanosecondsSince(). This is mach_absolute_time, so it's
+// cheap enough to take on every read.
+uint64_t iTermPipelineMetricsNow(void);
+uint64_t iTermPipelineMetricsNanosecondsSince(uint64_t start);
+
+// Adds a sample. Safe to call from any thread. Never locks or allocates.
+void iTermPipelineMetricsRecord(iTermPipelineStage stage, uint64_t value);
+
+// Records the microseconds elapsed since `start`.
+NS_INLINE void iTermPipelineMetricsRecordDuration(iTermPipelineStage stage, uint64_t start) {
+    iTermPipelineMetricsRecord(stage, iTermPipelineMetricsNanosecondsSince(start) / 1000);
+}
+
+// Index of the histogram bucket that counts `value`, and the smallest value counted by a bucket.
+// Exposed for tests.
+int iTermPipelineMetricsBucketForValue(uint64_t value);
+uint64_t iTermPipelineMetricsLowerBoundOfBucket(int bucket);
+
+@interface iTermPipelineMetrics : NSObject
+
+// The value below which `ntile` (in [0, 1]) of the stage's samples fall, rounded down to its
+// bucket's lower bound. Returns 0 if there are no samples.
++ (uint64_t)valueAtNTile:(double)ntile forStage:(iTermPipelineStage)stage;
+
+// Maps each stage's name to its count, mean, p50, p90, p99, and max. Percentiles are within 12.5%
+// of the true value; count, mean, and max are exact.
++ (NSDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *)snapshot;
+
+// The snapshot as a table, one stage per line.
++ (NSString *)stringValue;
+
++ (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,213 @@
+//
+//  iTermPipelineMetrics.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermPipelineMetrics.h"
+
+#include <mach/mach_time.h>
+#include <stdatomic.h>
+
+// Histograms are log-linear, like an HDR histogram with three bits of precision. Values below 16
+// get a bucket each. Above that, each power of two up to 2^40 is split into 8 buckets. Larger
+// values are clamped.
+#define iTermPipelineMetricsLinearBuckets 16
+#define iTermPipelineMetricsSubBucketBits 3
+#define iTermPipelineMetricsMaxExponent 40
+#define iTermPipelineMetricsBucketCount (iTermPipelineMetricsLinearBuckets + \
+    (iTermPipelineMetricsMaxExponent - 3) * (1 << iTermPipelineMetricsSubBucketBits))
+
+// Each thread writes to one of these shards so the pty reader threads and the main thread don't
+// fight over the same cache lines. Threads share a shard when there are more threads than shards.
+// That is still correct because every update is atomic.
+#define iTermPipelineMetricsShardCount 4
+
+typedef struct {
+    _Atomic uint64_t buckets[iTermPipelineMetricsBucketCount];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} iTermPipelineMetricsHistogram;
+
+// The shards of one stage added together.
+typedef struct {
+    uint64_t buckets[iTermPipelineMetricsBucketCount];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} iTermPipelineMetricsTotals;
+
+static iTermPipelineMetricsHistogram gPipelineMetricsHistograms[iTermPipelineMetricsShardCount][iTermPipelineStageCount];
+
+static NSString *iTermPipelineStageName(iTermPipelineStage stage) {
+    switch (stage) {
+        case iTermPipelineStagePTYReadBytes:
+            return @"pty_read_bytes";
+        case iTermPipelineStageParseMicrosecondsPerKB:
+            return @"parse_us_per_kb";
+        case iTermPipelineStageTokensPerBatch:
+            return @"tokens_per_batch";
+        case iTermPipelineStageExecutionSemaphoreWaitMicroseconds:
+            return @"execution_semaphore_wait_us";
+        case iTermPipelineStageExecuteMicroseconds:
+            return @"execute_us";
+        case iTermPipelineStageTriggerMicroseconds:
+            return @"trigger_us";
+        case iTermPipelineStageFrameBuildMicroseconds:
+            return @"frame_build_us";
+        case iTermPipelineStageCount:
+            break;
+    }
+    return @"unknown";
+}
+
+int iTermPipelineMetricsBucketForValue(uint64_t value) {
+    if (value < iTermPipelineMetricsLinearBuckets) {
+        return (int)value;
+    }
+    value = MIN(value, (1ULL << (iTermPipelineMetricsMaxExponent + 1)) - 1);
+    const int exponent = 63 - __builtin_clzll(value);
+    const int subBucket = (int)(value >> (exponent - iTermPipelineMetricsSubBucketBits)) & ((1 << iTermPipelineMetricsSubBucketBits) - 1);
+    return (iTermPipelineMetricsLinearBuckets +
+            (exponent - 4) * (1 << iTermPipelineMetricsSubBucketBits) +
+            subBucket);
+}
+
+uint64_t iTermPipelineMetricsLowerBoundOfBucket(int bucket) {
+    if (bucket < iTermPipelineMetricsLinearBuckets) {
+        return bucket;
+    }
+    const int exponent = (bucket - iTermPipelineMetricsLinearBuckets) / (1 << iTermPipelineMetricsSubBucketBits) + 4;
+    const uint64_t subBucket = (bucket - iTermPipelineMetricsLinearBuckets) % (1 << iTermPipelineMetricsSubBucketBits);
+    return (1ULL << exponent) + (subBucket << (exponent - iTermPipelineMetricsSubBucketBits));
+}
+
+static int iTermPipelineMetricsShard(void) {
+    static _Atomic int next;
+    static _Thread_local int shard = -1;
+    if (shard < 0) {
+        shard = atomic_fetch_add_explicit(&next, 1, memory_order_relaxed) % iTermPipelineMetricsShardCount;
+    }
+    return shard;
+}
+
+uint64_t iTermPipelineMetricsNow(void) {
+    return mach_absolute_time();
+}
+
+uint64_t iTermPipelineMetricsNanosecondsSince(uint64_t start) {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    const uint64_t elapsed = mach_absolute_time() - start;
+    return elapsed * timebase.numer / timebase.denom;
+}
+
+void iTermPipelineMetricsRecord(iTermPipelineStage stage, uint64_t value) {
+    iTermPipelineMetricsHistogram *histogram = &gPipelineMetricsHistograms[iTermPipelineMetricsShard()][stage];
+    atomic_fetch_add_explicit(&histogram->buckets[iTermPipelineMetricsBucketForValue(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&histogram->max,
+                                                  &max,
+                                                  value,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+@implementation iTermPipelineMetrics
+
+// Sums the shards of one stage.
+static void iTermPipelineMetricsGetTotals(iTermPipelineStage stage, iTermPipelineMetricsTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+    for (int shard = 0; shard < iTermPipelineMetricsShardCount; shard++) {
+        iTermPipelineMetricsHistogram *histogram = &gPipelineMetricsHistograms[shard][stage];
+        for (int i = 0; i < iTermPipelineMetricsBucketCount; i++) {
+            totals->buckets[i] += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        }
+        totals->count += atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        totals->sum += atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+        totals->max = MAX(totals->max, atomic_load_explicit(&histogram->max, memory_order_relaxed));
+    }
+}
+
+// Returns the lower bound of the bucket holding the sample of the given rank, so the result is
+// never above the true value and at most 12.5% below it.
+static uint64_t iTermPipelineMetricsTotalsValueAtNTile(const iTermPipelineMetricsTotals *totals, double ntile) {
+    if (totals->count == 0) {
+        return 0;
+    }
+    const uint64_t rank = MAX(1, (uint64_t)ceil(ntile * totals->count));
+    uint64_t seen = 0;
+    for (int i = 0; i < iTermPipelineMetricsBucketCount; i++) {
+        seen += totals->buckets[i];
+        if (seen >= rank) {
+            return MIN(totals->max, iTermPipelineMetricsLowerBoundOfBucket(i));
+        }
+    }
+    return totals->max;
+}
+
++ (uint64_t)valueAtNTile:(double)ntile forStage:(iTermPipelineStage)stage {
+    iTermPipelineMetricsTotals totals;
+    iTermPipelineMetricsGetTotals(stage, &totals);
+    return iTermPipelineMetricsTotalsValueAtNTile(&totals, ntile);
+}
+
++ (NSDictionary<NSString *, NSNumber *> *)summaryForStage:(iTermPipelineStage)stage {
+    iTermPipelineMetricsTotals totals;
+    iTermPipelineMetricsGetTotals(stage, &totals);
+    return @{ @"count": @(totals.count),
+              @"mean": @(totals.count ? (double)totals.sum / totals.count : 0),
+              @"p50": @(iTermPipelineMetricsTotalsValueAtNTile(&totals, 0.5)),
+              @"p90": @(iTermPipelineMetricsTotalsValueAtNTile(&totals, 0.9)),
+              @"p99": @(iTermPipelineMetricsTotalsValueAtNTile(&totals, 0.99)),
+              @"max": @(totals.max) };
+}
+
++ (NSDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *)snapshot {
+    NSMutableDictionary<NSString *, NSDictionary<NSString *, NSNumber *> *> *result = [NSMutableDictionary dictionary];
+    for (iTermPipelineStage stage = 0; stage < iTermPipelineStageCount; stage++) {
+        result[iTermPipelineStageName(stage)] = [self summaryForStage:stage];
+    }
+    return result;
+}
+
++ (NSString *)stringValue {
+    NSMutableString *result = [NSMutableString string];
+    for (iTermPipelineStage stage = 0; stage < iTermPipelineStageCount; stage++) {
+        NSDictionary<NSString *, NSNumber *> *summary = [self summaryForStage:stage];
+        [result appendFormat:@"%-28s n=%-10llu mean=%-10.1f p50=%-8llu p90=%-8llu p99=%-8llu max=%llu\n",
+         iTermPipelineStageName(stage).UTF8String,
+         summary[@"count"].unsignedLongLongValue,
+         summary[@"mean"].doubleValue,
+         summary[@"p50"].unsignedLongLongValue,
+         summary[@"p90"].unsignedLongLongValue,
+         summary[@"p99"].unsignedLongLongValue,
+         summary[@"max"].unsignedLongLongValue];
+    }
+    return result;
+}
+
++ (void)reset {
+    for (int shard = 0; shard < iTermPipelineMetricsShardCount; shard++) {
+        for (iTermPipelineStage stage = 0; stage < iTermPipelineStageCount; stage++) {
+            iTermPipelineMetricsHistogram *histogram = &gPipelineMetricsHistograms[shard][stage];
+            for (int i = 0; i < iTermPipelineMetricsBucketCount; i++) {
+                atomic_store_explicit(&histogram->buckets[i], 0, memory_order_relaxed);
+            }
+            atomic_store_explicit(&histogram->count, 0, memory_order_relaxed);
+            atomic_store_explicit(&histogram->sum, 0, memory_order_relaxed);
+            atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+        }
+    }
+}
+
+@end
@@ -0,0 +1,19 @@
+//
+//  iTermPipelineMetricsBuiltInFunction.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "iTermBuiltInFunctions.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// iterm2.get_pipeline_metrics() returns iTermPipelineMetrics' snapshot. Pass reset=true to clear
+// the counters after reading them.
+@interface iTermPipelineMetricsBuiltInFunction : NSObject<iTermBuiltInFunction>
+
+@end
+
+NS_ASSUME_NONNULL_END
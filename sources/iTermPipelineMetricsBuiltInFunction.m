@@ -0,0 +1,35 @@
+//
+//  iTermPipelineMetricsBuiltInFunction.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermPipelineMetricsBuiltInFunction.h"
+
+#import "iTermPipelineMetrics.h"
+
+@implementation iTermPipelineMetricsBuiltInFunction
+
++ (void)registerBuiltInFunction {
+    static NSString *const reset = @"reset";
+
+    iTermBuiltInFunction *func =
+    [[iTermBuiltInFunction alloc] initWithName:@"get_pipeline_metrics"
+                                     arguments:@{ reset: [NSNumber class] }
+                             optionalArguments:[NSSet setWithObject:reset]
+                                 defaultValues:@{ }
+                                       context:iTermVariablesSuggestionContextNone
+                                         block:
+     ^(NSDictionary * _Nonnull parameters, iTermBuiltInFunctionCompletionBlock  _Nonnull completion) {
+         NSDictionary *snapshot = [iTermPipelineMetrics snapshot];
+         if ([parameters[reset] boolValue]) {
+             [iTermPipelineMetrics reset];
+         }
+         completion(snapshot, nil);
+     }];
+    [[iTermBuiltInFunctions sharedInstance] registerFunction:func
+                                                   namespace:@"iterm2"];
+}
+
+@end
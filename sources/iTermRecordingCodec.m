@@ -6,6 +6,8 @@
 //
 
 #import "iTermRecordingCodec.h"
+#import "DVR.h"
+#import "iTermAsciicast.h"
 #import "iTermController.h"
 #import "iTermSavePanel.h"
 #import "iTermSessionLauncher.h"
@@ -19,13 +21,22 @@
 
 + (void)loadRecording {
     NSOpenPanel *panel = [[NSOpenPanel alloc] init];
-    panel.allowedFileTypes = @[ @"itr" ];
+    panel.allowedFileTypes = @[ @"itr", @"itrs", @"cast" ];
     if ([panel runModal] == NSModalResponseOK) {
         [self loadRecording:panel.URL];
     }
 }
 
 + (void)loadRecording:(NSURL *)url {
+    NSString *extension = url.pathExtension.lowercaseString;
+    if ([extension isEqualToString:@"itrs"]) {
+        [self loadStream:url];
+        return;
+    }
+    if ([extension isEqualToString:@"cast"]) {
+        [self loadAsciicast:url];
+        return;
+    }
     NSError *error = nil;
     NSData *gzipped = [NSData dataWithContentsOfURL:url options:0 error:&error];
     if (!gzipped) {
@@ -81,6 +92,49 @@
         return;
     }
 
+    [self replayInNewSessionWithProfile:dictProfile load:^(DVR *dvr) {
+        [dvr loadDictionary:dvrDict];
+    }];
+}
+
+// Streamed recordings don't include a profile, so the default one is used.
++ (void)loadStream:(NSURL *)url {
+    NSString *path = url.path;
+    DVR *probe = [[DVR alloc] initWithBufferCapacity:1];
+    if (![probe loadStreamAtPath:path]) {
+        [iTermWarning showWarningWithTitle:@"Could not read the file: it is not a streamed recording."
+                                   actions:@[ @"OK" ]
+                                identifier:@"RecordingMalformed"
+                               silenceable:kiTermWarningTypePersistent
+                                    window:nil];
+        return;
+    }
+    [self replayInNewSessionWithProfile:[[ProfileModel sharedInstance] defaultBookmark] load:^(DVR *dvr) {
+        [dvr loadStreamAtPath:path];
+    }];
+}
+
++ (void)loadAsciicast:(NSURL *)url {
+    NSError *error = nil;
+    NSData *data = [NSData dataWithContentsOfURL:url options:0 error:&error];
+    DVR *recording = data ? [iTermAsciicast dvrFromData:data error:&error] : nil;
+    if (!recording) {
+        [iTermWarning showWarningWithTitle:error.localizedDescription ?: @"Unknown error"
+                                   actions:@[ @"OK" ]
+                                 accessory:nil
+                                identifier:@"RecordingMalformed"
+                               silenceable:kiTermWarningTypePersistent
+                                   heading:@"Could not read the asciicast file."
+                                    window:nil];
+        return;
+    }
+    NSDictionary *dvrDict = recording.dictionaryValue;
+    [self replayInNewSessionWithProfile:[[ProfileModel sharedInstance] defaultBookmark] load:^(DVR *dvr) {
+        [dvr loadDictionary:dvrDict];
+    }];
+}
+
++ (void)replayInNewSessionWithProfile:(Profile *)dictProfile load:(void (^)(DVR *dvr))load {
     if (![iTermSessionLauncher profileIsWellFormed:dictProfile]) {
         return;
     }
@@ -96,7 +150,7 @@
                              makeSession:^(NSDictionary *profile, PseudoTerminal *windowController, void (^makeSessionCompletion)(PTYSession *)) {
         PTYSession *newSession = [[PTYSession alloc] initSynthetic:YES];
         newSession.profile = profile;
-        [newSession.screen.dvr loadDictionary:dvrDict];
+        load(newSession.screen.dvr);
         [windowController setupSession:newSession withSize:nil];
         dispatch_async(dispatch_get_main_queue(), ^{
             [windowController replaySession:newSession];
@@ -119,10 +173,13 @@
                                                      identifier:@"ExportRecording"
                                                initialDirectory:NSHomeDirectory()
                                                 defaultFilename:@"Recording.itr"
-                                               allowedFileTypes:@[ @"itr" ]];
+                                               allowedFileTypes:@[ @"itr", @"cast" ]];
     if (savePanel.path) {
         NSURL *url = [NSURL fileURLWithPath:savePanel.path];
-        if (url) {
+        if (url && [url.pathExtension.lowercaseString isEqualToString:@"cast"]) {
+            NSData *data = [iTermAsciicast dataFromDVR:session.screen.dvr from:from to:to];
+            [self writeRecording:data toURL:url];
+        } else if (url) {
             NSDictionary *dvrDict = [session.screen.dvr dictionaryValueFrom:from to:to];
             if (dvrDict) {
                 NSMutableDictionary *profile = [session.profile ?: @{} mutableCopy];
@@ -147,17 +204,7 @@
                                         @"profile": profile,
                                         @"version": @1 };
                 NSData *dictData = [[NSData it_dataWithArchivedObject:dict] gzippedData];
-                NSError *error = nil;
-                BOOL ok = [dictData writeToURL:url options:0 error:&error];
-                if (!ok) {
-                    [iTermWarning showWarningWithTitle:error.localizedDescription
-                                               actions:@[ @"OK" ]
-                                             accessory:nil
-                                            identifier:@"ErrorSavingRecording"
-                                           silenceable:kiTermWarningTypePersistent
-                                               heading:@"The recording could not be saved."
-                                                window:nil];
-                }
+                [self writeRecording:dictData toURL:url];
             } else {
                 [iTermWarning showWarningWithTitle:@"Error encoding recording."
                                            actions:@[ @"OK" ]
@@ -169,4 +216,18 @@
     }
 }
 
++ (void)writeRecording:(NSData *)data toURL:(NSURL *)url {
+    NSError *error = nil;
+    BOOL ok = [data writeToURL:url options:0 error:&error];
+    if (!ok) {
+        [iTermWarning showWarningWithTitle:error.localizedDescription
+                                   actions:@[ @"OK" ]
+                                 accessory:nil
+                                identifier:@"ErrorSavingRecording"
+                               silenceable:kiTermWarningTypePersistent
+                                   heading:@"The recording could not be saved."
+                                    window:nil];
+    }
+}
+
 @end
@@ -11,6 +11,17 @@ NS_ASSUME_NONNULL_BEGIN
 
 @class iTermImage;
 
+// Rows of a sixel image that the worker finished decoding.
+@interface iTermSixelBands : NSObject
+// RGBA, size.width pixels per row. Nil if no rows were completed.
+@property (nullable, nonatomic, readonly) NSData *rgba;
+@property (nonatomic, readonly) NSInteger firstRow;
+// Size of the image so far.
+@property (nonatomic, readonly) NSSize size;
+// Did the image give its size up front?
+@property (nonatomic, readonly) BOOL declaredSize;
+@end
+
 @interface iTermSandboxedWorkerClient : NSObject
 
 - (instancetype)init NS_UNAVAILABLE;
@@ -18,6 +29,15 @@ NS_ASSUME_NONNULL_BEGIN
 + (iTermImage * _Nullable)imageFromData:(NSData *)data;
 + (iTermImage * _Nullable)imageFromSixelData:(NSData *)data;
 
+// Decode a sixel image as it arrives. The first piece begins with the header that
+// +imageFromSixelData: expects. Returns nil if decoding failed, after which the identifier is
+// forgotten.
++ (iTermSixelBands * _Nullable)appendSixelData:(NSData *)data
+                         toImageWithIdentifier:(NSString *)identifier;
++ (iTermImage * _Nullable)finishSixelData:(NSData *)data
+                    toImageWithIdentifier:(NSString *)identifier;
++ (void)cancelSixelImageWithIdentifier:(NSString *)identifier;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -9,6 +9,23 @@
 #import "iTerm2SandboxedWorkerProtocol.h"
 #import "DebugLogging.h"
 
+@implementation iTermSixelBands
+
+- (instancetype)initWithRGBA:(NSData *)rgba
+                    firstRow:(NSInteger)firstRow
+                        size:(NSSize)size
+                declaredSize:(BOOL)declaredSize {
+    self = [super init];
+    if (self) {
+        _rgba = rgba;
+        _firstRow = firstRow;
+        _size = size;
+        _declaredSize = declaredSize;
+    }
+    return self;
+}
+
+@end
 
 @implementation iTermSandboxedWorkerClient
 
@@ -33,15 +50,15 @@
     }
 }
 
-+ (iTermImage *)performSynchronously:(void (^ NS_NOESCAPE)(NSXPCConnection *connection, void (^completion)(iTermImage *)))block {
++ (id)performSynchronously:(void (^ NS_NOESCAPE)(NSXPCConnection *connection, void (^completion)(id)))block {
     NSXPCConnection *connectionToService = [self connection];
 
     dispatch_group_t group = dispatch_group_create();
     dispatch_group_enter(group);
 
-    __block iTermImage *result = nil;
-    block(connectionToService, ^(iTermImage *image) {
-        result = image;
+    __block id result = nil;
+    block(connectionToService, ^(id object) {
+        result = object;
         dispatch_group_leave(group);
     });
 
@@ -72,4 +89,41 @@
     }];
 }
 
++ (iTermSixelBands *)appendSixelData:(NSData *)data toImageWithIdentifier:(NSString *)identifier {
+    return [self performSynchronously:^(NSXPCConnection *connectionToService, void (^completion)(iTermSixelBands *)) {
+        [[connectionToService remoteObjectProxyWithErrorHandler:^(NSError * _Nonnull error) {
+            XLog(@"Failed to connect to service: %@", error);
+            completion(nil);
+        }] appendSixelData:data
+     toImageWithIdentifier:identifier
+                 withReply:^(NSData * _Nullable rgba, NSInteger firstRow, NSInteger width, NSInteger height, BOOL declaredSize) {
+            if (width <= 0 || height <= 0) {
+                completion(nil);
+                return;
+            }
+            completion([[iTermSixelBands alloc] initWithRGBA:rgba
+                                                    firstRow:firstRow
+                                                        size:NSMakeSize(width, height)
+                                                declaredSize:declaredSize]);
+        }];
+    }];
+}
+
++ (iTermImage *)finishSixelData:(NSData *)data toImageWithIdentifier:(NSString *)identifier {
+    return [self performSynchronously:^(NSXPCConnection *connectionToService, void (^completion)(iTermImage *)) {
+        [[connectionToService remoteObjectProxyWithErrorHandler:^(NSError * _Nonnull error) {
+            XLog(@"Failed to connect to service: %@", error);
+            completion(nil);
+        }] finishSixelData:data toImageWithIdentifier:identifier withReply:^(iTermImage * _Nullable image) {
+            completion(image);
+        }];
+    }];
+}
+
++ (void)cancelSixelImageWithIdentifier:(NSString *)identifier {
+    [[[self connection] remoteObjectProxyWithErrorHandler:^(NSError * _Nonnull error) {
+        DLog(@"Failed to cancel sixel image: %@", error);
+    }] cancelSixelImageWithIdentifier:identifier];
+}
+
 @end
@@ -23,4 +23,7 @@
 
 - (void)addParameterWithName:(NSString *)name parsedExpression:(iTermParsedExpression *)expression;
 
+// Enumerates parameters in the order they were added.
+- (void)enumerateParametersWithBlock:(void (^ NS_NOESCAPE)(NSString *name, iTermParsedExpression *expression, BOOL *stop))block;
+
 @end
@@ -42,6 +42,8 @@ void iTermFunctionCallSplitFullyQualifiedName(NSString *fqName, NSString **names
 @implementation iTermScriptFunctionCall {
     // Maps an argument name to a parsed expression for its value.
     NSMutableDictionary<NSString *, iTermParsedExpression *> *_argToExpression;
+    // Argument names in the order they were added.
+    NSMutableArray<NSString *> *_argNames;
     NSMutableArray<iTermExpressionEvaluator *> *_evaluators;
     NSMutableSet<NSString *> *_remainingArgs;
 }
@@ -50,6 +52,7 @@ void iTermFunctionCallSplitFullyQualifiedName(NSString *fqName, NSString **names
     self = [super init];
     if (self) {
         _argToExpression = [NSMutableDictionary dictionary];
+        _argNames = [NSMutableArray array];
         _evaluators = [NSMutableArray array];
     }
     return self;
@@ -290,9 +293,22 @@ void iTermFunctionCallSplitFullyQualifiedName(NSString *fqName, NSString **names
 }
 
 - (void)addParameterWithName:(NSString *)name parsedExpression:(iTermParsedExpression *)expression {
+    if (!_argToExpression[name]) {
+        [_argNames addObject:name];
+    }
     _argToExpression[name] = expression;
 }
 
+- (void)enumerateParametersWithBlock:(void (^ NS_NOESCAPE)(NSString *, iTermParsedExpression *, BOOL *))block {
+    BOOL stop = NO;
+    for (NSString *name in _argNames) {
+        block(name, _argToExpression[name], &stop);
+        if (stop) {
+            return;
+        }
+    }
+}
+
 - (void)callWithScope:(iTermVariableScope *)scope
            invocation:(NSString *)invocation
              receiver:(NSString *)receiver
@@ -124,6 +124,11 @@ typedef NS_ENUM(NSInteger, iTermSelectionMode) {
 // Has clearColumnWindowForLiveSelection been called?
 @property(nonatomic, readonly) BOOL haveClearedColumnWindow;
 
+// Changes whenever the selected region changes. A copy has the same generation as its original
+// until one of them changes, and unrelated selections never share a generation, so selections
+// with equal generations select the same cells.
+@property(nonatomic, readonly) NSUInteger generation;
+
 // Returns the debugging name for a selection mode.
 + (NSString *)nameForMode:(iTermSelectionMode)mode;
 
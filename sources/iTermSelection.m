@@ -14,11 +14,22 @@
 #import "NSObject+iTerm.h"
 #import "ScreenChar.h"
 
+#include <stdatomic.h>
+
 static NSString *const kSelectionSubSelectionsKey = @"Sub selections";
 
 static NSString *const kiTermSubSelectionRange = @"Range";
 static NSString *const kiTermSubSelectionMode = @"Mode";
 
+// Upper bound on the number of lines whose selected indexes are remembered.
+static const NSUInteger kiTermSelectionMaximumCachedLines = 1000;
+
+static _Atomic NSUInteger iTermSelectionLastGeneration;
+
+static NSUInteger iTermSelectionNewGeneration(void) {
+    return atomic_fetch_add_explicit(&iTermSelectionLastGeneration, 1, memory_order_relaxed) + 1;
+}
+
 @implementation iTermSubSelection
 
 + (instancetype)subSelectionWithAbsRange:(VT100GridAbsWindowedRange)unsafeRange
@@ -142,12 +153,124 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
 }
 @end
 
+typedef struct {
+    long long top;
+    long long bottom;
+    // Largest bottom of this entry and the entries below it in the tree.
+    long long maxBottom;
+    // Index of the sub-selection.
+    NSUInteger index;
+} iTermSelectionIndexEntry;
+
+static int iTermSelectionIndexEntryCompare(const void *a, const void *b) {
+    const long long lhs = ((const iTermSelectionIndexEntry *)a)->top;
+    const long long rhs = ((const iTermSelectionIndexEntry *)b)->top;
+    return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+}
+
+// Entries in [begin, end) form a subtree rooted at the middle entry. Returns the subtree's largest
+// bottom.
+static long long iTermSelectionIndexComputeMaxBottom(iTermSelectionIndexEntry *entries,
+                                                     NSUInteger begin,
+                                                     NSUInteger end) {
+    if (begin >= end) {
+        return LLONG_MIN;
+    }
+    const NSUInteger mid = begin + (end - begin) / 2;
+    const long long left = iTermSelectionIndexComputeMaxBottom(entries, begin, mid);
+    const long long right = iTermSelectionIndexComputeMaxBottom(entries, mid + 1, end);
+    entries[mid].maxBottom = MAX(entries[mid].bottom, MAX(left, right));
+    return entries[mid].maxBottom;
+}
+
+static void iTermSelectionIndexSearch(const iTermSelectionIndexEntry *entries,
+                                      NSUInteger begin,
+                                      NSUInteger end,
+                                      long long line,
+                                      NS_NOESCAPE void (^block)(NSUInteger)) {
+    while (begin < end) {
+        const NSUInteger mid = begin + (end - begin) / 2;
+        if (entries[mid].maxBottom < line) {
+            // Everything in this subtree ends before the line.
+            return;
+        }
+        iTermSelectionIndexSearch(entries, begin, mid, line, block);
+        if (entries[mid].top > line) {
+            // Everything to the right begins after the line.
+            return;
+        }
+        if (entries[mid].bottom >= line) {
+            block(entries[mid].index);
+        }
+        begin = mid + 1;
+    }
+}
+
+// Finds the sub-selections that touch a line in O(log n + k) time. Entries are sorted by top line
+// and form an implicit balanced tree in which each entry knows the largest bottom line beneath it,
+// so subtrees that end above the line are skipped. It never changes after it is made, so copies of
+// a selection share it.
+@interface iTermSelectionIndex : NSObject
+- (instancetype)initWithSubSelections:(NSArray<iTermSubSelection *> *)subSelections;
+
+// Calls |block| with the position in the initializer's array of each sub-selection that touches
+// |line|, in no particular order.
+- (void)enumerateSubSelectionIndexesOnAbsoluteLine:(long long)line
+                                             block:(void (NS_NOESCAPE ^)(NSUInteger i))block;
+@end
+
+@implementation iTermSelectionIndex {
+    iTermSelectionIndexEntry *_entries;
+    NSUInteger _count;
+}
+
+- (instancetype)initWithSubSelections:(NSArray<iTermSubSelection *> *)subSelections {
+    self = [super init];
+    if (self) {
+        _count = subSelections.count;
+        _entries = malloc(MAX(1, _count) * sizeof(*_entries));
+        NSUInteger i = 0;
+        for (iTermSubSelection *sub in subSelections) {
+            const VT100GridAbsCoordRange range = sub.absRange.coordRange;
+            // Box selections may be flipped vertically.
+            _entries[i].top = MIN(range.start.y, range.end.y);
+            _entries[i].bottom = MAX(range.start.y, range.end.y);
+            _entries[i].index = i;
+            i++;
+        }
+        qsort(_entries, _count, sizeof(*_entries), iTermSelectionIndexEntryCompare);
+        iTermSelectionIndexComputeMaxBottom(_entries, 0, _count);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_entries);
+    [super dealloc];
+}
+
+- (void)enumerateSubSelectionIndexesOnAbsoluteLine:(long long)line
+                                             block:(void (NS_NOESCAPE ^)(NSUInteger i))block {
+    iTermSelectionIndexSearch(_entries, 0, _count, line, block);
+}
+
+@end
+
 @implementation iTermSelection {
     VT100GridAbsWindowedRange _absRange;
     VT100GridAbsWindowedRange _initialAbsRange;
     BOOL _live;
     BOOL _extend;
     NSMutableArray *_subSelections;  // iTermSubSelection array
+
+    // Built on demand from _subSelections. Nil when out of date.
+    iTermSelectionIndex *_subSelectionIndex;
+
+    // Maps an absolute line number to its selected indexes. Valid only for
+    // _lineCacheGeneration and _lineCacheWidth.
+    NSMutableDictionary<NSNumber *, NSIndexSet *> *_lineCache;
+    NSUInteger _lineCacheGeneration;
+    int _lineCacheWidth;
 }
 
 + (NSString *)nameForMode:(iTermSelectionMode)mode {
@@ -173,12 +296,16 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
     self = [super init];
     if (self) {
         _subSelections = [[NSMutableArray alloc] init];
+        _lineCache = [[NSMutableDictionary alloc] init];
+        _generation = iTermSelectionNewGeneration();
     }
     return self;
 }
 
 - (void)dealloc {
     [_subSelections release];
+    [_subSelectionIndex release];
+    [_lineCache release];
     [super dealloc];
 }
 
@@ -190,6 +317,33 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
             [[self class] nameForMode:_selectionMode], _subSelections, _delegate];
 }
 
+// Call after anything that might change which cells are selected.
+- (void)selectedRegionDidChange {
+    _generation = iTermSelectionNewGeneration();
+}
+
+// Call after adding, removing, or modifying sub-selections.
+- (void)subSelectionsDidChange {
+    [_subSelectionIndex release];
+    _subSelectionIndex = nil;
+    [self selectedRegionDidChange];
+}
+
+- (iTermSelectionIndex *)subSelectionIndex {
+    if (!_subSelectionIndex) {
+        _subSelectionIndex = [[iTermSelectionIndex alloc] initWithSubSelections:_subSelections];
+    }
+    return _subSelectionIndex;
+}
+
+- (void)setSelectionMode:(iTermSelectionMode)selectionMode {
+    if (selectionMode == _selectionMode) {
+        return;
+    }
+    _selectionMode = selectionMode;
+    [self selectedRegionDidChange];
+}
+
 - (void)flip {
     _absRange.coordRange = VT100GridAbsCoordRangeMake(_absRange.coordRange.end.x,
                                                       _absRange.coordRange.end.y,
@@ -216,6 +370,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         _absRange = sub.absRange;
         _selectionMode = sub.selectionMode;
         [_subSelections removeLastObject];
+        [self subSelectionsDidChange];
     }
     DLog(@"Begin extending selection.");
     _live = YES;
@@ -288,6 +443,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         }
     }
     [self extendPastNulls];
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -359,6 +515,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
     if (_resumable && resume && [_subSelections count]) {
         _absRange = [self lastAbsRange];
         [_subSelections removeLastObject];
+        [self subSelectionsDidChange];
         // Preserve existing value of appending flag.
     } else {
         _appending = append;
@@ -366,6 +523,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
 
     if (!_appending) {
         [_subSelections removeAllObjects];
+        [self subSelectionsDidChange];
     }
     DLog(@"Begin new selection. coord=%@, extend=%d", VT100GridAbsCoordDescription(absCoord), extend);
     _live = YES;
@@ -379,6 +537,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
 
     DLog(@"Begin selection, range=%@", VT100GridAbsWindowedRangeDescription(_absRange));
     [self extendPastNulls];
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -404,6 +563,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
                                                       width:self.width];
             [_subSelections addObject:sub];
         }
+        [self subSelectionsDidChange];
         _resumable = NO;
     } else {
         if (self.liveRangeIsFlipped) {
@@ -419,6 +579,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
             sub.absRange = _absRange;
             sub.selectionMode = _selectionMode;
             [_subSelections addObject:sub];
+            [self subSelectionsDidChange];
             _resumable = YES;
         } else {
             _resumable = NO;
@@ -428,6 +589,8 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
     _extend = NO;
     _live = NO;
 
+    [self selectedRegionDidChange];
+
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -463,6 +626,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         case kiTermSelectionModeBox:
             break;
     }
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -481,6 +645,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         DLog(@"Clear selection");
         _absRange = VT100GridAbsWindowedRangeMake(VT100GridAbsCoordRangeMake(-1, -1, -1, -1), 0, 0);
         [_subSelections removeAllObjects];
+        [self subSelectionsDidChange];
         [_delegate selectionDidChange:[[self retain] autorelease]];
     }
 }
@@ -544,6 +709,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
 
     _extend = YES;
     [self extendPastNulls];
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
     if (startLiveSelection) {
         return YES;
@@ -614,27 +780,38 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         if (_absRange.coordRange.start.y < totalScrollbackOverflow) {
            _absRange.coordRange.start.x = 0;
            _absRange.coordRange.start.y = totalScrollbackOverflow;
+           [self selectedRegionDidChange];
         }
        if (_absRange.coordRange.end.y < totalScrollbackOverflow) {
           [self clearSelection];
         }
     }
 
-    NSMutableArray<iTermSubSelection *> *subsToRemove = [NSMutableArray array];
+    BOOL subSelectionsChanged = NO;
+    NSMutableIndexSet *indexesToRemove = [NSMutableIndexSet indexSet];
+    NSUInteger i = 0;
     for (iTermSubSelection *sub in _subSelections) {
         VT100GridAbsWindowedRange range = sub.absRange;
         if (range.coordRange.start.y < totalScrollbackOverflow) {
             range.coordRange.start.x = 0;
             range.coordRange.start.y = totalScrollbackOverflow;
+            sub.absRange = range;
+            subSelectionsChanged = YES;
         }
-        sub.absRange = range;
         if (range.coordRange.end.y < totalScrollbackOverflow) {
-            [subsToRemove addObject:sub];
+            [indexesToRemove addIndex:i];
         }
+        i++;
     }
 
-    for (iTermSubSelection *sub in subsToRemove) {
-        [_subSelections removeObject:sub];
+    if (indexesToRemove.count) {
+        [_subSelections removeObjectsAtIndexes:indexesToRemove];
+        subSelectionsChanged = YES;
+    }
+    if (subSelectionsChanged) {
+        // The generation stays the same when nothing scrolled out, so copies made before this
+        // call still compare equal.
+        [self subSelectionsDidChange];
     }
 
     if (notifyDelegateOfChange) {
@@ -654,11 +831,16 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
     if (![self hasSelection]) {
         return NO;
     }
-    BOOL contained = NO;
-    for (iTermSubSelection *sub in [self allSubSelections]) {
+    __block BOOL contained = NO;
+    [[self subSelectionIndex] enumerateSubSelectionIndexesOnAbsoluteLine:absCoord.y
+                                                                   block:^(NSUInteger i) {
+        iTermSubSelection *sub = _subSelections[i];
         if ([sub containsAbsCoord:absCoord]) {
             contained = !contained;
         }
+    }];
+    if ([self haveLiveSelection] && [self absCoord:absCoord isInAbsRange:[self unflippedLiveAbsRange]]) {
+        contained = !contained;
     }
 
     return contained;
@@ -679,6 +861,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
 
 - (void)setSelectedAbsRange:(VT100GridAbsWindowedRange)selectedRange {
     _absRange = selectedRange;
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -692,9 +875,12 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         [theCopy->_subSelections addObject:[[sub copy] autorelease]];
     }
     theCopy->_resumable = _resumable;
+    theCopy->_selectionMode = _selectionMode;
+    // The copied sub-selections are in the same order, so the index still applies.
+    theCopy->_subSelectionIndex = [_subSelectionIndex retain];
+    theCopy->_generation = _generation;
 
     theCopy.delegate = _delegate;
-    theCopy.selectionMode = _selectionMode;
 
     return theCopy;
 }
@@ -838,7 +1024,9 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
                                   withObject:[iTermSubSelection subSelectionWithAbsRange:firstRange
                                                                                     mode:mode
                                                                                    width:self.width]];
+        [self subSelectionsDidChange];
     }
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -852,7 +1040,9 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         [_subSelections addObject:[iTermSubSelection subSelectionWithAbsRange:lastRange
                                                                          mode:mode
                                                                         width:self.width]];
+        [self subSelectionsDidChange];
     }
+    [self selectedRegionDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -870,6 +1060,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
         }
         [_subSelections addObject:sub];
     }
+    [self subSelectionsDidChange];
     [_delegate selectionDidChange:[[self retain] autorelease]];
 }
 
@@ -892,6 +1083,7 @@ static NSString *const kiTermSubSelectionMode = @"Mode";
     }
     [_subSelections autorelease];
     _subSelections = [newSubs retain];
+    [self subSelectionsDidChange];
 }
 
 static NSRange iTermMakeRange(NSInteger location, NSInteger length) {
@@ -961,35 +1153,34 @@ static NSRange iTermMakeRange(NSInteger location, NSInteger length) {
 }
 
 - (NSIndexSet *)selectedIndexesOnAbsoluteLine:(long long)line {
-    const NSInteger numberOfSubSelections = _subSelections.count;
-    if (!_live && numberOfSubSelections == 0) {
+    if (!_live && _subSelections.count == 0) {
         // Fast path
         return [NSIndexSet indexSet];
     }
-    if (!_live && numberOfSubSelections == 1) {
-        // Fast path
-        iTermSubSelection *sub = _subSelections[0];
-        NSRange theRange = [self rangeOfIndexesInAbsRange:sub.absRange
-                                           onAbsoluteLine:line
-                                                     mode:sub.selectionMode];
-        return [NSIndexSet it_indexSetWithIndexesInRange:theRange];
-    }
-    if (_live && numberOfSubSelections == 0) {
-        // Fast path
-        NSRange theRange = [self rangeOfIndexesInAbsRange:[self unflippedLiveAbsRange]
-                                           onAbsoluteLine:line
-                                                     mode:_selectionMode];
-        return [NSIndexSet it_indexSetWithIndexesInRange:theRange];
+
+    // Renderers ask about every visible line on every frame, so remember the answers until the
+    // selection changes.
+    const int width = [self width];
+    if (_lineCacheGeneration != _generation || _lineCacheWidth != width) {
+        [_lineCache removeAllObjects];
+        _lineCacheGeneration = _generation;
+        _lineCacheWidth = width;
+    }
+    NSNumber *key = @(line);
+    NSIndexSet *indexes = _lineCache[key];
+    if (!indexes) {
+        indexes = [self uncachedSelectedIndexesOnAbsoluteLine:line];
+        if (_lineCache.count >= kiTermSelectionMaximumCachedLines) {
+            [_lineCache removeAllObjects];
+        }
+        _lineCache[key] = indexes;
     }
+    return indexes;
+}
 
-    // Slow path.
+- (NSIndexSet *)uncachedSelectedIndexesOnAbsoluteLine:(long long)line {
     NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
-    for (iTermSubSelection *sub in [self allSubSelections]) {
-        VT100GridAbsWindowedRange range = sub.absRange;
-        NSRange theRange = [self rangeOfIndexesInAbsRange:range
-                                           onAbsoluteLine:line
-                                                     mode:sub.selectionMode];
-
+    void (^toggle)(NSRange) = ^(NSRange theRange) {
         // Any values in theRange that intersect indexes should be removed from indexes.
         // And values in theSet that don't intersect indexes should be added to indexes.
         NSMutableIndexSet *indexesToAdd = [NSMutableIndexSet it_indexSetWithIndexesInRange:theRange];
@@ -1002,9 +1193,22 @@ static NSRange iTermMakeRange(NSInteger location, NSInteger length) {
         }];
         [indexes removeIndexes:indexesToRemove];
         [indexes addIndexes:indexesToAdd];
+    };
+
+    [[self subSelectionIndex] enumerateSubSelectionIndexesOnAbsoluteLine:line
+                                                                   block:^(NSUInteger i) {
+        iTermSubSelection *sub = _subSelections[i];
+        toggle([self rangeOfIndexesInAbsRange:sub.absRange
+                               onAbsoluteLine:line
+                                         mode:sub.selectionMode]);
+    }];
+    if (_live) {
+        toggle([self rangeOfIndexesInAbsRange:[self unflippedLiveAbsRange]
+                               onAbsoluteLine:line
+                                         mode:_selectionMode]);
     }
 
-    return indexes;
+    return [[indexes copy] autorelease];
 }
 
 // orphaned tab fillers are selected iff they are in the selection.
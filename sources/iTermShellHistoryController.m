@@ -10,6 +10,7 @@
 
 #import "DebugLogging.h"
 #import "iTermCommandHistoryEntryMO+Additions.h"
+#import "iTermCommandHistoryIndex.h"
 #import "iTermDirectoryTree.h"
 #import "iTermHostRecordMO.h"
 #import "iTermHostRecordMO+Additions.h"
@@ -53,6 +54,9 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
 
     // Keys are remote host keys, "user@hostname".
     NSMutableDictionary<NSString *, NSMutableArray<iTermCommandHistoryCommandUseMO *> *> *_expandedCache;
+
+    // Keys are remote host keys. Built on first use and discarded when entries are deleted.
+    NSMutableDictionary<NSString *, iTermCommandHistoryIndex *> *_commandIndexes;
     NSManagedObjectContext *_managedObjectContext;
     iTermDirectoryTree *_tree;
 
@@ -99,6 +103,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     }
     _records = [[NSMutableDictionary alloc] init];
     _expandedCache = [[NSMutableDictionary alloc] init];
+    _commandIndexes = [[NSMutableDictionary alloc] init];
     _tree = [[iTermDirectoryTree alloc] init];
 
     [self removeOldData];
@@ -111,6 +116,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
 - (void)dealloc {
     [_records release];
     [_expandedCache release];
+    [_commandIndexes release];
     [_managedObjectContext release];
     [_tree release];
     [super dealloc];
@@ -351,6 +357,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     // Reload everything.
     [_records removeAllObjects];
     [_expandedCache removeAllObjects];
+    [_commandIndexes removeAllObjects];
     [_tree release];
     _tree = [[iTermDirectoryTree alloc] init];
     [self loadObjectGraph];
@@ -434,6 +441,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     }
 
     if (commandHistory) {
+        [_commandIndexes removeAllObjects];
         [self deleteObjectsWithEntityName:[iTermCommandHistoryEntryMO entityName]];
         [self deleteObjectsWithEntityName:[iTermCommandHistoryCommandUseMO entityName]];
     }
@@ -471,14 +479,8 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
         [self setRecord:hostRecord forHost:host];
     }
 
-    iTermCommandHistoryEntryMO *theEntry = nil;
-    for (iTermCommandHistoryEntryMO *entry in hostRecord.entries) {
-        if ([entry.command isEqualToString:command]) {
-            theEntry = entry;
-            break;
-        }
-    }
-
+    iTermCommandHistoryIndex *index = [self commandIndexForHost:host];
+    iTermCommandHistoryEntryMO *theEntry = [index entryWithCommand:command];
     if (!theEntry) {
         theEntry = [iTermCommandHistoryEntryMO commandHistoryEntryInContext:_managedObjectContext];
         theEntry.command = command;
@@ -487,6 +489,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
 
     theEntry.numberOfUses = @(theEntry.numberOfUses.integerValue + 1);
     theEntry.timeOfLastUse = @([self now]);
+    [index updateEntry:theEntry];
 
     iTermCommandHistoryCommandUseMO *commandUse =
     [iTermCommandHistoryCommandUseMO commandHistoryCommandUseInContext:_managedObjectContext];
@@ -528,22 +531,18 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     if (host == nil) {
         return [self commandHistoryEntriesWithPrefix:partialCommand onHost:[VT100RemoteHost localhost]];
     }
-    BOOL emptyPartialCommand = (partialCommand.length == 0);
-    NSMutableArray<iTermCommandHistoryEntryMO *> *result = [NSMutableArray array];
-    iTermHostRecordMO *hostRecord = [self recordForHost:host];
-    for (iTermCommandHistoryEntryMO *entry in hostRecord.entries) {
-        if (emptyPartialCommand || [entry.command caseInsensitiveHasPrefix:partialCommand]) {
-            // The FinalTerm algorithm doesn't require |partialCommand| to be a prefix of the
-            // history entry, but based on how our autocomplete works, it makes sense to only
-            // accept prefixes. Their scoring algorithm is implemented in case this should change.
-            entry.matchLocation = @0;
-            [result addObject:entry];
-        }
+    if (![self recordForHost:host]) {
+        return @[];
     }
-
-    // TODO: Cache this.
-    NSArray *sortedEntries = [result sortedArrayUsingSelector:@selector(compare:)];
-    return [sortedEntries subarrayWithRange:NSMakeRange(0, MIN(kMaxResults, sortedEntries.count))];
+    NSArray<iTermCommandHistoryEntryMO *> *result =
+        [[self commandIndexForHost:host] entriesWithPrefix:partialCommand limit:kMaxResults];
+    for (iTermCommandHistoryEntryMO *entry in result) {
+        // The FinalTerm algorithm doesn't require |partialCommand| to be a prefix of the
+        // history entry, but based on how our autocomplete works, it makes sense to only
+        // accept prefixes. Their scoring algorithm is implemented in case this should change.
+        entry.matchLocation = @0;
+    }
+    return result;
 }
 
 - (NSArray<iTermCommandHistoryCommandUseMO *> *)autocompleteSuggestionsWithPartialCommand:(NSString *)partialCommand
@@ -660,6 +659,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     if (hostRecord) {
         [hostRecord removeEntries:hostRecord.entries];
         [_expandedCache removeObjectForKey:key];
+        [_commandIndexes removeObjectForKey:key];
         [self saveCommandHistory];
     }
 }
@@ -752,6 +752,7 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
 - (void)loadObjectGraph {
     [self loadObjectGraphIntoDictionary:_records];
     [_expandedCache removeAllObjects];
+    [_commandIndexes removeAllObjects];
     for (NSString *hostKey in _records) {
         iTermHostRecordMO *hostRecord = _records[hostKey];
         for (iTermRecentDirectoryMO *directory in hostRecord.directories) {
@@ -789,6 +790,16 @@ static const NSTimeInterval kMaxTimeToRememberDirectories = 60 * 60 * 24 * 90;
     return result;
 }
 
+- (iTermCommandHistoryIndex *)commandIndexForHost:(VT100RemoteHost *)host {
+    NSString *key = host.key ?: @"";
+    iTermCommandHistoryIndex *index = _commandIndexes[key];
+    if (!index) {
+        index = [[[iTermCommandHistoryIndex alloc] initWithEntries:[[self recordForHost:host] entries] ?: @[]] autorelease];
+        _commandIndexes[key] = index;
+    }
+    return index;
+}
+
 - (void)loadExpandedCacheForHost:(VT100RemoteHost *)host {
     NSString *key = host.key ?: @"";
 
@@ -0,0 +1,585 @@
+//
+//  iTermSixelDecoder.c
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#include "iTermSixelDecoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__)
+#include <immintrin.h>
+#include <sys/sysctl.h>
+#endif
+
+const int iTermSixelDecoderMaximumDimension = 8192;
+
+enum {
+    iTermSixelDecoderMaximumParameters = 16,
+    iTermSixelDecoderMaximumParameterValue = 65535,
+    // Index 0 is the background. Color register n is at index n + 1.
+    iTermSixelDecoderNumberOfColors = 256
+};
+
+typedef enum {
+    iTermSixelDecoderStateGround,
+    iTermSixelDecoderStateEscape,
+    // Parameters of the introducer, before the q.
+    iTermSixelDecoderStateIntroducer,
+    iTermSixelDecoderStateSixel,
+    // " Pan ; Pad ; Ph ; Pv
+    iTermSixelDecoderStateRasterAttributes,
+    // ! Pn
+    iTermSixelDecoderStateRepeat,
+    // # Pc ; Pu ; Px ; Py ; Pz
+    iTermSixelDecoderStateColor,
+    iTermSixelDecoderStateFinished
+} iTermSixelDecoderState;
+
+struct iTermSixelDecoder {
+    iTermSixelDecoderState state;
+    // -1 before the first digit of an introducer parameter.
+    int param;
+    int params[iTermSixelDecoderMaximumParameters];
+    int numberOfParams;
+
+    // Position of the next sixel. y is the top row of the current band.
+    int x;
+    int y;
+    // Largest coordinates drawn on.
+    int maxX;
+    int maxY;
+    int declaredWidth;
+    int declaredHeight;
+    int repeatCount;
+    int colorIndex;
+    bool failed;
+
+    // One palette index per pixel. Rows are `stride` bytes apart and `rows` of them are allocated.
+    // Unallocated pixels have the background color.
+    unsigned char *pixels;
+    int stride;
+    int rows;
+
+    // RGBA bytes of each color.
+    uint32_t palette[iTermSixelDecoderNumberOfColors];
+};
+
+#pragma mark - Colors
+
+static int iTermSixelDecoderMin(int a, int b) {
+    return a < b ? a : b;
+}
+
+static int iTermSixelDecoderMax(int a, int b) {
+    return a > b ? a : b;
+}
+
+static uint32_t iTermSixelDecoderRGBA(int r, int g, int b, int a) {
+    const unsigned char bytes[4] = { r, g, b, a };
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+// Converts a percentage to 0-255, rounding as libsixel does.
+static int iTermSixelDecoderPercentToByte(int percent) {
+    return (percent * 255 + 50) / 100;
+}
+
+static uint32_t iTermSixelDecoderRGBAFromPercent(int r, int g, int b) {
+    return iTermSixelDecoderRGBA(iTermSixelDecoderPercentToByte(r),
+                                 iTermSixelDecoderPercentToByte(g),
+                                 iTermSixelDecoderPercentToByte(b),
+                                 0xff);
+}
+
+// Hue is in degrees with blue at 0, as on the VT340. Lightness and saturation are percentages.
+static uint32_t iTermSixelDecoderRGBAFromHLS(int hue, int lightness, int saturation) {
+    const double l = lightness / 100.0;
+    const double chroma = saturation * (1.0 - (l > 0.5 ? 2 * l - 1 : 1 - 2 * l)) / 2.0;
+    const double max = lightness + chroma;
+    const double min = lightness - chroma;
+    // Rotate so that red is at 0, as in HSL.
+    hue = (hue + 240) % 360;
+    double r, g, b;
+    switch (hue / 60) {
+        case 0:
+            r = max;
+            g = min + (max - min) * (hue / 60.0);
+            b = min;
+            break;
+        case 1:
+            r = min + (max - min) * ((120 - hue) / 60.0);
+            g = max;
+            b = min;
+            break;
+        case 2:
+            r = min;
+            g = max;
+            b = min + (max - min) * ((hue - 120) / 60.0);
+            break;
+        case 3:
+            r = min;
+            g = min + (max - min) * ((240 - hue) / 60.0);
+            b = max;
+            break;
+        case 4:
+            r = min + (max - min) * ((hue - 240) / 60.0);
+            g = min;
+            b = max;
+            break;
+        default:
+            r = max;
+            g = min;
+            b = min + (max - min) * ((360 - hue) / 60.0);
+            break;
+    }
+    return iTermSixelDecoderRGBAFromPercent((int)r, (int)g, (int)b);
+}
+
+static void iTermSixelDecoderInitializePalette(iTermSixelDecoder *decoder) {
+    static const int vt340[16][3] = {
+        {  0,  0,  0 }, { 20, 20, 80 }, { 80, 13, 13 }, { 20, 80, 20 },
+        { 80, 20, 80 }, { 20, 80, 80 }, { 80, 80, 20 }, { 53, 53, 53 },
+        { 26, 26, 26 }, { 33, 33, 60 }, { 60, 26, 26 }, { 33, 60, 33 },
+        { 60, 33, 60 }, { 33, 60, 60 }, { 60, 60, 33 }, { 80, 80, 80 }
+    };
+    int n = 0;
+    decoder->palette[n++] = iTermSixelDecoderRGBA(0, 0, 0, 0xff);
+    for (int i = 0; i < 16; i++) {
+        decoder->palette[n++] = iTermSixelDecoderRGBAFromPercent(vt340[i][0], vt340[i][1], vt340[i][2]);
+    }
+    for (int r = 0; r < 6; r++) {
+        for (int g = 0; g < 6; g++) {
+            for (int b = 0; b < 6; b++) {
+                decoder->palette[n++] = iTermSixelDecoderRGBA(r * 51, g * 51, b * 51, 0xff);
+            }
+        }
+    }
+    for (int i = 0; n < iTermSixelDecoderNumberOfColors; i++) {
+        decoder->palette[n++] = iTermSixelDecoderRGBA(i * 11, i * 11, i * 11, 0xff);
+    }
+}
+
+#pragma mark - Pixels
+
+// Makes sure pixels up to (but not including) width x height are allocated.
+static bool iTermSixelDecoderReserve(iTermSixelDecoder *decoder, int width, int height) {
+    width = iTermSixelDecoderMin(width, iTermSixelDecoderMaximumDimension);
+    height = iTermSixelDecoderMin(height, iTermSixelDecoderMaximumDimension);
+    if (width <= decoder->stride && height <= decoder->rows) {
+        return true;
+    }
+    // Grow geometrically so that an image that is drawn a band at a time is copied a few times
+    // rather than once per band.
+    const int stride = iTermSixelDecoderMin(iTermSixelDecoderMaximumDimension,
+                                            iTermSixelDecoderMax(width, width > decoder->stride ? decoder->stride * 2 : decoder->stride));
+    const int rows = iTermSixelDecoderMin(iTermSixelDecoderMaximumDimension,
+                                          iTermSixelDecoderMax(height, height > decoder->rows ? decoder->rows * 2 : decoder->rows));
+    if (stride == decoder->stride) {
+        unsigned char *pixels = realloc(decoder->pixels, (size_t)stride * rows);
+        if (!pixels) {
+            return false;
+        }
+        memset(pixels + (size_t)stride * decoder->rows, 0, (size_t)stride * (rows - decoder->rows));
+        decoder->pixels = pixels;
+        decoder->rows = rows;
+        return true;
+    }
+    unsigned char *pixels = calloc((size_t)stride * rows, 1);
+    if (!pixels) {
+        return false;
+    }
+    for (int y = 0; y < decoder->rows; y++) {
+        memcpy(pixels + (size_t)y * stride, decoder->pixels + (size_t)y * decoder->stride, decoder->stride);
+    }
+    free(decoder->pixels);
+    decoder->pixels = pixels;
+    decoder->stride = stride;
+    decoder->rows = rows;
+    return true;
+}
+
+static bool iTermSixelDecoderDrawSixel(iTermSixelDecoder *decoder, int bits) {
+    const int count = decoder->repeatCount;
+    decoder->repeatCount = 1;
+    if (bits == 0) {
+        decoder->x = iTermSixelDecoderMin(decoder->x + count, iTermSixelDecoderMaximumDimension);
+        return true;
+    }
+    if (!iTermSixelDecoderReserve(decoder, decoder->x + count, decoder->y + 6)) {
+        return false;
+    }
+    const int left = decoder->x;
+    const int right = iTermSixelDecoderMin(decoder->x + count, decoder->stride);
+    for (int i = 0; i < 6; i++) {
+        const int y = decoder->y + i;
+        if (!(bits & (1 << i)) || y >= decoder->rows || left >= right) {
+            continue;
+        }
+        memset(decoder->pixels + (size_t)y * decoder->stride + left, decoder->colorIndex, right - left);
+        decoder->maxX = iTermSixelDecoderMax(decoder->maxX, right - 1);
+        decoder->maxY = iTermSixelDecoderMax(decoder->maxY, y);
+    }
+    decoder->x = iTermSixelDecoderMin(decoder->x + count, iTermSixelDecoderMaximumDimension);
+    return true;
+}
+
+#pragma mark - Parsing
+
+static void iTermSixelDecoderAddParameter(iTermSixelDecoder *decoder) {
+    if (decoder->numberOfParams < iTermSixelDecoderMaximumParameters) {
+        decoder->params[decoder->numberOfParams++] = iTermSixelDecoderMax(0, decoder->param);
+    }
+    decoder->param = 0;
+}
+
+static void iTermSixelDecoderAddDigit(iTermSixelDecoder *decoder, unsigned char c) {
+    decoder->param = iTermSixelDecoderMin(iTermSixelDecoderMaximumParameterValue,
+                                          iTermSixelDecoderMax(0, decoder->param) * 10 + (c - '0'));
+}
+
+static void iTermSixelDecoderBeginParameters(iTermSixelDecoder *decoder, iTermSixelDecoderState state) {
+    decoder->param = 0;
+    decoder->numberOfParams = 0;
+    decoder->state = state;
+}
+
+static void iTermSixelDecoderHandleIntroducer(iTermSixelDecoder *decoder) {
+    if (decoder->param >= 0) {
+        iTermSixelDecoderAddParameter(decoder);
+    }
+    if (decoder->numberOfParams > 1 && decoder->params[1] == 1) {
+        // Pixels that aren't drawn keep whatever is behind the image.
+        decoder->palette[0] = 0;
+    }
+    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateSixel);
+}
+
+static bool iTermSixelDecoderHandleRasterAttributes(iTermSixelDecoder *decoder) {
+    iTermSixelDecoderAddParameter(decoder);
+    if (decoder->numberOfParams > 2 && decoder->params[2] > 0) {
+        decoder->declaredWidth = iTermSixelDecoderMin(decoder->params[2], iTermSixelDecoderMaximumDimension);
+    }
+    if (decoder->numberOfParams > 3 && decoder->params[3] > 0) {
+        decoder->declaredHeight = iTermSixelDecoderMin(decoder->params[3], iTermSixelDecoderMaximumDimension);
+    }
+    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateSixel);
+    return iTermSixelDecoderReserve(decoder, decoder->declaredWidth, decoder->declaredHeight);
+}
+
+static void iTermSixelDecoderHandleRepeat(iTermSixelDecoder *decoder) {
+    decoder->repeatCount = iTermSixelDecoderMax(1, decoder->param);
+    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateSixel);
+}
+
+static void iTermSixelDecoderHandleColor(iTermSixelDecoder *decoder) {
+    iTermSixelDecoderAddParameter(decoder);
+    const int *params = decoder->params;
+    if (decoder->numberOfParams > 0) {
+        decoder->colorIndex = iTermSixelDecoderMin(params[0] + 1, iTermSixelDecoderNumberOfColors - 1);
+    }
+    if (decoder->numberOfParams > 4) {
+        if (params[1] == 1) {
+            decoder->palette[decoder->colorIndex] =
+                iTermSixelDecoderRGBAFromHLS(iTermSixelDecoderMin(params[2], 360),
+                                             iTermSixelDecoderMin(params[3], 100),
+                                             iTermSixelDecoderMin(params[4], 100));
+        } else if (params[1] == 2) {
+            decoder->palette[decoder->colorIndex] =
+                iTermSixelDecoderRGBAFromPercent(iTermSixelDecoderMin(params[2], 100),
+                                                 iTermSixelDecoderMin(params[3], 100),
+                                                 iTermSixelDecoderMin(params[4], 100));
+        }
+    }
+    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateSixel);
+}
+
+// Returns false if memory ran out.
+static bool iTermSixelDecoderHandleSixelByte(iTermSixelDecoder *decoder, unsigned char c) {
+    switch (c) {
+        case 0x1b:
+            decoder->state = iTermSixelDecoderStateEscape;
+            return true;
+        case '"':
+            iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateRasterAttributes);
+            return true;
+        case '!':
+            iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateRepeat);
+            return true;
+        case '#':
+            iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateColor);
+            return true;
+        case '$':
+            // Graphics carriage return
+            decoder->x = 0;
+            return true;
+        case '-':
+            // Graphics new line
+            decoder->x = 0;
+            decoder->y = iTermSixelDecoderMin(decoder->y + 6, iTermSixelDecoderMaximumDimension);
+            return true;
+        default:
+            if (c >= '?' && c <= '~') {
+                return iTermSixelDecoderDrawSixel(decoder, c - '?');
+            }
+            return true;
+    }
+}
+
+bool iTermSixelDecoderAppend(iTermSixelDecoder *decoder, const unsigned char *bytes, size_t length) {
+    for (size_t i = 0; i < length && !decoder->failed; i++) {
+        const unsigned char c = bytes[i];
+        switch (decoder->state) {
+            case iTermSixelDecoderStateGround:
+                if (c == 0x1b) {
+                    decoder->state = iTermSixelDecoderStateEscape;
+                } else if (c == 0x90) {
+                    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateIntroducer);
+                    decoder->param = -1;
+                } else if (c == 0x9c) {
+                    decoder->state = iTermSixelDecoderStateFinished;
+                }
+                break;
+
+            case iTermSixelDecoderStateEscape:
+                if (c == '\\') {
+                    decoder->state = iTermSixelDecoderStateFinished;
+                } else if (c == 'P') {
+                    iTermSixelDecoderBeginParameters(decoder, iTermSixelDecoderStateIntroducer);
+                    decoder->param = -1;
+                }
+                break;
+
+            case iTermSixelDecoderStateIntroducer:
+                if (c == 0x1b) {
+                    decoder->state = iTermSixelDecoderStateEscape;
+                } else if (c >= '0' && c <= '9') {
+                    iTermSixelDecoderAddDigit(decoder, c);
+                } else if (c == ';') {
+                    iTermSixelDecoderAddParameter(decoder);
+                } else if (c == 'q') {
+                    iTermSixelDecoderHandleIntroducer(decoder);
+                }
+                break;
+
+            case iTermSixelDecoderStateSixel:
+                decoder->failed = !iTermSixelDecoderHandleSixelByte(decoder, c);
+                break;
+
+            case iTermSixelDecoderStateRasterAttributes:
+            case iTermSixelDecoderStateRepeat:
+            case iTermSixelDecoderStateColor:
+                if (c == 0x1b) {
+                    decoder->state = iTermSixelDecoderStateEscape;
+                    break;
+                }
+                if (c >= '0' && c <= '9') {
+                    iTermSixelDecoderAddDigit(decoder, c);
+                    break;
+                }
+                if (c == ';' && decoder->state != iTermSixelDecoderStateRepeat) {
+                    iTermSixelDecoderAddParameter(decoder);
+                    break;
+                }
+                // Any other character ends the parameters and is then handled as sixel data.
+                if (decoder->state == iTermSixelDecoderStateRasterAttributes) {
+                    decoder->failed = !iTermSixelDecoderHandleRasterAttributes(decoder);
+                } else if (decoder->state == iTermSixelDecoderStateRepeat) {
+                    iTermSixelDecoderHandleRepeat(decoder);
+                } else {
+                    iTermSixelDecoderHandleColor(decoder);
+                }
+                if (!decoder->failed) {
+                    decoder->failed = !iTermSixelDecoderHandleSixelByte(decoder, c);
+                }
+                break;
+
+            case iTermSixelDecoderStateFinished:
+                return true;
+        }
+    }
+    return !decoder->failed;
+}
+
+#pragma mark - Lifecycle
+
+iTermSixelDecoder *iTermSixelDecoderCreate(void) {
+    iTermSixelDecoder *decoder = calloc(1, sizeof(*decoder));
+    if (!decoder) {
+        return NULL;
+    }
+    decoder->repeatCount = 1;
+    // libsixel starts out drawing with color register 15.
+    decoder->colorIndex = 16;
+    iTermSixelDecoderInitializePalette(decoder);
+    if (!iTermSixelDecoderReserve(decoder, 1, 1)) {
+        free(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+void iTermSixelDecoderFree(iTermSixelDecoder *decoder) {
+    if (!decoder) {
+        return;
+    }
+    free(decoder->pixels);
+    free(decoder);
+}
+
+#pragma mark - Output
+
+int iTermSixelDecoderGetWidth(const iTermSixelDecoder *decoder) {
+    return iTermSixelDecoderMax(decoder->declaredWidth, decoder->maxX + 1);
+}
+
+int iTermSixelDecoderGetHeight(const iTermSixelDecoder *decoder) {
+    return iTermSixelDecoderMax(decoder->declaredHeight, decoder->maxY + 1);
+}
+
+bool iTermSixelDecoderHasDeclaredSize(const iTermSixelDecoder *decoder) {
+    return decoder->declaredWidth > 0 && decoder->declaredHeight > 0;
+}
+
+int iTermSixelDecoderGetNumberOfCompleteRows(const iTermSixelDecoder *decoder) {
+    if (decoder->state == iTermSixelDecoderStateFinished) {
+        return iTermSixelDecoderGetHeight(decoder);
+    }
+    return iTermSixelDecoderMin(decoder->y, iTermSixelDecoderGetHeight(decoder));
+}
+
+void iTermSixelDecoderCopyRGBA(const iTermSixelDecoder *decoder,
+                               int firstRow,
+                               int count,
+                               unsigned char *rgba) {
+    const size_t width = iTermSixelDecoderGetWidth(decoder);
+    for (int i = 0; i < count; i++) {
+        iTermSixelExpandPixels(decoder->pixels + (size_t)(firstRow + i) * decoder->stride,
+                               width,
+                               decoder->palette,
+                               (uint32_t *)(rgba + i * width * 4));
+    }
+}
+
+#pragma mark - Palette Expansion
+
+static void iTermSixelExpandPixelsScalar(const unsigned char *indices,
+                                         size_t count,
+                                         const uint32_t palette[256],
+                                         uint32_t *rgba) {
+    for (size_t i = 0; i < count; i++) {
+        rgba[i] = palette[indices[i]];
+    }
+}
+
+#if defined(__ARM_NEON)
+
+// Looks up 16 indices in a 256-entry byte table held in four 64-byte pieces. Each lookup leaves
+// lanes alone whose index is out of its piece's range, so subtracting 64 between lookups visits
+// each piece once.
+static inline uint8x16_t iTermSixelLookUp(const uint8x16x4_t table[4], uint8x16_t index) {
+    const uint8x16_t stride = vdupq_n_u8(64);
+    uint8x16_t result = vqtbl4q_u8(table[0], index);
+    index = vsubq_u8(index, stride);
+    result = vqtbx4q_u8(result, table[1], index);
+    index = vsubq_u8(index, stride);
+    result = vqtbx4q_u8(result, table[2], index);
+    index = vsubq_u8(index, stride);
+    return vqtbx4q_u8(result, table[3], index);
+}
+
+void iTermSixelExpandPixels(const unsigned char *indices,
+                            size_t count,
+                            const uint32_t palette[256],
+                            uint32_t *rgba) {
+    // One table per channel. A channel's table fills 16 vector registers, so pixels are done a
+    // strip at a time: each channel is looked up across the strip, then the channels are
+    // interleaved into RGBA.
+    uint8_t planes[4][256];
+    for (int i = 0; i < 256; i++) {
+        uint8_t bytes[4];
+        memcpy(bytes, &palette[i], sizeof(bytes));
+        for (int c = 0; c < 4; c++) {
+            planes[c][i] = bytes[c];
+        }
+    }
+    enum { iTermSixelStripLength = 256 };
+    uint8_t channels[4][iTermSixelStripLength];
+    size_t i = 0;
+    while (count - i >= 16) {
+        const size_t n = (count - i < iTermSixelStripLength) ? ((count - i) & ~(size_t)15) : iTermSixelStripLength;
+        for (int c = 0; c < 4; c++) {
+            uint8x16x4_t table[4];
+            for (int t = 0; t < 4; t++) {
+                table[t] = vld1q_u8_x4(planes[c] + 64 * t);
+            }
+            for (size_t j = 0; j < n; j += 16) {
+                vst1q_u8(channels[c] + j, iTermSixelLookUp(table, vld1q_u8(indices + i + j)));
+            }
+        }
+        for (size_t j = 0; j < n; j += 16) {
+            uint8x16x4_t pixels;
+            for (int c = 0; c < 4; c++) {
+                pixels.val[c] = vld1q_u8(channels[c] + j);
+            }
+            vst4q_u8((uint8_t *)(rgba + i + j), pixels);
+        }
+        i += n;
+    }
+    iTermSixelExpandPixelsScalar(indices + i, count - i, palette, rgba + i);
+}
+
+#elif defined(__x86_64__)
+
+__attribute__((target("avx2")))
+static void iTermSixelExpandPixelsAVX2(const unsigned char *indices,
+                                       size_t count,
+                                       const uint32_t palette[256],
+                                       uint32_t *rgba) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indices + i)));
+        const __m256i pixels = _mm256_i32gather_epi32((const int *)palette, index, 4);
+        _mm256_storeu_si256((__m256i *)(rgba + i), pixels);
+    }
+    iTermSixelExpandPixelsScalar(indices + i, count - i, palette, rgba + i);
+}
+
+static bool iTermSixelHasAVX2(void) {
+    static int hasAVX2 = -1;
+    if (hasAVX2 < 0) {
+        int value = 0;
+        size_t size = sizeof(value);
+        hasAVX2 = (sysctlbyname("hw.optional.avx2_0", &value, &size, NULL, 0) == 0 && value);
+    }
+    return hasAVX2;
+}
+
+void iTermSixelExpandPixels(const unsigned char *indices,
+                            size_t count,
+                            const uint32_t palette[256],
+                            uint32_t *rgba) {
+    if (iTermSixelHasAVX2()) {
+        iTermSixelExpandPixelsAVX2(indices, count, palette, rgba);
+    } else {
+        iTermSixelExpandPixelsScalar(indices, count, palette, rgba);
+    }
+}
+
+#else
+
+void iTermSixelExpandPixels(const unsigned char *indices,
+                            size_t count,
+                            const uint32_t palette[256],
+                            uint32_t *rgba) {
+    iTermSixelExpandPixelsScalar(indices, count, palette, rgba);
+}
+
+#endif
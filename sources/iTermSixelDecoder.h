@@ -0,0 +1,62 @@
+//
+//  iTermSixelDecoder.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#ifndef iTermSixelDecoder_h
+#define iTermSixelDecoder_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Decodes DEC sixel graphics incrementally. Data may be appended in pieces split anywhere. Sixels
+// are drawn in bands six pixels tall from the top down, so once a graphics new line ends a band its
+// rows are never drawn on again and can be shown while the rest of the image is still arriving.
+// Only redefining a color register afterwards changes how they look.
+//
+// The interpretation follows libsixel, which was used before: color registers 0-15 start out with
+// the VT340 colors, 16-231 with a 6x6x6 cube and the rest with a gray ramp, and pixels that are
+// never drawn have the background color. That is black unless P2 of the introducer is 1, which
+// makes it transparent.
+typedef struct iTermSixelDecoder iTermSixelDecoder;
+
+// Pixels beyond this many in either dimension are clipped.
+extern const int iTermSixelDecoderMaximumDimension;
+
+iTermSixelDecoder *iTermSixelDecoderCreate(void);
+void iTermSixelDecoderFree(iTermSixelDecoder *decoder);
+
+// Consumes the DCS introducer (ESC P P1;P2;P3 q), the sixel data, and the string terminator.
+// Anything after the string terminator is ignored. Returns false if memory ran out, after which
+// the decoder ignores its input.
+bool iTermSixelDecoderAppend(iTermSixelDecoder *decoder, const unsigned char *bytes, size_t length);
+
+// The size of the image if no more data were to arrive: that given by the raster attributes, or
+// the extent of the pixels drawn so far if it is larger. Always at least 1x1.
+int iTermSixelDecoderGetWidth(const iTermSixelDecoder *decoder);
+int iTermSixelDecoderGetHeight(const iTermSixelDecoder *decoder);
+
+// Did the raster attributes give both a width and a height?
+bool iTermSixelDecoderHasDeclaredSize(const iTermSixelDecoder *decoder);
+
+// Number of rows at the top of the image that belong to bands that have ended.
+int iTermSixelDecoderGetNumberOfCompleteRows(const iTermSixelDecoder *decoder);
+
+// Writes `count` rows starting at `firstRow` in the current colors, as four bytes of RGBA per
+// pixel and iTermSixelDecoderGetWidth() pixels per row. The rows must be within the height.
+void iTermSixelDecoderCopyRGBA(const iTermSixelDecoder *decoder,
+                               int firstRow,
+                               int count,
+                               unsigned char *rgba);
+
+// Replaces each palette index with its RGBA word. Uses NEON table lookups on arm64 and AVX2
+// gathers on x86-64 processors that have them.
+void iTermSixelExpandPixels(const unsigned char *indices,
+                            size_t count,
+                            const uint32_t palette[256],
+                            uint32_t *rgba);
+
+#endif /* iTermSixelDecoder_h */
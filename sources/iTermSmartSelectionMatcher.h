@@ -0,0 +1,37 @@
+//
+//  iTermSmartSelectionMatcher.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A set of smart selection rules with their regexes compiled. Get one with +matcherForRules:,
+// which compiles a rule set only the first time it is seen.
+@interface iTermSmartSelectionMatcher : NSObject
+
++ (instancetype)matcherForRules:(NSArray<NSDictionary *> *)rules;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Calls `block` for each rule match in `string` that contains `targetOffset`, along with its
+// score. For each rule, a search begins at each offset up to `targetOffset` as though the string
+// began there, so ^ and lookbehinds can't see text before it. After a match that contains the
+// target, the next search begins at its end. Rules without actions are skipped if
+// `actionRequired` is set.
+- (void)enumerateMatchesInString:(NSString *)string
+                containingOffset:(NSInteger)targetOffset
+                  actionRequired:(BOOL)actionRequired
+                           block:(void (^ NS_NOESCAPE)(NSDictionary *rule,
+                                                       NSTextCheckingResult *match,
+                                                       double score))block;
+
+// The full match followed by each capture group, with @"" for groups that did not participate.
+- (NSArray<NSString *> *)componentsOfMatch:(NSTextCheckingResult *)match inString:(NSString *)string;
+
+@end
+
+NS_ASSUME_NONNULL_END
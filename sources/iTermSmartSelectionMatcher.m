@@ -0,0 +1,134 @@
+//
+//  iTermSmartSelectionMatcher.m
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermSmartSelectionMatcher.h"
+
+#import "DebugLogging.h"
+#import "SmartSelectionController.h"
+
+@interface iTermCompiledSmartSelectionRule : NSObject
+@property (nonatomic, retain) NSDictionary *rule;
+@property (nonatomic, retain) NSRegularExpression *regex;
+@property (nonatomic) double precision;
+@property (nonatomic) BOOL hasActions;
+@end
+
+@implementation iTermCompiledSmartSelectionRule
+
+- (void)dealloc {
+    [_rule release];
+    [_regex release];
+    [super dealloc];
+}
+
+@end
+
+@implementation iTermSmartSelectionMatcher {
+    NSArray<iTermCompiledSmartSelectionRule *> *_compiledRules;
+}
+
++ (instancetype)matcherForRules:(NSArray<NSDictionary *> *)rules {
+    static NSCache<NSArray *, iTermSmartSelectionMatcher *> *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc] init];
+        // Each profile can have its own rules, but few are in use at once.
+        cache.countLimit = 16;
+    });
+    iTermSmartSelectionMatcher *matcher = [cache objectForKey:rules];
+    if (!matcher) {
+        matcher = [[[self alloc] initWithRules:rules] autorelease];
+        [cache setObject:matcher forKey:[[rules copy] autorelease]];
+    }
+    return matcher;
+}
+
+- (instancetype)initWithRules:(NSArray<NSDictionary *> *)rules {
+    self = [super init];
+    if (self) {
+        NSMutableArray<iTermCompiledSmartSelectionRule *> *compiledRules = [NSMutableArray array];
+        for (NSDictionary *rule in rules) {
+            NSString *pattern = [SmartSelectionController regexInRule:rule];
+            if (!pattern.length) {
+                // Can't match anything of nonzero length.
+                continue;
+            }
+            NSError *error = nil;
+            NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:pattern
+                                                                                   options:0
+                                                                                     error:&error];
+            if (!regex) {
+                DLog(@"Ignore smart selection rule with bad regex %@: %@", pattern, error);
+                continue;
+            }
+            iTermCompiledSmartSelectionRule *compiledRule = [[[iTermCompiledSmartSelectionRule alloc] init] autorelease];
+            compiledRule.rule = rule;
+            compiledRule.regex = regex;
+            compiledRule.precision = [SmartSelectionController precisionInRule:rule];
+            compiledRule.hasActions = [[SmartSelectionController actionsInRule:rule] count] > 0;
+            [compiledRules addObject:compiledRule];
+        }
+        _compiledRules = [compiledRules copy];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_compiledRules release];
+    [super dealloc];
+}
+
+- (void)enumerateMatchesInString:(NSString *)string
+                containingOffset:(NSInteger)targetOffset
+                  actionRequired:(BOOL)actionRequired
+                           block:(void (^ NS_NOESCAPE)(NSDictionary *rule,
+                                                       NSTextCheckingResult *match,
+                                                       double score))block {
+    const NSUInteger length = string.length;
+    if (targetOffset < 0 || targetOffset >= length) {
+        return;
+    }
+    for (iTermCompiledSmartSelectionRule *compiledRule in _compiledRules) {
+        if (actionRequired && !compiledRule.hasActions) {
+            DLog(@"Ignore smart selection rule because it has no action: %@", compiledRule.rule);
+            continue;
+        }
+        NSUInteger start = 0;
+        while (start <= targetOffset) {
+            // Without NSMatchingWithTransparentBounds or NSMatchingWithoutAnchoringBounds, this
+            // behaves as though the string began at `start`.
+            NSTextCheckingResult *match = [compiledRule.regex firstMatchInString:string
+                                                                         options:0
+                                                                           range:NSMakeRange(start, length - start)];
+            if (!match) {
+                break;
+            }
+            const NSRange range = match.range;
+            if (range.location <= targetOffset && NSMaxRange(range) > targetOffset) {
+                block(compiledRule.rule, match, compiledRule.precision * range.length);
+                start = NSMaxRange(range);
+            } else {
+                start = range.location + 1;
+            }
+        }
+    }
+}
+
+- (NSArray<NSString *> *)componentsOfMatch:(NSTextCheckingResult *)match inString:(NSString *)string {
+    NSMutableArray<NSString *> *components = [NSMutableArray arrayWithCapacity:match.numberOfRanges];
+    for (NSUInteger i = 0; i < match.numberOfRanges; i++) {
+        const NSRange range = [match rangeAtIndex:i];
+        if (range.location == NSNotFound) {
+            [components addObject:@""];
+        } else {
+            [components addObject:[string substringWithRange:range]];
+        }
+    }
+    return components;
+}
+
+@end
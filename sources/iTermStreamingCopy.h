@@ -0,0 +1,34 @@
+//
+//  iTermStreamingCopy.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+@class iTermStreamingTextExtractor;
+
+// Copies text too big to build as one string. The pasteboard is claimed at once with a promise,
+// so nothing stale can be pasted, while the extractor streams the text into a temporary file. When
+// the pasteboard asks for the data, extraction is finished synchronously if it hasn't finished
+// yet, and the file is handed over memory-mapped.
+//
+// The object keeps itself alive as long as it owns the pasteboard. If extraction fails or is
+// canceled while it still owns the pasteboard, the pasteboard is cleared.
+@interface iTermStreamingCopy : NSObject<NSPasteboardItemDataProvider>
+
+// Called on the main thread when extraction ends. `completed` is NO if it failed or was canceled.
+@property(nonatomic, copy) void (^completion)(BOOL completed);
+
+// Returns nil if the temporary file can't be created. Configure the extractor and add its ranges
+// before calling -writeToPasteboard:.
+- (instancetype)initWithExtractor:(iTermStreamingTextExtractor *)extractor NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Clears the pasteboard, promises plain text, and starts extracting.
+- (void)writeToPasteboard:(NSPasteboard *)pasteboard;
+
+- (void)cancel;
+
+@end
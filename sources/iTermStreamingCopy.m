@@ -0,0 +1,153 @@
+//
+//  iTermStreamingCopy.m
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermStreamingCopy.h"
+
+#import "DebugLogging.h"
+#import "iTermStreamingTextExtractor.h"
+
+@implementation iTermStreamingCopy {
+    iTermStreamingTextExtractor *_extractor;
+    NSString *_path;
+    NSFileHandle *_fileHandle;
+    NSPasteboard *_pasteboard;
+    NSInteger _changeCount;
+    // Set while we own the pasteboard, balanced by a release when the pasteboard is done with us.
+    BOOL _retainedForPasteboard;
+    BOOL _finished;
+    BOOL _completed;
+    // Set while providing data, so a failure then doesn't clear the pasteboard out from under it.
+    BOOL _providing;
+}
+
+- (instancetype)initWithExtractor:(iTermStreamingTextExtractor *)extractor {
+    self = [super init];
+    if (self) {
+        NSString *template = [NSTemporaryDirectory() stringByAppendingPathComponent:@"iTerm2-copy.XXXXXX"];
+        char *path = strdup(template.fileSystemRepresentation);
+        // mkstemp creates the file readable only by the user.
+        const int fd = mkstemp(path);
+        if (fd < 0) {
+            DLog(@"Can't create temporary file for copy: %s", strerror(errno));
+            free(path);
+            [self release];
+            return nil;
+        }
+        _path = [[[NSFileManager defaultManager] stringWithFileSystemRepresentation:path
+                                                                             length:strlen(path)] copy];
+        free(path);
+        _fileHandle = [[NSFileHandle alloc] initWithFileDescriptor:fd closeOnDealloc:YES];
+        _extractor = [extractor retain];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    DLog(@"Remove %@", _path);
+    [_extractor release];
+    [_fileHandle release];
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+    [_path release];
+    [_pasteboard release];
+    [_completion release];
+    [super dealloc];
+}
+
+#pragma mark - APIs
+
+- (void)writeToPasteboard:(NSPasteboard *)pasteboard {
+    assert(!_pasteboard);
+    DLog(@"Promise streaming copy to %@ via %@", pasteboard, _path);
+    _pasteboard = [pasteboard retain];
+    [pasteboard clearContents];
+    NSPasteboardItem *item = [[[NSPasteboardItem alloc] init] autorelease];
+    [item setDataProvider:self forTypes:@[ NSPasteboardTypeString ]];
+    if ([pasteboard writeObjects:@[ item ]]) {
+        _changeCount = pasteboard.changeCount;
+        _retainedForPasteboard = YES;
+        [self retain];
+    } else {
+        DLog(@"Failed to write promise to pasteboard");
+    }
+
+    NSFileHandle *fileHandle = _fileHandle;
+    [_extractor startWithSink:^BOOL(NSData *data) {
+        @try {
+            [fileHandle writeData:data];
+        } @catch (NSException *exception) {
+            DLog(@"Failed to write copied text: %@", exception);
+            return NO;
+        }
+        return YES;
+    } completion:^(BOOL completed) {
+        [self extractionDidFinish:completed];
+    }];
+}
+
+- (void)cancel {
+    [_extractor cancel];
+}
+
+#pragma mark - Private
+
+- (void)extractionDidFinish:(BOOL)completed {
+    DLog(@"Streaming copy finished. completed=%@", @(completed));
+    _finished = YES;
+    _completed = completed;
+    [_fileHandle closeFile];
+    if (!completed && !_providing && [self ownsPasteboard]) {
+        DLog(@"Clear pasteboard after failed copy");
+        // This causes -pasteboardFinishedWithDataProvider: to be called.
+        [_pasteboard clearContents];
+    }
+    void (^completion)(BOOL) = [[_completion retain] autorelease];
+    [_completion release];
+    _completion = nil;
+    if (completion) {
+        completion(completed);
+    }
+}
+
+- (BOOL)ownsPasteboard {
+    return _retainedForPasteboard && _pasteboard.changeCount == _changeCount;
+}
+
+#pragma mark - NSPasteboardItemDataProvider
+
+- (void)pasteboard:(NSPasteboard *)pasteboard item:(NSPasteboardItem *)item provideDataForType:(NSPasteboardType)type {
+    DLog(@"Provide %@ for streaming copy. finished=%@", type, @(_finished));
+    _providing = YES;
+    if (!_finished) {
+        [_extractor finishSynchronously];
+    }
+    _providing = NO;
+    if (!_completed) {
+        DLog(@"No data to provide");
+        return;
+    }
+    NSError *error = nil;
+    NSData *data = [NSData dataWithContentsOfFile:_path
+                                          options:NSDataReadingMappedIfSafe
+                                            error:&error];
+    if (!data) {
+        DLog(@"Can't read %@: %@", _path, error);
+        return;
+    }
+    DLog(@"Providing %@ bytes", @(data.length));
+    [item setData:data forType:type];
+}
+
+- (void)pasteboardFinishedWithDataProvider:(NSPasteboard *)pasteboard {
+    DLog(@"Pasteboard finished with streaming copy");
+    [_extractor cancel];
+    if (_retainedForPasteboard) {
+        _retainedForPasteboard = NO;
+        [self autorelease];
+    }
+}
+
+@end
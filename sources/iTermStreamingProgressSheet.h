@@ -0,0 +1,28 @@
+//
+//  iTermStreamingProgressSheet.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+// A sheet with a progress bar and a Cancel button for long-running work such as streaming a huge
+// selection. It appears only if the work is still going after a moment, so quick jobs don't flash
+// it.
+@interface iTermStreamingProgressSheet : NSObject
+
+// Fraction done, from 0 to 1.
+@property(nonatomic, assign) double progress;
+
+// `cancelHandler` is called on the main thread if the user presses Cancel. If `window` is nil no
+// sheet is shown.
+- (instancetype)initWithMessage:(NSString *)message
+                         window:(NSWindow *)window
+                  cancelHandler:(void (^)(void))cancelHandler NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Removes the sheet, or keeps it from appearing. Call when the work ends.
+- (void)close;
+
+@end
@@ -0,0 +1,120 @@
+//
+//  iTermStreamingProgressSheet.m
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermStreamingProgressSheet.h"
+
+#import "DebugLogging.h"
+
+// How long to wait before showing the sheet.
+static const NSTimeInterval kStreamingProgressSheetDelay = 0.5;
+
+@implementation iTermStreamingProgressSheet {
+    NSString *_message;
+    NSWindow *_window;
+    void (^_cancelHandler)(void);
+    NSPanel *_panel;
+    NSProgressIndicator *_indicator;
+    BOOL _closed;
+}
+
+- (instancetype)initWithMessage:(NSString *)message
+                         window:(NSWindow *)window
+                  cancelHandler:(void (^)(void))cancelHandler {
+    self = [super init];
+    if (self) {
+        _message = [message copy];
+        _window = [window retain];
+        _cancelHandler = [cancelHandler copy];
+        if (_window) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kStreamingProgressSheetDelay * NSEC_PER_SEC)),
+                           dispatch_get_main_queue(), ^{
+                               [self show];
+                           });
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_message release];
+    [_window release];
+    [_cancelHandler release];
+    [_panel release];
+    [_indicator release];
+    [super dealloc];
+}
+
+#pragma mark - APIs
+
+- (void)setProgress:(double)progress {
+    _progress = progress;
+    _indicator.doubleValue = progress;
+}
+
+- (void)close {
+    if (_closed) {
+        return;
+    }
+    _closed = YES;
+    [_cancelHandler release];
+    _cancelHandler = nil;
+    if (_panel) {
+        DLog(@"Close progress sheet “%@”", _message);
+        [_window endSheet:_panel];
+        [_panel orderOut:nil];
+    }
+}
+
+#pragma mark - Private
+
+- (void)show {
+    if (_closed || !_window.isVisible) {
+        return;
+    }
+    DLog(@"Show progress sheet “%@”", _message);
+    const CGFloat margin = 20;
+    const CGFloat width = 360;
+    _panel = [[NSPanel alloc] initWithContentRect:NSMakeRect(0, 0, width, 112)
+                                        styleMask:NSWindowStyleMaskTitled
+                                          backing:NSBackingStoreBuffered
+                                            defer:YES];
+    _panel.releasedWhenClosed = NO;
+
+    NSTextField *label = [NSTextField labelWithString:_message];
+    label.frame = NSMakeRect(margin, 72, width - margin * 2, 20);
+    [_panel.contentView addSubview:label];
+
+    _indicator = [[NSProgressIndicator alloc] initWithFrame:NSMakeRect(margin, 48, width - margin * 2, 20)];
+    _indicator.style = NSProgressIndicatorStyleBar;
+    _indicator.indeterminate = NO;
+    _indicator.minValue = 0;
+    _indicator.maxValue = 1;
+    _indicator.doubleValue = _progress;
+    [_panel.contentView addSubview:_indicator];
+
+    NSButton *button = [NSButton buttonWithTitle:@"Cancel" target:self action:@selector(cancel:)];
+    button.keyEquivalent = @"\e";
+    [button sizeToFit];
+    button.frame = NSMakeRect(width - margin - NSWidth(button.frame),
+                              12,
+                              NSWidth(button.frame),
+                              NSHeight(button.frame));
+    [_panel.contentView addSubview:button];
+
+    [_window beginSheet:_panel completionHandler:nil];
+}
+
+- (void)cancel:(id)sender {
+    DLog(@"User canceled “%@”", _message);
+    void (^cancelHandler)(void) = [[_cancelHandler retain] autorelease];
+    [self close];
+    if (cancelHandler) {
+        cancelHandler();
+    }
+}
+
+@end
@@ -0,0 +1,62 @@
+//
+//  iTermStreamingTextExtractor.h
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "iTermTextExtractor.h"
+#import "VT100GridTypes.h"
+
+@class iTermSelection;
+
+// Extracts the plain text of ranges that may span millions of lines without building one string
+// for all of it. The data source isn't thread-safe, so the main thread copies a chunk of lines at a
+// time, letting the run loop turn between chunks. Their text is extracted, encoded, and handed to
+// the sink on a background queue. Only one chunk is in flight at a time, so memory use doesn't
+// depend on the size of the ranges.
+//
+// Ranges use absolute line numbers. If lines are lost to scrollback before they are reached,
+// extraction continues from the first line still available and `linesWereLost` is set.
+@interface iTermStreamingTextExtractor : NSObject
+
+// These have the same meaning as in -[iTermTextExtractor contentInRange:...]. Set them before
+// starting.
+@property(nonatomic, assign) iTermTextExtractorNullPolicy nullPolicy;
+@property(nonatomic, assign) BOOL includeLastNewline;
+@property(nonatomic, assign) BOOL trimTrailingWhitespace;
+
+// Defaults to UTF-8. Characters that can't be represented are converted lossily.
+@property(nonatomic, assign) NSStringEncoding encoding;
+
+// Called on the main thread after each chunk with the fraction of lines extracted so far.
+@property(nonatomic, copy) void (^progressHandler)(double fraction);
+
+@property(nonatomic, readonly) BOOL linesWereLost;
+
+- (instancetype)initWithDataSource:(id<iTermTextDataSource>)dataSource NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Adds a range to extract after those already added. If `eol` is set, a newline follows the
+// range's text unless it already ends in one.
+- (void)addRange:(VT100GridAbsWindowedRange)range eol:(BOOL)eol;
+
+// Adds each range of the selection.
+- (void)addRangesFromSelection:(iTermSelection *)selection;
+
+// Begins extracting. `sink` is called on a background queue with each chunk of encoded text, in
+// order; it returns NO to stop. `completion` is called on the main thread after the last call to
+// `sink`. `completed` is NO if the sink stopped or the extractor was canceled.
+- (void)startWithSink:(BOOL (^)(NSData *data))sink
+           completion:(void (^)(BOOL completed))completion;
+
+// Stops before the next chunk. The completion block is still called.
+- (void)cancel;
+
+// Extracts whatever remains, blocking the main thread until the sink has received all of it, then
+// calls the completion block. Use this when the text is needed right away, as when a pasteboard
+// asks for data that is still being extracted. Does nothing if not started or already finished.
+- (void)finishSynchronously;
+
+@end
@@ -0,0 +1,362 @@
+//
+//  iTermStreamingTextExtractor.m
+//  iTerm2
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermStreamingTextExtractor.h"
+
+#import "DebugLogging.h"
+#import "iTermSelection.h"
+
+// Lines per chunk. Copying this many takes well under a millisecond.
+static const int kStreamingTextExtractorLinesPerChunk = 1000;
+
+typedef struct {
+    VT100GridAbsWindowedRange range;
+    BOOL eol;
+} iTermStreamingTextExtractorRange;
+
+// What to extract from a snapshot, decided on the main thread.
+typedef struct {
+    // Relative to the snapshot's lines.
+    VT100GridWindowedRange range;
+    BOOL includeLastNewline;
+    BOOL trimTrailingWhitespace;
+    // Is this the first chunk of its range?
+    BOOL beginsRange;
+    // Is this the last chunk of a range that should end in a newline?
+    BOOL eol;
+} iTermStreamingTextExtractorChunk;
+
+// A copy of some consecutive lines of a data source, so their text can be extracted on a
+// background queue. Line numbers start at 0 with the first line copied, and the scrollback overflow
+// is adjusted so absolute line numbers are unchanged.
+@interface iTermStreamingTextExtractorSnapshot : NSObject<iTermTextDataSource>
+- (instancetype)initWithDataSource:(id<iTermTextDataSource>)dataSource
+                         firstLine:(int)firstLine
+                             count:(int)count;
+@end
+
+@implementation iTermStreamingTextExtractorSnapshot {
+    // One extra line of nulls at the end stands in for lines out of range.
+    NSMutableData *_lines;
+    int _width;
+    int _numberOfLines;
+    long long _totalScrollbackOverflow;
+}
+
+- (instancetype)initWithDataSource:(id<iTermTextDataSource>)dataSource
+                         firstLine:(int)firstLine
+                             count:(int)count {
+    self = [super init];
+    if (self) {
+        _width = [dataSource width];
+        _numberOfLines = count;
+        _totalScrollbackOverflow = [dataSource totalScrollbackOverflow] + firstLine;
+        const size_t lineSize = (_width + 1) * sizeof(screen_char_t);
+        _lines = [[NSMutableData alloc] initWithLength:(count + 1) * lineSize];
+        unsigned char *bytes = _lines.mutableBytes;
+        for (int i = 0; i < count; i++) {
+            memcpy(bytes + i * lineSize, [dataSource getLineAtIndex:firstLine + i], lineSize);
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_lines release];
+    [super dealloc];
+}
+
+- (int)width {
+    return _width;
+}
+
+- (int)numberOfLines {
+    return _numberOfLines;
+}
+
+- (long long)totalScrollbackOverflow {
+    return _totalScrollbackOverflow;
+}
+
+- (screen_char_t *)getLineAtIndex:(int)theIndex {
+    if (theIndex < 0 || theIndex >= _numberOfLines) {
+        theIndex = _numberOfLines;
+    }
+    screen_char_t *lines = _lines.mutableBytes;
+    return lines + theIndex * (_width + 1);
+}
+
+@end
+
+@implementation iTermStreamingTextExtractor {
+    id<iTermTextDataSource> _dataSource;
+
+    // Array of iTermStreamingTextExtractorRange.
+    NSMutableData *_ranges;
+    // Index into _ranges of the range being extracted.
+    NSUInteger _rangeIndex;
+    // Absolute line number where the next chunk of the current range begins.
+    long long _nextLine;
+
+    long long _totalLines;
+    long long _linesDone;
+
+    dispatch_queue_t _queue;
+    // These are only accessed on _queue.
+    // Did the current range's text so far end in a newline?
+    BOOL _endsInNewline;
+    BOOL _sinkStopped;
+
+    BOOL (^_sink)(NSData *);
+    void (^_completion)(BOOL);
+    BOOL _started;
+    BOOL _cancelled;
+    BOOL _finished;
+}
+
+- (instancetype)initWithDataSource:(id<iTermTextDataSource>)dataSource {
+    self = [super init];
+    if (self) {
+        _dataSource = [dataSource retain];
+        _ranges = [[NSMutableData alloc] init];
+        _nullPolicy = kiTermTextExtractorNullPolicyMidlineAsSpaceIgnoreTerminal;
+        _encoding = NSUTF8StringEncoding;
+        _nextLine = LLONG_MIN;
+        _queue = dispatch_queue_create("com.iterm2.streaming-text-extractor", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_dataSource release];
+    [_ranges release];
+    [_progressHandler release];
+    [_sink release];
+    [_completion release];
+    dispatch_release(_queue);
+    [super dealloc];
+}
+
+#pragma mark - APIs
+
+- (void)addRange:(VT100GridAbsWindowedRange)range eol:(BOOL)eol {
+    assert(!_started);
+    iTermStreamingTextExtractorRange value = { .range = range, .eol = eol };
+    [_ranges appendBytes:&value length:sizeof(value)];
+    _totalLines += MAX(0, range.coordRange.end.y - range.coordRange.start.y + 1);
+}
+
+- (void)addRangesFromSelection:(iTermSelection *)selection {
+    [selection enumerateSelectedAbsoluteRanges:^(VT100GridAbsWindowedRange range, BOOL *stop, BOOL eol) {
+        [self addRange:range eol:eol];
+    }];
+}
+
+- (void)startWithSink:(BOOL (^)(NSData *))sink completion:(void (^)(BOOL))completion {
+    assert(!_started);
+    _started = YES;
+    _sink = [sink copy];
+    _completion = [completion copy];
+    DLog(@"Begin streaming %lld lines in %d ranges",
+         _totalLines, (int)(_ranges.length / sizeof(iTermStreamingTextExtractorRange)));
+    [self extractNextChunk];
+}
+
+- (void)cancel {
+    DLog(@"Cancel streaming extraction");
+    _cancelled = YES;
+}
+
+- (void)finishSynchronously {
+    if (!_started || _finished) {
+        return;
+    }
+    DLog(@"Finish streaming extraction synchronously");
+    // Let the chunk in flight reach the sink. When it calls back to extract the next chunk it will
+    // find the extractor finished.
+    dispatch_sync(_queue, ^{});
+    __block BOOL ok = !_sinkStopped;
+    while (ok && !_cancelled) {
+        iTermStreamingTextExtractorChunk chunk;
+        iTermStreamingTextExtractorSnapshot *snapshot = [self nextChunk:&chunk];
+        if (!snapshot) {
+            break;
+        }
+        dispatch_sync(_queue, ^{
+            ok = [self writeChunk:chunk snapshot:snapshot];
+        });
+    }
+    [self finishWithSuccess:ok && !_cancelled];
+}
+
+#pragma mark - Private
+
+- (void)extractNextChunk {
+    if (_finished) {
+        return;
+    }
+    if (_cancelled) {
+        [self finishWithSuccess:NO];
+        return;
+    }
+    iTermStreamingTextExtractorChunk chunk;
+    iTermStreamingTextExtractorSnapshot *snapshot = [self nextChunk:&chunk];
+    if (!snapshot) {
+        // Wait for writes already queued before finishing.
+        dispatch_async(_queue, ^{
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self finishWithSuccess:YES];
+            });
+        });
+        return;
+    }
+    if (_progressHandler && _totalLines > 0) {
+        _progressHandler(MIN(1.0, (double)_linesDone / _totalLines));
+    }
+    dispatch_async(_queue, ^{
+        const BOOL ok = [self writeChunk:chunk snapshot:snapshot];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (ok) {
+                [self extractNextChunk];
+            } else {
+                DLog(@"Sink stopped streaming extraction");
+                [self finishWithSuccess:NO];
+            }
+        });
+    });
+}
+
+- (void)finishWithSuccess:(BOOL)success {
+    if (_finished) {
+        return;
+    }
+    _finished = YES;
+    DLog(@"Streaming extraction finished. success=%@ linesWereLost=%@", @(success), @(_linesWereLost));
+    void (^completion)(BOOL) = [[_completion retain] autorelease];
+    [_completion release];
+    _completion = nil;
+    [_sink release];
+    _sink = nil;
+    if (completion) {
+        completion(success);
+    }
+}
+
+// Runs on _queue. Extracts the text of a chunk, encodes it, and hands it to the sink. Returns NO
+// if the sink stopped.
+- (BOOL)writeChunk:(iTermStreamingTextExtractorChunk)chunk
+          snapshot:(iTermStreamingTextExtractorSnapshot *)snapshot {
+    if (_sinkStopped) {
+        return NO;
+    }
+    if (chunk.beginsRange) {
+        _endsInNewline = NO;
+    }
+    iTermTextExtractor *extractor = [iTermTextExtractor textExtractorWithDataSource:snapshot];
+    NSString *content =
+        [extractor contentInRange:chunk.range
+                attributeProvider:nil
+                       nullPolicy:_nullPolicy
+                              pad:NO
+               includeLastNewline:chunk.includeLastNewline
+           trimTrailingWhitespace:chunk.trimTrailingWhitespace
+                     cappedAtSize:-1
+                     truncateTail:YES
+                continuationChars:nil
+                           coords:nil] ?: @"";
+    if (content.length > 0) {
+        _endsInNewline = [content hasSuffix:@"\n"];
+    }
+    if (chunk.eol && !_endsInNewline) {
+        content = [content stringByAppendingString:@"\n"];
+    }
+    NSData *data = [content dataUsingEncoding:_encoding allowLossyConversion:YES];
+    if (data.length > 0 && !_sink(data)) {
+        _sinkStopped = YES;
+        return NO;
+    }
+    return YES;
+}
+
+// Copies the lines of the next chunk and describes what to extract from them. Returns nil if there
+// are none left. Only the copy is done here on the main thread; the text is extracted later on
+// _queue.
+- (iTermStreamingTextExtractorSnapshot *)nextChunk:(iTermStreamingTextExtractorChunk *)chunk {
+    const iTermStreamingTextExtractorRange *ranges = _ranges.bytes;
+    const NSUInteger count = _ranges.length / sizeof(*ranges);
+    while (_rangeIndex < count) {
+        const VT100GridAbsWindowedRange range = ranges[_rangeIndex].range;
+        const long long overflow = [_dataSource totalScrollbackOverflow];
+        const int width = [_dataSource width];
+        const int numberOfLines = [_dataSource numberOfLines];
+
+        const BOOL beginsRange = (_nextLine == LLONG_MIN);
+        long long startY = MAX(_nextLine, range.coordRange.start.y);
+        BOOL startsRange = (startY == range.coordRange.start.y);
+        if (startY < overflow) {
+            DLog(@"Lines %lld through %lld were lost before they could be extracted",
+                 startY, overflow - 1);
+            _linesWereLost = YES;
+            _linesDone += overflow - startY;
+            startY = overflow;
+            startsRange = NO;
+        }
+        const long long endY = MIN(range.coordRange.end.y, overflow + numberOfLines - 1);
+        if (startY > endY) {
+            [self advanceToNextRange];
+            continue;
+        }
+
+        // Prefer to end a chunk at a hard newline so trailing whitespace is trimmed just as it
+        // would be if the range were extracted all at once.
+        const int firstLine = (int)(startY - overflow);
+        int lastLine = (int)MIN(endY - overflow, (long long)firstLine + kStreamingTextExtractorLinesPerChunk - 1);
+        const BOOL endsRange = (lastLine + overflow == endY);
+        BOOL endsAtHardNewline = endsRange;
+        for (int y = lastLine; !endsAtHardNewline && y >= firstLine; y--) {
+            screen_char_t *line = [_dataSource getLineAtIndex:y];
+            if (line[width].code == EOL_HARD) {
+                lastLine = y;
+                endsAtHardNewline = YES;
+            }
+        }
+
+        const int left = range.columnWindow.length > 0 ? range.columnWindow.location : 0;
+        const int right = range.columnWindow.length > 0 ? range.columnWindow.location + range.columnWindow.length : width;
+        const VT100GridCoordRange coordRange =
+            VT100GridCoordRangeMake(startsRange ? range.coordRange.start.x : left,
+                                    0,
+                                    (endsRange && endY == range.coordRange.end.y) ? range.coordRange.end.x : right,
+                                    lastLine - firstLine);
+        chunk->range = VT100GridWindowedRangeMake(coordRange,
+                                                  range.columnWindow.location,
+                                                  range.columnWindow.length);
+        chunk->includeLastNewline = endsRange ? _includeLastNewline : YES;
+        chunk->trimTrailingWhitespace = endsAtHardNewline && _trimTrailingWhitespace;
+        chunk->beginsRange = beginsRange;
+        chunk->eol = endsRange && ranges[_rangeIndex].eol;
+
+        iTermStreamingTextExtractorSnapshot *snapshot =
+            [[[iTermStreamingTextExtractorSnapshot alloc] initWithDataSource:_dataSource
+                                                                   firstLine:firstLine
+                                                                       count:lastLine - firstLine + 1] autorelease];
+        _linesDone += lastLine - firstLine + 1;
+        _nextLine = lastLine + overflow + 1;
+        if (endsRange) {
+            [self advanceToNextRange];
+        }
+        return snapshot;
+    }
+    return nil;
+}
+
+- (void)advanceToNextRange {
+    _rangeIndex++;
+    _nextLine = LLONG_MIN;
+}
+
+@end
@@ -9,6 +9,7 @@
 
 #import "DebugLogging.h"
 #import "iTermAPIHelper.h"
+#import "iTermCompiledExpression.h"
 #import "iTermExpressionEvaluator.h"
 #import "iTermScriptFunctionCall.h"
 #import "iTermScriptHistory.h"
@@ -28,6 +29,12 @@
     iTermVariableScope *_scope;
     BOOL _observing;
     iTermVariableReference<NSString *> *_sourceRef;
+
+    // Newest version of any dependency at the last evaluation. NSNotFound if the result can't be
+    // reused, for example because it calls functions.
+    NSUInteger _lastDependencyVersion;
+    __weak iTermVariableScope *_lastScope;
+    NSString *_lastSwiftyString;
 }
 
 - (instancetype)initWithString:(NSString *)swiftyString
@@ -138,7 +145,35 @@
     _observing = NO;
 }
 
+// Returns the newest version of the variables the string depends on, or NSNotFound if its value
+// can depend on something else. Versions only increase, so this changes when any dependency does.
+- (NSUInteger)dependencyVersionInScope:(iTermVariableScope *)scope {
+    iTermCompiledExpression *compiled = [iTermCompiledExpression compiledInterpolatedString:_swiftyString];
+    if (compiled.containsFunctionCall) {
+        return NSNotFound;
+    }
+    NSUInteger version = 0;
+    for (NSString *path in compiled.dependencies) {
+        version = MAX(version, [scope versionForVariableName:path]);
+    }
+    return version;
+}
+
 - (void)evaluateSynchronously:(BOOL)synchronously {
+    iTermVariableScope *scope = self.scope;
+    const NSUInteger dependencyVersion = [self dependencyVersionInScope:scope];
+    if (_evaluatedString &&
+        dependencyVersion != NSNotFound &&
+        scope == _lastScope &&
+        [_swiftyString isEqualToString:_lastSwiftyString] &&
+        dependencyVersion == _lastDependencyVersion) {
+        DLog(@"%p: %@ skip evaluation because no dependency changed", self, _swiftyString);
+        return;
+    }
+    _lastDependencyVersion = dependencyVersion;
+    _lastScope = scope;
+    _lastSwiftyString = [_swiftyString copy];
+
     __weak __typeof(self) weakSelf = self;
     NSInteger count = ++_count;
     DLog(@"%p: %@->%@ evaluate %@", self, _sourceRef.path, _destinationPath, _swiftyString);
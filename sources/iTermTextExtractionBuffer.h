@@ -0,0 +1,44 @@
+//
+//  iTermTextExtractionBuffer.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+#import "VT100GridTypes.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// UTF-16 text extracted from the grid along with a parallel array giving the coord each code unit
+// came from. Characters can be added at either end in amortized constant time, which suits
+// searching backward and then forward from a point. Storage is kept across -reset, so use
+// +checkOut and -checkIn to reuse one buffer per thread instead of allocating on every hover.
+@interface iTermTextExtractionBuffer : NSObject
+@property (nonatomic, readonly) NSInteger length;
+
+// Both are `length` long and valid until the buffer is next mutated.
+@property (nonatomic, readonly) const unichar *characters NS_RETURNS_INNER_POINTER;
+@property (nonatomic, readonly) const VT100GridCoord *coords NS_RETURNS_INNER_POINTER;
+
+// Returns this thread's idle buffer, or a new one if it's already checked out.
++ (instancetype)checkOut;
+
+// Resets the buffer and makes it available to the next +checkOut on this thread.
+- (void)checkIn;
+
+- (void)reset;
+- (void)appendCharacters:(const unichar *)characters
+                  length:(NSInteger)length
+                   coord:(VT100GridCoord)coord;
+- (void)prependCharacters:(const unichar *)characters
+                   length:(NSInteger)length
+                    coord:(VT100GridCoord)coord;
+- (VT100GridCoord)coordAtIndex:(NSInteger)index;
+
+// A copy of the characters.
+- (NSString *)string;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,117 @@
+//
+//  iTermTextExtractionBuffer.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermTextExtractionBuffer.h"
+
+#import "DebugLogging.h"
+
+static NSString *const iTermTextExtractionBufferThreadDictionaryKey = @"iTermTextExtractionBuffer";
+
+// Don't keep a buffer that grew to hold something unusually large.
+static const NSInteger iTermTextExtractionBufferMaximumRetainedCapacity = 1024 * 1024;
+
+@implementation iTermTextExtractionBuffer {
+    // Content lives in [_start, _start + _length) of both arrays, leaving room to grow both ways.
+    unichar *_characters;
+    VT100GridCoord *_coords;
+    NSInteger _start;
+    NSInteger _length;
+    NSInteger _capacity;
+}
+
++ (instancetype)checkOut {
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    iTermTextExtractionBuffer *buffer = threadDictionary[iTermTextExtractionBufferThreadDictionaryKey];
+    if (buffer) {
+        [threadDictionary removeObjectForKey:iTermTextExtractionBufferThreadDictionaryKey];
+        return buffer;
+    }
+    return [[self alloc] init];
+}
+
+- (void)dealloc {
+    free(_characters);
+    free(_coords);
+}
+
+- (void)checkIn {
+    [self reset];
+    if (_capacity > iTermTextExtractionBufferMaximumRetainedCapacity) {
+        return;
+    }
+    [[NSThread currentThread] threadDictionary][iTermTextExtractionBufferThreadDictionaryKey] = self;
+}
+
+- (void)reset {
+    _start = _capacity / 2;
+    _length = 0;
+}
+
+- (const unichar *)characters {
+    return _characters + _start;
+}
+
+- (const VT100GridCoord *)coords {
+    return _coords + _start;
+}
+
+- (VT100GridCoord)coordAtIndex:(NSInteger)index {
+    ITAssertWithMessage(index >= 0 && index < _length, @"Index %@ out of bounds [0, %@)", @(index), @(_length));
+    return _coords[_start + index];
+}
+
+- (NSString *)string {
+    return [NSString stringWithCharacters:self.characters length:_length];
+}
+
+// Ensures there are at least `before` free slots before the content and `after` free slots after
+// it. When it has to grow it centers the content so both ends have room.
+- (void)reserveBefore:(NSInteger)before after:(NSInteger)after {
+    if (_start >= before && _capacity - _start - _length >= after) {
+        return;
+    }
+    const NSInteger capacity = MAX(64, MAX(_capacity * 2, (_length + before + after) * 2));
+    const NSInteger start = (capacity - _length) / 2;
+    unichar *characters = malloc(capacity * sizeof(*characters));
+    VT100GridCoord *coords = malloc(capacity * sizeof(*coords));
+    if (_length) {
+        memmove(characters + start, _characters + _start, _length * sizeof(*characters));
+        memmove(coords + start, _coords + _start, _length * sizeof(*coords));
+    }
+    free(_characters);
+    free(_coords);
+    _characters = characters;
+    _coords = coords;
+    _start = start;
+    _capacity = capacity;
+}
+
+- (void)appendCharacters:(const unichar *)characters
+                  length:(NSInteger)length
+                   coord:(VT100GridCoord)coord {
+    [self reserveBefore:0 after:length];
+    const NSInteger end = _start + _length;
+    for (NSInteger i = 0; i < length; i++) {
+        _characters[end + i] = characters[i];
+        _coords[end + i] = coord;
+    }
+    _length += length;
+}
+
+- (void)prependCharacters:(const unichar *)characters
+                   length:(NSInteger)length
+                    coord:(VT100GridCoord)coord {
+    [self reserveBefore:length after:0];
+    _start -= length;
+    for (NSInteger i = 0; i < length; i++) {
+        _characters[_start + i] = characters[i];
+        _coords[_start + i] = coord;
+    }
+    _length += length;
+}
+
+@end
@@ -179,8 +179,8 @@ extern const NSInteger kLongMaximumWordLength;
 // See comment at -contentInRange:nullPolicy:pad:includeLastNewline:trimTrailingWhitespace:cappedAtSize:continuationChars:coords:
 // If |convertNullToSpace| is YES then the string does not stop at a NULL character.
 //
-// If |coords| is non-nil it will be filled with NSValue*s in 1:1 correspondence with characters in
-// the return value, giving VT100GridCoord's with their provenance.
+// The result's gridCoords are in 1:1 correspondence with its UTF-16 code units, giving each one's
+// provenance.
 - (iTermLocatedString *)wrappedLocatedStringAt:(VT100GridCoord)coord
                                        forward:(BOOL)forward
                            respectHardNewlines:(BOOL)respectHardNewlines
@@ -8,14 +8,16 @@
 
 #import "iTermTextExtractor.h"
 #import "DebugLogging.h"
+#import "iTermGridCoordArray.h"
 #import "iTermImageInfo.h"
 #import "iTermLocatedString.h"
 #import "iTermPreferences.h"
+#import "iTermSmartSelectionMatcher.h"
 #import "iTermSystemVersion.h"
+#import "iTermTextExtractionBuffer.h"
 #import "iTermURLStore.h"
 #import "NSStringITerm.h"
 #import "NSMutableAttributedString+iTerm.h"
-#import "RegexKitLite.h"
 #import "PreferencePanel.h"
 #import "SmartMatch.h"
 #import "SmartSelectionController.h"
@@ -354,19 +356,6 @@ const NSInteger kLongMaximumWordLength = 100000;
                                                                     location.y)];
     }
 
-    // String composed of the characters found to be in the word, excluding private range characters.
-    NSMutableString *stringFromLocation = [NSMutableString string];
-    NSMutableArray *coords = [NSMutableArray array];
-
-    // Has one entry for each cell in the word before `location`. Stores the
-    // length of the string at that cell. Typically 1, but can be long for
-    // surrogate pair and composed characters.
-    NSMutableArray<NSNumber *> *stringLengthsInPrefix = [NSMutableArray array];
-
-    // Has one entry for each cell in the word after `location`. Stores the
-    // index into `stringFromLocation` where that cell's string begins.
-    NSMutableArray<NSNumber *> *indexesInSuffix = [NSMutableArray array];
-
     const int xLimit = [self xLimit];
     const int width = [_dataSource width];
     const BOOL windowTouchesLeftMargin = (_logicalWindow.location == 0);
@@ -376,6 +365,14 @@ const NSInteger kLongMaximumWordLength = 100000;
         return VT100GridWindowedRangeMake(VT100GridCoordRangeMake(-1, -1, -1, -1),
                                           _logicalWindow.location, _logicalWindow.length);
     }
+
+    // Characters found to be in the word, excluding private range characters, and the coord of the
+    // cell each came from. The search forward appends to it and the search backward prepends.
+    iTermTextExtractionBuffer *buffer = [iTermTextExtractionBuffer checkOut];
+
+    // Number of cells in the word before `location`.
+    __block NSUInteger numberOfCellsInPrefix = 0;
+
     VT100GridCoordRange theRange = VT100GridCoordRangeMake(location.x,
                                                            location.y,
                                                            width,
@@ -404,9 +401,9 @@ const NSInteger kLongMaximumWordLength = 100000;
                               if (theChar.complexChar ||
                                   theChar.code < ITERM2_PRIVATE_BEGIN ||
                                   theChar.code > ITERM2_PRIVATE_END) {
-                                  [indexesInSuffix addObject:@(stringFromLocation.length)];
-                                  [stringFromLocation appendString:(ScreenCharToStr(&theChar) ?: @"")];
-                                  [coords addObject:[NSValue valueWithGridCoord:coord]];
+                                  unichar temp[kMaxParts];
+                                  const int length = ExpandScreenChar(&theChar, temp);
+                                  [buffer appendCharacters:temp length:length coord:coord];
                               }
                           }
                           return !isInWord;
@@ -422,11 +419,6 @@ const NSInteger kLongMaximumWordLength = 100000;
     // Search backward for the start of the word.
     theRange = VT100GridCoordRangeMake(0, 0, location.x, location.y);
 
-    // We want to iterate backward over the string and concatenate characters in reverse order.
-    // Appending to the start of a NSMutableString is very slow, but appending to the start of
-    // a NSMutableArray is fast. So we build an array of tiny strings in the reverse order of how
-    // they appear and then concatenate them after the enumeration.
-    NSMutableArray *substrings = [NSMutableArray array];
     DLog(@"** Begin searching backward for the end of the word");
     iterations = 0;
     [self enumerateInReverseCharsInRange:VT100GridWindowedRangeMake(theRange,
@@ -448,11 +440,11 @@ const NSInteger kLongMaximumWordLength = 100000;
                                        DLog(@"Is in word");
                                        if (theChar.complexChar ||
                                            theChar.code < ITERM2_PRIVATE_BEGIN || theChar.code > ITERM2_PRIVATE_END) {
-                                           NSString *theString = ScreenCharToStr(&theChar);
-                                           if (theString) {
-                                               [substrings insertObject:theString atIndex:0];
-                                               [coords insertObject:[NSValue valueWithGridCoord:coord] atIndex:0];
-                                               [stringLengthsInPrefix insertObject:@(theString.length) atIndex:0];
+                                           unichar temp[kMaxParts];
+                                           const int length = ExpandScreenChar(&theChar, temp);
+                                           if (length > 0) {
+                                               [buffer prependCharacters:temp length:length coord:coord];
+                                               numberOfCellsInPrefix += 1;
                                            }
                                        }
                                    }
@@ -466,7 +458,22 @@ const NSInteger kLongMaximumWordLength = 100000;
                                                               ignoringNewlines:NO];
 
                                 }];
-    NSString *stringBeforeLocation = [substrings componentsJoinedByString:@""];
+    NSString *string = buffer.string;
+
+    // Coords of all the cells in the word, in order.
+    iTermGridCoordArray *coords = [[[iTermGridCoordArray alloc] init] autorelease];
+
+    // Will be in 1:1 correspondence with `coords`.
+    // The string in the cell at `coords[i]` starts at index `indexes[i]`.
+    NSMutableArray<NSNumber *> *indexes = [NSMutableArray array];
+    const VT100GridCoord *bufferCoords = buffer.coords;
+    for (NSInteger i = 0; i < buffer.length; i++) {
+        if (i == 0 || !VT100GridCoordEquals(bufferCoords[i], bufferCoords[i - 1])) {
+            [coords appendCoord:bufferCoords[i]];
+            [indexes addObject:@(i)];
+        }
+    }
+    [buffer checkIn];
 
     if (!coords.count) {
         DLog(@"Found no coords");
@@ -478,8 +485,8 @@ const NSInteger kLongMaximumWordLength = 100000;
 
     if (theClass != kTextExtractorClassWord || big) {
         DLog(@"Not word class");
-        VT100GridCoord start = [[coords firstObject] gridCoordValue];
-        VT100GridCoord end = [[coords lastObject] gridCoordValue];
+        VT100GridCoord start = coords.first;
+        VT100GridCoord end = coords.last;
         return [self windowedRangeWithRange:VT100GridCoordRangeMake(start.x,
                                                                     start.y,
                                                                     end.x + 1,
@@ -499,21 +506,8 @@ const NSInteger kLongMaximumWordLength = 100000;
         // wrinkle: in issue 4325 we see that 翻真的 consists of two words: 翻 and 真的. The OS
         // (presumably by using ICU's text boundary analysis code) knows how to do the segmentation.
 
-        NSString *string = [stringBeforeLocation stringByAppendingString:stringFromLocation];
         NSAttributedString *attributedString = [[[NSAttributedString alloc] initWithString:string attributes:@{}] autorelease];
 
-        // Will be in 1:1 correspondence with `coords`.
-        // The string in the cell at `coords[i]` starts at index `indexes[i]`.
-        NSMutableArray<NSNumber *> *indexes = [NSMutableArray array];
-        NSInteger prefixLength = 0;
-        for (NSNumber *length in stringLengthsInPrefix) {
-            [indexes addObject:@(prefixLength)];
-            prefixLength += length.integerValue;
-        }
-        for (NSNumber *index in indexesInSuffix) {
-            [indexes addObject:@(prefixLength + index.integerValue)];
-        }
-
         DLog(@"indexes: %@", indexes);
 
         // Set end to an index that is not in the middle of an OS-defined-word. It will be at the start
@@ -521,10 +515,10 @@ const NSInteger kLongMaximumWordLength = 100000;
         BOOL previousCharacterWasWhitelisted = YES;
 
         // `end` can index into `coords` and `indexes`.
-        NSInteger end = stringLengthsInPrefix.count;
+        NSInteger end = numberOfCellsInPrefix;
         while (end < coords.count) {
-            DLog(@"Consider end=%@ at %@", @(end), VT100GridCoordDescription([coords[end] gridCoordValue]));
-            if ([self isWhitelistedAlphanumericAtCoord:[coords[end] gridCoordValue]]) {
+            DLog(@"Consider end=%@ at %@", @(end), VT100GridCoordDescription([coords coordAtIndex:end]));
+            if ([self isWhitelistedAlphanumericAtCoord:[coords coordAtIndex:end]]) {
                 DLog(@"Is whitelisted");
                 ++end;
                 previousCharacterWasWhitelisted = YES;
@@ -546,7 +540,6 @@ const NSInteger kLongMaximumWordLength = 100000;
         // Same thing but in reverse.
 
         NSInteger start;
-        const NSUInteger numberOfCellsInPrefix = stringLengthsInPrefix.count;
 
         // `provisionalStart` is an initial place to begin looking for the start of the word. This is
         // used to compute the initial value of `start`, later on. If there is a suffix it is the index
@@ -565,7 +558,7 @@ const NSInteger kLongMaximumWordLength = 100000;
 
         // First, ensure that start is either at the start of a word (as defined by the OS) or on a
         // whitelisted character.
-        if ([self isWhitelistedAlphanumericAtCoord:[coords[provisionalStart] gridCoordValue]]) {
+        if ([self isWhitelistedAlphanumericAtCoord:[coords coordAtIndex:provisionalStart]]) {
             // On a whitelisted character. We'll search back past all of them.
             DLog(@"Starting on a whitelisted character");
             previousCharacterWasWhitelisted = YES;
@@ -583,8 +576,8 @@ const NSInteger kLongMaximumWordLength = 100000;
 
         //  Move back until two consecutive OS-defined words are found or we reach the start of the string.
         while (start > 0) {
-            DLog(@"Consider start=%@ at %@", @(start-1), VT100GridCoordDescription([coords[start - 1] gridCoordValue]));
-            if ([self isWhitelistedAlphanumericAtCoord:[coords[start - 1] gridCoordValue]]) {
+            DLog(@"Consider start=%@ at %@", @(start-1), VT100GridCoordDescription([coords coordAtIndex:start - 1]));
+            if ([self isWhitelistedAlphanumericAtCoord:[coords coordAtIndex:start - 1]]) {
                 DLog(@"Is whitelisted");
                 --start;
                 previousCharacterWasWhitelisted = YES;
@@ -601,8 +594,8 @@ const NSInteger kLongMaximumWordLength = 100000;
             }
         }
 
-        VT100GridCoord startCoord = [coords[start] gridCoordValue];
-        VT100GridCoord endCoord = [coords[end - 1] gridCoordValue];
+        VT100GridCoord startCoord = [coords coordAtIndex:start];
+        VT100GridCoord endCoord = [coords coordAtIndex:end - 1];
 
         // It's a half open interval so advance endCoord by one.
         endCoord.x += 1;
@@ -712,82 +705,55 @@ const NSInteger kLongMaximumWordLength = 100000;
                            range:(VT100GridWindowedRange *)range
                 ignoringNewlines:(BOOL)ignoringNewlines {
     location = [self coordLockedToWindow:location];
-    int targetOffset;
-    const int numLines = 2;
-    NSMutableArray* coords = [NSMutableArray arrayWithCapacity:numLines * _logicalWindow.length];
-    NSString *textWindow = [self textAround:location
-                                     radius:2
-                               targetOffset:&targetOffset
-                                     coords:coords
-                           ignoringNewlines:ignoringNewlines || [self hasLogicalWindow]];
+    iTermTextExtractionBuffer *buffer = [iTermTextExtractionBuffer checkOut];
+    const int targetOffset = [self getTextAround:location
+                                          radius:2
+                                        inBuffer:buffer
+                                ignoringNewlines:ignoringNewlines || [self hasLogicalWindow]];
+    NSString *textWindow = buffer.string;
 
     NSArray* rulesArray = rules ?: [SmartSelectionController defaultRules];
-    const int numRules = [rulesArray count];
+    iTermSmartSelectionMatcher *matcher = [iTermSmartSelectionMatcher matcherForRules:rulesArray];
 
     NSMutableDictionary* matches = [NSMutableDictionary dictionaryWithCapacity:13];
-    int numCoords = [coords count];
+    const NSInteger numCoords = buffer.length;
 
     BOOL debug = [SmartSelectionController logDebugInfo];
     if (debug) {
         NSLog(@"Perform smart selection on text: %@", textWindow);
     }
-    for (int j = 0; j < numRules; j++) {
-        NSDictionary *rule = [rulesArray objectAtIndex:j];
-        if (actionRequired && [[SmartSelectionController actionsInRule:rule] count] == 0) {
-            DLog(@"Ignore smart selection rule because it has no action: %@", rule);
-            continue;
+    [matcher enumerateMatchesInString:textWindow
+                     containingOffset:targetOffset
+                       actionRequired:actionRequired
+                                block:^(NSDictionary *rule, NSTextCheckingResult *regexMatch, double score) {
+        const NSRange temp = regexMatch.range;
+        NSString* result = [textWindow substringWithRange:temp];
+        SmartMatch* oldMatch = [matches objectForKey:result];
+        if (oldMatch && score <= oldMatch.score) {
+            return;
         }
-        NSString *regex = [SmartSelectionController regexInRule:rule];
-        double precision = [SmartSelectionController precisionInRule:rule];
+        SmartMatch* match = [[[SmartMatch alloc] init] autorelease];
+        match.score = score;
+        VT100GridCoord startCoord = [buffer coordAtIndex:temp.location];
+        VT100GridCoord endCoord = [buffer coordAtIndex:MIN(numCoords - 1,
+                                                           temp.location + temp.length - 1)];
+        endCoord = [self successorOfCoord:endCoord];
+        match.startX = startCoord.x;
+        match.absStartY = startCoord.y + [_dataSource totalScrollbackOverflow];
+        match.endX = endCoord.x;
+        match.absEndY = endCoord.y + [_dataSource totalScrollbackOverflow];
+        match.rule = rule;
+        match.components = [matcher componentsOfMatch:regexMatch inString:textWindow];
+        [matches setObject:match forKey:result];
+
         if (debug) {
-            NSLog(@"Try regex %@", regex);
-        }
-        for (int i = 0; i <= targetOffset; i++) {
-            NSString* substring = [textWindow substringWithRange:NSMakeRange(i, [textWindow length] - i)];
-            NSError* regexError = nil;
-            NSRange temp = [substring rangeOfRegex:regex
-                                           options:0
-                                           inRange:NSMakeRange(0, [substring length])
-                                           capture:0
-                                             error:&regexError];
-            if (temp.location != NSNotFound) {
-                if (i + temp.location <= targetOffset && i + temp.location + temp.length > targetOffset) {
-                    NSString* result = [substring substringWithRange:temp];
-                    double score = precision * (double) temp.length;
-                    SmartMatch* oldMatch = [matches objectForKey:result];
-                    if (!oldMatch || score > oldMatch.score) {
-                        SmartMatch* match = [[[SmartMatch alloc] init] autorelease];
-                        match.score = score;
-                        VT100GridCoord startCoord = [coords[i + temp.location] gridCoordValue];
-                        VT100GridCoord endCoord = [coords[MIN(numCoords - 1,
-                                                              i + temp.location + temp.length - 1)] gridCoordValue];
-                        endCoord = [self successorOfCoord:endCoord];
-                        match.startX = startCoord.x;
-                        match.absStartY = startCoord.y + [_dataSource totalScrollbackOverflow];
-                        match.endX = endCoord.x;
-                        match.absEndY = endCoord.y + [_dataSource totalScrollbackOverflow];
-                        match.rule = rule;
-                        match.components = [substring captureComponentsMatchedByRegex:regex
-                                                                              options:0
-                                                                                range:NSMakeRange(0, [substring length])
-                                                                                error:&regexError];
-                        [matches setObject:match forKey:result];
-
-                        if (debug) {
-                            NSLog(@"Regex matched. Add result %@ at %d,%lld -> %d,%lld with score %lf", result,
-                                  match.startX, match.absStartY, match.endX, match.absEndY,
-                                  match.score);
-                        }
-                    }
-                    i += temp.location + temp.length - 1;
-                } else {
-                    i += temp.location;
-                }
-            } else {
-                break;
-            }
+            NSLog(@"Regex %@ matched. Add result %@ at %d,%lld -> %d,%lld with score %lf",
+                  [SmartSelectionController regexInRule:rule], result,
+                  match.startX, match.absStartY, match.endX, match.absEndY,
+                  match.score);
         }
-    }
+    }];
+    [buffer checkIn];
 
     if ([matches count]) {
         NSArray* sortedMatches = [[matches allValues] sortedArrayUsingSelector:@selector(compare:)];
@@ -1170,11 +1136,12 @@ const NSInteger kLongMaximumWordLength = 100000;
     }
 }
 
-- (NSString *)textAround:(VT100GridCoord)coord
-                  radius:(int)radius
-            targetOffset:(int *)targetOffset
-                  coords:(NSMutableArray *)coords
-        ignoringNewlines:(BOOL)ignoringNewlines {
+// Fills `buffer` with the text around `coord`, and returns the index in it of the first code unit
+// at or after `coord`, or -1 if there isn't one.
+- (int)getTextAround:(VT100GridCoord)coord
+              radius:(int)radius
+            inBuffer:(iTermTextExtractionBuffer *)buffer
+    ignoringNewlines:(BOOL)ignoringNewlines {
     BOOL ignoreContinuations = (_logicalWindow.length > 0);
     int xLimit = [self xLimit];
     int trueWidth = [_dataSource width];
@@ -1182,8 +1149,7 @@ const NSInteger kLongMaximumWordLength = 100000;
                                                            coord.y - radius,
                                                            coord.x,
                                                            coord.y);
-    NSMutableString* joinedLines =
-        [NSMutableString stringWithCapacity:radius * _logicalWindow.length];
+    [buffer reset];
     VT100GridWindowedRange windowedRange = VT100GridWindowedRangeMake(theRange,
                                                                       _logicalWindow.location,
                                                                       _logicalWindow.length);
@@ -1202,11 +1168,9 @@ const NSInteger kLongMaximumWordLength = 100000;
                                    } else if (theChar.complexChar ||
                                               theChar.code < ITERM2_PRIVATE_BEGIN ||
                                               theChar.code > ITERM2_PRIVATE_END) {
-                                       NSString* string = CharToStr(theChar.code, theChar.complexChar) ?: @"";
-                                       [joinedLines insertString:string atIndex:0];
-                                       for (int i = 0; i < [string length]; i++) {
-                                         [coords insertObject:[NSValue valueWithGridCoord:charCoord] atIndex:0];
-                                       }
+                                       unichar temp[kMaxParts];
+                                       const int length = ExpandScreenChar(&theChar, temp);
+                                       [buffer prependCharacters:temp length:length coord:charCoord];
                                    }
                                    return NO;
                                }
@@ -1241,11 +1205,9 @@ const NSInteger kLongMaximumWordLength = 100000;
                           } else if (theChar.complexChar ||
                                      theChar.code < ITERM2_PRIVATE_BEGIN ||
                                      theChar.code > ITERM2_PRIVATE_END) {
-                              NSString* string = CharToStr(theChar.code, theChar.complexChar) ?: @"";
-                              [joinedLines appendString:string];
-                              for (int i = 0; i < [string length]; i++) {
-                                  [coords addObject:[NSValue valueWithGridCoord:charCoord]];
-                              }
+                              unichar temp[kMaxParts];
+                              const int length = ExpandScreenChar(&theChar, temp);
+                              [buffer appendCharacters:temp length:length coord:charCoord];
                           }
                           return NO;
                       }
@@ -1257,15 +1219,15 @@ const NSInteger kLongMaximumWordLength = 100000;
                                                      ignoringNewlines:ignoringNewlines];
                        }];
 
-    *targetOffset = -1;
-    for (int i = 0; i < coords.count; i++) {
-        NSComparisonResult order = VT100GridCoordOrder(coord, [coords[i] gridCoordValue]);
+    const VT100GridCoord *coords = buffer.coords;
+    const NSInteger length = buffer.length;
+    for (int i = 0; i < length; i++) {
+        NSComparisonResult order = VT100GridCoordOrder(coord, coords[i]);
         if (order != NSOrderedDescending) {
-            *targetOffset = i;
-            break;
+            return i;
         }
     }
-    return joinedLines;
+    return -1;
 }
 
 - (VT100GridWindowedRange)rangeForWrappedLineEncompassing:(VT100GridCoord)coord
@@ -1384,7 +1346,9 @@ trimTrailingWhitespace:(BOOL)trimSelectionTrailingSpaces
                   cappedAtSize:maxBytes
                   truncateTail:truncateTail
              continuationChars:continuationChars];
-    [coordsOut addObjectsFromArray:locatedString.coords];
+    if (coordsOut) {
+        [coordsOut addObjectsFromArray:[locatedString.gridCoords arrayOfValues]];
+    }
     return attributeProvider ? ((iTermLocatedAttributedString *)locatedString).attributedString : locatedString.string;
 }
 
@@ -0,0 +1,56 @@
+//
+//  iTermUnicodeTables.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+// Properties of each code point, packed into a byte. The tables are generated by
+// tools/unicode_tables.py from the character sets in NSCharacterSet+iTerm.m, which remain the
+// source of truth. Rerun it after changing them.
+typedef NS_OPTIONS(uint8_t, iTermUnicodeProperties) {
+    iTermUnicodePropertyFullWidth8 = 1 << 0,
+    iTermUnicodePropertyFullWidth9 = 1 << 1,
+    iTermUnicodePropertyAmbiguousWidth8 = 1 << 2,
+    iTermUnicodePropertyAmbiguousWidth9 = 1 << 3,
+    // Default_Ignorable_Code_Point.
+    iTermUnicodePropertyIgnorable = 1 << 4,
+    // +[NSCharacterSet spacingCombiningMarksForUnicodeVersion:12], before the advanced setting
+    // that controls whether it's used.
+    iTermUnicodePropertySpacingCombiningMark = 1 << 5,
+    // A BMP character that is a grapheme cluster by itself when the characters on either side of
+    // it also have this property. Never set for characters that need special handling by
+    // StringToScreenChars.
+    iTermUnicodePropertyOwnCluster = 1 << 6,
+};
+
+extern const uint8_t iTermUnicodePropertyIndex[0x110000 >> 8];
+extern const uint8_t iTermUnicodePropertyBlocks[][256];
+
+NS_INLINE iTermUnicodeProperties iTermUnicodePropertiesOfCharacter(UTF32Char c) {
+    if (c > 0x10ffff) {
+        return 0;
+    }
+    return iTermUnicodePropertyBlocks[iTermUnicodePropertyIndex[c >> 8]][c & 0xff];
+}
+
+// Equivalent to +[NSString isDoubleWidthCharacter:ambiguousIsDoubleWidth:unicodeVersion:].
+NS_INLINE BOOL iTermUnicodeIsDoubleWidth(iTermUnicodeProperties properties,
+                                         BOOL ambiguousIsDoubleWidth,
+                                         NSInteger unicodeVersion) {
+    iTermUnicodeProperties mask;
+    if (unicodeVersion >= 9) {
+        mask = iTermUnicodePropertyFullWidth9;
+        if (ambiguousIsDoubleWidth) {
+            mask |= iTermUnicodePropertyAmbiguousWidth9;
+        }
+    } else {
+        mask = iTermUnicodePropertyFullWidth8;
+        if (ambiguousIsDoubleWidth) {
+            mask |= iTermUnicodePropertyAmbiguousWidth8;
+        }
+    }
+    return (properties & mask) != 0;
+}
@@ -0,0 +1,31 @@
+//
+//  iTermVariablePath.h
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// An interned variable path like "session.name". There is one live instance per distinct string,
+// so paths are split into components only once and compare by pointer. The hash is computed up
+// front, which makes paths cheap dictionary keys. Unreferenced paths are freed.
+@interface iTermVariablePath : NSObject<NSCopying>
+
+@property (nonatomic, readonly) NSString *string;
+
+// The first component, like "session".
+@property (nonatomic, readonly) NSString *head;
+
+// Everything after the first component, like "name". Nil if there is only one component.
+@property (nullable, nonatomic, readonly) iTermVariablePath *tail;
+
++ (instancetype)pathWithString:(NSString *)string;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
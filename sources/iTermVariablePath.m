@@ -0,0 +1,69 @@
+//
+//  iTermVariablePath.m
+//  iTerm2SharedARC
+//
+//  Created by George Nachman on 10/19/26.
+//
+
+#import "iTermVariablePath.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation iTermVariablePath {
+    NSUInteger _hash;
+}
+
++ (instancetype)pathWithString:(NSString *)string {
+    // Values are held weakly because programs can create arbitrarily many user variables. A path
+    // only goes away once nothing references it, so nothing is left to compare it to by pointer.
+    static NSMapTable<NSString *, iTermVariablePath *> *paths;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        paths = [NSMapTable strongToWeakObjectsMapTable];
+    });
+    @synchronized(paths) {
+        iTermVariablePath *path = [paths objectForKey:string];
+        if (!path) {
+            path = [[self alloc] initWithString:string];
+            [paths setObject:path forKey:path.string];
+        }
+        return path;
+    }
+}
+
+- (instancetype)initWithString:(NSString *)string {
+    self = [super init];
+    if (self) {
+        _string = [string copy];
+        _hash = _string.hash;
+        const NSRange range = [_string rangeOfString:@"."];
+        if (range.location == NSNotFound) {
+            _head = _string;
+        } else {
+            _head = [_string substringToIndex:range.location];
+            // Called with the lock held. @synchronized is recursive.
+            _tail = [iTermVariablePath pathWithString:[_string substringFromIndex:NSMaxRange(range)]];
+        }
+    }
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p %@>", NSStringFromClass(self.class), self, _string];
+}
+
+- (NSUInteger)hash {
+    return _hash;
+}
+
+- (BOOL)isEqual:(id)object {
+    return self == object;
+}
+
+- (id)copyWithZone:(nullable NSZone *)zone {
+    return self;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
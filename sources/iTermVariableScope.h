@@ -39,6 +39,10 @@ NS_ASSUME_NONNULL_BEGIN
 - (id)valueForVariableName:(NSString *)name;
 - (id)valueForPath:(NSString *)firstName, ... NS_REQUIRES_NIL_TERMINATION;
 
+// Returns a number that changes whenever the value of the variable might have changed. Comparing
+// versions is cheaper than comparing values and does not require observing the variable.
+- (NSUInteger)versionForVariableName:(NSString *)name;
+
 - (NSString *)stringValueForVariableName:(NSString *)name;
 // Values of NSNull get unset
 - (void)setValuesFromDictionary:(NSDictionary<NSString *, id> *)dict;
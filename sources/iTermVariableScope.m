@@ -10,6 +10,7 @@
 #import "DebugLogging.h"
 #import "iTermObject.h"
 #import "iTermTuple.h"
+#import "iTermVariablePath.h"
 #import "iTermVariableReference.h"
 #import "iTermVariables.h"
 #import "iTermVariables+Private.h"
@@ -57,11 +58,73 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+// Where a path led the last time it was looked up. It holds while the scope's frames and every
+// iTermVariables consulted along the way keep their structure versions.
+@interface iTermVariableResolution : NSObject {
+@public
+    __weak iTermVariables *_owner;
+    NSString *_terminal;
+    // Newest of the frames version and the dependencies' structure versions.
+    NSUInteger _structureVersion;
+}
+- (instancetype)initWithFramesVersion:(NSUInteger)framesVersion NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+- (void)addDependency:(iTermVariables *)variables;
+- (BOOL)isValidForFramesVersion:(NSUInteger)framesVersion;
+@end
+
+@implementation iTermVariableResolution {
+    NSUInteger _framesVersion;
+    NSPointerArray *_dependencies;
+    NSMutableArray<NSNumber *> *_dependencyVersions;
+}
+
+- (instancetype)initWithFramesVersion:(NSUInteger)framesVersion {
+    self = [super init];
+    if (self) {
+        _framesVersion = framesVersion;
+        _structureVersion = framesVersion;
+        _dependencies = [NSPointerArray weakObjectsPointerArray];
+        _dependencyVersions = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)addDependency:(iTermVariables *)variables {
+    const NSUInteger version = variables.structureVersion;
+    [_dependencies addPointer:(__bridge void *)variables];
+    [_dependencyVersions addObject:@(version)];
+    _structureVersion = MAX(_structureVersion, version);
+}
+
+- (BOOL)isValidForFramesVersion:(NSUInteger)framesVersion {
+    if (framesVersion != _framesVersion || !_owner) {
+        return NO;
+    }
+    const NSUInteger count = _dependencies.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        // A freed dependency reads as nil, which also invalidates the resolution.
+        iTermVariables *variables = (__bridge iTermVariables *)[_dependencies pointerAtIndex:i];
+        if (!variables || variables.structureVersion != _dependencyVersions[i].unsignedIntegerValue) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@end
+
+// Resolutions for this many paths are kept per scope. A scope normally uses far fewer.
+static const NSUInteger iTermVariableScopeMaximumResolutions = 256;
+
 @implementation iTermVariableScope {
     NSMutableArray<iTermTuple<NSString *, iTermVariables *> *> *_frames;
     // References to paths without an owner. This normally only happens when a session is being
     // shut down (e.g, tab.currentSession is assigned to nil)
     NSPointerArray *_danglingReferences;
+    NSMutableDictionary<iTermVariablePath *, iTermVariableResolution *> *_resolutions;
+    // Changes when _frames does.
+    NSUInteger _framesVersion;
 }
 
 - (instancetype)init {
@@ -69,6 +132,8 @@ NS_ASSUME_NONNULL_BEGIN
     if (self) {
         _frames = [NSMutableArray array];
         _danglingReferences = [NSPointerArray weakObjectsPointerArray];
+        _resolutions = [NSMutableDictionary dictionary];
+        _framesVersion = iTermVariablesNewVersion();
     }
     return self;
 }
@@ -79,6 +144,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void)addVariables:(iTermVariables *)variables toScopeNamed:(nullable NSString *)scopeName {
     [_frames insertObject:[iTermTuple tupleWithObject:scopeName andObject:variables] atIndex:0];
+    _framesVersion = iTermVariablesNewVersion();
     [self resolveDanglingReferences];
 }
 
@@ -86,6 +152,7 @@ NS_ASSUME_NONNULL_BEGIN
     [_frames removeObjectsPassingTest:^BOOL(iTermTuple<NSString *,iTermVariables *> *obj) {
         return [obj.firstObject isEqual:name];
     }];
+    _framesVersion = iTermVariablesNewVersion();
 }
 
 - (NSArray<iTermVariables *> *)variablesInScopeNamed:(nullable NSString *)scopeName {
@@ -123,9 +190,81 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (id)valueForVariableName:(NSString *)name {
+    NSString *terminal = nil;
+    iTermVariables *owner = [self ownerOfTerminalForVariablePath:[iTermVariablePath pathWithString:name]
+                                                        terminal:&terminal
+                                                structureVersion:NULL];
+    return [owner valueForVariableName:terminal];
+}
+
+- (NSUInteger)versionForVariableName:(NSString *)name {
+    NSString *terminal = nil;
+    NSUInteger structureVersion = 0;
+    iTermVariables *owner = [self ownerOfTerminalForVariablePath:[iTermVariablePath pathWithString:name]
+                                                        terminal:&terminal
+                                                structureVersion:&structureVersion];
+    if (!owner) {
+        // Nothing records when a weakly held owner goes away, so assume it may change at any time.
+        return iTermVariablesNewVersion();
+    }
+    return MAX(structureVersion, [owner versionOfVariableNamed:terminal]);
+}
+
+// Finds the iTermVariables that holds the value for `path` for reading. Results are cached until
+// the frames or the structure of an iTermVariables consulted changes. Returns nil if the path goes
+// through something other than iTermVariables. `structureVersion` is set to a number that changes
+// when the result might.
+- (nullable iTermVariables *)ownerOfTerminalForVariablePath:(iTermVariablePath *)path
+                                                   terminal:(out NSString **)terminal
+                                           structureVersion:(out NSUInteger *)structureVersion {
+    // Reads used to be safe from any thread; only the main thread touches the cache.
+    const BOOL useCache = [NSThread isMainThread];
+    iTermVariableResolution *resolution = useCache ? _resolutions[path] : nil;
+    if ([resolution isValidForFramesVersion:_framesVersion]) {
+        iTermVariables *owner = resolution->_owner;
+        if (owner) {
+            *terminal = resolution->_terminal;
+            if (structureVersion) {
+                *structureVersion = resolution->_structureVersion;
+            }
+            return owner;
+        }
+    }
+
+    // Which frame a path starts in depends on what the anonymous frames define, so every frame is
+    // a dependency, as is each iTermVariables the path goes through.
+    resolution = [[iTermVariableResolution alloc] initWithFramesVersion:_framesVersion];
+    for (iTermTuple<NSString *, iTermVariables *> *tuple in _frames) {
+        [resolution addDependency:tuple.secondObject];
+    }
     NSString *stripped = nil;
-    iTermVariables *owner = [self ownerForKey:name forWriting:NO stripped:&stripped];
-    return [owner valueForVariableName:stripped];
+    iTermVariables *owner = [self ownerForKey:path.string forWriting:NO stripped:&stripped];
+    if (!owner) {
+        return nil;
+    }
+    iTermVariablePath *remainder = [iTermVariablePath pathWithString:stripped];
+    while (owner && remainder.tail) {
+        [resolution addDependency:owner];
+        owner = [iTermVariables castFrom:[owner valueForVariableName:remainder.head]];
+        remainder = remainder.tail;
+    }
+    if (!owner) {
+        return nil;
+    }
+    *terminal = remainder.head;
+    if (structureVersion) {
+        *structureVersion = resolution->_structureVersion;
+    }
+    if (!useCache) {
+        return owner;
+    }
+    resolution->_owner = owner;
+    resolution->_terminal = remainder.head;
+    if (!_resolutions[path] && _resolutions.count >= iTermVariableScopeMaximumResolutions) {
+        [_resolutions removeAllObjects];
+    }
+    _resolutions[path] = resolution;
+    return owner;
 }
 
 - (NSString *)stringValueForVariableName:(NSString *)name {
@@ -135,11 +274,8 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (nullable iTermVariables *)ownerForKey:(NSString *)key forWriting:(BOOL)forWriting stripped:(out NSString **)stripped {
-    NSArray<NSString *> *parts = [key componentsSeparatedByString:@"."];
-    if (parts.count == 0) {
-        return nil;
-    }
-    if (parts.count == 1) {
+    iTermVariablePath *path = [iTermVariablePath pathWithString:key];
+    if (!path.tail) {
         *stripped = key;
         if (!forWriting) {
             // Check all anonymous frames in case one of them is a match.
@@ -159,12 +295,12 @@ NS_ASSUME_NONNULL_BEGIN
     }
     __block NSString *strippedOut = nil;
     iTermVariables *owner = [_frames objectPassingTest:^BOOL(iTermTuple<NSString *,iTermVariables *> *element, NSUInteger index, BOOL *stop) {
-        if (element.firstObject == nil && [element.secondObject valueForVariableName:parts[0]]) {
+        if (element.firstObject == nil && [element.secondObject valueForVariableName:path.head]) {
             strippedOut = key;
             return YES;
         } else {
-            strippedOut = [[parts subarrayFromIndex:1] componentsJoinedByString:@"."];
-            return [element.firstObject isEqualToString:parts[0]];
+            strippedOut = path.tail.string;
+            return [element.firstObject isEqualToString:path.head];
         }
     }].secondObject;
     *stripped = strippedOut;
@@ -174,32 +310,26 @@ NS_ASSUME_NONNULL_BEGIN
 - (nullable iTermVariables *)ownerOfTerminalForPath:(NSString *)path
                                          forWriting:(BOOL)forWriting
                                            terminal:(out NSString **)terminal {
-    NSArray<NSString *> *parts = [path componentsSeparatedByString:@"."];
-    if (parts.count == 0) {
-        return nil;
-    }
-
     NSString *stripped;
     iTermVariables *owner = [self ownerForKey:path forWriting:forWriting stripped:&stripped];
     if (!owner) {
         return nil;
     }
 
-    parts = [stripped componentsSeparatedByString:@"."];
-    assert(parts.count > 0);
-    while (parts.count > 1) {
-        id value = [owner valueForVariableName:parts.firstObject];
+    iTermVariablePath *remainder = [iTermVariablePath pathWithString:stripped];
+    while (remainder.tail) {
+        id value = [owner valueForVariableName:remainder.head];
         if (value == nil) {
             return nil;
         }
         ITAssertWithMessage([value isKindOfClass:[iTermVariables class]],
                             @"Value is not iTermVariables. It is %@. The path is %@. The remaining parts are %@",
-                            value, path, parts);
+                            value, path, remainder.string);
         assert([value isKindOfClass:[iTermVariables class]]);
         owner = value;
-        parts = [parts subarrayFromIndex:1];
+        remainder = remainder.tail;
     }
-    *terminal = parts[0];
+    *terminal = remainder.head;
     return owner;
 }
 
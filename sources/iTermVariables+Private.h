@@ -7,12 +7,24 @@
 
 #import "iTermVariables.h"
 
+@class iTermVariablePath;
 @protocol iTermVariableReference;
 
+// Returns a number larger than any previously returned.
+NSUInteger iTermVariablesNewVersion(void);
+
 @interface iTermVariables(Private)
 
+// Changes when a variable of this object is defined or undefined, or when a nested iTermVariables
+// in it is assigned or replaced. Until it changes, a name looked up here finds the same nested
+// iTermVariables, or the same absence of one.
+- (NSUInteger)structureVersion;
+
 - (NSDictionary<NSString *, NSString *> *)stringValuedDictionaryInScope:(nullable NSString *)scopeName;
 - (nullable id)valueForVariableName:(NSString *)name;
+- (nullable id)valueForVariablePath:(iTermVariablePath *)path;
+// Version of the last assignment to a terminal value of this object, or 0 if it was never set.
+- (NSUInteger)versionOfVariableNamed:(NSString *)name;
 - (NSString *)stringValueForVariableName:(NSString *)name;
 - (BOOL)hasLinkToReference:(id<iTermVariableReference>)reference
                       path:(NSString *)path;
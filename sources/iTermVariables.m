@@ -9,7 +9,9 @@
 
 #import "DebugLogging.h"
 #import "iTermTuple.h"
+#import "iTermVariablePath.h"
 #import "iTermVariableReference.h"
+#import "iTermVariables+Private.h"
 #import "iTermVariablesIndex.h"
 #import "iTermWeakVariables.h"
 #import "NSArray+iTerm.h"
@@ -18,6 +20,8 @@
 #import "NSObject+iTerm.h"
 #import "NSStringITerm.h"
 
+#include <stdatomic.h>
+
 NS_ASSUME_NONNULL_BEGIN
 
 typedef iTermTriple<NSNumber *, iTermVariables *, NSString *> iTermVariablesDepthOwnerNamesTriple;
@@ -94,10 +98,22 @@ NSString *const iTermVariableKeyWindowNumber = @"number";
 
 // NOTE: If you add here, also update +recordBuiltInVariables
 
+#pragma mark - Versions
+
+// Both kinds of version are drawn from this counter so a version never repeats.
+static _Atomic NSUInteger iTermVariablesLastVersion;
+
+NSUInteger iTermVariablesNewVersion(void) {
+    return atomic_fetch_add_explicit(&iTermVariablesLastVersion, 1, memory_order_relaxed) + 1;
+}
+
 #pragma mark -
 
 @implementation iTermVariables {
     NSMutableDictionary<NSString *, id> *_values;
+    // Version of each terminal value, including ones that have been unset.
+    NSMutableDictionary<NSString *, NSNumber *> *_versions;
+    NSUInteger _structureVersion;
     __weak iTermVariables *_parent;
     NSString *_parentName;
     iTermVariablesSuggestionContext _context;
@@ -124,6 +140,8 @@ NSString *const iTermVariableKeyWindowNumber = @"number";
         _owner = owner;
         _context = context;
         _values = [NSMutableDictionary dictionary];
+        _versions = [NSMutableDictionary dictionary];
+        _structureVersion = iTermVariablesNewVersion();
         _resolvedLinks = [NSMutableDictionary dictionary];
         _unresolvedLinks = [NSMutableDictionary dictionary];
 
@@ -204,20 +222,24 @@ NSString *const iTermVariableKeyWindowNumber = @"number";
 }
 
 - (nullable id)valueForVariableName:(NSString *)name {
-    if (_values[name]) {
-        return [self valueByUnwrappingWeakVariables:_values[name]];
-    }
-    NSArray<NSString *> *parts = [name componentsSeparatedByString:@"."];
-    if (parts.count <= 1) {
-        return nil;
-    }
+    return [self valueForVariablePath:[iTermVariablePath pathWithString:name]];
+}
 
-    id value = _values[parts.firstObject];
-    iTermVariables *child = [iTermVariables castFrom:[self valueByUnwrappingWeakVariables:value]];
-    if (!child) {
-        return nil;
+- (nullable id)valueForVariablePath:(iTermVariablePath *)path {
+    id value = [self valueByUnwrappingWeakVariables:_values[path.head]];
+    if (!path.tail) {
+        return value;
     }
-    return [child valueForVariableName:[[parts subarrayFromIndex:1] componentsJoinedByString:@"."]];
+    iTermVariables *child = [iTermVariables castFrom:value];
+    return [child valueForVariablePath:path.tail];
+}
+
+- (NSUInteger)structureVersion {
+    return _structureVersion;
+}
+
+- (NSUInteger)versionOfVariableNamed:(NSString *)name {
+    return _versions[name].unsignedIntegerValue;
 }
 
 - (NSString *)stringValueForVariableName:(NSString *)name {
@@ -241,30 +263,31 @@ NSString *const iTermVariableKeyWindowNumber = @"number";
 
 - (void)addLinkToReference:(id<iTermVariableReference>)reference
                       path:(NSString *)path {
-    NSArray<NSString *> *parts = [path componentsSeparatedByString:@"."];
-    id value = _values[parts.firstObject];
+    iTermVariablePath *variablePath = [iTermVariablePath pathWithString:path];
+    NSString *head = variablePath.head;
+    id value = _values[head];
     if (value) {
-        [self addWeakReferenceToLinkTable:_resolvedLinks toObject:reference forKey:parts.firstObject];
-        [reference addLinkToVariables:self localPath:parts.firstObject];
+        [self addWeakReferenceToLinkTable:_resolvedLinks toObject:reference forKey:head];
+        [reference addLinkToVariables:self localPath:head];
         iTermVariables *sub = [iTermVariables castFrom:[self valueByUnwrappingWeakVariables:value]];
-        if (sub && parts.count > 1) {
-            [sub addLinkToReference:reference path:[[parts subarrayFromIndex:1] componentsJoinedByString:@"."]];
+        if (sub && variablePath.tail) {
+            [sub addLinkToReference:reference path:variablePath.tail.string];
         }
     } else {
-        [self addWeakReferenceToLinkTable:_unresolvedLinks toObject:reference forKey:parts.firstObject];
+        [self addWeakReferenceToLinkTable:_unresolvedLinks toObject:reference forKey:head];
     }
 }
 
 - (BOOL)hasLinkToReference:(id<iTermVariableReference>)reference
                       path:(NSString *)path {
-    NSArray<NSString *> *parts = [path componentsSeparatedByString:@"."];
-    id value = _values[parts.firstObject];
+    iTermVariablePath *variablePath = [iTermVariablePath pathWithString:path];
+    id value = _values[variablePath.head];
     if (!value) {
         return [_unresolvedLinks[path].allObjects containsObject:reference];
     }
     iTermVariables *sub = [iTermVariables castFrom:[self valueByUnwrappingWeakVariables:value]];
-    if (sub && parts.count > 1) {
-        return [sub hasLinkToReference:reference path:[[parts subarrayFromIndex:1] componentsJoinedByString:@"."]];
+    if (sub && variablePath.tail) {
+        return [sub hasLinkToReference:reference path:variablePath.tail.string];
     }
     return [_resolvedLinks[path].allObjects containsObject:reference];
 }
@@ -385,28 +408,38 @@ NSString *const iTermVariableKeyWindowNumber = @"number";
     }
 
     // If name refers to a variable of a child, go down a level.
-    NSArray<NSString *> *parts = [name componentsSeparatedByString:@"."];
-    if (parts.count > 1) {
-        iTermVariables *child = [iTermVariables castFrom:[self valueByUnwrappingWeakVariables:_values[parts.firstObject]]];
+    iTermVariablePath *path = [iTermVariablePath pathWithString:name];
+    if (path.tail) {
+        iTermVariables *child = [iTermVariables castFrom:[self valueByUnwrappingWeakVariables:_values[path.head]]];
         if (!child) {
             return nil;
         }
         return [child setValue:value
-              forVariableNamed:[[parts subarrayFromIndex:1] componentsJoinedByString:@"."]
+              forVariableNamed:path.tail.string
                withSideEffects:sideEffects
                           weak:weak];
     }
 
-    const BOOL changed = ![NSObject object:value isEqualToObject:[self valueByUnwrappingWeakVariables:_values[name]]];
+    id oldValue = [self valueByUnwrappingWeakVariables:_values[name]];
+    const BOOL changed = ![NSObject object:value isEqualToObject:oldValue];
     if (!changed) {
         return self;
     }
+    const BOOL isSet = (value && ![NSNull castFrom:value]);
+    if (!oldValue ||
+        !isSet ||
+        [oldValue isKindOfClass:[iTermVariables class]] ||
+        [value isKindOfClass:[iTermVariables class]]) {
+        // Changing which variables exist or how they nest can change what a path resolves to.
+        _structureVersion = iTermVariablesNewVersion();
+    }
+    _versions[name] = @(iTermVariablesNewVersion());
     iTermVariables *child = [iTermVariables castFrom:value];
     if (child && !weak) {
         child->_parentName = [name copy];
         child->_parent = self;
     }
-    if (value && ![NSNull castFrom:value]) {
+    if (isSet) {
         if ([value isKindOfClass:[iTermVariables class]]) {
             if (weak) {
                 _values[name] = [[iTermWeakVariables alloc] initWithVariables:value];
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Generates sources/iTermUnicodeTables.c.
+
+Run from the repo root:
+    tools/unicode_tables.py > sources/iTermUnicodeTables.c
+
+The width, ignorable, and spacing combining mark properties are read from the character sets in
+sources/NSCharacterSet+iTerm.m so the tables always agree with them. Rerun this after changing
+those sets. Whether a character is its own grapheme cluster comes from Python's unicodedata.
+
+Each code point gets one byte of properties. The bits are defined in iTermUnicodeTables.h. The
+table has two stages: the high bits of a code point select one of a small number of distinct
+256-entry blocks, and the low 8 bits index into it.
+"""
+import re
+import sys
+import unicodedata
+
+CHARACTER_SETS = "sources/NSCharacterSet+iTerm.m"
+
+# Must match iTermUnicodeTables.h.
+FULL_WIDTH_8 = 1 << 0
+FULL_WIDTH_9 = 1 << 1
+AMBIGUOUS_WIDTH_8 = 1 << 2
+AMBIGUOUS_WIDTH_9 = 1 << 3
+IGNORABLE = 1 << 4
+SPACING_COMBINING_MARK = 1 << 5
+OWN_CLUSTER = 1 << 6
+
+MAX_CODE_POINT = 0x10ffff
+BLOCK_SIZE = 256
+
+def method_body(source, selector):
+    """Returns the text of the class method whose selector begins with selector."""
+    start = source.index("+ (instancetype)" + selector)
+    end = source.index("\n}\n", start)
+    return source[start:end]
+
+def ranges_added_to(body, variable):
+    """Yields (location, length) for each addCharactersInRange: on variable."""
+    pattern = r"\[%s addCharactersInRange:NSMakeRange\(([^,]+),([^\)]+)\)\];" % re.escape(variable)
+    for m in re.finditer(pattern, body):
+        # Lengths are either literals or like 0x115f - 0x1100 + 1.
+        yield int(m.group(1), 16), eval(m.group(2), {"__builtins__": {}})
+
+def mark(properties, body, variable, bit):
+    for location, length in ranges_added_to(body, variable):
+        for c in range(location, min(location + length, MAX_CODE_POINT + 1)):
+            properties[c] |= bit
+
+# Hangul jamo combine with the syllables and jamo around them.
+HANGUL_JAMO = [(0x1100, 0x11ff), (0xa960, 0xa97f), (0xd7b0, 0xd7ff)]
+
+# Grapheme_Cluster_Break=Prepend in the BMP. These combine with the following character.
+PREPEND = [(0x600, 0x605), (0x6dd, 0x6dd), (0x70f, 0x70f), (0x890, 0x891), (0x8e2, 0x8e2),
+           (0xd4e, 0xd4e)]
+
+# Grapheme_Extend and SpacingMark characters in the BMP that aren't in a mark category.
+EXTEND_OTHER = [(0x200c, 0x200d), (0xe33, 0xe33), (0xeb3, 0xeb3), (0xff9e, 0xff9f)]
+
+# Reserved for iTerm2's own use, as in ScreenChar.h. StringToScreenChars converts them.
+ITERM2_PRIVATE = [(0xf000, 0xf003)]
+
+def in_ranges(c, ranges):
+    return any(low <= c <= high for low, high in ranges)
+
+def is_own_cluster(c, properties):
+    """True if c can't combine with its neighbors as long as they are also own-cluster characters.
+
+    This is conservative: it's fine to leave out characters that would turn out to be alone.
+    """
+    if c > 0xffff or 0xd800 <= c <= 0xdfff:
+        # Takes a surrogate pair in UTF-16.
+        return False
+    if c == 0x0d:
+        # CR LF is one cluster.
+        return False
+    if unicodedata.category(chr(c)) in ("Mn", "Mc", "Me"):
+        return False
+    if properties[c] & (IGNORABLE | SPACING_COMBINING_MARK):
+        return False
+    for ranges in (HANGUL_JAMO, PREPEND, EXTEND_OTHER, ITERM2_PRIVATE):
+        if in_ranges(c, ranges):
+            return False
+    return True
+
+def main():
+    source = open(CHARACTER_SETS).read()
+    properties = [0] * (MAX_CODE_POINT + 1)
+
+    full_width = method_body(source, "fullWidthCharacterSetForUnicodeVersion:")
+    mark(properties, full_width, "sFullWidth8", FULL_WIDTH_8)
+    mark(properties, full_width, "sFullWidth9", FULL_WIDTH_9)
+
+    ambiguous = method_body(source, "ambiguousWidthCharacterSetForUnicodeVersion:")
+    mark(properties, ambiguous, "sAmbiguousWidth8", AMBIGUOUS_WIDTH_8)
+    mark(properties, ambiguous, "sAmbiguousWidth9", AMBIGUOUS_WIDTH_9)
+
+    mark(properties, method_body(source, "ignorableCharactersForUnicodeVersion:"),
+         "defaultIgnorables", IGNORABLE)
+    mark(properties, method_body(source, "spacingCombiningMarksForUnicodeVersion:"),
+         "set", SPACING_COMBINING_MARK)
+
+    for c in range(0x10000):
+        if is_own_cluster(c, properties):
+            properties[c] |= OWN_CLUSTER
+
+    blocks = []
+    block_numbers = {}
+    index = []
+    for start in range(0, MAX_CODE_POINT + 1, BLOCK_SIZE):
+        block = tuple(properties[start:start + BLOCK_SIZE])
+        if block not in block_numbers:
+            block_numbers[block] = len(blocks)
+            blocks.append(block)
+        index.append(block_numbers[block])
+
+    out = sys.stdout
+    out.write("// Generated by tools/unicode_tables.py from NSCharacterSet+iTerm.m and Unicode %s.\n"
+              % unicodedata.unidata_version)
+    out.write("// Do not edit.\n\n")
+    out.write('#include "iTermUnicodeTables.h"\n\n')
+    out.write("const uint8_t iTermUnicodePropertyBlocks[%d][%d] = {\n" % (len(blocks), BLOCK_SIZE))
+    for block in blocks:
+        out.write("    {\n")
+        for row in range(0, BLOCK_SIZE, 16):
+            out.write("        " + ", ".join("0x%02x" % v for v in block[row:row + 16]) + ",\n")
+        out.write("    },\n")
+    out.write("};\n\n")
+    out.write("const uint8_t iTermUnicodePropertyIndex[%d] = {\n" % len(index))
+    for row in range(0, len(index), 16):
+        out.write("    " + ", ".join("%d" % v for v in index[row:row + 16]) + ",\n")
+    out.write("};\n")
+    assert len(blocks) <= 256
+
+if __name__ == "__main__":
+    main()